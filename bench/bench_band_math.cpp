@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <CLI/CLI.hpp>
+
+#include "band_math.h"
+#include "bench_gdal_utils.h"
+#include "bench_utils.h"
+#include "block_grid.h"
+#include "codec_collection.h"
+#include "gdal_priv.h"
+
+static std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>>
+BuildAllCodecs() {
+  auto pool = InitCodecs(/* nonCascaded */ true, nullptr);
+  for (auto& c :
+       InitCodecs(/* nonCascaded */ false, std::make_unique<DeltaCodec>()))
+    pool.push_back(std::move(c));
+  return pool;
+}
+
+static std::size_t ElapsedNs(std::chrono::steady_clock::time_point t0) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - t0)
+      .count();
+}
+
+// Baseline: decode every referenced band in full, evaluate the program
+// over whole bands (one full-band register per stack slot), then encode
+// the output tiles.
+static BlockGrid BandMathDecodeAll(
+    const BandMathExpr& e, const std::vector<const BlockGrid*>& bands,
+    const StatefulIntegerCodec<int32_t>& outProto, const BandMathParams& p,
+    int numThreads) {
+  const BlockGrid& shape = CheckBandMathInputs(e, bands);
+  const std::size_t n = shape.TileLength();
+  const std::size_t total = n * shape.tiles.size();
+  std::vector<std::vector<int32_t>> decoded(bands.size());
+  std::vector<const int32_t*> in(bands.size(), nullptr);
+  for (int b : e.bands) {
+    decoded[b].resize(total + bands[b]->MaxOverflow());
+#pragma omp parallel for num_threads(numThreads) schedule(dynamic)
+    for (std::size_t t = 0; t < shape.tiles.size(); ++t)
+      bands[b]->tiles[t]->DecodeRange(decoded[b].data() + t * n, 0, n, n);
+    in[b] = decoded[b].data();
+  }
+
+  std::vector<float> regs(static_cast<std::size_t>(e.maxDepth) * total);
+  std::vector<int32_t> result(total);
+  RunBandMath(e, in.data(), total, regs.data(), total, result.data(), p);
+
+  BlockGrid out;
+  out.blockSize = shape.blockSize;
+  out.blocksX = shape.blocksX;
+  out.blocksY = shape.blocksY;
+  out.tiles.resize(shape.tiles.size());
+#pragma omp parallel for num_threads(numThreads) schedule(dynamic)
+  for (std::size_t t = 0; t < out.tiles.size(); ++t) {
+    out.tiles[t].reset(outProto.CloneFresh());
+    out.tiles[t]->AllocEncoded(result.data() + t * n, n);
+    out.tiles[t]->EncodeArray(result.data() + t * n, n);
+  }
+  return out;
+}
+
+static bool SameGrid(const BlockGrid& a, const BlockGrid& b) {
+  std::vector<int32_t> x(a.TileLength() + a.MaxOverflow()),
+      y(b.TileLength() + b.MaxOverflow());
+  for (int by = 0; by < a.blocksY; ++by)
+    for (int bx = 0; bx < a.blocksX; ++bx) {
+      a.DecodeTile(bx, by, x.data());
+      b.DecodeTile(bx, by, y.data());
+      if (!std::equal(x.begin(), x.begin() + a.TileLength(), y.begin()))
+        return false;
+    }
+  return true;
+}
+
+int main(int argc, char* argv[]) {
+  CLI::App app{
+      "Benchmark fused, chunked band math over compressed band grids against "
+      "decoding every band and then computing"};
+
+  std::vector<std::string> filePaths;
+  int blockSize{}, numReps{};
+  std::string expression = "(B2 - B1) / (B2 + B1)";
+  float scale = 10000.0f;
+  std::vector<std::string> codecNames = {"[+]_custom_delta_unvec+simdcomp"};
+  std::string outCodecName = "simdcomp_for";
+  std::vector<std::size_t> chunks = {1024};
+  int numThreads = 1;
+  std::vector<std::string> kernels = {"auto"};
+
+  app.add_option("files", filePaths,
+                 "One multi-band GeoTIFF, or one GeoTIFF per band (B1, B2, "
+                 "... in order)")
+      ->required();
+  app.add_option("--blocksize,-b", blockSize, "Block side length in pixels")
+      ->required();
+  app.add_option("--numreps,-r", numReps, "Repetitions per combination")
+      ->required();
+  app.add_option("--expr,-e", expression, "Band math expression over B1..Bn");
+  app.add_option("--scale", scale, "Output is round(value * scale)");
+  app.add_option("--codec", codecNames,
+                 "Codec name(s) holding the band grids, or 'all'");
+  app.add_option("--ocodec", outCodecName, "Codec for the output grid");
+  app.add_option("--chunk", chunks, "Chunk size(s) in values");
+  app.add_option("--threads,-t", numThreads, "OpenMP threads");
+  app.add_option("--kernel", kernels,
+                 "Kernel(s): auto|scalar|sse41|avx2|avx512");
+
+  CLI11_PARSE(app, argc, argv);
+
+  GDALAllRegister();
+  GDALSetCacheMax(64 * 1024 * 1024);
+  std::vector<GDALDataset*> open;
+  std::vector<GDALRasterBand*> rasterBands;
+  for (auto& path : filePaths) {
+    auto* dataset =
+        static_cast<GDALDataset*>(GDALOpen(path.c_str(), GA_ReadOnly));
+    if (dataset == nullptr) {
+      std::cerr << std::format("Failed to open file: {}", path) << '\n';
+      return 1;
+    }
+    open.push_back(dataset);
+    const int count = filePaths.size() == 1 ? dataset->GetRasterCount() : 1;
+    for (int b = 1; b <= count; ++b)
+      rasterBands.push_back(dataset->GetRasterBand(b));
+  }
+
+  BandMathExpr e = CompileBandMath(expression);
+  if (!e.bands.empty() &&
+      e.bands.back() >= static_cast<int>(rasterBands.size())) {
+    std::cerr << std::format("Expression reads B{} but only {} bands given",
+                             e.bands.back() + 1, rasterBands.size())
+              << '\n';
+    return 1;
+  }
+  auto pool = BuildAllCodecs();
+  auto codecs = SelectCodecsByName(pool, codecNames);
+  auto outCodecs = SelectCodecsByName(pool, {outCodecName});
+  if (codecs.empty() || outCodecs.empty()) {
+    std::cerr << "NO CODECS SELECTED.\n";
+    return 1;
+  }
+
+  for (auto& codec : codecs) {
+    // Only the bands the expression reads are ingested.
+    std::vector<BlockGrid> grids(rasterBands.size());
+    std::vector<const BlockGrid*> bands(rasterBands.size(), nullptr);
+    std::size_t inputBytes = 0;
+    for (int b : e.bands) {
+      grids[b] = ReadBlockGrid(rasterBands[b], blockSize, *codec, numThreads);
+      inputBytes += grids[b].EncodedBytes();
+      bands[b] = &grids[b];
+    }
+
+    for (auto& kernel : kernels) {
+      SetTransformationSimdLevel(ParseSimdLevel(kernel));
+      for (std::size_t chunk : chunks) {
+        BandMathParams params{.scale = scale, .chunkValues = chunk};
+        std::cout << "**BENCHMARK BANDMATH**\n";
+        std::cout << std::format(
+                         "expr={},bands={},blocksize={},numreps={},codec={},"
+                         "outcodec={},chunk={},threads={},kernel={},"
+                         "inputbytes={}",
+                         expression, rasterBands.size(), blockSize, numReps,
+                         codec->name(), outCodecs[0]->name(), chunk,
+                         numThreads, ToString(TransformationSimdLevel()),
+                         inputBytes)
+                  << '\n';
+
+        RunningStats wall, decode, eval, encode, decodeAll;
+        bool match = true;
+        for (int rep = 0; rep < numReps; ++rep) {
+          BandMathStats stats;
+          BlockGrid fused = EvaluateBandMath(e, bands, *outCodecs[0], params,
+                                             numThreads, &stats);
+          wall.Update(stats.wallTime);
+          decode.Update(stats.decodeTime);
+          eval.Update(stats.evalTime);
+          encode.Update(stats.encodeTime);
+
+          auto t0 = std::chrono::steady_clock::now();
+          BlockGrid reference =
+              BandMathDecodeAll(e, bands, *outCodecs[0], params, numThreads);
+          decodeAll.Update(ElapsedNs(t0));
+          if (rep == 0) match = SameGrid(fused, reference);
+        }
+        std::cout << std::format(
+                         "tottimewall:{},meantimewall:{},vartimewall:{},"
+                         "meantimedecode:{},meantimeeval:{},meantimeencode:{},"
+                         "match:{}",
+                         wall.Total(), wall.mean, wall.Variance(), decode.mean,
+                         eval.mean, encode.mean, match)
+                  << '\n';
+        std::cout << std::format("decodeall:meantimewall:{},vartimewall:{}",
+                                 decodeAll.mean, decodeAll.Variance())
+                  << '\n';
+        if (wall.mean > 0)
+          std::cout << std::format("speedupvsdecodeall:{}",
+                                   decodeAll.mean / wall.mean)
+                    << '\n';
+      }
+    }
+  }
+
+  for (auto* dataset : open) GDALClose(dataset);
+  return 0;
+}
@@ -0,0 +1,127 @@
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <CLI/CLI.hpp>
+
+#include "bench_gdal_utils.h"
+#include "bench_utils.h"
+#include "cascade_search.h"
+#include "codec_collection.h"
+#include "gdal_priv.h"
+
+int main(int argc, char* argv[]) {
+  CLI::App app{
+      "Search codec chains (ordering, logical stages, physical codec) on "
+      "sample blocks and print the Pareto front of compression factor "
+      "against decode time"};
+
+  std::string filePath;
+  int blockSize{}, nBlocks{};
+  std::vector<std::string> orderings = {"default", "zigzag", "morton"};
+  std::vector<std::string> logicalNames = {"all"};
+  std::vector<std::string> physicalNames = {"all"};
+  CascadeSearchParams params;
+  bool printAll = false;
+
+  app.add_option("file", filePath, "GeoTIFF file path")->required();
+  app.add_option("--blocksize,-b", blockSize, "Block side length in pixels")
+      ->required();
+  app.add_option("--numblocks,-n", nBlocks, "Number of blocks to sample")
+      ->required();
+  app.add_option("--ordering", orderings,
+                 "Block ordering(s) to try: default|zigzag|morton");
+  app.add_option("--logical", logicalNames,
+                 "Logical stage codec name(s), or 'all'");
+  app.add_option("--physical", physicalNames,
+                 "Physical terminator codec name(s), or 'all'");
+  app.add_option("--stages", params.maxLogicalStages,
+                 "Maximum logical stages per chain");
+  app.add_option("--beam", params.beamWidth, "Prefixes kept per depth");
+  app.add_option("--decodereps", params.decodeReps,
+                 "Decode timings per sample (fastest counts)");
+  app.add_flag("--all", printAll, "Print every chain evaluated");
+
+  CLI11_PARSE(app, argc, argv);
+
+  GDALAllRegister();
+  GDALDataset* dataset =
+      static_cast<GDALDataset*>(GDALOpen(filePath.c_str(), GA_ReadOnly));
+  if (dataset == nullptr) {
+    std::cerr << std::format("Failed to open file: {}", filePath) << '\n';
+    return 1;
+  }
+  GDALRasterBand* band = dataset->GetRasterBand(1);
+  const int rasterWidth = band->GetXSize();
+  const int rasterHeight = band->GetYSize();
+
+  auto logicalPool = InitLogicalCodecs();
+  auto physicalPool = InitPhysicalCodecs();
+  auto logical = SelectCodecsByName(logicalPool, logicalNames);
+  auto physical = SelectCodecsByName(physicalPool, physicalNames);
+  if (logical.empty() && physical.empty()) {
+    std::cerr << "NO CODECS SELECTED.\n";
+    return 1;
+  }
+
+  // Shift values non-negative as bench_comp does.
+  int32_t globalMin = std::numeric_limits<int32_t>::max();
+  for (int y = 0; y < rasterHeight / blockSize; ++y)
+    for (int x = 0; x < rasterWidth / blockSize; ++x)
+      ComputeMinForBlock(band, x * blockSize, y * blockSize, blockSize,
+                         globalMin);
+
+  std::vector<std::vector<int32_t>> rowMajor;
+  for (auto& offset : SampleBlockOffsets(rasterWidth / blockSize,
+                                         rasterHeight / blockSize, blockSize,
+                                         nBlocks)) {
+    auto block = ReadGeoTiffBlock(band, offset.x, offset.y, blockSize,
+                                  rasterWidth, rasterHeight);
+    if (static_cast<int>(block.size()) != blockSize * blockSize) continue;
+    if (globalMin < 0)
+      for (auto& v : block) v += (-globalMin);
+    rowMajor.push_back(std::move(block));
+  }
+
+  std::vector<CascadeCandidate> all;
+  std::vector<Ordering> allOrderings;
+  for (auto& orderingName : orderings) {
+    Ordering ordering = ParseOrdering(orderingName);
+    auto samples = rowMajor;
+    for (auto& s : samples) ApplyOrdering(s, ordering, blockSize);
+    for (auto& c : SearchCascades(logical, physical, samples, params)) {
+      all.push_back(std::move(c));
+      allOrderings.push_back(ordering);
+    }
+  }
+
+  std::cout << "**BENCHMARK CASCADESEARCH**\n";
+  std::cout << std::format(
+                   "file={},blocksize={},numblocks={},samples={},"
+                   "maxlogicalstages={},beam={},decodereps={},evaluated={}",
+                   filePath, blockSize, nBlocks, rowMajor.size(),
+                   params.maxLogicalStages, params.beamWidth,
+                   params.decodeReps, all.size())
+            << '\n';
+
+  auto print = [&](const char* tag, std::size_t i) {
+    const auto& c = all[i];
+    std::cout << std::format(
+                     "{}:{},ordering:{},stages:{},ok:{},cf:{},tencpervalue:{},"
+                     "tdecpervalue:{},score:{}",
+                     tag, c.name, ToString(allOrderings[i]),
+                     c.logical.size() + (c.physical >= 0), c.ok, c.cf,
+                     c.tencPerValue, c.tdecPerValue, c.Score())
+              << '\n';
+  };
+  if (printAll)
+    for (std::size_t i = 0; i < all.size(); ++i) print("chain", i);
+  for (std::size_t i : ParetoFront(all)) print("pareto", i);
+
+  GDALClose(dataset);
+  return 0;
+}
@@ -1,6 +1,7 @@
 #include <algorithm>
 #include <limits>
 #include <memory>
+#include <optional>
 #include <format>
 #include <iostream>
 #include <ranges>
@@ -11,7 +12,11 @@
 #include "bench_gdal_utils.h"
 #include "bench_utils.h"
 #include "codec_collection.h"
+#include "error_bounded_codec.h"
 #include "gdal_priv.h"
+#include "lz4_codecs.h"
+#include "shuffle_codecs.h"
+#include "stage_pipeline.h"
 
 // If `compositeName` matches a codec in the non-cascaded pool, returns that
 // codec cascaded with all physical codecs. Otherwise returns the full
@@ -39,34 +44,190 @@ static std::vector<CodecStats> BenchmarkWindow(
   return stats;
 }
 
+// Makes sure the two-pass delta + simdcomp composite and the single-pass
+// SimdComp-D1 codecs are all benchmarked, for the d1contrast lines.
+static void AddD1ContrastCodecs(
+    std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>>& codecs) {
+  std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>> wanted;
+  wanted.push_back(std::make_unique<CompositeStatefulIntegerCodec<int32_t>>(
+      std::make_unique<DeltaCodec>(), std::make_unique<SimdCompCodec>()));
+  wanted.push_back(std::make_unique<SimdCompD1Codec>());
+  wanted.push_back(std::make_unique<SimdCompD1Codec>(/* zigzag */ true));
+  for (auto& w : wanted)
+    if (std::ranges::none_of(codecs,
+                             [&](auto& c) { return c->name() == w->name(); }))
+      codecs.push_back(std::move(w));
+}
+
+// General-purpose codecs across their speed/ratio range, so they are not
+// judged by one default setting.
+static void AddLevelSweepCodecs(
+    std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>>& codecs,
+    const std::vector<int>& zstdLevels, const std::vector<int>& lz4Accels,
+    const std::vector<int>& lz4hcLevels) {
+  for (int level : zstdLevels)
+    codecs.push_back(std::make_unique<ZstdCodec>(level));
+  for (int accel : lz4Accels)
+    codecs.push_back(std::make_unique<LZ4Codec>(accel));
+  for (int level : lz4hcLevels)
+    codecs.push_back(std::make_unique<LZ4Codec>(1, level));
+}
+
+// Adds each byte-oriented codec (Zstd and LZ4 at their defaults if there
+// are none) behind a byte and/or bit shuffle.
+static void AddShuffleCodecs(
+    std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>>& codecs,
+    const std::vector<std::string>& shuffles) {
+  if (shuffles.empty()) return;
+  if (std::ranges::none_of(codecs, [](auto& c) { return c->AcceptsBytes(); })) {
+    codecs.push_back(std::make_unique<ZstdCodec>(3));
+    codecs.push_back(std::make_unique<LZ4Codec>());
+  }
+  const std::size_t numCodecs = codecs.size();
+  for (auto& shuffle : shuffles) {
+    if (shuffle != "byte" && shuffle != "bit")
+      throw std::invalid_argument("Unknown shuffle: " + shuffle);
+    for (std::size_t ci = 0; ci < numCodecs; ++ci) {
+      if (!codecs[ci]->AcceptsBytes()) continue;
+      std::unique_ptr<ByteStage<int32_t>> stage;
+      if (shuffle == "byte")
+        stage = std::make_unique<ByteShuffleStage>();
+      else
+        stage = std::make_unique<BitShuffleStage>();
+      codecs.push_back(std::make_unique<ByteCompositeCodec<int32_t>>(
+          std::move(stage), std::unique_ptr<StatefulIntegerCodec<int32_t>>(
+                                codecs[ci]->CloneFresh())));
+    }
+  }
+}
+
+// Typed pipelines whose bit packer or shuffle feeds a byte compressor,
+// which the int32-only composites cannot express.
+static void AddStagePipelineCodecs(
+    std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>>& codecs) {
+  using DeltaPack =
+      StagePipeline<ValueStage<DeltaCodec>, PackStage<SimdCompCodec>,
+                    ByteCodecStage<LZ4Codec>>;
+  using DeltaPackZstd =
+      StagePipeline<ValueStage<DeltaCodec>, PackStage<SimdCompCodec>,
+                    ByteCodecStage<ZstdCodec>>;
+  using ForPack = StagePipeline<ValueStage<FORCodec>, PackStage<SimdCompCodec>,
+                                ByteCodecStage<LZ4Codec>>;
+  using DeltaShuffle =
+      StagePipeline<ValueStage<DeltaCodec>,
+                    ByteTransformStage<ByteShuffleStage>,
+                    ByteCodecStage<LZ4Codec>>;
+  codecs.push_back(std::make_unique<DeltaPack>());
+  codecs.push_back(std::make_unique<DeltaPackZstd>(
+      ValueStage<DeltaCodec>(), PackStage<SimdCompCodec>(),
+      ByteCodecStage<ZstdCodec>(ZstdCodec(1))));
+  codecs.push_back(std::make_unique<ForPack>());
+  codecs.push_back(std::make_unique<DeltaShuffle>());
+}
+
+// Puts the error-bounded quantiser in front of every codec, which then
+// encodes the bin codes; BenchmarkOneCodec checks the bound on decode.
+static void WrapErrorBoundedCodecs(
+    std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>>& codecs,
+    ErrorBoundSpec bound) {
+  for (auto& codec : codecs)
+    codec = std::make_unique<ErrorBoundedCodec<int32_t>>(bound,
+                                                         std::move(codec));
+}
+
+// Wraps every codec so blocks holding `noData` (already shifted with the
+// block values) are encoded as validity bitmap + values per `mode`.
+static void WrapNoDataCodecs(
+    std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>>& codecs,
+    NoDataMode mode, int32_t noData) {
+  for (auto& codec : codecs)
+    codec = std::make_unique<NoDataCodec>(mode, noData, std::move(codec));
+}
+
+// Reads a block and applies the configuration's shift, ordering and
+// transformation; empty if the block is not full.
+static std::vector<int32_t> ReadPreparedBlock(
+    GDALRasterBand* band, BlockOffset offset, int blockSize, int rasterWidth,
+    int rasterHeight, int32_t globalMin, Ordering ordering,
+    Transformation trans) {
+  auto blockData = ReadGeoTiffBlock(band, offset.x, offset.y, blockSize,
+                                    rasterWidth, rasterHeight);
+  if (static_cast<int>(blockData.size()) != blockSize * blockSize) return {};
+  if (globalMin < 0)
+    for (auto& v : blockData) v += (-globalMin);
+  RemapAndTransform(blockData, ordering, trans, blockSize);
+  return blockData;
+}
+
+struct DictionaryOptions {
+  size_t capacity = 0;  // 0: no dictionary codecs
+  int numSamples = 0;
+  std::vector<int> levels;
+};
+
 static void RunBenchConfig(
     GDALRasterBand* band, int rasterWidth, int rasterHeight,
     const std::string& filePath, int blockSize, int nBlocks, int32_t globalMin,
     const std::string& compositeName, Ordering ordering, Transformation trans,
-    std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>>& codecs) {
+    std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>>& baseCodecs,
+    bool d1Contrast, NoDataMode noDataMode, int32_t shiftedNoData,
+    const DictionaryOptions& dict,
+    const std::optional<ErrorBoundSpec>& errorBound) {
+  int blocksInWidth = rasterWidth / blockSize;
+  int blocksInHeight = rasterHeight / blockSize;
+
+  std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>> codecs;
+  for (auto& codec : baseCodecs) codecs.emplace_back(codec->CloneFresh());
+  // Dictionaries depend on the ordering and transformation, so they are
+  // trained per configuration from blocks prepared like the benchmarked
+  // ones (evenly spaced, as a deployment would train on its own raster).
+  std::size_t dictBytes = 0;
+  if (dict.capacity > 0) {
+    std::vector<std::vector<int32_t>> samples;
+    for (auto& offset : SampleBlockOffsets(blocksInWidth, blocksInHeight,
+                                           blockSize, dict.numSamples)) {
+      auto block = ReadPreparedBlock(band, offset, blockSize, rasterWidth,
+                                     rasterHeight, globalMin, ordering, trans);
+      if (!block.empty()) samples.push_back(std::move(block));
+    }
+    auto dictionary = TrainZstdDictionary(samples, dict.capacity);
+    dictBytes = dictionary->bytes.size();
+    for (int level : dict.levels) {
+      std::unique_ptr<StatefulIntegerCodec<int32_t>> codec =
+          std::make_unique<ZstdCodec>(level, dictionary);
+      if (errorBound)
+        codec = std::make_unique<ErrorBoundedCodec<int32_t>>(
+            *errorBound, std::move(codec));
+      if (noDataMode != NoDataMode::None)
+        codec = std::make_unique<NoDataCodec>(noDataMode, shiftedNoData,
+                                              std::move(codec));
+      codecs.push_back(std::move(codec));
+    }
+  }
+
   std::cout << std::format("**BENCHMARK**\nfile={},blockSize={},nBlocks={},composite={},"
-               "ordering={},transformation={}",
+               "ordering={},transformation={},nodata={},errorbound={}",
                filePath, blockSize, nBlocks, compositeName,
-               ToString(ordering), ToString(trans)) << '\n';
+               ToString(ordering), ToString(trans), ToString(noDataMode),
+               errorBound ? ToString(*errorBound) : "none") << '\n';
 
   std::cout << "*CODECS:*\n";
   for (std::size_t ci = 0; ci < codecs.size(); ++ci)
     std::cout << std::format("{}={}", ci, codecs[ci]->name()) << '\n';
   std::cout << "*ENDCODECS*\n";
-
-  int blocksInWidth = rasterWidth / blockSize;
-  int blocksInHeight = rasterHeight / blockSize;
+  if (dict.capacity > 0)
+    std::cout << std::format("zstddictbytes:{}", dictBytes) << '\n';
 
   std::vector<std::vector<CodecStats>> codecWindowStats(codecs.size());
+  std::vector<float> cfMeans(codecs.size()), tencMeans(codecs.size()),
+      tdecMeans(codecs.size());
 
   for (auto& offset :
        SampleBlockOffsets(blocksInWidth, blocksInHeight, blockSize, nBlocks)) {
-    auto blockData = ReadGeoTiffBlock(band, offset.x, offset.y, blockSize,
-                                      rasterWidth, rasterHeight);
-    if (static_cast<int>(blockData.size()) != blockSize * blockSize) continue;
-    if (globalMin < 0)
-      for (auto& v : blockData) v += (-globalMin);
-    RemapAndTransform(blockData, ordering, trans, blockSize);
+    auto blockData = ReadPreparedBlock(band, offset, blockSize, rasterWidth,
+                                       rasterHeight, globalMin, ordering,
+                                       trans);
+    if (blockData.empty()) continue;
     auto blockStats = BenchmarkWindow(blockData, codecs);
     for (std::size_t ci = 0; ci < codecs.size(); ++ci)
       codecWindowStats[ci].push_back(blockStats[ci]);
@@ -90,6 +251,33 @@ static void RunBenchConfig(
     std::cout << std::format("c:{},cfmean:{},cfvar:{},bpimean:{},bpivar:{},"
                  "tencmean:{},tencvar:{},tdecmean:{},tdecvar:{}",
                  ci, cfm, cfv, bpim, bpiv, tem, tev, tdm, tdv) << '\n';
+    cfMeans[ci] = cfm;
+    tencMeans[ci] = tem;
+    tdecMeans[ci] = tdm;
+  }
+
+  if (!d1Contrast) return;
+  // The composite writes the delta array (4 bytes per value) and reads it
+  // back for bit packing on every encode and decode; D1 codecs do not.
+  auto find = [&](const std::string& name) {
+    auto it = std::ranges::find_if(
+        codecs, [&](auto& c) { return c->name() == name; });
+    return static_cast<std::size_t>(it - codecs.begin());
+  };
+  std::size_t composite = find("[+]_custom_delta_unvec+simdcomp");
+  for (auto* d1Name : {"simdcomp_d1", "simdcomp_d1_zigzag"}) {
+    std::size_t d1 = find(d1Name);
+    if (d1 == codecs.size() || composite == codecs.size()) continue;
+    std::cout << std::format(
+                     "d1contrast:{},composite:{},cfratio:{},tencratio:{},"
+                     "tdecratio:{},tdecsaved:{},intermediatebytessaved:{}",
+                     d1Name, codecs[composite]->name(),
+                     cfMeans[d1] / cfMeans[composite],
+                     tencMeans[d1] / tencMeans[composite],
+                     tdecMeans[d1] / tdecMeans[composite],
+                     tdecMeans[composite] - tdecMeans[d1],
+                     2 * sizeof(int32_t) * blockSize * blockSize)
+              << '\n';
   }
 }
 
@@ -102,6 +290,14 @@ int main(int argc, char** argv) {
   std::vector<std::string> orderings = {"default"};
   std::vector<std::string> compositeNames = {"none"};
   std::vector<std::string> transformations = {"none"};
+  bool d1Contrast = false;
+  std::string noDataModeName = "none";
+  bool levelSweep = false;
+  std::vector<int> zstdLevels, lz4Accels, lz4hcLevels;
+  DictionaryOptions dict{.numSamples = 100};
+  std::vector<std::string> shuffles;
+  bool stagePipelines = false;
+  double absErrorBound = -1, relErrorBound = -1;
 
   app.add_option("file", filePath, "GeoTIFF file path")->required();
   app.add_option("--blocksize,-b", blockSize, "Block side length in pixels")
@@ -116,9 +312,56 @@ int main(int argc, char** argv) {
   app.add_option("--trans", transformations,
                  "Transformation(s): none|Threshold|SmoothAndShift|"
                  "IndexBasedClassification|ValueBasedClassification|ValueShift");
+  app.add_flag("--d1contrast", d1Contrast,
+               "Also run delta+simdcomp and the SimdComp-D1 codecs and print "
+               "how single-pass D1 compares with the two-pass composite");
+  app.add_option("--nodata", noDataModeName,
+                 "How blocks holding the band's nodata value are encoded: "
+                 "none (as ordinary values)|split (validity bitmap + dense "
+                 "valid values)|fill (validity bitmap + nodata replaced by "
+                 "the previous valid value)");
+  app.add_flag("--levelsweep", levelSweep,
+               "Also run Zstd levels 1,3,6,9,12,15,19, LZ4 accelerations "
+               "1,4,16,64 and LZ4 HC levels 3,6,9,12 (unless given below)");
+  app.add_option("--zstdlevels", zstdLevels, "Zstd level(s) to run");
+  app.add_option("--lz4accels", lz4Accels, "LZ4 acceleration(s) to run");
+  app.add_option("--lz4hclevels", lz4hcLevels, "LZ4 HC level(s) to run");
+  app.add_option("--zstddict", dict.capacity,
+                 "Also run Zstd with a dictionary of at most this many bytes, "
+                 "trained per configuration from sampled blocks, at the "
+                 "Zstd levels (3 by default)");
+  app.add_option("--dictsamples", dict.numSamples,
+                 "Blocks sampled to train the Zstd dictionary");
+  app.add_option("--shuffle", shuffles,
+                 "Also run the byte-oriented codecs (Zstd, LZ4 by default) "
+                 "behind a shuffle: byte|bit");
+  app.add_flag("--stagepipelines", stagePipelines,
+               "Also run typed pipelines feeding a bit packer or shuffle into "
+               "LZ4/Zstd (delta+simdcomp+LZ4, delta+simdcomp+Zstd_1, "
+               "FOR+simdcomp+LZ4, delta+byteshuffle+LZ4)");
+  app.add_option("--errorbound", absErrorBound,
+                 "Lossy: quantise each value to within this absolute error "
+                 "(in raster units; below 1 is lossless) before every codec");
+  app.add_option("--relerrorbound", relErrorBound,
+                 "Lossy: as --errorbound, with the bound this fraction of "
+                 "each block's value range");
 
   CLI11_PARSE(app, argc, argv);
 
+  if (levelSweep) {
+    if (zstdLevels.empty()) zstdLevels = {1, 3, 6, 9, 12, 15, 19};
+    if (lz4Accels.empty()) lz4Accels = {1, 4, 16, 64};
+    if (lz4hcLevels.empty()) lz4hcLevels = {3, 6, 9, 12};
+  }
+  dict.levels = zstdLevels.empty() ? std::vector<int>{3} : zstdLevels;
+  if (absErrorBound >= 0 && relErrorBound >= 0) {
+    std::cerr << "--errorbound and --relerrorbound are exclusive\n";
+    return 1;
+  }
+  std::optional<ErrorBoundSpec> errorBound;
+  if (absErrorBound >= 0) errorBound = AbsoluteErrorBound(absErrorBound);
+  if (relErrorBound >= 0) errorBound = RelativeErrorBound(relErrorBound);
+
   GDALAllRegister();
   GDALDataset* dataset =
       static_cast<GDALDataset*>(GDALOpen(filePath.c_str(), GA_ReadOnly));
@@ -131,15 +374,32 @@ int main(int argc, char** argv) {
   int rasterWidth = band->GetXSize();
   int rasterHeight = band->GetYSize();
 
+  // With a nodata mode the nodata value is left out of the global minimum
+  // and each block's validity is encoded separately; otherwise it is an
+  // ordinary (usually outlying) value.
+  NoDataSpec noData = ReadNoDataSpec(band, ParseNoDataMode(noDataModeName));
+  if (!noData.present) noData.mode = NoDataMode::None;
+  if (noData.mode == NoDataMode::None) noData.present = false;
+
   // Compute global minimum once; used to shift all values non-negative.
   int32_t globalMin = std::numeric_limits<int32_t>::max();
   for (int y = 0; y < rasterHeight / blockSize; ++y)
     for (int x = 0; x < rasterWidth / blockSize; ++x)
       ComputeMinForBlock(band, x * blockSize, y * blockSize, blockSize,
-                         globalMin);
+                         globalMin, noData);
+  const int32_t shiftedNoData = static_cast<int32_t>(
+      static_cast<uint32_t>(noData.value) -
+      static_cast<uint32_t>(std::min(globalMin, 0)));
 
   for (auto& compositeName : compositeNames) {
     auto codecs = BuildCodecsForComposite(compositeName);
+    if (d1Contrast) AddD1ContrastCodecs(codecs);
+    AddLevelSweepCodecs(codecs, zstdLevels, lz4Accels, lz4hcLevels);
+    AddShuffleCodecs(codecs, shuffles);
+    if (stagePipelines) AddStagePipelineCodecs(codecs);
+    // Quantised inside the nodata wrapper, so nodata stays exact.
+    if (errorBound) WrapErrorBoundedCodecs(codecs, *errorBound);
+    if (noData.present) WrapNoDataCodecs(codecs, noData.mode, shiftedNoData);
     for (auto& ordering : orderings) {
       Ordering orderingEnum = ParseOrdering(ordering);
       for (auto& transformation : transformations) {
@@ -147,7 +407,8 @@ int main(int argc, char** argv) {
         try {
           RunBenchConfig(band, rasterWidth, rasterHeight, filePath, blockSize,
                          nBlocks, globalMin, compositeName, orderingEnum,
-                         transEnum, codecs);
+                         transEnum, codecs, d1Contrast, noData.mode,
+                         shiftedNoData, dict, errorBound);
         } catch (const std::exception& e) {
           std::cout << " ERROR see cerr\n";
           std::cerr << std::format("Error: {}", e.what()) << '\n';
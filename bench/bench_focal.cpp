@@ -0,0 +1,181 @@
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <CLI/CLI.hpp>
+
+#include "bench_gdal_utils.h"
+#include "bench_utils.h"
+#include "block_grid.h"
+#include "codec_collection.h"
+#include "direct_codec.h"
+#include "focal.h"
+#include "gdal_priv.h"
+
+static std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>>
+BuildAllCodecs() {
+  auto pool = InitCodecs(/* nonCascaded */ true, nullptr);
+  for (auto& c :
+       InitCodecs(/* nonCascaded */ false, std::make_unique<DeltaCodec>()))
+    pool.push_back(std::move(c));
+  pool.push_back(std::make_unique<DirectAccessCodec>());
+  return pool;
+}
+
+static std::size_t ElapsedNs(std::chrono::steady_clock::time_point t0) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - t0)
+      .count();
+}
+
+// Baseline: decode the whole raster (plus a clamped border), filter it and
+// encode the output tiles.
+static BlockGrid FocalFullRaster(const BlockGrid& in, FocalOp op,
+                                 const StatefulIntegerCodec<int32_t>& outProto,
+                                 const FocalParams& params, int numThreads) {
+  const int bs = in.blockSize, w = in.Width(), h = in.Height();
+  const std::size_t stride = static_cast<std::size_t>(w) + 2;
+  std::vector<int32_t> raster(stride * (h + 2));
+  auto row = [&](int y) { return raster.data() + stride * (y + 1) + 1; };
+#pragma omp parallel num_threads(numThreads)
+  {
+    std::vector<int32_t> tile(in.TileLength() + in.MaxOverflow());
+#pragma omp for schedule(dynamic)
+    for (std::size_t t = 0; t < in.tiles.size(); ++t) {
+      int bx = static_cast<int>(t % in.blocksX);
+      int by = static_cast<int>(t / in.blocksX);
+      in.DecodeTile(bx, by, tile.data());
+      for (int y = 0; y < bs; ++y)
+        std::copy_n(tile.data() + static_cast<std::size_t>(y) * bs, bs,
+                    row(by * bs + y) + bx * bs);
+    }
+  }
+  std::copy_n(row(0) - 1, stride, row(-1) - 1);
+  std::copy_n(row(h - 1) - 1, stride, row(h) - 1);
+  for (int y = -1; y <= h; ++y) {
+    row(y)[-1] = row(y)[0];
+    row(y)[w] = row(y)[w - 1];
+  }
+
+  std::vector<int32_t> filtered(static_cast<std::size_t>(w) * h);
+#pragma omp parallel num_threads(numThreads)
+  {
+    std::vector<int32_t> gx(w), gy(w);
+#pragma omp for schedule(static)
+    for (int y = 0; y < h; ++y)
+      FocalRow(op, row(y - 1), row(y), row(y + 1), w,
+               filtered.data() + static_cast<std::size_t>(y) * w, gx.data(),
+               gy.data(), params);
+  }
+  return EncodeBlockGrid(filtered.data(), w, h, bs, outProto, numThreads);
+}
+
+int main(int argc, char* argv[]) {
+  CLI::App app{
+      "Benchmark 3x3 focal operations over a compressed block grid against "
+      "decoding the whole raster"};
+
+  std::string filePath;
+  int blockSize{}, numReps{};
+  std::vector<std::string> codecNames = {"custom_delta_unvec"};
+  std::string outCodecName = "simdcomp_for";
+  std::vector<std::string> ops = {"Mean", "Max", "Slope", "Aspect", "Sobel"};
+  int numThreads = 1;
+  double cellSize = 1.0;
+  std::vector<std::string> kernels = {"auto"};
+
+  app.add_option("file", filePath, "GeoTIFF file path")->required();
+  app.add_option("--blocksize,-b", blockSize, "Block side length in pixels")
+      ->required();
+  app.add_option("--numreps,-r", numReps, "Repetitions per combination")
+      ->required();
+  app.add_option("--codec", codecNames,
+                 "Codec name(s) holding the input grid, or 'all'");
+  app.add_option("--ocodec", outCodecName, "Codec for the output grid");
+  app.add_option("--op", ops, "Focal operation(s): Mean|Max|Slope|Aspect|Sobel");
+  app.add_option("--cellsize", cellSize,
+                 "Pixel spacing in value units (Slope only)");
+  app.add_option("--threads,-t", numThreads, "OpenMP threads");
+  app.add_option("--kernel", kernels,
+                 "Stencil kernel(s): auto|scalar|sse41|avx2|avx512");
+
+  CLI11_PARSE(app, argc, argv);
+
+  GDALAllRegister();
+  GDALSetCacheMax(64 * 1024 * 1024);
+  GDALDataset* dataset =
+      static_cast<GDALDataset*>(GDALOpen(filePath.c_str(), GA_ReadOnly));
+  if (dataset == nullptr) {
+    std::cerr << std::format("Failed to open file: {}", filePath) << '\n';
+    return 1;
+  }
+  GDALRasterBand* band = dataset->GetRasterBand(1);
+
+  auto pool = BuildAllCodecs();
+  auto codecs = SelectCodecsByName(pool, codecNames);
+  auto outCodecs = SelectCodecsByName(pool, {outCodecName});
+  if (codecs.empty() || outCodecs.empty()) {
+    std::cerr << "NO CODECS SELECTED.\n";
+    return 1;
+  }
+  FocalParams params{.cellSize = cellSize};
+
+  for (auto& codec : codecs) {
+    BlockGrid grid = ReadBlockGrid(band, blockSize, *codec, numThreads);
+    for (auto& kernel : kernels) {
+      SetTransformationSimdLevel(ParseSimdLevel(kernel));
+      for (auto& opName : ops) {
+        FocalOp op = ParseFocalOp(opName);
+        std::cout << "**BENCHMARK FOCAL**\n";
+        std::cout << std::format(
+                         "file={},blocksize={},numreps={},codec={},outcodec={},"
+                         "op={},threads={},kernel={},width={},height={},"
+                         "encodedbytes={}",
+                         filePath, blockSize, numReps, codec->name(),
+                         outCodecs[0]->name(), ToString(op), numThreads,
+                         ToString(TransformationSimdLevel()), grid.Width(),
+                         grid.Height(), grid.EncodedBytes())
+                  << '\n';
+
+        RunningStats wall, decode, halo, stencil, encode, full;
+        std::size_t haloValues = 0;
+        for (int rep = 0; rep < numReps; ++rep) {
+          FocalStats stats;
+          auto t0 = std::chrono::steady_clock::now();
+          FocalBlockGrid(grid, op, *outCodecs[0], params, numThreads, &stats);
+          wall.Update(ElapsedNs(t0));
+          decode.Update(stats.decodeTime);
+          halo.Update(stats.haloTime);
+          stencil.Update(stats.stencilTime);
+          encode.Update(stats.encodeTime);
+          haloValues = stats.haloValues;
+
+          t0 = std::chrono::steady_clock::now();
+          FocalFullRaster(grid, op, *outCodecs[0], params, numThreads);
+          full.Update(ElapsedNs(t0));
+        }
+        std::cout << std::format(
+                         "tottimewall:{},meantimewall:{},vartimewall:{},"
+                         "meantimedecode:{},meantimehalo:{},meantimestencil:{},"
+                         "meantimeencode:{},halovalues:{}",
+                         wall.Total(), wall.mean, wall.Variance(), decode.mean,
+                         halo.mean, stencil.mean, encode.mean, haloValues)
+                  << '\n';
+        std::cout << std::format("fullraster:meantimewall:{},vartimewall:{}",
+                                 full.mean, full.Variance())
+                  << '\n';
+        if (wall.mean > 0)
+          std::cout << std::format("speedupvsfullraster:{}",
+                                   full.mean / wall.mean)
+                    << '\n';
+      }
+    }
+  }
+
+  GDALClose(dataset);
+  return 0;
+}
@@ -2,17 +2,40 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
 #include <vector>
 
+#include "block_grid.h"
 #include "gdal_priv.h"
+#include "multiband.h"
+#include "time_stack.h"
 
-// Updates `min` with the minimum value found in the given raster block.
+// Updates `min` with the minimum value found in the given raster block,
+// ignoring `noData` when it is present.
 inline void ComputeMinForBlock(GDALRasterBand* band, int xOff, int yOff,
-                                int blockSize, int32_t& min) {
+                                int blockSize, int32_t& min,
+                                const NoDataSpec& noData = {}) {
   std::vector<int32_t> blockData(blockSize * blockSize);
   band->RasterIO(GF_Read, xOff, yOff, blockSize, blockSize, blockData.data(),
                  blockSize, blockSize, GDT_Int32, 0, 0);
-  for (auto& v : blockData) min = std::min(min, v);
+  for (auto& v : blockData)
+    if (!noData.present || v != noData.value) min = std::min(min, v);
+}
+
+// The band's nodata value (GetNoDataValue) with encoding mode `mode`. Not
+// present if the band has none or it is not an int32 value.
+inline NoDataSpec ReadNoDataSpec(GDALRasterBand* band, NoDataMode mode) {
+  int ok = 0;
+  double v = band->GetNoDataValue(&ok);
+  NoDataSpec spec;
+  spec.mode = mode;
+  spec.present = ok && v >= std::numeric_limits<int32_t>::min() &&
+                 v <= std::numeric_limits<int32_t>::max() &&
+                 v == static_cast<double>(static_cast<int64_t>(v));
+  if (spec.present) spec.value = static_cast<int32_t>(v);
+  return spec;
 }
 
 // Reads a raster block, handling partial blocks at the raster boundary.
@@ -27,3 +50,88 @@ inline std::vector<int32_t> ReadGeoTiffBlock(GDALRasterBand* band, int xOff,
                  0);
   return data;
 }
+
+// Encodes the full tiles of `band` into a BlockGrid with clones of `proto`.
+// GDAL reads are serialised; encoding runs on `numThreads` threads. The
+// band's nodata value is recorded, and tiles holding it are encoded per
+// `noDataMode`.
+inline BlockGrid ReadBlockGrid(GDALRasterBand* band, int blockSize,
+                               const StatefulIntegerCodec<int32_t>& proto,
+                               int numThreads = 1,
+                               bool withHistograms = false,
+                               bool constantTiles = true,
+                               NoDataMode noDataMode = NoDataMode::None) {
+  return EncodeBlockGrid(
+      band->GetXSize() / blockSize, band->GetYSize() / blockSize, blockSize,
+      proto,
+      [&](int bx, int by, int32_t* tile) {
+        CPLErr err;
+#pragma omp critical(gdal_read)
+        err = band->RasterIO(GF_Read, bx * blockSize, by * blockSize,
+                             blockSize, blockSize, tile, blockSize, blockSize,
+                             GDT_Int32, 0, 0);
+        if (err != CE_None)
+          throw std::runtime_error("RasterIO failed reading tile (" +
+                                   std::to_string(bx) + ", " +
+                                   std::to_string(by) + ")");
+      },
+      numThreads, withHistograms, constantTiles,
+      ReadNoDataSpec(band, noDataMode));
+}
+
+// Encodes the full tiles of every band of `dataset` into a MultiBandGrid.
+// GDAL reads are serialised; prediction and encoding run on `numThreads`.
+inline MultiBandGrid ReadMultiBandGrid(
+    GDALDataset* dataset, int blockSize,
+    const StatefulIntegerCodec<int32_t>& proto, BandPrediction prediction,
+    BandLayout layout, int numThreads = 1) {
+  const int numBands = dataset->GetRasterCount();
+  const std::size_t n = static_cast<std::size_t>(blockSize) * blockSize;
+  return EncodeMultiBandGrid(
+      numBands, dataset->GetRasterXSize() / blockSize,
+      dataset->GetRasterYSize() / blockSize, blockSize, proto, prediction,
+      layout,
+      [&](int bx, int by, int32_t* tile) {
+        for (int b = 0; b < numBands; ++b) {
+          CPLErr err;
+#pragma omp critical(gdal_read)
+          err = dataset->GetRasterBand(b + 1)->RasterIO(
+              GF_Read, bx * blockSize, by * blockSize, blockSize, blockSize,
+              tile + b * n, blockSize, blockSize, GDT_Int32, 0, 0);
+          if (err != CE_None)
+            throw std::runtime_error(
+                "RasterIO failed reading band " + std::to_string(b + 1) +
+                " of tile (" + std::to_string(bx) + ", " + std::to_string(by) +
+                ")");
+        }
+      },
+      numThreads);
+}
+
+// Encodes the full tiles of band 1 of each of `days` (same size, in day
+// order) into a TimeStack. GDAL reads are serialised; residuals and
+// encoding run on `numThreads`.
+inline TimeStack ReadTimeStack(const std::vector<GDALDataset*>& days,
+                               int blockSize, int subBlockSize,
+                               int keyframeInterval,
+                               const StatefulIntegerCodec<int32_t>& proto,
+                               TemporalPrediction prediction,
+                               int numThreads = 1) {
+  return EncodeTimeStack(
+      static_cast<int>(days.size()), days[0]->GetRasterXSize() / blockSize,
+      days[0]->GetRasterYSize() / blockSize, blockSize, subBlockSize,
+      keyframeInterval, proto, prediction,
+      [&](int day, int bx, int by, int32_t* tile) {
+        CPLErr err;
+#pragma omp critical(gdal_read)
+        err = days[day]->GetRasterBand(1)->RasterIO(
+            GF_Read, bx * blockSize, by * blockSize, blockSize, blockSize,
+            tile, blockSize, blockSize, GDT_Int32, 0, 0);
+        if (err != CE_None)
+          throw std::runtime_error("RasterIO failed reading day " +
+                                   std::to_string(day) + " tile (" +
+                                   std::to_string(bx) + ", " +
+                                   std::to_string(by) + ")");
+      },
+      numThreads);
+}
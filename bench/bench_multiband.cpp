@@ -0,0 +1,172 @@
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <CLI/CLI.hpp>
+
+#include "bench_gdal_utils.h"
+#include "bench_utils.h"
+#include "codec_collection.h"
+#include "gdal_priv.h"
+#include "multiband.h"
+
+static std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>>
+BuildAllCodecs() {
+  auto pool = InitCodecs(/* nonCascaded */ true, nullptr);
+  for (auto& c :
+       InitCodecs(/* nonCascaded */ false, std::make_unique<DeltaCodec>()))
+    pool.push_back(std::move(c));
+  return pool;
+}
+
+static std::size_t ElapsedNs(std::chrono::steady_clock::time_point t0) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - t0)
+      .count();
+}
+
+// Decodes every tile of `grid`: all bands (band < 0) or one band.
+// Returns false if any tile differs from `reference` (when given).
+static bool DecodeGrid(const MultiBandGrid& grid, int band, int numThreads,
+                       const MultiBandGrid* reference = nullptr) {
+  const std::size_t n = grid.TileLength();
+  const std::size_t values = band < 0 ? n * grid.numBands : n;
+  bool match = true;
+#pragma omp parallel num_threads(numThreads) reduction(&& : match)
+  {
+    std::vector<int32_t> out(values), expected(reference ? values : 0);
+    std::vector<int32_t> scratch(grid.ScratchLength()),
+        refScratch(reference ? reference->ScratchLength() : 0);
+#pragma omp for schedule(dynamic)
+    for (std::size_t t = 0; t < grid.NumTiles(); ++t) {
+      int bx = static_cast<int>(t % grid.blocksX);
+      int by = static_cast<int>(t / grid.blocksX);
+      if (band < 0)
+        grid.DecodeTile(bx, by, out.data(), scratch.data());
+      else
+        grid.DecodeBand(bx, by, band, out.data(), scratch.data());
+      if (reference == nullptr) continue;
+      if (band < 0)
+        reference->DecodeTile(bx, by, expected.data(), refScratch.data());
+      else
+        reference->DecodeBand(bx, by, band, expected.data(),
+                              refScratch.data());
+      match = match && out == expected;
+    }
+  }
+  return match;
+}
+
+int main(int argc, char* argv[]) {
+  CLI::App app{
+      "Benchmark multi-band storage with cross-band prediction and BSQ/BIP "
+      "tile layouts"};
+
+  std::string filePath;
+  int blockSize{}, numReps{};
+  std::vector<std::string> codecNames = {"[+]_custom_delta_unvec+simdcomp"};
+  std::vector<std::string> predictions = {"None", "Previous", "Linear"};
+  std::vector<std::string> layouts = {"BSQ", "BIP"};
+  int numThreads = 1;
+
+  app.add_option("file", filePath, "Multi-band GeoTIFF file path")->required();
+  app.add_option("--blocksize,-b", blockSize, "Block side length in pixels")
+      ->required();
+  app.add_option("--numreps,-r", numReps, "Repetitions per combination")
+      ->required();
+  app.add_option("--codec", codecNames, "Physical codec name(s), or 'all'");
+  app.add_option("--prediction", predictions,
+                 "Band prediction(s): None|Previous|Linear");
+  app.add_option("--layout", layouts, "Tile layout(s): BSQ|BIP");
+  app.add_option("--threads,-t", numThreads, "OpenMP threads");
+
+  CLI11_PARSE(app, argc, argv);
+
+  GDALAllRegister();
+  GDALSetCacheMax(64 * 1024 * 1024);
+  GDALDataset* dataset =
+      static_cast<GDALDataset*>(GDALOpen(filePath.c_str(), GA_ReadOnly));
+  if (dataset == nullptr) {
+    std::cerr << std::format("Failed to open file: {}", filePath) << '\n';
+    return 1;
+  }
+  const int numBands = dataset->GetRasterCount();
+
+  auto pool = BuildAllCodecs();
+  auto codecs = SelectCodecsByName(pool, codecNames);
+  if (codecs.empty()) {
+    std::cerr << "NO CODECS SELECTED.\n";
+    return 1;
+  }
+
+  for (auto& codec : codecs) {
+    // Independent band-sequential tiles: what per-band ingest would store.
+    MultiBandGrid independent =
+        ReadMultiBandGrid(dataset, blockSize, *codec, BandPrediction::None,
+                          BandLayout::BSQ, numThreads);
+    const double pixels = static_cast<double>(independent.Width()) *
+                          independent.Height();
+    for (auto& predictionName : predictions) {
+      BandPrediction prediction = ParseBandPrediction(predictionName);
+      for (auto& layoutName : layouts) {
+        BandLayout layout = ParseBandLayout(layoutName);
+        std::cout << "**BENCHMARK MULTIBAND**\n";
+        std::cout << std::format(
+                         "file={},blocksize={},numreps={},codec={},bands={},"
+                         "prediction={},layout={},threads={},width={},"
+                         "height={}",
+                         filePath, blockSize, numReps, codec->name(), numBands,
+                         ToString(prediction), ToString(layout), numThreads,
+                         independent.Width(), independent.Height())
+                  << '\n';
+
+        RunningStats ingest, decodeAll, decodeLast;
+        std::size_t bytes = 0;
+        bool match = true;
+        for (int rep = 0; rep < numReps; ++rep) {
+          // Ingest: GDAL reads, band prediction and encoding.
+          auto t0 = std::chrono::steady_clock::now();
+          MultiBandGrid grid = ReadMultiBandGrid(dataset, blockSize, *codec,
+                                                 prediction, layout, numThreads);
+          ingest.Update(ElapsedNs(t0));
+          bytes = grid.EncodedBytes();
+
+          t0 = std::chrono::steady_clock::now();
+          DecodeGrid(grid, -1, numThreads);
+          decodeAll.Update(ElapsedNs(t0));
+
+          // The last band is the worst case for prediction chains.
+          t0 = std::chrono::steady_clock::now();
+          DecodeGrid(grid, numBands - 1, numThreads);
+          decodeLast.Update(ElapsedNs(t0));
+
+          if (rep == 0) match = DecodeGrid(grid, -1, numThreads, &independent);
+        }
+        // Every encoded byte is decoded once when all bands are consumed.
+        std::cout << std::format(
+                         "encodedbytes:{},independentbytes:{},"
+                         "bytesperpixel:{},savingvsindependent:{},match:{}",
+                         bytes, independent.EncodedBytes(), bytes / pixels,
+                         1.0 - static_cast<double>(bytes) /
+                                   independent.EncodedBytes(),
+                         match)
+                  << '\n';
+        std::cout << std::format(
+                         "meantimeingest:{},vartimeingest:{},"
+                         "meantimedecodeall:{},vartimedecodeall:{},"
+                         "meantimedecodelastband:{},vartimedecodelastband:{}",
+                         ingest.mean, ingest.Variance(), decodeAll.mean,
+                         decodeAll.Variance(), decodeLast.mean,
+                         decodeLast.Variance())
+                  << '\n';
+      }
+    }
+  }
+
+  GDALClose(dataset);
+  return 0;
+}
@@ -16,6 +16,7 @@
 #include "codec_collection.h"
 #include "direct_codec.h"
 #include "gdal_priv.h"
+#include "pipeline.h"
 
 static std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>>
 BuildAllCodecs() {
@@ -30,9 +31,28 @@ BuildAllCodecs() {
        InitCodecs(/* nonCascaded */ false, std::make_unique<FORCodec>()))
     pool.push_back(std::move(c));
   pool.push_back(std::make_unique<DirectAccessCodec>());
+  // Segmented variants decode incrementally under --chunk.
+  CODECFactory factory;
+  for (const char* scheme : {"simdfastpfor256", "simdbinarypacking"})
+    pool.push_back(std::make_unique<FastPForCodec>(factory.getFromName(scheme),
+                                                   /* segmentLength */ 4096));
   return pool;
 }
 
+// Bitmap codecs only round-trip 0/1 data, so they are never part of "all"
+// and must be named explicitly (e.g. --itrans Threshold --icodec roaring).
+static void AddNamedMaskCodecs(
+    std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>>& selected,
+    const std::vector<std::string>& names) {
+  std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>> masks;
+  masks.push_back(std::make_unique<BitsetCodec>());
+  masks.push_back(std::make_unique<RoaringCodec>());
+  masks.push_back(std::make_unique<EWAHCodec>());
+  for (auto& mask : masks)
+    if (std::ranges::find(names, mask->name()) != names.end())
+      selected.emplace_back(mask->CloneFresh());
+}
+
 static std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>>
 SplitIntoFullBlocks(GDALRasterBand* band, int rasterWidth, int rasterHeight,
                     int blockSize, int numBlocks,
@@ -92,6 +112,16 @@ static void BenchmarkAccess(
     std::size_t blockIndex = accessIndexes[i];
     auto& codec = codecs[blockIndex];
 
+    // Fused variants run on the encoded block and pick their own output
+    // format, so there is no separate decode or re-encode to time.
+    if (AccessTransformationIsFused(accessTransformation)) {
+      statsDec.Update(0);
+      statsTrans.Update(ApplyFusedAccessTransformation(
+          codec, accessTransformation, blockSize));
+      statsEnc.Update(0);
+      continue;
+    }
+
     auto benchblock = [&](std::vector<int32_t>& buf) {
       std::size_t decodeTime = 0;
       if (!isDirectAccess) {
@@ -102,8 +132,8 @@ static void BenchmarkAccess(
       }
       statsDec.Update(decodeTime);
 
-      std::size_t transTime =
-          ApplyAccessTransformation(buf, accessTransformation, blockSize);
+      std::size_t transTime = ApplyAccessTransformation(
+          buf, accessTransformation, blockSize, codec.get());
       statsTrans.Update(transTime);
 
       if (dataChange) {
@@ -149,11 +179,12 @@ static void RunOneCombination(
   std::cout << "**BENCHMARK ACCESS**\n";
   std::cout << std::format("file={},blocksize={},numblocks={},numreps={},basecodec={},"
                "accesscodec={},ordering={},initialtransformation={},"
-               "sampleaccesspattern={},accesstransformation={}",
+               "sampleaccesspattern={},accesstransformation={},kernel={}",
                filePath, blockSize, numBlocks, numReps,
                baseCodec.name(), accessCodec.name(),
                ToString(combo.ordering), ToString(combo.initTrans),
-               ToString(accessPattern), ToString(combo.accessTrans)) << '\n';
+               ToString(accessPattern), ToString(combo.accessTrans),
+               ToString(TransformationSimdLevel())) << '\n';
 
   RunningStats statsDec, statsTrans, statsEnc;
 
@@ -184,6 +215,62 @@ static void RunOneCombination(
                statsEnc.Total(),  statsEnc.mean,  statsEnc.Variance()) << '\n';
 }
 
+// One (ordering × initTrans × pipeline × chunk) combination run by the tile
+// pipeline engine instead of the hardcoded decode/transform/re-encode
+// sequence. Returns the mean wall time per repetition (ns).
+static double RunPipelineCombination(
+    GDALRasterBand* band, int nXSize, int nYSize, const char* filePath,
+    int blockSize, int numBlocks, int numReps, int32_t min, Ordering ordering,
+    Transformation initTrans, const std::string& pipelineSpec, int numThreads,
+    std::size_t chunkSize, StatefulIntegerCodec<int32_t>& baseCodec,
+    StatefulIntegerCodec<int32_t>& accessCodec) {
+  TilePipeline pipeline = ParsePipeline(pipelineSpec, accessCodec);
+  pipeline.SetChunkSize(chunkSize);
+
+  std::cout << "**BENCHMARK PIPELINE**\n";
+  std::cout << std::format("file={},blocksize={},numblocks={},numreps={},basecodec={},"
+               "accesscodec={},ordering={},initialtransformation={},"
+               "pipeline={},threads={},chunk={},kernel={}",
+               filePath, blockSize, numBlocks, numReps,
+               baseCodec.name(), accessCodec.name(), ToString(ordering),
+               ToString(initTrans), pipeline.name(), numThreads,
+               chunkSize, ToString(TransformationSimdLevel())) << '\n';
+
+  std::vector<std::string> stageNames;
+  std::vector<RunningStats> stageStats(pipeline.NumStages());
+  RunningStats statsWall;
+  int64_t reduction = 0;
+
+  for (int rep = 0; rep < numReps; rep++) {
+    std::unique_ptr<StatefulIntegerCodec<int32_t>> expBase(
+        baseCodec.CloneFresh());
+    auto codecGrid =
+        SplitIntoFullBlocks(band, nXSize, nYSize, blockSize, numBlocks,
+                             std::move(expBase), min, initTrans, ordering);
+    if (codecGrid.empty()) {
+      std::cerr << "NO CODECS FORMING GRID.\n";
+      return 0;
+    }
+
+    PipelineStats stats = pipeline.Run(codecGrid, blockSize, numThreads);
+    for (std::size_t s = 0; s < stageStats.size(); ++s)
+      stageStats[s].Merge(stats.stageTimes[s]);
+    statsWall.Update(stats.wallTime);
+    reduction = stats.reduction;
+    stageNames = stats.stageNames;
+  }
+
+  for (std::size_t s = 0; s < stageStats.size(); ++s)
+    std::cout << std::format("stage:{},name:{},tottime:{},meantime:{},vartime:{}",
+                 s, stageNames[s], stageStats[s].Total(), stageStats[s].mean,
+                 stageStats[s].Variance()) << '\n';
+  std::cout << std::format("tottimewall:{},meantimewall:{},vartimewall:{},"
+               "reduction:{}",
+               statsWall.Total(), statsWall.mean, statsWall.Variance(),
+               reduction) << '\n';
+  return statsWall.mean;
+}
+
 static void RunAllBenchmarks(
     GDALRasterBand* band, int nXSize, int nYSize, const char* filePath,
     int blockSize, int numBlocks, int numReps, int32_t min,
@@ -192,7 +279,32 @@ static void RunAllBenchmarks(
     const std::vector<std::string>& orderings,
     const std::vector<std::string>& initialTransformations,
     const std::vector<std::string>& accessTransformations,
-    const std::vector<std::string>& sampleAccessPatterns) {
+    const std::vector<std::string>& sampleAccessPatterns,
+    const std::vector<std::string>& pipelines, int numThreads,
+    const std::vector<std::size_t>& chunkSizes) {
+  if (!pipelines.empty()) {
+    for (auto& o : orderings)
+      for (auto& it : initialTransformations)
+        for (auto& spec : pipelines)
+          for (auto& baseCodec : baseCodecs)
+            for (auto& accessCodec : accessCodecs) {
+              // Chunked runs report their speedup over whole-tile decode.
+              double wholeTile = 0;
+              for (std::size_t chunk : chunkSizes) {
+                double wall = RunPipelineCombination(
+                    band, nXSize, nYSize, filePath, blockSize, numBlocks,
+                    numReps, min, ParseOrdering(o), ParseTransformation(it),
+                    spec, numThreads, chunk, *baseCodec, *accessCodec);
+                if (chunk == 0)
+                  wholeTile = wall;
+                else if (wholeTile > 0 && wall > 0)
+                  std::cout << std::format("speedupvswholetile:{}",
+                                           wholeTile / wall) << '\n';
+              }
+            }
+    return;
+  }
+
   // Build flat combo list so strings are parsed once, not per-iteration.
   std::vector<BenchCombo> combos;
   for (auto& o : orderings)
@@ -222,6 +334,10 @@ int main(int argc, char* argv[]) {
   std::vector<std::string> initialTransformations = {"none"};
   std::vector<std::string> sampleAccessPatterns = {"linear"};
   std::vector<std::string> accessTransformations = {"linearXOR"};
+  std::vector<std::string> pipelines;
+  int numThreads = 1;
+  std::vector<std::size_t> chunkSizes = {0};
+  std::vector<std::string> kernels = {"auto"};
 
   app.add_option("file", filePath, "GeoTIFF file path")->required();
   app.add_option("--blocksize,-b", blockSize, "Block side length in pixels")
@@ -244,7 +360,23 @@ int main(int argc, char* argv[]) {
   app.add_option("--atrans", accessTransformations,
                  "Access transformation(s): linearXOR|linearSum|linearSumSimd|"
                  "linearSumFused|randomXOR|randomSum|Threshold|SmoothAndShift|"
-                 "IndexBasedClassification|ValueBasedClassification|ValueShift");
+                 "IndexBasedClassification|ValueBasedClassification|ValueShift|"
+                 "ThresholdFused|ValueShiftFused|SumFused (fused variants ignore "
+                 "--acodec)");
+  app.add_option("--pipeline", pipelines,
+                 "Tile pipeline(s) run instead of --atrans/--pattern, as "
+                 "comma-separated stages: decode|encode|remap:<ordering>|"
+                 "reduce:sum|xor|min|max|<access transformation>, "
+                 "e.g. decode,Threshold,encode");
+  app.add_option("--threads,-t", numThreads,
+                 "Threads used by --pipeline runs");
+  app.add_option("--chunk", chunkSizes,
+                 "Chunk size(s) in values for --pipeline runs: decode is "
+                 "interleaved with the element-wise stages after it; 0 "
+                 "decodes whole tiles. List 0 first to report speedups");
+  app.add_option("--kernel", kernels,
+                 "Transformation kernel(s): auto|scalar|sse41|avx2|avx512; "
+                 "every combination is run once per kernel");
 
   CLI11_PARSE(app, argc, argv);
 
@@ -272,11 +404,16 @@ int main(int argc, char* argv[]) {
   auto allCodecs_access = BuildAllCodecs();
   auto baseCodecs = SelectCodecsByName(allCodecs_initial, initialCodecNames);
   auto accessCodecs = SelectCodecsByName(allCodecs_access, accessCodecNames);
-
-  RunAllBenchmarks(band, nXSize, nYSize, filePath.c_str(), blockSize, numBlocks,
-                   numReps, min, baseCodecs, accessCodecs, orderings,
-                   initialTransformations, accessTransformations,
-                   sampleAccessPatterns);
+  AddNamedMaskCodecs(baseCodecs, initialCodecNames);
+  AddNamedMaskCodecs(accessCodecs, accessCodecNames);
+
+  for (auto& kernel : kernels) {
+    SetTransformationSimdLevel(ParseSimdLevel(kernel));
+    RunAllBenchmarks(band, nXSize, nYSize, filePath.c_str(), blockSize,
+                     numBlocks, numReps, min, baseCodecs, accessCodecs,
+                     orderings, initialTransformations, accessTransformations,
+                     sampleAccessPatterns, pipelines, numThreads, chunkSizes);
+  }
 
   GDALClose(dataset);
   return 0;
@@ -0,0 +1,188 @@
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <CLI/CLI.hpp>
+
+#include "bench_gdal_utils.h"
+#include "bench_utils.h"
+#include "block_grid.h"
+#include "codec_collection.h"
+#include "cpl_conv.h"
+#include "cpl_vsi.h"
+#include "gdal_priv.h"
+#include "pyramid.h"
+
+static std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>>
+BuildAllCodecs() {
+  auto pool = InitCodecs(/* nonCascaded */ true, nullptr);
+  for (auto& c :
+       InitCodecs(/* nonCascaded */ false, std::make_unique<DeltaCodec>()))
+    pool.push_back(std::move(c));
+  return pool;
+}
+
+static std::size_t ElapsedNs(std::chrono::steady_clock::time_point t0) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - t0)
+      .count();
+}
+
+static const char* GdalResampling(Resampling r) {
+  return r == Resampling::Mean ? "AVERAGE" : "NEAREST";
+}
+
+// Baseline: GDAL's BuildOverviews for band 1, on a tiled GeoTIFF copy of the
+// source in /vsimem so the source file is left untouched. Only the overview
+// build is timed, with GDAL_NUM_THREADS set to `numThreads`.
+static std::size_t TimeGdalOverviews(GDALDataset* source, int blockSize,
+                                     int numLevels, Resampling r,
+                                     int numThreads) {
+  const char* path = "/vsimem/bench_pyramid.tif";
+  std::string blockX = std::format("BLOCKXSIZE={}", blockSize);
+  std::string blockY = std::format("BLOCKYSIZE={}", blockSize);
+  const char* options[] = {"TILED=YES", blockX.c_str(), blockY.c_str(),
+                           nullptr};
+  GDALDriver* gtiff = GetGDALDriverManager()->GetDriverByName("GTiff");
+  GDALDataset* copy =
+      gtiff->CreateCopy(path, source, /* bStrict */ false,
+                        const_cast<char**>(options), nullptr, nullptr);
+  if (copy == nullptr)
+    throw std::runtime_error("Failed to copy the source to " +
+                             std::string(path));
+
+  std::vector<int> factors;
+  for (int l = 1; l <= numLevels; ++l) factors.push_back(1 << l);
+  int bandList[] = {1};
+  CPLSetConfigOption("GDAL_NUM_THREADS", std::to_string(numThreads).c_str());
+  auto t0 = std::chrono::steady_clock::now();
+  CPLErr err = copy->BuildOverviews(GdalResampling(r), numLevels,
+                                    factors.data(), 1, bandList, nullptr,
+                                    nullptr);
+  std::size_t elapsed = ElapsedNs(t0);
+  CPLSetConfigOption("GDAL_NUM_THREADS", nullptr);
+  GDALClose(copy);
+  VSIUnlink(path);
+  if (err != CE_None) throw std::runtime_error("GDAL BuildOverviews failed");
+  return elapsed;
+}
+
+int main(int argc, char* argv[]) {
+  CLI::App app{
+      "Benchmark building an overview pyramid from a compressed block grid "
+      "against GDAL's BuildOverviews"};
+
+  std::string filePath;
+  int blockSize{}, numReps{};
+  std::vector<std::string> codecNames = {"custom_delta_unvec"};
+  std::string outCodecName = "simdcomp_for";
+  std::vector<std::string> resamplings = {"Mean", "Nearest"};
+  int numLevels = 0;
+  int numThreads = 1;
+  std::vector<std::string> kernels = {"auto"};
+  bool skipGdal = false;
+
+  app.add_option("file", filePath, "GeoTIFF file path")->required();
+  app.add_option("--blocksize,-b", blockSize, "Block side length in pixels")
+      ->required();
+  app.add_option("--numreps,-r", numReps, "Repetitions per combination")
+      ->required();
+  app.add_option("--codec", codecNames,
+                 "Codec name(s) holding the input grid, or 'all'");
+  app.add_option("--ocodec", outCodecName, "Codec for the overview levels");
+  app.add_option("--resampling", resamplings, "Resampling(s): Mean|Nearest");
+  app.add_option("--levels", numLevels,
+                 "Overview levels (factors 2, 4, ...); 0 for all the grid "
+                 "supports");
+  app.add_option("--threads,-t", numThreads, "OpenMP threads");
+  app.add_option("--kernel", kernels,
+                 "Downsample kernel(s): auto|scalar|sse41|avx2|avx512");
+  app.add_flag("--nogdal", skipGdal, "Skip the GDAL BuildOverviews baseline");
+
+  CLI11_PARSE(app, argc, argv);
+
+  GDALAllRegister();
+  GDALSetCacheMax(64 * 1024 * 1024);
+  GDALDataset* dataset =
+      static_cast<GDALDataset*>(GDALOpen(filePath.c_str(), GA_ReadOnly));
+  if (dataset == nullptr) {
+    std::cerr << std::format("Failed to open file: {}", filePath) << '\n';
+    return 1;
+  }
+  GDALRasterBand* band = dataset->GetRasterBand(1);
+
+  auto pool = BuildAllCodecs();
+  auto codecs = SelectCodecsByName(pool, codecNames);
+  auto outCodecs = SelectCodecsByName(pool, {outCodecName});
+  if (codecs.empty() || outCodecs.empty()) {
+    std::cerr << "NO CODECS SELECTED.\n";
+    return 1;
+  }
+
+  for (auto& codec : codecs) {
+    BlockGrid grid = ReadBlockGrid(band, blockSize, *codec, numThreads);
+    const int levels = numLevels ? numLevels : MaxPyramidLevels(grid);
+    for (auto& kernel : kernels) {
+      SetTransformationSimdLevel(ParseSimdLevel(kernel));
+      for (auto& resamplingName : resamplings) {
+        Resampling r = ParseResampling(resamplingName);
+        std::cout << "**BENCHMARK PYRAMID**\n";
+        std::cout << std::format(
+                         "file={},blocksize={},numreps={},codec={},outcodec={},"
+                         "resampling={},levels={},threads={},kernel={},"
+                         "width={},height={},encodedbytes={}",
+                         filePath, blockSize, numReps, codec->name(),
+                         outCodecs[0]->name(), ToString(r), levels, numThreads,
+                         ToString(TransformationSimdLevel()), grid.Width(),
+                         grid.Height(), grid.EncodedBytes())
+                  << '\n';
+
+        RunningStats wall, decode, downsample, encode, gdal;
+        std::size_t tilesDecoded = 0, pyramidBytes = 0;
+        for (int rep = 0; rep < numReps; ++rep) {
+          PyramidStats stats;
+          auto pyramid =
+              BuildPyramid(grid, *outCodecs[0], r, levels, numThreads, &stats);
+          wall.Update(stats.wallTime);
+          decode.Update(stats.decodeTime);
+          downsample.Update(stats.downsampleTime);
+          encode.Update(stats.encodeTime);
+          tilesDecoded = stats.tilesDecoded;
+          pyramidBytes = 0;
+          for (auto& level : pyramid) pyramidBytes += level.EncodedBytes();
+
+          if (!skipGdal)
+            gdal.Update(
+                TimeGdalOverviews(dataset, blockSize, levels, r, numThreads));
+        }
+        std::cout << std::format(
+                         "tottimewall:{},meantimewall:{},vartimewall:{},"
+                         "meantimedecode:{},meantimedownsample:{},"
+                         "meantimeencode:{},tilesdecoded:{},pyramidbytes:{}",
+                         wall.Total(), wall.mean, wall.Variance(), decode.mean,
+                         downsample.mean, encode.mean, tilesDecoded,
+                         pyramidBytes)
+                  << '\n';
+        if (skipGdal) continue;
+        // GDAL covers the whole raster, the grid only its full tiles.
+        std::cout << std::format(
+                         "gdal:meantimewall:{},vartimewall:{},width:{},"
+                         "height:{}",
+                         gdal.mean, gdal.Variance(), band->GetXSize(),
+                         band->GetYSize())
+                  << '\n';
+        if (wall.mean > 0)
+          std::cout << std::format("speedupvsgdal:{}", gdal.mean / wall.mean)
+                    << '\n';
+      }
+    }
+  }
+
+  GDALClose(dataset);
+  return 0;
+}
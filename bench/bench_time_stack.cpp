@@ -0,0 +1,216 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <CLI/CLI.hpp>
+
+#include "bench_gdal_utils.h"
+#include "bench_utils.h"
+#include "codec_collection.h"
+#include "gdal_priv.h"
+#include "time_stack.h"
+
+static std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>>
+BuildAllCodecs() {
+  auto pool = InitCodecs(/* nonCascaded */ true, nullptr);
+  for (auto& c :
+       InitCodecs(/* nonCascaded */ false, std::make_unique<DeltaCodec>()))
+    pool.push_back(std::move(c));
+  return pool;
+}
+
+static std::size_t ElapsedNs(std::chrono::steady_clock::time_point t0) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - t0)
+      .count();
+}
+
+// The GeoTIFFs of `dir` in file name order: one day each.
+static std::vector<std::string> ListDays(const std::string& dir) {
+  std::vector<std::string> paths;
+  for (auto& entry : std::filesystem::directory_iterator(dir)) {
+    auto ext = entry.path().extension().string();
+    std::ranges::transform(ext, ext.begin(), ::tolower);
+    if (entry.is_regular_file() && (ext == ".tif" || ext == ".tiff"))
+      paths.push_back(entry.path().string());
+  }
+  std::ranges::sort(paths);
+  return paths;
+}
+
+// Decodes every tile of `day`. Returns false if any tile differs from
+// `reference` (when given).
+static bool DecodeDay(const TimeStack& stack, int day, int numThreads,
+                      const TimeStack* reference = nullptr) {
+  const std::size_t n = stack.TileLength();
+  bool match = true;
+#pragma omp parallel num_threads(numThreads) reduction(&& : match)
+  {
+    std::vector<int32_t> out(n), expected(reference ? n : 0);
+    std::vector<int32_t> scratch(stack.ScratchLength()),
+        refScratch(reference ? reference->ScratchLength() : 0);
+#pragma omp for schedule(dynamic)
+    for (std::size_t t = 0; t < stack.NumTiles(); ++t) {
+      int bx = static_cast<int>(t % stack.blocksX);
+      int by = static_cast<int>(t / stack.blocksX);
+      stack.DecodeTile(day, bx, by, out.data(), scratch.data());
+      if (reference == nullptr) continue;
+      reference->DecodeTile(day, bx, by, expected.data(), refScratch.data());
+      match = match && out == expected;
+    }
+  }
+  return match;
+}
+
+int main(int argc, char* argv[]) {
+  CLI::App app{
+      "Benchmark a directory of daily GeoTIFFs stored as a time stack: each "
+      "day against the day before, with periodic keyframes"};
+
+  std::string dirPath;
+  int blockSize{}, numReps{};
+  int subBlockSize = 16;
+  std::vector<std::string> codecNames = {"[+]_custom_delta_unvec+simdcomp"};
+  std::vector<std::string> predictions = {"Xor", "Subtract"};
+  std::vector<int> keyframeIntervals = {1, 7, 30};
+  std::vector<int> reconstructDays;
+  int numThreads = 1;
+
+  app.add_option("dir", dirPath,
+                 "Directory of same-grid GeoTIFFs, one per day in file name "
+                 "order")
+      ->required();
+  app.add_option("--blocksize,-b", blockSize, "Block side length in pixels")
+      ->required();
+  app.add_option("--numreps,-r", numReps, "Repetitions per combination")
+      ->required();
+  app.add_option("--subblock,-s", subBlockSize,
+                 "Side of the sub-blocks tracked by the change bitmap");
+  app.add_option("--codec", codecNames, "Physical codec name(s), or 'all'");
+  app.add_option("--prediction", predictions,
+                 "Temporal prediction(s): Xor|Subtract");
+  app.add_option("--keyframe,-k", keyframeIntervals,
+                 "Keyframe interval(s) in days (1: every day stored whole)");
+  app.add_option("--day", reconstructDays,
+                 "Day(s) k to time reconstructing (default: the first day, "
+                 "the day before the second keyframe and the last day)");
+  app.add_option("--threads,-t", numThreads, "OpenMP threads");
+
+  CLI11_PARSE(app, argc, argv);
+
+  GDALAllRegister();
+  GDALSetCacheMax(64 * 1024 * 1024);
+  std::vector<GDALDataset*> days;
+  for (auto& path : ListDays(dirPath)) {
+    auto* dataset =
+        static_cast<GDALDataset*>(GDALOpen(path.c_str(), GA_ReadOnly));
+    if (dataset == nullptr) {
+      std::cerr << std::format("Failed to open file: {}", path) << '\n';
+      return 1;
+    }
+    if (!days.empty() &&
+        (dataset->GetRasterXSize() != days[0]->GetRasterXSize() ||
+         dataset->GetRasterYSize() != days[0]->GetRasterYSize())) {
+      std::cerr << std::format("{} is not on the grid of the first day",
+                               path)
+                << '\n';
+      return 1;
+    }
+    days.push_back(dataset);
+  }
+  if (days.empty()) {
+    std::cerr << std::format("No GeoTIFFs in {}", dirPath) << '\n';
+    return 1;
+  }
+  const int numDays = static_cast<int>(days.size());
+
+  auto pool = BuildAllCodecs();
+  auto codecs = SelectCodecsByName(pool, codecNames);
+  if (codecs.empty()) {
+    std::cerr << "NO CODECS SELECTED.\n";
+    return 1;
+  }
+
+  for (auto& codec : codecs) {
+    // Every day stored whole: what per-day ingest would store.
+    TimeStack independent =
+        ReadTimeStack(days, blockSize, subBlockSize, 1, *codec,
+                      TemporalPrediction::Subtract, numThreads);
+    const double pixelDays = static_cast<double>(independent.Width()) *
+                             independent.Height() * numDays;
+    for (auto& predictionName : predictions) {
+      TemporalPrediction prediction = ParseTemporalPrediction(predictionName);
+      for (int interval : keyframeIntervals) {
+        std::vector<int> ks = reconstructDays;
+        if (ks.empty()) ks = {0, std::min(interval, numDays) - 1, numDays - 1};
+        std::erase_if(ks, [&](int k) { return k < 0 || k >= numDays; });
+        std::ranges::sort(ks);
+        ks.erase(std::unique(ks.begin(), ks.end()), ks.end());
+
+        std::cout << "**BENCHMARK TIMESTACK**\n";
+        std::cout << std::format(
+                         "dir={},days={},blocksize={},subblock={},numreps={},"
+                         "codec={},prediction={},keyframe={},threads={},"
+                         "width={},height={}",
+                         dirPath, numDays, blockSize, subBlockSize, numReps,
+                         codec->name(), ToString(prediction), interval,
+                         numThreads, independent.Width(),
+                         independent.Height())
+                  << '\n';
+
+        RunningStats ingest;
+        std::vector<RunningStats> reconstruct(ks.size());
+        std::size_t bytes = 0;
+        bool match = true;
+        for (int rep = 0; rep < numReps; ++rep) {
+          // Ingest: GDAL reads, change detection, residuals and encoding.
+          auto t0 = std::chrono::steady_clock::now();
+          TimeStack stack =
+              ReadTimeStack(days, blockSize, subBlockSize, interval, *codec,
+                            prediction, numThreads);
+          ingest.Update(ElapsedNs(t0));
+          bytes = stack.EncodedBytes();
+
+          // Day k replays every day since its keyframe.
+          for (std::size_t i = 0; i < ks.size(); ++i) {
+            t0 = std::chrono::steady_clock::now();
+            DecodeDay(stack, ks[i], numThreads);
+            reconstruct[i].Update(ElapsedNs(t0));
+          }
+
+          if (rep == 0)
+            for (int k : ks)
+              match = DecodeDay(stack, k, numThreads, &independent) && match;
+        }
+        std::cout << std::format(
+                         "encodedbytes:{},independentbytes:{},"
+                         "bytesperpixelperday:{},savingvsindependent:{},"
+                         "match:{}",
+                         bytes, independent.EncodedBytes(), bytes / pixelDays,
+                         1.0 - static_cast<double>(bytes) /
+                                   independent.EncodedBytes(),
+                         match)
+                  << '\n';
+        std::cout << std::format("meantimeingest:{},vartimeingest:{}",
+                                 ingest.mean, ingest.Variance())
+                  << '\n';
+        for (std::size_t i = 0; i < ks.size(); ++i)
+          std::cout << std::format(
+                           "day:{},daysreplayed:{},meantimereconstruct:{},"
+                           "vartimereconstruct:{}",
+                           ks[i], ks[i] % interval, reconstruct[i].mean,
+                           reconstruct[i].Variance())
+                    << '\n';
+      }
+    }
+  }
+
+  for (auto* dataset : days) GDALClose(dataset);
+  return 0;
+}
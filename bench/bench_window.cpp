@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <CLI/CLI.hpp>
+
+#include "bench_gdal_utils.h"
+#include "bench_utils.h"
+#include "block_grid.h"
+#include "codec_collection.h"
+#include "gdal_priv.h"
+#include "window_query.h"
+
+static std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>>
+BuildAllCodecs() {
+  auto pool = InitCodecs(/* nonCascaded */ true, nullptr);
+  for (auto& c :
+       InitCodecs(/* nonCascaded */ false, std::make_unique<DeltaCodec>()))
+    pool.push_back(std::move(c));
+  return pool;
+}
+
+int main(int argc, char* argv[]) {
+  CLI::App app{
+      "Benchmark window reads from a compressed grid (decoding only the "
+      "intersecting tiles) against GDAL RasterIO on the source file"};
+
+  std::string filePath;
+  int blockSize{}, numReps{};
+  std::vector<std::string> codecNames = {"[+]_custom_delta_unvec+simdcomp"};
+  std::vector<int> sizes = {64, 512, 2048};
+  int numWindows = 16;
+  bool geo = false;
+  bool noConstantTiles = false;
+  int numThreads = 1;
+  unsigned seed = 1;
+
+  app.add_option("file", filePath, "GeoTIFF file path")->required();
+  app.add_option("--blocksize,-b", blockSize, "Block side length in pixels")
+      ->required();
+  app.add_option("--numreps,-r", numReps, "Repetitions per combination")
+      ->required();
+  app.add_option("--codec", codecNames, "Codec name(s), or 'all'");
+  app.add_option("--sizes", sizes,
+                 "Window side length(s) in pixels, clamped to the grid "
+                 "(small/medium/large by default)");
+  app.add_option("--numwindows,-n", numWindows,
+                 "Random windows per size (not tile-aligned)");
+  app.add_flag("--geo", geo,
+               "Query by geo box through the dataset's geotransform");
+  app.add_flag("--noconstanttiles", noConstantTiles,
+               "Encode constant tiles with the codec too (no fill fast path)");
+  app.add_option("--threads,-t", numThreads, "OpenMP threads");
+  app.add_option("--seed", seed, "Seed for window positions");
+
+  CLI11_PARSE(app, argc, argv);
+
+  GDALAllRegister();
+  GDALSetCacheMax(64 * 1024 * 1024);
+  GDALDataset* dataset =
+      static_cast<GDALDataset*>(GDALOpen(filePath.c_str(), GA_ReadOnly));
+  if (dataset == nullptr) {
+    std::cerr << std::format("Failed to open file: {}", filePath) << '\n';
+    return 1;
+  }
+  GDALRasterBand* band = dataset->GetRasterBand(1);
+  GeoTransform transform;
+  if (geo && dataset->GetGeoTransform(transform.gt.data()) != CE_None) {
+    std::cerr << "Dataset has no geotransform.\n";
+    return 1;
+  }
+
+  auto pool = BuildAllCodecs();
+  auto codecs = SelectCodecsByName(pool, codecNames);
+  if (codecs.empty()) {
+    std::cerr << "NO CODECS SELECTED.\n";
+    return 1;
+  }
+
+  for (auto& codec : codecs) {
+    BlockGrid grid = ReadBlockGrid(band, blockSize, *codec, numThreads, false,
+                                   !noConstantTiles);
+    for (int size : sizes) {
+      const int side = std::min({size, grid.Width(), grid.Height()});
+      std::mt19937 gen(seed);
+      std::vector<PixelWindow> windows;
+      for (int i = 0; i < numWindows; ++i)
+        windows.push_back(
+            {std::uniform_int_distribution<int>(0, grid.Width() - side)(gen),
+             std::uniform_int_distribution<int>(0, grid.Height() - side)(gen),
+             side, side});
+
+      std::cout << "**BENCHMARK WINDOW**\n";
+      std::cout << std::format(
+                       "file={},blocksize={},numreps={},codec={},window={},"
+                       "numwindows={},geo={},constanttiles={},threads={},"
+                       "encodedbytes={}",
+                       filePath, blockSize, numReps, codec->name(), side,
+                       numWindows, geo, !noConstantTiles, numThreads,
+                       grid.EncodedBytes())
+                << '\n';
+
+      RunningStats grids, gdal;
+      WindowQueryStats total;
+      bool match = true;
+      std::vector<int32_t> expected;
+      for (int rep = 0; rep < numReps; ++rep) {
+        std::size_t gridTime = 0, gdalTime = 0;
+        total = {};
+        for (auto w : windows) {
+          WindowQueryStats stats;
+          std::vector<int32_t> values;
+          if (geo) {
+            // Pixel-aligned geo box of the same window.
+            double x0, y0, x1, y1;
+            transform.ToGeo(w.x, w.y, x0, y0);
+            transform.ToGeo(w.x + w.width, w.y + w.height, x1, y1);
+            auto t0 = std::chrono::steady_clock::now();
+            values = ReadGeoWindow(grid, transform, std::min(x0, x1),
+                                   std::min(y0, y1), std::max(x0, x1),
+                                   std::max(y0, y1), w, numThreads, &stats);
+            stats.wallTime =
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - t0)
+                    .count();
+          } else {
+            values = ReadWindow(grid, w, numThreads, &stats);
+          }
+          gridTime += stats.wallTime;
+          total.tilesFull += stats.tilesFull;
+          total.tilesPartial += stats.tilesPartial;
+          total.tilesFilled += stats.tilesFilled;
+          total.rowsDecoded += stats.rowsDecoded;
+
+          expected.resize(w.Size());
+          auto t0 = std::chrono::steady_clock::now();
+          CPLErr err = band->RasterIO(GF_Read, w.x, w.y, w.width, w.height,
+                                      expected.data(), w.width, w.height,
+                                      GDT_Int32, 0, 0);
+          gdalTime += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now() - t0)
+                          .count();
+          match = match && err == CE_None && values == expected;
+        }
+        grids.Update(gridTime);
+        gdal.Update(gdalTime);
+      }
+      std::cout << std::format(
+                       "tottimewall:{},meantimewall:{},vartimewall:{},"
+                       "tilesfull:{},tilespartial:{},tilesfilled:{},"
+                       "rowsdecoded:{},match:{}",
+                       grids.Total(), grids.mean, grids.Variance(),
+                       total.tilesFull, total.tilesPartial, total.tilesFilled,
+                       total.rowsDecoded, match)
+                << '\n';
+      std::cout << std::format("gdalrasterio:meantimewall:{},vartimewall:{}",
+                               gdal.mean, gdal.Variance())
+                << '\n';
+      if (grids.mean > 0)
+        std::cout << std::format("speedupvsgdal:{}", gdal.mean / grids.mean)
+                  << '\n';
+    }
+  }
+
+  GDALClose(dataset);
+  return 0;
+}
@@ -0,0 +1,185 @@
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <CLI/CLI.hpp>
+
+#include "bench_gdal_utils.h"
+#include "bench_utils.h"
+#include "block_grid.h"
+#include "codec_collection.h"
+#include "gdal_priv.h"
+#include "zonal.h"
+
+static std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>>
+BuildAllCodecs() {
+  auto pool = InitCodecs(/* nonCascaded */ true, nullptr);
+  for (auto& c :
+       InitCodecs(/* nonCascaded */ false, std::make_unique<DeltaCodec>()))
+    pool.push_back(std::move(c));
+  for (auto& c :
+       InitCodecs(/* nonCascaded */ false, std::make_unique<RLECodec>()))
+    pool.push_back(std::move(c));
+  return pool;
+}
+
+// Baseline: decode both tiles in full, then look up every valid pixel's
+// zone.
+static ZoneTable ZonalStatisticsDecodeBoth(const BlockGrid& values,
+                                           const BlockGrid& zones,
+                                           int numThreads) {
+  CheckSameShape(values, zones);
+  const std::size_t n = values.TileLength();
+  ZoneTable table;
+#pragma omp parallel num_threads(numThreads)
+  {
+    std::unordered_map<int32_t, ZoneStats> partial;
+    std::vector<int32_t> v(n + values.MaxOverflow()), z(n + zones.MaxOverflow());
+#pragma omp for schedule(dynamic)
+    for (std::size_t t = 0; t < values.tiles.size(); ++t) {
+      values.tiles[t]->DecodeRange(v.data(), 0, n, n);
+      zones.tiles[t]->DecodeRange(z.data(), 0, n, n);
+      for (std::size_t i = 0; i < n; ++i)
+        if ((!values.noData.present || v[i] != values.noData.value) &&
+            (!zones.noData.present || z[i] != zones.noData.value))
+          partial[z[i]].Add(v[i]);
+    }
+#pragma omp critical(zonal_merge)
+    for (const auto& [zone, stats] : partial) table[zone].Merge(stats);
+  }
+  return table;
+}
+
+static GDALRasterBand* OpenBand(const std::string& path,
+                                std::vector<GDALDataset*>& open) {
+  auto* dataset =
+      static_cast<GDALDataset*>(GDALOpen(path.c_str(), GA_ReadOnly));
+  if (dataset == nullptr) return nullptr;
+  open.push_back(dataset);
+  return dataset->GetRasterBand(1);
+}
+
+int main(int argc, char* argv[]) {
+  CLI::App app{
+      "Benchmark zonal statistics over a compressed value grid and zone grid "
+      "against decoding both and looping"};
+
+  std::string valuePath, zonePath;
+  int blockSize{}, numReps{};
+  std::vector<std::string> valueCodecNames = {"[+]_custom_delta_unvec+simdcomp"};
+  std::vector<std::string> zoneCodecNames = {"custom_rle_unvec"};
+  int numThreads = 1;
+  std::string noDataModeName = "none";
+  std::vector<std::string> kernels = {"auto"};
+
+  app.add_option("values", valuePath, "GeoTIFF of values (e.g. elevation)")
+      ->required();
+  app.add_option("zones", zonePath, "GeoTIFF of zones (e.g. land cover)")
+      ->required();
+  app.add_option("--blocksize,-b", blockSize, "Block side length in pixels")
+      ->required();
+  app.add_option("--numreps,-r", numReps, "Repetitions per combination")
+      ->required();
+  app.add_option("--vcodec", valueCodecNames,
+                 "Codec name(s) for the value grid, or 'all'");
+  app.add_option("--zcodec", zoneCodecNames,
+                 "Codec name(s) for the zone grid, or 'all'");
+  app.add_option("--threads,-t", numThreads, "OpenMP threads");
+  app.add_option("--nodata", noDataModeName,
+                 "Encoding of value tiles holding nodata: none|split|fill "
+                 "(nodata pixels are skipped either way)");
+  app.add_option("--kernel", kernels,
+                 "Slice kernel(s): auto|scalar|sse41|avx2|avx512");
+
+  CLI11_PARSE(app, argc, argv);
+
+  GDALAllRegister();
+  GDALSetCacheMax(64 * 1024 * 1024);
+  std::vector<GDALDataset*> open;
+  GDALRasterBand* valueBand = OpenBand(valuePath, open);
+  GDALRasterBand* zoneBand = OpenBand(zonePath, open);
+  if (valueBand == nullptr || zoneBand == nullptr) {
+    std::cerr << std::format("Failed to open file: {}",
+                             valueBand ? zonePath : valuePath)
+              << '\n';
+    return 1;
+  }
+  if (valueBand->GetXSize() != zoneBand->GetXSize() ||
+      valueBand->GetYSize() != zoneBand->GetYSize()) {
+    std::cerr << "Value and zone rasters differ in size.\n";
+    return 1;
+  }
+
+  auto pool = BuildAllCodecs();
+  auto valueCodecs = SelectCodecsByName(pool, valueCodecNames);
+  auto zoneCodecs = SelectCodecsByName(pool, zoneCodecNames);
+  if (valueCodecs.empty() || zoneCodecs.empty()) {
+    std::cerr << "NO CODECS SELECTED.\n";
+    return 1;
+  }
+
+  for (auto& valueCodec : valueCodecs) {
+    BlockGrid values =
+        ReadBlockGrid(valueBand, blockSize, *valueCodec, numThreads, false,
+                      true, ParseNoDataMode(noDataModeName));
+    for (auto& zoneCodec : zoneCodecs) {
+      BlockGrid zones = ReadBlockGrid(zoneBand, blockSize, *zoneCodec, numThreads);
+      for (auto& kernel : kernels) {
+        SetTransformationSimdLevel(ParseSimdLevel(kernel));
+        std::cout << "**BENCHMARK ZONAL**\n";
+        std::cout << std::format(
+                         "values={},zones={},blocksize={},numreps={},"
+                         "valuecodec={},zonecodec={},threads={},kernel={},"
+                         "nodata={},valuebytes={},zonebytes={}",
+                         valuePath, zonePath, blockSize, numReps,
+                         valueCodec->name(), zoneCodec->name(), numThreads,
+                         ToString(TransformationSimdLevel()), noDataModeName,
+                         values.EncodedBytes(), zones.EncodedBytes())
+                  << '\n';
+
+        RunningStats wall, decode, aggregate, baseline;
+        std::size_t numRuns = 0, numZones = 0;
+        bool match = true;
+        for (int rep = 0; rep < numReps; ++rep) {
+          ZonalTiming timing;
+          ZoneTable table = ZonalStatistics(values, zones, numThreads, &timing);
+          wall.Update(timing.wallTime);
+          decode.Update(timing.decodeTime);
+          aggregate.Update(timing.aggregateTime);
+          numRuns = timing.numRuns;
+          numZones = table.size();
+
+          auto t0 = std::chrono::steady_clock::now();
+          ZoneTable expected =
+              ZonalStatisticsDecodeBoth(values, zones, numThreads);
+          baseline.Update(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              std::chrono::steady_clock::now() - t0)
+                              .count());
+          match = match && table == expected;
+        }
+        std::cout << std::format(
+                         "tottimewall:{},meantimewall:{},vartimewall:{},"
+                         "meantimedecode:{},meantimeaggregate:{},runs:{},"
+                         "zones:{},match:{}",
+                         wall.Total(), wall.mean, wall.Variance(), decode.mean,
+                         aggregate.mean, numRuns, numZones, match)
+                  << '\n';
+        std::cout << std::format("decodeboth:meantimewall:{},vartimewall:{}",
+                                 baseline.mean, baseline.Variance())
+                  << '\n';
+        if (wall.mean > 0)
+          std::cout << std::format("speedupvsdecodeboth:{}",
+                                   baseline.mean / wall.mean)
+                    << '\n';
+      }
+    }
+  }
+
+  for (auto* dataset : open) GDALClose(dataset);
+  return 0;
+}
@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <cstdint>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <CLI/CLI.hpp>
+
+#include "bench_gdal_utils.h"
+#include "bench_utils.h"
+#include "block_grid.h"
+#include "codec_collection.h"
+#include "gdal_priv.h"
+#include "zone_map.h"
+
+static std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>>
+BuildAllCodecs() {
+  auto pool = InitCodecs(/* nonCascaded */ true, nullptr);
+  for (auto& c :
+       InitCodecs(/* nonCascaded */ false, std::make_unique<DeltaCodec>()))
+    pool.push_back(std::move(c));
+  return pool;
+}
+
+// "ge:" thresholds at the given quantiles of the grid's values, so the
+// default predicates select ~1%, ~10% and ~50% of the raster.
+static std::vector<ValuePredicate> QuantilePredicates(
+    const BlockGrid& grid, const std::vector<double>& quantiles) {
+  const std::size_t n = grid.TileLength();
+  std::vector<int32_t> all(grid.tiles.size() * n + grid.MaxOverflow());
+  for (std::size_t t = 0; t < grid.tiles.size(); ++t)
+    grid.tiles[t]->DecodeRange(all.data() + t * n, 0, n, n);
+  all.resize(grid.tiles.size() * n);
+  std::vector<ValuePredicate> preds;
+  for (double q : quantiles) {
+    auto k = static_cast<std::size_t>(q * (all.size() - 1));
+    std::nth_element(all.begin(), all.begin() + k, all.end());
+    preds.push_back({PredicateOp::GreaterEqual, all[k], 0});
+  }
+  return preds;
+}
+
+int main(int argc, char* argv[]) {
+  CLI::App app{
+      "Benchmark value-predicate queries (count or mask) over a compressed "
+      "grid with per-tile zone maps against decoding every tile"};
+
+  std::string filePath;
+  int blockSize{}, numReps{};
+  std::vector<std::string> codecNames = {"[+]_custom_delta_unvec+simdcomp"};
+  std::vector<std::string> predTexts;
+  bool histograms = false;
+  std::string query = "count";
+  int numThreads = 1;
+  std::vector<std::string> kernels = {"auto"};
+
+  app.add_option("file", filePath, "GeoTIFF file path")->required();
+  app.add_option("--blocksize,-b", blockSize, "Block side length in pixels")
+      ->required();
+  app.add_option("--numreps,-r", numReps, "Repetitions per combination")
+      ->required();
+  app.add_option("--codec", codecNames, "Codec name(s), or 'all'");
+  app.add_option("--pred", predTexts,
+                 "Predicate(s): gt|ge|lt|le|eq:V or between:A:B (default: "
+                 "ge: the 0.99, 0.9 and 0.5 quantiles)");
+  app.add_flag("--histogram", histograms,
+               "Record a 16-bin histogram in each tile's zone map");
+  app.add_option("--query", query, "count|mask");
+  app.add_option("--threads,-t", numThreads, "OpenMP threads");
+  app.add_option("--kernel", kernels,
+                 "Predicate kernel(s): auto|scalar|sse41|avx2|avx512");
+
+  CLI11_PARSE(app, argc, argv);
+  if (query != "count" && query != "mask") {
+    std::cerr << std::format("Unknown query: {}", query) << '\n';
+    return 1;
+  }
+
+  GDALAllRegister();
+  GDALSetCacheMax(64 * 1024 * 1024);
+  GDALDataset* dataset =
+      static_cast<GDALDataset*>(GDALOpen(filePath.c_str(), GA_ReadOnly));
+  if (dataset == nullptr) {
+    std::cerr << std::format("Failed to open file: {}", filePath) << '\n';
+    return 1;
+  }
+  GDALRasterBand* band = dataset->GetRasterBand(1);
+
+  auto pool = BuildAllCodecs();
+  auto codecs = SelectCodecsByName(pool, codecNames);
+  if (codecs.empty()) {
+    std::cerr << "NO CODECS SELECTED.\n";
+    return 1;
+  }
+  BitsetCodec maskProto;
+
+  for (auto& codec : codecs) {
+    BlockGrid grid =
+        ReadBlockGrid(band, blockSize, *codec, numThreads, histograms);
+    std::vector<ValuePredicate> preds;
+    for (auto& text : predTexts) preds.push_back(ParseValuePredicate(text));
+    if (preds.empty()) preds = QuantilePredicates(grid, {0.99, 0.9, 0.5});
+
+    for (auto& pred : preds) {
+      for (auto& kernel : kernels) {
+        SetTransformationSimdLevel(ParseSimdLevel(kernel));
+        std::cout << "**BENCHMARK ZONEMAP**\n";
+        std::cout << std::format(
+                         "file={},blocksize={},numreps={},codec={},pred={},"
+                         "histogram={},query={},threads={},kernel={},tiles={},"
+                         "encodedbytes={}",
+                         filePath, blockSize, numReps, codec->name(),
+                         ToString(pred), histograms, query, numThreads,
+                         ToString(TransformationSimdLevel()),
+                         grid.tiles.size(), grid.EncodedBytes())
+                  << '\n';
+
+        RunningStats pruned, baseline;
+        ZoneMapStats stats, baseStats;
+        uint64_t matches = 0;
+        bool match = true;
+        for (int rep = 0; rep < numReps; ++rep) {
+          if (query == "count") {
+            matches = CountMatching(grid, pred, numThreads, true, &stats);
+            match = match && matches == CountMatching(grid, pred, numThreads,
+                                                      false, &baseStats);
+          } else {
+            BlockGrid mask = PredicateMask(grid, pred, maskProto, numThreads,
+                                           true, &stats);
+            BlockGrid expected = PredicateMask(grid, pred, maskProto,
+                                               numThreads, false, &baseStats);
+            matches = 0;
+            for (auto& s : mask.synopses) matches += s.max;
+            std::vector<int32_t> a(mask.TileLength() + mask.MaxOverflow()),
+                b(a.size());
+            for (int by = 0; by < mask.blocksY; ++by)
+              for (int bx = 0; bx < mask.blocksX; ++bx) {
+                mask.DecodeTile(bx, by, a.data());
+                expected.DecodeTile(bx, by, b.data());
+                match = match && a == b;
+              }
+          }
+          pruned.Update(stats.wallTime);
+          baseline.Update(baseStats.wallTime);
+        }
+        std::cout << std::format(
+                         "tottimewall:{},meantimewall:{},vartimewall:{},"
+                         "tilesskipped:{},tilesfilled:{},tilesdecoded:{},"
+                         "{}:{},match:{}",
+                         pruned.Total(), pruned.mean, pruned.Variance(),
+                         stats.tilesSkipped, stats.tilesFilled,
+                         stats.tilesDecoded,
+                         query == "count" ? "matches" : "tileswithmatches",
+                         matches, match)
+                  << '\n';
+        std::cout << std::format("decodeall:meantimewall:{},vartimewall:{}",
+                                 baseline.mean, baseline.Variance())
+                  << '\n';
+        if (pruned.mean > 0)
+          std::cout << std::format("speedupvsdecodeall:{}",
+                                   baseline.mean / pruned.mean)
+                    << '\n';
+      }
+    }
+  }
+
+  GDALClose(dataset);
+  return 0;
+}
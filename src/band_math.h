@@ -0,0 +1,629 @@
+#pragma once
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "block_grid.h"
+#include "transformations_simd.h"
+
+///////////////////////////////////////////////////////////////////////////
+// band math: per-pixel arithmetic over several compressed band grids,   //
+// e.g. NDVI = (B2 - B1) / (B2 + B1). The expression is parsed once into //
+// postfix code. Tiles are then streamed chunk by chunk: each referenced //
+// band is pulled from its decode cursor into an L1-sized buffer and the //
+// whole program runs over that chunk before the next is decoded, so no  //
+// band or intermediate is ever materialised beyond one chunk.           //
+///////////////////////////////////////////////////////////////////////////
+
+// Grammar (whitespace ignored, bands are 1-based as in GDAL):
+//   expr    := term (('+' | '-') term)*
+//   term    := unary (('*' | '/') unary)*
+//   unary   := '-' unary | primary
+//   primary := number | 'B' digits | ('min' | 'max') '(' expr ',' expr ')'
+//            | '(' expr ')'
+// Arithmetic is single precision; constant subexpressions are folded and
+// constant operands become immediates.
+
+enum class BandMathOpCode : uint8_t {
+  Load,   // push band `band`
+  Const,  // push `imm`
+  Neg,
+  Add,
+  Sub,
+  Mul,
+  Div,
+  Min,
+  Max,
+};
+
+struct BandMathOp {
+  BandMathOpCode code;
+  int band = 0;          // Load: 0-based band index
+  float imm = 0;         // Const, or the constant operand of a binary op
+  bool immLhs = false;   // binary: imm op top
+  bool immRhs = false;   // binary: top op imm
+};
+
+struct BandMathExpr {
+  std::string source;
+  std::vector<BandMathOp> code;
+  std::vector<int> bands;  // 0-based bands loaded, ascending
+  int maxDepth = 0;        // chunk registers needed
+};
+
+namespace band_math_detail {
+
+struct Node {
+  BandMathOpCode code;
+  int band = 0;
+  float value = 0;
+  std::unique_ptr<Node> lhs, rhs;
+};
+
+inline float Apply(BandMathOpCode c, float a, float b) {
+  switch (c) {
+    case BandMathOpCode::Add:
+      return a + b;
+    case BandMathOpCode::Sub:
+      return a - b;
+    case BandMathOpCode::Mul:
+      return a * b;
+    case BandMathOpCode::Div:
+      return a / b;
+    case BandMathOpCode::Min:
+      return b < a ? b : a;
+    case BandMathOpCode::Max:
+      return a < b ? b : a;
+    default:
+      return 0;
+  }
+}
+
+class Parser {
+ public:
+  explicit Parser(const std::string& s) : s{s} {}
+
+  std::unique_ptr<Node> Parse() {
+    auto n = Expr();
+    Skip();
+    if (pos != s.size()) Fail("unexpected '" + std::string(1, s[pos]) + "'");
+    return n;
+  }
+
+ private:
+  const std::string& s;
+  std::size_t pos = 0;
+
+  [[noreturn]] void Fail(const std::string& what) {
+    throw std::invalid_argument("Band math: " + what + " at position " +
+                                std::to_string(pos) + " of \"" + s + "\"");
+  }
+
+  void Skip() {
+    while (pos < s.size() && std::isspace(static_cast<unsigned char>(s[pos])))
+      ++pos;
+  }
+
+  bool Accept(char c) {
+    Skip();
+    if (pos < s.size() && s[pos] == c) {
+      ++pos;
+      return true;
+    }
+    return false;
+  }
+
+  void Expect(char c) {
+    if (!Accept(c)) Fail(std::string("expected '") + c + "'");
+  }
+
+  static std::unique_ptr<Node> Leaf(BandMathOpCode c, float v, int band = 0) {
+    auto n = std::make_unique<Node>();
+    n->code = c;
+    n->value = v;
+    n->band = band;
+    return n;
+  }
+
+  // Folds when both sides are constants.
+  static std::unique_ptr<Node> Binary(BandMathOpCode c,
+                                      std::unique_ptr<Node> l,
+                                      std::unique_ptr<Node> r) {
+    if (l->code == BandMathOpCode::Const && r->code == BandMathOpCode::Const)
+      return Leaf(BandMathOpCode::Const, Apply(c, l->value, r->value));
+    auto n = std::make_unique<Node>();
+    n->code = c;
+    n->lhs = std::move(l);
+    n->rhs = std::move(r);
+    return n;
+  }
+
+  std::unique_ptr<Node> Expr() {
+    auto n = Term();
+    for (;;) {
+      if (Accept('+'))
+        n = Binary(BandMathOpCode::Add, std::move(n), Term());
+      else if (Accept('-'))
+        n = Binary(BandMathOpCode::Sub, std::move(n), Term());
+      else
+        return n;
+    }
+  }
+
+  std::unique_ptr<Node> Term() {
+    auto n = Unary();
+    for (;;) {
+      if (Accept('*'))
+        n = Binary(BandMathOpCode::Mul, std::move(n), Unary());
+      else if (Accept('/'))
+        n = Binary(BandMathOpCode::Div, std::move(n), Unary());
+      else
+        return n;
+    }
+  }
+
+  std::unique_ptr<Node> Unary() {
+    if (!Accept('-')) return Primary();
+    auto operand = Unary();
+    if (operand->code == BandMathOpCode::Const)
+      return Leaf(BandMathOpCode::Const, -operand->value);
+    auto n = std::make_unique<Node>();
+    n->code = BandMathOpCode::Neg;
+    n->lhs = std::move(operand);
+    return n;
+  }
+
+  std::unique_ptr<Node> Primary() {
+    Skip();
+    if (pos == s.size()) Fail("unexpected end");
+    if (Accept('(')) {
+      auto n = Expr();
+      Expect(')');
+      return n;
+    }
+    const char c = s[pos];
+    if (std::isdigit(static_cast<unsigned char>(c)) || c == '.') {
+      char* end = nullptr;
+      float v = std::strtof(s.c_str() + pos, &end);
+      if (end == s.c_str() + pos) Fail("bad number");
+      pos = end - s.c_str();
+      return Leaf(BandMathOpCode::Const, v);
+    }
+    if (c == 'B' || c == 'b') {
+      std::size_t start = ++pos;
+      while (pos < s.size() && std::isdigit(static_cast<unsigned char>(s[pos])))
+        ++pos;
+      if (start == pos) Fail("expected a band number");
+      int band = 0;
+      try {
+        band = std::stoi(s.substr(start, pos - start));
+      } catch (const std::out_of_range&) {
+        Fail("band number out of range");
+      }
+      if (band < 1) Fail("bands are numbered from 1");
+      return Leaf(BandMathOpCode::Load, 0, band - 1);
+    }
+    for (auto [name, code] : {std::pair{"min", BandMathOpCode::Min},
+                              std::pair{"max", BandMathOpCode::Max}}) {
+      if (s.compare(pos, 3, name) != 0) continue;
+      pos += 3;
+      Expect('(');
+      auto l = Expr();
+      Expect(',');
+      auto r = Expr();
+      Expect(')');
+      return Binary(code, std::move(l), std::move(r));
+    }
+    Fail("unexpected '" + std::string(1, c) + "'");
+  }
+};
+
+inline void Emit(const Node& n, BandMathExpr& e, int& depth) {
+  auto push = [&](BandMathOp op) {
+    e.code.push_back(op);
+    e.maxDepth = std::max(e.maxDepth, ++depth);
+  };
+  switch (n.code) {
+    case BandMathOpCode::Load:
+      push({.code = n.code, .band = n.band});
+      e.bands.push_back(n.band);
+      return;
+    case BandMathOpCode::Const:
+      push({.code = n.code, .imm = n.value});
+      return;
+    case BandMathOpCode::Neg:
+      Emit(*n.lhs, e, depth);
+      e.code.push_back({.code = n.code});
+      return;
+    default:
+      break;
+  }
+  BandMathOp op{.code = n.code};
+  if (n.rhs->code == BandMathOpCode::Const) {
+    Emit(*n.lhs, e, depth);
+    op.imm = n.rhs->value;
+    op.immRhs = true;
+  } else if (n.lhs->code == BandMathOpCode::Const) {
+    Emit(*n.rhs, e, depth);
+    op.imm = n.lhs->value;
+    op.immLhs = true;
+  } else {
+    Emit(*n.lhs, e, depth);
+    Emit(*n.rhs, e, depth);
+    --depth;
+  }
+  e.code.push_back(op);
+}
+
+}  // namespace band_math_detail
+
+// Parses `source`; throws std::invalid_argument on syntax errors.
+inline BandMathExpr CompileBandMath(const std::string& source) {
+  BandMathExpr e;
+  e.source = source;
+  auto root = band_math_detail::Parser(source).Parse();
+  int depth = 0;
+  band_math_detail::Emit(*root, e, depth);
+  std::sort(e.bands.begin(), e.bands.end());
+  e.bands.erase(std::unique(e.bands.begin(), e.bands.end()), e.bands.end());
+  return e;
+}
+
+struct BandMathParams {
+  float scale = 1.0f;  // output = round(value * scale), ties to even
+  int32_t noData = std::numeric_limits<int32_t>::min();  // NaN, +-inf and
+                                                          // out of range
+  std::size_t chunkValues = 1024;  // per register; 4 KiB keeps it in L1
+};
+
+struct BandMathStats {
+  std::size_t decodeTime = 0;  // ns (all threads)
+  std::size_t evalTime = 0;    // ns (all threads)
+  std::size_t encodeTime = 0;  // ns (all threads)
+  std::size_t wallTime = 0;    // ns
+};
+
+////////////////////
+// chunk kernels  //
+////////////////////
+
+// The op loops are written once, as plain loops the compiler vectorises,
+// and inlined into one entry point per target (the scalar one has
+// vectorisation switched off). Each op is its own pass over the chunk, so
+// results do not depend on the target.
+
+namespace band_math_detail {
+
+template <typename F>
+[[gnu::always_inline]] inline void Map(float* a, const float* b, std::size_t n,
+                                       F f) {
+  for (std::size_t i = 0; i < n; ++i) a[i] = f(a[i], b[i]);
+}
+
+template <typename F>
+[[gnu::always_inline]] inline void MapImm(float* a, float imm, bool immLhs,
+                                          std::size_t n, F f) {
+  if (immLhs)
+    for (std::size_t i = 0; i < n; ++i) a[i] = f(imm, a[i]);
+  else
+    for (std::size_t i = 0; i < n; ++i) a[i] = f(a[i], imm);
+}
+
+template <typename F>
+[[gnu::always_inline]] inline void Binary(const BandMathOp& op, float* lhs,
+                                          const float* top, std::size_t n,
+                                          F f) {
+  if (op.immLhs || op.immRhs)
+    MapImm(lhs, op.imm, op.immLhs, n, f);
+  else
+    Map(lhs, top, n, f);
+}
+
+// `in[b]` holds band b's chunk (only the bands the program loads); `regs`
+// holds maxDepth registers `stride` floats apart. Returns the result
+// register.
+[[gnu::always_inline]] inline const float* Run(const BandMathExpr& e,
+                                               const int32_t* const* in,
+                                               std::size_t n, float* regs,
+                                               std::size_t stride) {
+  float* top = regs - stride;
+  for (const BandMathOp& op : e.code) {
+    switch (op.code) {
+      case BandMathOpCode::Load: {
+        top += stride;
+        const int32_t* src = in[op.band];
+        for (std::size_t i = 0; i < n; ++i) top[i] = static_cast<float>(src[i]);
+        break;
+      }
+      case BandMathOpCode::Const:
+        top += stride;
+        std::fill_n(top, n, op.imm);
+        break;
+      case BandMathOpCode::Neg:
+        for (std::size_t i = 0; i < n; ++i) top[i] = -top[i];
+        break;
+      default: {
+        const bool imm = op.immLhs || op.immRhs;
+        float* dst = imm ? top : top - stride;
+        switch (op.code) {
+          case BandMathOpCode::Add:
+            Binary(op, dst, top, n, [](float a, float b) { return a + b; });
+            break;
+          case BandMathOpCode::Sub:
+            Binary(op, dst, top, n, [](float a, float b) { return a - b; });
+            break;
+          case BandMathOpCode::Mul:
+            Binary(op, dst, top, n, [](float a, float b) { return a * b; });
+            break;
+          case BandMathOpCode::Div:
+            Binary(op, dst, top, n, [](float a, float b) { return a / b; });
+            break;
+          case BandMathOpCode::Min:
+            Binary(op, dst, top, n,
+                   [](float a, float b) { return b < a ? b : a; });
+            break;
+          case BandMathOpCode::Max:
+            Binary(op, dst, top, n,
+                   [](float a, float b) { return a < b ? b : a; });
+            break;
+          default:
+            break;
+        }
+        top = dst;
+      }
+    }
+  }
+  return top;
+}
+
+// Output stores: round(v * scale) to nearest, ties to even, in every kernel
+// (nearbyint under the default rounding mode, and the explicit SIMD
+// rounding); noData for NaN, infinities and values outside int32. 2^31 is
+// exact in float and NaN fails both range comparisons.
+
+constexpr float kStoreLo = -2147483648.0f, kStoreHi = 2147483648.0f;
+
+inline void StoreScalar(const float* r, std::size_t n, int32_t* out,
+                        const BandMathParams& p) {
+  for (std::size_t i = 0; i < n; ++i) {
+    float v = std::nearbyint(r[i] * p.scale);
+    out[i] = v > kStoreLo && v < kStoreHi ? static_cast<int32_t>(v) : p.noData;
+  }
+}
+
+inline void StoreSSE41(const float* r, std::size_t n, int32_t* out,
+                       const BandMathParams& p) {
+  const __m128 scale = _mm_set1_ps(p.scale), lo = _mm_set1_ps(kStoreLo),
+               hi = _mm_set1_ps(kStoreHi);
+  const __m128 noData = _mm_castsi128_ps(_mm_set1_epi32(p.noData));
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128 v = _mm_round_ps(_mm_mul_ps(_mm_loadu_ps(r + i), scale),
+                            _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m128 ok = _mm_and_ps(_mm_cmpgt_ps(v, lo), _mm_cmplt_ps(v, hi));
+    __m128 q = _mm_castsi128_ps(_mm_cvttps_epi32(v));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                     _mm_castps_si128(_mm_blendv_ps(noData, q, ok)));
+  }
+  StoreScalar(r + i, n - i, out + i, p);
+}
+
+TRANSFORM_TARGET_AVX2
+inline void StoreAVX2(const float* r, std::size_t n, int32_t* out,
+                      const BandMathParams& p) {
+  const __m256 scale = _mm256_set1_ps(p.scale),
+               lo = _mm256_set1_ps(kStoreLo), hi = _mm256_set1_ps(kStoreHi);
+  const __m256 noData = _mm256_castsi256_ps(_mm256_set1_epi32(p.noData));
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 v = _mm256_round_ps(_mm256_mul_ps(_mm256_loadu_ps(r + i), scale),
+                               _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 ok = _mm256_and_ps(_mm256_cmp_ps(v, lo, _CMP_GT_OQ),
+                              _mm256_cmp_ps(v, hi, _CMP_LT_OQ));
+    __m256 q = _mm256_castsi256_ps(_mm256_cvttps_epi32(v));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+                        _mm256_castps_si256(_mm256_blendv_ps(noData, q, ok)));
+  }
+  StoreScalar(r + i, n - i, out + i, p);
+}
+
+TRANSFORM_TARGET_AVX512
+inline void StoreAVX512(const float* r, std::size_t n, int32_t* out,
+                        const BandMathParams& p) {
+  const __m512 scale = _mm512_set1_ps(p.scale), lo = _mm512_set1_ps(kStoreLo),
+               hi = _mm512_set1_ps(kStoreHi);
+  const __m512i noData = _mm512_set1_epi32(p.noData);
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m512 v = _mm512_roundscale_ps(
+        _mm512_mul_ps(_mm512_loadu_ps(r + i), scale),
+        _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __mmask16 ok = _mm512_cmp_ps_mask(v, lo, _CMP_GT_OQ) &
+                   _mm512_cmp_ps_mask(v, hi, _CMP_LT_OQ);
+    _mm512_storeu_si512(out + i, _mm512_mask_blend_epi32(
+                                     ok, noData, _mm512_cvttps_epi32(v)));
+  }
+  StoreScalar(r + i, n - i, out + i, p);
+}
+
+[[gnu::optimize("no-tree-vectorize")]] inline void RunScalar(
+    const BandMathExpr& e, const int32_t* const* in, std::size_t n,
+    float* regs, std::size_t stride, int32_t* out, const BandMathParams& p) {
+  StoreScalar(Run(e, in, n, regs, stride), n, out, p);
+}
+
+inline void RunSSE41(const BandMathExpr& e, const int32_t* const* in,
+                     std::size_t n, float* regs, std::size_t stride,
+                     int32_t* out, const BandMathParams& p) {
+  StoreSSE41(Run(e, in, n, regs, stride), n, out, p);
+}
+
+TRANSFORM_TARGET_AVX2
+inline void RunAVX2(const BandMathExpr& e, const int32_t* const* in,
+                    std::size_t n, float* regs, std::size_t stride,
+                    int32_t* out, const BandMathParams& p) {
+  StoreAVX2(Run(e, in, n, regs, stride), n, out, p);
+}
+
+TRANSFORM_TARGET_AVX512
+inline void RunAVX512(const BandMathExpr& e, const int32_t* const* in,
+                      std::size_t n, float* regs, std::size_t stride,
+                      int32_t* out, const BandMathParams& p) {
+  StoreAVX512(Run(e, in, n, regs, stride), n, out, p);
+}
+
+}  // namespace band_math_detail
+
+// Evaluates `e` over n pixels into `out`; `in` is indexed by band and
+// `regs` holds e.maxDepth registers of `stride` >= n floats. Dispatches on
+// TransformationSimdLevel().
+inline void RunBandMath(const BandMathExpr& e, const int32_t* const* in,
+                        std::size_t n, float* regs, std::size_t stride,
+                        int32_t* out, const BandMathParams& p) {
+  using namespace band_math_detail;
+  switch (TransformationSimdLevel()) {
+    case SimdLevel::AVX512:
+      return RunAVX512(e, in, n, regs, stride, out, p);
+    case SimdLevel::AVX2:
+      return RunAVX2(e, in, n, regs, stride, out, p);
+    case SimdLevel::SSE41:
+      return RunSSE41(e, in, n, regs, stride, out, p);
+    case SimdLevel::Scalar:
+      return RunScalar(e, in, n, regs, stride, out, p);
+  }
+}
+
+///////////////////////
+// grid evaluation   //
+///////////////////////
+
+// Checks the grids `e` reads (entries it does not read may be null) and
+// returns the one giving the output shape.
+inline const BlockGrid& CheckBandMathInputs(
+    const BandMathExpr& e, const std::vector<const BlockGrid*>& bands) {
+  if (bands.empty())
+    throw std::invalid_argument("Band math needs at least one band grid");
+  if (!e.bands.empty() && e.bands.back() >= static_cast<int>(bands.size()))
+    throw std::invalid_argument("\"" + e.source + "\" reads B" +
+                                std::to_string(e.bands.back() + 1) +
+                                " but only " + std::to_string(bands.size()) +
+                                " band grids were given");
+  const int first = e.bands.empty() ? 0 : e.bands.front();
+  for (int b : e.bands.empty() ? std::vector<int>{0} : e.bands) {
+    const BlockGrid* g = bands[b];
+    if (g == nullptr)
+      throw std::invalid_argument("Band grid B" + std::to_string(b + 1) +
+                                  " is missing");
+    if (g->blockSize != bands[first]->blockSize ||
+        g->blocksX != bands[first]->blocksX ||
+        g->blocksY != bands[first]->blocksY)
+      throw std::invalid_argument("Band grids B" + std::to_string(first + 1) +
+                                  " and B" + std::to_string(b + 1) +
+                                  " differ in shape");
+  }
+  return *bands[first];
+}
+
+// Evaluates `e` over the band grids (B1 = bands[0], ...) into a grid
+// encoded with clones of `outProto`. Each tile is processed in chunks of
+// p.chunkValues (rounded up to the cursors' granularity): every loaded
+// band's cursor yields one chunk, the program runs on it, and only the
+// output tile is kept whole for encoding.
+inline BlockGrid EvaluateBandMath(const BandMathExpr& e,
+                                  const std::vector<const BlockGrid*>& bands,
+                                  const StatefulIntegerCodec<int32_t>& outProto,
+                                  const BandMathParams& p = {},
+                                  int numThreads = 1,
+                                  BandMathStats* stats = nullptr) {
+  const BlockGrid& shape = CheckBandMathInputs(e, bands);
+  const std::size_t n = shape.TileLength();
+
+  std::size_t granularity = 1, overflow = 0;
+  for (int b : e.bands) {
+    overflow = std::max(overflow, bands[b]->MaxOverflow());
+    granularity = std::lcm(granularity, bands[b]->CursorGranularity());
+  }
+  const std::size_t chunk =
+      std::min(n, (std::max<std::size_t>(p.chunkValues, 1) + granularity - 1) /
+                      granularity * granularity);
+
+  BlockGrid out;
+  out.blockSize = shape.blockSize;
+  out.blocksX = shape.blocksX;
+  out.blocksY = shape.blocksY;
+  out.tiles.resize(shape.tiles.size());
+
+  std::size_t decodeTime = 0, evalTime = 0, encodeTime = 0;
+  auto elapsed = [](auto t0) {
+    return static_cast<std::size_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - t0)
+            .count());
+  };
+  OmpExceptionGuard guard;
+  auto tStart = std::chrono::steady_clock::now();
+#pragma omp parallel num_threads(numThreads) \
+    reduction(+ : decodeTime, evalTime, encodeTime)
+  {
+    std::vector<std::vector<int32_t>> buffers(bands.size());
+    std::vector<const int32_t*> in(bands.size(), nullptr);
+    for (int b : e.bands) {
+      buffers[b].resize(chunk + overflow);
+      in[b] = buffers[b].data();
+    }
+    std::vector<float> regs(static_cast<std::size_t>(e.maxDepth) * chunk);
+    std::vector<int32_t> result(n);
+    std::vector<std::unique_ptr<DecodeCursor<int32_t>>> cursors(bands.size());
+#pragma omp for schedule(dynamic)
+    for (std::size_t t = 0; t < shape.tiles.size(); ++t)
+      guard.Run([&] {
+        auto t0 = std::chrono::steady_clock::now();
+        for (int b : e.bands)
+          cursors[b] = bands[b]->tiles[t]->NewDecodeCursor(n);
+        decodeTime += elapsed(t0);
+        for (std::size_t pos = 0; pos < n; pos += chunk) {
+          const std::size_t m = std::min(chunk, n - pos);
+          t0 = std::chrono::steady_clock::now();
+          for (int b : e.bands)
+            for (std::size_t got = 0; got < m;) {
+              std::size_t k =
+                  cursors[b]->Next(buffers[b].data() + got, m - got);
+              if (k == 0)
+                throw std::runtime_error("Band tile ended before its length");
+              got += k;
+            }
+          decodeTime += elapsed(t0);
+          t0 = std::chrono::steady_clock::now();
+          RunBandMath(e, in.data(), m, regs.data(), chunk,
+                      result.data() + pos, p);
+          evalTime += elapsed(t0);
+        }
+        t0 = std::chrono::steady_clock::now();
+        out.tiles[t].reset(outProto.CloneFresh());
+        out.tiles[t]->AllocEncoded(result.data(), n);
+        out.tiles[t]->EncodeArray(result.data(), n);
+        encodeTime += elapsed(t0);
+      });
+  }
+  guard.Rethrow();
+
+  if (stats) {
+    stats->decodeTime = decodeTime;
+    stats->evalTime = evalTime;
+    stats->encodeTime = encodeTime;
+    stats->wallTime = elapsed(tStart);
+  }
+  return out;
+}
@@ -13,7 +13,9 @@
 #include <string>
 #include <vector>
 
+#include "bitmap_codecs.h"
 #include "generic_codecs.h"
+#include "nodata_codecs.h"
 #include "remappings.h"
 #include "transformations.h"
 #include "util.h"
@@ -36,14 +38,17 @@ enum class AccessTransformation {
   LinearXOR,
   LinearSum,
   LinearSumSimd,   // SSE SIMD vectorised sum — fair baseline matching FastPFor ISA
-  LinearSumFused,  // reads pre-computed 32-bit sum from codec overflow slot
+  LinearSumFused,  // codec's overflow-slot sum, else its FusedSum
   RandomXOR,
   RandomSum,
   Threshold,
   SmoothAndShift,
   IndexBasedClassification,
   ValueBasedClassification,
-  ValueShift
+  ValueShift,
+  ThresholdFused,  // codec emits a bitset straight from the encoded payload
+  ValueShiftFused, // codec shifts its encoded values, e.g. via the FOR reference
+  SumFused         // codec sums its encoded block; works through composites
 };
 
 
@@ -87,6 +92,9 @@ inline AccessTransformation ParseAccessTransformation(const std::string& s) {
   if (s == "ValueBasedClassification")
     return AccessTransformation::ValueBasedClassification;
   if (s == "ValueShift") return AccessTransformation::ValueShift;
+  if (s == "ThresholdFused") return AccessTransformation::ThresholdFused;
+  if (s == "ValueShiftFused") return AccessTransformation::ValueShiftFused;
+  if (s == "SumFused") return AccessTransformation::SumFused;
   throw std::invalid_argument("Unknown access transformation: " + s);
 }
 
@@ -155,6 +163,12 @@ inline std::string ToString(AccessTransformation t) {
       return "ValueBasedClassification";
     case AccessTransformation::ValueShift:
       return "ValueShift";
+    case AccessTransformation::ThresholdFused:
+      return "ThresholdFused";
+    case AccessTransformation::ValueShiftFused:
+      return "ValueShiftFused";
+    case AccessTransformation::SumFused:
+      return "SumFused";
   }
   return "";
 }
@@ -217,6 +231,7 @@ void RemapAndTransform(std::vector<T>& data, Ordering o, Transformation t,
 
 // Sink for SIMD/fused sum results — file-scope prevents dead-code elimination.
 inline int32_t kLinearSumSink = 0;
+inline int64_t kFusedSumSink = 0;
 
 // Returns true for variants that mutate the block data (requiring re-encoding).
 inline bool AccessTransformationMutatesData(AccessTransformation t) {
@@ -232,18 +247,78 @@ inline bool AccessTransformationMutatesData(AccessTransformation t) {
   }
 }
 
+// Returns true for variants applied to the encoded block by the codec itself
+// (see ApplyFusedAccessTransformation) rather than to a decoded buffer.
+inline bool AccessTransformationIsFused(AccessTransformation t) {
+  return t == AccessTransformation::ThresholdFused ||
+         t == AccessTransformation::ValueShiftFused ||
+         t == AccessTransformation::SumFused;
+}
+
+// Returns true for variants that act on each value independently, so they can
+// run on a chunk of a block straight after it is decoded (see DecodeCursor).
+inline bool AccessTransformationIsElementwise(AccessTransformation t) {
+  switch (t) {
+    case AccessTransformation::LinearXOR:
+    case AccessTransformation::LinearSum:
+    case AccessTransformation::LinearSumSimd:
+    case AccessTransformation::ValueShift:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Chunk counterpart of ApplyAccessTransformation for element-wise variants.
+inline void ApplyAccessTransformationChunk(int32_t* data, std::size_t count,
+                                           AccessTransformation t) {
+  switch (t) {
+    case AccessTransformation::ValueShift: {
+      ValueShift(data, count, static_cast<int32_t>(std::pow(2, 23)));
+      break;
+    }
+    case AccessTransformation::LinearSum: {
+      volatile int64_t dummy = 0;  // volatile prevents auto-vectorisation
+      for (std::size_t i = 0; i < count; ++i) dummy += data[i];
+      break;
+    }
+    case AccessTransformation::LinearSumSimd: {
+      std::size_t i = 0;
+      __m128i vsum = _mm_setzero_si128();
+      for (; i + 4 <= count; i += 4)
+        vsum = _mm_add_epi32(vsum,
+                             _mm_loadu_si128((const __m128i*)&data[i]));
+      vsum = _mm_hadd_epi32(vsum, vsum);
+      vsum = _mm_hadd_epi32(vsum, vsum);
+      kLinearSumSink += _mm_cvtsi128_si32(vsum);
+      for (; i < count; ++i) kLinearSumSink += data[i];
+      break;
+    }
+    case AccessTransformation::LinearXOR: {
+      volatile int32_t dummy = 0;
+      for (std::size_t i = 0; i < count; ++i) dummy ^= data[i];
+      break;
+    }
+    default:
+      throw std::invalid_argument("Access transformation " + ToString(t) +
+                                  " cannot run on chunks");
+  }
+}
+
 // Primary template: no-op for unsupported element types; returns 0 ns.
+// `codec` is the codec `data` was decoded from, used by LinearSumFused.
 template <typename T>
-std::size_t ApplyAccessTransformation(std::vector<T>& /*data*/,
-                                       AccessTransformation /*t*/,
-                                       std::size_t /*blockSize*/) {
+std::size_t ApplyAccessTransformation(
+    std::vector<T>& /*data*/, AccessTransformation /*t*/,
+    std::size_t /*blockSize*/,
+    StatefulIntegerCodec<T>* /*codec*/ = nullptr) {
   return 0;
 }
 
 template <>
 inline std::size_t ApplyAccessTransformation<int32_t>(
     std::vector<int32_t>& data, AccessTransformation t,
-    std::size_t blockSize) {
+    std::size_t blockSize, StatefulIntegerCodec<int32_t>* codec) {
   auto startRead = std::chrono::steady_clock::now();
   switch (t) {
     case AccessTransformation::Threshold:
@@ -261,6 +336,11 @@ inline std::size_t ApplyAccessTransformation<int32_t>(
     case AccessTransformation::ValueShift:
       ValueShift(data, static_cast<int32_t>(std::pow(2, 23)));
       break;
+    case AccessTransformation::ThresholdFused:
+    case AccessTransformation::ValueShiftFused:
+    case AccessTransformation::SumFused:
+      throw std::invalid_argument(ToString(t) +
+                                  " applies to encoded blocks, not buffers");
     case AccessTransformation::LinearSum: {
       volatile int64_t dummy = 0;  // volatile prevents auto-vectorisation
       for (std::size_t bi = 0; bi < blockSize * blockSize; bi++) {
@@ -285,8 +365,25 @@ inline std::size_t ApplyAccessTransformation<int32_t>(
       break;
     }
     case AccessTransformation::LinearSumFused: {
-      // Reads 32-bit sum written by the codec into the overflow slot.
-      kLinearSumSink = data[blockSize * blockSize];
+      // The *_fused codecs leave a 32-bit sum in the overflow slot while
+      // decoding. Any other codec sums its encoded block (FusedSum), and
+      // without one the decoded values are summed. Nodata tiles sum only
+      // their valid pixels.
+      std::size_t n = blockSize * blockSize;
+      if (auto* nd = dynamic_cast<NoDataCodec*>(codec)) {
+        kFusedSumSink = nd->ValidSum(n, data.data());
+        break;
+      }
+      if (codec && codec->WritesOverflowSum() && data.size() > n) {
+        kLinearSumSink = data[n];
+        break;
+      }
+      int64_t sum = 0;
+      if (!codec || !codec->FusedSum(n, sum)) {
+        sum = 0;
+        for (std::size_t bi = 0; bi < n; bi++) sum += data[bi];
+      }
+      kFusedSumSink = sum;
       break;
     }
     case AccessTransformation::RandomXOR: {
@@ -328,6 +425,67 @@ inline std::size_t ApplyAccessTransformation<int32_t>(
           .count());
 }
 
+// Applies a fused variant to an encoded block, replacing `codec` with the
+// result: a BitsetCodec for ThresholdFused, the shifted codec itself for
+// ValueShiftFused. SumFused leaves the block as is and writes the block sum
+// (of the valid pixels, for nodata tiles) to kFusedSumSink. Codecs without
+// the fused kernel are decoded, transformed and re-encoded into the same
+// output format. Returns the elapsed ns.
+inline std::size_t ApplyFusedAccessTransformation(
+    std::unique_ptr<StatefulIntegerCodec<int32_t>>& codec,
+    AccessTransformation t, std::size_t blockSize) {
+  std::size_t n = blockSize * blockSize;
+  auto t0 = std::chrono::steady_clock::now();
+  auto decodeAll = [&] {
+    std::vector<int32_t> buf(n + codec->GetOverflowSize(n));
+    codec->DecodeArray(buf.data(), n);
+    buf.resize(n);
+    return buf;
+  };
+  switch (t) {
+    case AccessTransformation::ThresholdFused: {
+      auto bitset = std::make_unique<BitsetCodec>();
+      bitset->AllocEncoded(nullptr, n);
+      if (!codec->FusedThreshold(n, bitset->words.data())) {
+        auto buf = decodeAll();
+        Threshold(buf, Avg(buf));
+        bitset->EncodeArray(buf.data(), n);
+      }
+      codec = std::move(bitset);
+      break;
+    }
+    case AccessTransformation::ValueShiftFused: {
+      int32_t delta = static_cast<int32_t>(std::pow(2, 23));
+      if (!codec->FusedValueShift(n, delta)) {
+        auto buf = decodeAll();
+        ValueShift(buf, delta);
+        std::unique_ptr<StatefulIntegerCodec<int32_t>> reenc(
+            codec->CloneFresh());
+        reenc->AllocEncoded(buf.data(), n);
+        reenc->EncodeArray(buf.data(), n);
+        codec = std::move(reenc);
+      }
+      break;
+    }
+    case AccessTransformation::SumFused: {
+      int64_t sum = 0;
+      if (auto* nd = dynamic_cast<NoDataCodec*>(codec.get())) {
+        sum = nd->ValidSum(n);
+      } else if (!codec->FusedSum(n, sum)) {
+        auto buf = decodeAll();
+        for (int32_t v : buf) sum += v;
+      }
+      kFusedSumSink = sum;
+      break;
+    }
+    default:
+      throw std::invalid_argument(ToString(t) + " is not a fused variant");
+  }
+  auto t1 = std::chrono::steady_clock::now();
+  return static_cast<std::size_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count());
+}
+
 
 struct RunningStats {
   std::size_t n = 0;
@@ -340,6 +498,16 @@ struct RunningStats {
     mean += delta / static_cast<double>(n);
     M2   += delta * (static_cast<double>(x) - mean);
   }
+  // Combines partial stats from another accumulator (Chan et al.), e.g. one
+  // per thread.
+  void Merge(const RunningStats& o) {
+    if (o.n == 0) return;
+    double na = static_cast<double>(n), nb = static_cast<double>(o.n);
+    double delta = o.mean - mean;
+    n += o.n;
+    mean += delta * nb / static_cast<double>(n);
+    M2   += o.M2 + delta * delta * na * nb / static_cast<double>(n);
+  }
   double Variance() const { return n > 1 ? M2 / static_cast<double>(n) : 0.0; }
   double Total()    const { return mean * static_cast<double>(n); }
 };
@@ -384,11 +552,19 @@ CodecStats BenchmarkOneCodec(std::vector<T>& data,
   }
   auto endDecode = std::chrono::steady_clock::now();
 
+  // Lossless codecs must round-trip exactly; error-bounded ones must stay
+  // within the bound their encode reports.
+  const double bound = codec->MaxAbsError();
   for (std::size_t i = 0; i < data.size(); i++) {
-    if (data[i] != dataBack[i]) {
+    bool outOfBound =
+        bound == 0 ? data[i] != dataBack[i]
+                   : std::fabs(static_cast<double>(data[i]) -
+                               static_cast<double>(dataBack[i])) > bound;
+    if (outOfBound) {
       std::cout << " ERROR see cerr\n";
-      std::cerr << std::format("in!=out {}(i={}:o{}b{},len={})",
-                   codec->name(), i, data[i], dataBack[i], data.size()) << '\n';
+      std::cerr << std::format("in!=out {}(i={}:o{}b{},len={},bound={})",
+                   codec->name(), i, data[i], dataBack[i], data.size(),
+                   bound) << '\n';
       return stats;
     }
   }
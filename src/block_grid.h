@@ -0,0 +1,226 @@
+#pragma once
+
+#include <omp.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "constant_codecs.h"
+#include "generic_codecs.h"
+#include "nodata_codecs.h"
+#include "util.h"
+
+//////////////////////////////////////////////////////////////////////////
+// compressed raster: a row-major grid of square tiles, each tile stored //
+// row-major and encoded independently. Only full tiles are kept, as in  //
+// the benchmarks (the right/bottom remainder of the raster is dropped). //
+// Constant and near-constant tiles are stored with the constant codecs  //
+// instead of the grid's codec unless the caller opts out, and tiles     //
+// holding the raster's nodata value can be split into validity + data.  //
+//////////////////////////////////////////////////////////////////////////
+
+// Most exceptions a tile may have to be stored as near-constant.
+constexpr std::size_t kMaxNearConstantExceptions = 16;
+
+// Per-tile zone map computed at encode time: value range, the bit width a
+// frame-of-reference packer needs for it, and optionally a 16-bin histogram
+// over [min, max]. Lets queries skip tiles without decoding them.
+struct TileSynopsis {
+  static constexpr int kBins = 16;
+
+  int32_t min = 0;
+  int32_t max = 0;
+  uint32_t bitWidth = 0;  // bits of max - min
+  bool hasHistogram = false;
+  std::array<uint32_t, kBins> histogram{};
+
+  // Values per histogram bin; bin i covers [min + i * w, min + (i + 1) * w).
+  uint64_t BinWidth() const {
+    uint64_t range = uint64_t(int64_t{max} - min) + 1;
+    return (range + kBins - 1) / kBins;
+  }
+
+  int Bin(int32_t v) const {
+    return static_cast<int>(uint64_t(int64_t{v} - min) / BinWidth());
+  }
+};
+
+inline TileSynopsis ComputeTileSynopsis(const int32_t* tile, std::size_t n,
+                                        bool withHistogram) {
+  TileSynopsis s;
+  if (n == 0) return s;
+  auto [lo, hi] = std::minmax_element(tile, tile + n);
+  s.min = *lo;
+  s.max = *hi;
+  uint32_t range = static_cast<uint32_t>(s.max) - static_cast<uint32_t>(s.min);
+  s.bitWidth = range == 0 ? 0 : 32 - __builtin_clz(range);
+  if (withHistogram) {
+    s.hasHistogram = true;
+    for (std::size_t i = 0; i < n; ++i) ++s.histogram[s.Bin(tile[i])];
+  }
+  return s;
+}
+
+struct BlockGrid {
+  int blockSize = 0;
+  int blocksX = 0;  // tiles per raster row
+  int blocksY = 0;  // tile rows
+  std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>> tiles;
+  // One per tile when the grid was built with zone maps, else empty.
+  std::vector<TileSynopsis> synopses;
+  // Reductions skip pixels equal to noData.value when noData.present.
+  NoDataSpec noData;
+
+  bool HasSynopses() const { return synopses.size() == tiles.size(); }
+
+  std::size_t TileLength() const {
+    return static_cast<std::size_t>(blockSize) * blockSize;
+  }
+  int Width() const { return blocksX * blockSize; }
+  int Height() const { return blocksY * blockSize; }
+
+  StatefulIntegerCodec<int32_t>& Tile(int bx, int by) const {
+    return *tiles[static_cast<std::size_t>(by) * blocksX + bx];
+  }
+
+  // Values a decode buffer needs beyond TileLength() for any tile.
+  std::size_t MaxOverflow() const {
+    std::size_t overflow = 0;
+    for (auto& tile : tiles)
+      overflow = std::max(overflow, tile->GetOverflowSize(TileLength()));
+    return overflow;
+  }
+
+  // Lcm of the tiles' cursor granularities (tiles may use different codecs
+  // once constant tiles are split out), one cursor per distinct codec.
+  std::size_t CursorGranularity() const {
+    std::size_t granularity = 1;
+    std::vector<std::string> seen;
+    for (auto& tile : tiles) {
+      std::string name = tile->name();
+      if (std::find(seen.begin(), seen.end(), name) != seen.end()) continue;
+      granularity = std::lcm(
+          granularity, tile->NewDecodeCursor(TileLength())->Granularity());
+      seen.push_back(std::move(name));
+    }
+    return granularity;
+  }
+
+  // True, with the value, if tile (bx, by) holds a single value; callers can
+  // then fill instead of decoding.
+  bool TileConstant(int bx, int by, int32_t& value) const {
+    return Tile(bx, by).ConstantValue(TileLength(), value);
+  }
+
+  // Decodes tile (bx, by) into `out` (TileLength() + MaxOverflow() values).
+  void DecodeTile(int bx, int by, int32_t* out) const {
+    Tile(bx, by).DecodeRange(out, 0, TileLength(), TileLength());
+  }
+
+  // Decodes tile rows [row, row + numRows) only, through the codec's partial
+  // decode, into `out` (numRows * blockSize + MaxOverflow() values).
+  void DecodeRows(int bx, int by, int row, int numRows, int32_t* out) const {
+    Tile(bx, by).DecodeRange(out, static_cast<std::size_t>(row) * blockSize,
+                             static_cast<std::size_t>(numRows) * blockSize,
+                             TileLength());
+  }
+
+  std::size_t EncodedBytes() const {
+    std::size_t bytes = 0;
+    for (auto& tile : tiles)
+      bytes += tile->EncodedNumValues() * tile->EncodedSizeValue();
+    return bytes;
+  }
+};
+
+// Fills one row-major tile given its block column and row.
+using TileReader = std::function<void(int bx, int by, int32_t* tile)>;
+
+// Encodes a blocksX x blocksY grid with fresh clones of `proto`, reading each
+// tile through `read`, and records each tile's zone map (with histograms if
+// asked). With `constantTiles`, single-valued tiles get a ConstantCodec and
+// tiles with at most kMaxNearConstantExceptions outliers a NearConstantCodec.
+// Other tiles holding `noData.value` are wrapped in a NoDataCodec when
+// noData.mode is Split or Fill. Tiles are encoded on `numThreads` OpenMP
+// threads; `read` must be safe to call concurrently for that. The first
+// exception thrown by `read` or a codec is rethrown once the threads stop.
+inline BlockGrid EncodeBlockGrid(int blocksX, int blocksY, int blockSize,
+                                 const StatefulIntegerCodec<int32_t>& proto,
+                                 const TileReader& read, int numThreads = 1,
+                                 bool withHistograms = false,
+                                 bool constantTiles = true,
+                                 const NoDataSpec& noData = {}) {
+  if (blocksX <= 0 || blocksY <= 0 || blockSize <= 0)
+    throw std::invalid_argument("Block grid needs at least one tile, got " +
+                                std::to_string(blocksX) + "x" +
+                                std::to_string(blocksY) + " of size " +
+                                std::to_string(blockSize));
+  BlockGrid grid;
+  grid.blockSize = blockSize;
+  grid.blocksX = blocksX;
+  grid.blocksY = blocksY;
+  grid.noData = noData;
+  grid.tiles.resize(static_cast<std::size_t>(blocksX) * blocksY);
+  grid.synopses.resize(grid.tiles.size());
+  std::size_t n = grid.TileLength();
+  OmpExceptionGuard guard;
+#pragma omp parallel num_threads(numThreads)
+  {
+    std::vector<int32_t> tile(n);
+#pragma omp for schedule(dynamic)
+    for (std::size_t t = 0; t < grid.tiles.size(); ++t)
+      guard.Run([&] {
+        read(static_cast<int>(t % blocksX), static_cast<int>(t / blocksX),
+             tile.data());
+        const TileSynopsis& s = grid.synopses[t] =
+            ComputeTileSynopsis(tile.data(), n, withHistograms);
+        int32_t base;
+        if (constantTiles && s.min == s.max)
+          grid.tiles[t] = std::make_unique<ConstantCodec>();
+        else if (constantTiles &&
+                 FindNearConstantBase(tile.data(), n,
+                                      kMaxNearConstantExceptions, base))
+          grid.tiles[t] = std::make_unique<NearConstantCodec>();
+        else if (noData.present && noData.mode != NoDataMode::None &&
+                 std::find(tile.begin(), tile.end(), noData.value) !=
+                     tile.end())
+          grid.tiles[t] = std::make_unique<NoDataCodec>(
+              noData.mode, noData.value,
+              std::unique_ptr<StatefulIntegerCodec<int32_t>>(
+                  proto.CloneFresh()));
+        else
+          grid.tiles[t].reset(proto.CloneFresh());
+        grid.tiles[t]->AllocEncoded(tile.data(), n);
+        grid.tiles[t]->EncodeArray(tile.data(), n);
+      });
+  }
+  guard.Rethrow();
+  return grid;
+}
+
+// Encodes a row-major raster of `width` x `height` values.
+inline BlockGrid EncodeBlockGrid(const int32_t* raster, int width, int height,
+                                 int blockSize,
+                                 const StatefulIntegerCodec<int32_t>& proto,
+                                 int numThreads = 1,
+                                 bool withHistograms = false,
+                                 bool constantTiles = true,
+                                 const NoDataSpec& noData = {}) {
+  return EncodeBlockGrid(
+      width / blockSize, height / blockSize, blockSize, proto,
+      [&](int bx, int by, int32_t* tile) {
+        for (int y = 0; y < blockSize; ++y)
+          std::copy_n(raster +
+                          static_cast<std::size_t>(by * blockSize + y) * width +
+                          static_cast<std::size_t>(bx) * blockSize,
+                      blockSize, tile + static_cast<std::size_t>(y) * blockSize);
+      },
+      numThreads, withHistograms, constantTiles, noData);
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cascade_codec.h"
+#include "generic_codecs.h"
+
+//////////////////////////////////////////////////////////////////////////
+// cascade search: finds good codec chains for a dataset from a handful //
+// of sample blocks. A chain is zero or more logical stages (delta,     //
+// FOR, RLE, ...) optionally terminated by one physical codec. Chains   //
+// are grown one logical stage at a time with a beam search that keeps  //
+// the prefixes whose best termination has the lowest cf x decode time. //
+// Every chain tried is kept so callers can report the Pareto front of  //
+// compression factor against decode time.                              //
+//////////////////////////////////////////////////////////////////////////
+
+struct CascadeSearchParams {
+  int maxLogicalStages = 3;  // logical stages ahead of the physical codec
+  int beamWidth = 4;         // prefixes kept per depth
+  int decodeReps = 3;        // decode timings per sample; the fastest counts
+};
+
+struct CascadeCandidate {
+  std::vector<int> logical;  // indices into the logical pool, in order
+  int physical = -1;         // index into the physical pool, -1 for none
+  std::string name;
+  bool ok = false;           // encoded and round-tripped every sample
+  double cf = 0;             // encoded bytes / original bytes
+  double tencPerValue = 0;   // ns
+  double tdecPerValue = 0;   // ns
+
+  // Lower is better: bytes kept times time spent getting them back.
+  double Score() const {
+    return ok ? cf * tdecPerValue : std::numeric_limits<double>::infinity();
+  }
+};
+
+// Builds the chain's codec from fresh clones of the pool entries.
+inline std::unique_ptr<StatefulIntegerCodec<int32_t>> BuildCascade(
+    const std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>>& logical,
+    const std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>>& physical,
+    const std::vector<int>& logicalStages, int physicalStage) {
+  std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>> stages;
+  for (int l : logicalStages) stages.emplace_back(logical.at(l)->CloneFresh());
+  if (physicalStage >= 0)
+    stages.emplace_back(physical.at(physicalStage)->CloneFresh());
+  if (stages.size() == 1) return std::move(stages[0]);
+  return std::make_unique<CascadeStatefulIntegerCodec<int32_t>>(
+      std::move(stages));
+}
+
+// Encodes and decodes every sample with a fresh clone of `proto`. Fills the
+// candidate's measurements; ok stays false if any sample throws or fails to
+// round-trip.
+inline void EvaluateCascade(const StatefulIntegerCodec<int32_t>& proto,
+                            const std::vector<std::vector<int32_t>>& samples,
+                            int decodeReps, CascadeCandidate& c) {
+  c.ok = false;
+  c.name = proto.name();
+  std::size_t values = 0, encodedBytes = 0, tenc = 0, tdec = 0;
+  std::vector<int32_t> back;
+  try {
+    for (auto& sample : samples) {
+      std::unique_ptr<StatefulIntegerCodec<int32_t>> codec(proto.CloneFresh());
+      const std::size_t n = sample.size();
+      codec->AllocEncoded(sample.data(), n);
+      auto t0 = std::chrono::steady_clock::now();
+      codec->EncodeArray(sample.data(), n);
+      auto t1 = std::chrono::steady_clock::now();
+      tenc += std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0)
+                  .count();
+      encodedBytes += codec->EncodedNumValues() * codec->EncodedSizeValue();
+
+      back.assign(n + codec->GetOverflowSize(n), 0);
+      std::size_t best = std::numeric_limits<std::size_t>::max();
+      for (int rep = 0; rep < std::max(decodeReps, 1); ++rep) {
+        t0 = std::chrono::steady_clock::now();
+        codec->DecodeArray(back.data(), n);
+        t1 = std::chrono::steady_clock::now();
+        best = std::min<std::size_t>(
+            best, std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0)
+                      .count());
+      }
+      tdec += best;
+      if (!std::equal(sample.begin(), sample.end(), back.begin())) return;
+      values += n;
+    }
+  } catch (const std::exception&) {
+    return;
+  }
+  if (values == 0) return;
+  c.ok = true;
+  c.cf = static_cast<double>(encodedBytes) / (values * sizeof(int32_t));
+  c.tencPerValue = static_cast<double>(tenc) / values;
+  c.tdecPerValue = static_cast<double>(tdec) / values;
+}
+
+// Indices of the round-tripping candidates no other candidate beats on both
+// cf and decode time, ordered by increasing cf.
+inline std::vector<std::size_t> ParetoFront(
+    const std::vector<CascadeCandidate>& candidates) {
+  std::vector<std::size_t> order;
+  for (std::size_t i = 0; i < candidates.size(); ++i)
+    if (candidates[i].ok) order.push_back(i);
+  std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+    const auto &x = candidates[a], &y = candidates[b];
+    return x.cf != y.cf ? x.cf < y.cf : x.tdecPerValue < y.tdecPerValue;
+  });
+  // Sweeping by cf, a point is on the front iff it decodes strictly faster
+  // than everything before it.
+  std::vector<std::size_t> front;
+  double fastest = std::numeric_limits<double>::infinity();
+  for (std::size_t i : order)
+    if (candidates[i].tdecPerValue < fastest) {
+      fastest = candidates[i].tdecPerValue;
+      front.push_back(i);
+    }
+  return front;
+}
+
+// Beam search over chains of up to params.maxLogicalStages logical stages
+// and an optional physical terminator. Returns every chain evaluated.
+inline std::vector<CascadeCandidate> SearchCascades(
+    const std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>>& logical,
+    const std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>>& physical,
+    const std::vector<std::vector<int32_t>>& samples,
+    const CascadeSearchParams& params = {}) {
+  std::vector<CascadeCandidate> all;
+  std::vector<std::vector<int>> frontier = {{}};
+  for (int depth = 0; depth <= params.maxLogicalStages && !frontier.empty();
+       ++depth) {
+    // Score each prefix by its best termination.
+    std::vector<std::pair<double, std::size_t>> scored;
+    for (std::size_t f = 0; f < frontier.size(); ++f) {
+      double best = std::numeric_limits<double>::infinity();
+      for (int p = -1; p < static_cast<int>(physical.size()); ++p) {
+        if (frontier[f].empty() && p < 0) continue;
+        CascadeCandidate c;
+        c.logical = frontier[f];
+        c.physical = p;
+        EvaluateCascade(*BuildCascade(logical, physical, c.logical, p),
+                        samples, params.decodeReps, c);
+        best = std::min(best, c.Score());
+        all.push_back(std::move(c));
+      }
+      scored.emplace_back(best, f);
+    }
+    if (depth == params.maxLogicalStages) break;
+
+    std::sort(scored.begin(), scored.end());
+    std::vector<std::vector<int>> next;
+    for (std::size_t k = 0;
+         k < scored.size() && k < static_cast<std::size_t>(params.beamWidth);
+         ++k) {
+      // Prefixes that never round-trip cannot be rescued by more stages.
+      if (scored[k].first == std::numeric_limits<double>::infinity() &&
+          !frontier[scored[k].second].empty())
+        continue;
+      for (int l = 0; l < static_cast<int>(logical.size()); ++l) {
+        next.push_back(frontier[scored[k].second]);
+        next.back().push_back(l);
+      }
+    }
+    frontier = std::move(next);
+  }
+  return all;
+}
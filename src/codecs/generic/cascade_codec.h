@@ -0,0 +1,194 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "generic_codecs.h"
+#include "intermediate_buffers.h"
+
+///////////////////////////////////////////////////////////////////////
+// cascade codec: N stages, each encoding the previous one's output //
+// ! assumes every stage but the last encodes to the input type ! //
+///////////////////////////////////////////////////////////////////////
+
+// Any number of stages, e.g. delta -> RLE -> SimdComp. The two-stage case
+// is CompositeStatefulIntegerCodec (composite_codec.h).
+template <typename T>
+class CascadeStatefulIntegerCodec : public StatefulIntegerCodec<T> {
+ private:
+  std::vector<std::unique_ptr<StatefulIntegerCodec<T>>> stages;
+  // inputSizes[i]: number of values stage i encoded (inputSizes[0] is the
+  // block length).
+  std::vector<size_t> inputSizes;
+  // Stage 0's EncodedSumTerms, taken while its encoding existed.
+  bool sumFromSecond = false;
+  int64_t sumBias = 0, sumDivisor = 1;
+
+  // Runs `f` and, with `ns`, adds its duration to *ns. Lets the Bench*
+  // variants time the stages' own kernels, without the pool handling.
+  template <typename F>
+  static void Timed(size_t* ns, F&& f) {
+    if (!ns) return f();
+    auto t0 = std::chrono::steady_clock::now();
+    f();
+    auto t1 = std::chrono::steady_clock::now();
+    *ns += std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0)
+               .count();
+  }
+
+  void EncodeStages(const T* in, const size_t length, size_t* ns) {
+    const T* cur = in;
+    size_t curSize = length;
+    for (size_t i = 0; i < stages.size(); ++i) {
+      inputSizes[i] = curSize;
+      if (i + 1 < stages.size())
+        IntermediateBuffers<T>::Lend(stages[i]->GetEncoded(), 0);
+      stages[i]->AllocEncoded(cur, curSize);
+      Timed(ns, [&] { stages[i]->EncodeArray(cur, curSize); });
+      if (i == 0)
+        sumFromSecond = stages.size() > 1 &&
+                        stages[0]->EncodedSumTerms(length, sumBias, sumDivisor);
+      if (i > 0) {
+        IntermediateBuffers<T>::Reclaim(stages[i - 1]->GetEncoded());
+        stages[i - 1]->clear();
+      }
+      if (i + 1 == stages.size()) break;
+      auto& encoded = stages[i]->GetEncoded();
+      cur = encoded.data();
+      curSize = encoded.size();
+    }
+  }
+
+  // Decodes stages last..to+1, each directly into a pooled buffer lent to
+  // the previous stage as its encoding, leaving stage `to` ready to decode.
+  // Each buffer goes back to the pool once it has been consumed; stage
+  // `to`'s is reclaimed by the caller.
+  void DecodeIntermediates(size_t* ns = nullptr, size_t to = 0) {
+    for (size_t i = stages.size() - 1; i > to; --i) {
+      std::vector<T>& dest = stages[i - 1]->GetEncoded();
+      IntermediateBuffers<T>::Lend(
+          dest, inputSizes[i] + stages[i]->GetOverflowSize(inputSizes[i]));
+      Timed(ns, [&] { stages[i]->DecodeArray(dest.data(), inputSizes[i]); });
+      dest.resize(inputSizes[i]);
+      if (i + 1 < stages.size())
+        IntermediateBuffers<T>::Reclaim(stages[i]->GetEncoded());
+    }
+  }
+
+  void DecodeStages(T* out, const size_t length, size_t* ns) {
+    DecodeIntermediates(ns);
+    Timed(ns, [&] { stages[0]->DecodeArray(out, length); });
+    if (stages.size() > 1)
+      IntermediateBuffers<T>::Reclaim(stages[0]->GetEncoded());
+  }
+
+ public:
+  explicit CascadeStatefulIntegerCodec(
+      std::vector<std::unique_ptr<StatefulIntegerCodec<T>>> stageCodecs)
+      : stages(std::move(stageCodecs)), inputSizes(stages.size(), 0) {
+    if (stages.empty())
+      throw std::invalid_argument("Cascade needs at least one stage");
+  }
+
+  const std::vector<std::unique_ptr<StatefulIntegerCodec<T>>>& Stages() const {
+    return stages;
+  }
+
+  // Intermediate sizes are unknown until each stage has run.
+  void AllocEncoded(const T* in, size_t length) override {}
+
+  void EncodeArray(const T* in, const size_t length) override {
+    EncodeStages(in, length, nullptr);
+  }
+
+  size_t BenchEncode(const T* in, const size_t length) override {
+    size_t ns = 0;
+    EncodeStages(in, length, &ns);
+    return ns;
+  }
+
+  void DecodeArray(T* out, const size_t length) override {
+    DecodeStages(out, length, nullptr);
+  }
+
+  size_t BenchDecode(T* out, const size_t length) override {
+    size_t ns = 0;
+    DecodeStages(out, length, &ns);
+    return ns;
+  }
+
+  // The first stage decides how runs are produced (natively for RLE).
+  void DecodeRuns(size_t length, std::vector<ValueRun<T>>& runs) override {
+    DecodeIntermediates();
+    stages[0]->DecodeRuns(length, runs);
+    if (stages.size() > 1)
+      IntermediateBuffers<T>::Reclaim(stages[0]->GetEncoded());
+  }
+
+  // The sum is the first stage's: a later stage's fused sum would be that of
+  // its input (e.g. the deltas), so the intermediates are decoded and the
+  // first stage sums the last of them without writing the values out (FOR:
+  // n * ref + offsets, RLE: runs, delta: prefix states). A first stage
+  // without a fused sum decodes the intermediate it already has into a
+  // pooled buffer, so the caller's fallback does not decode everything again.
+  //
+  // When stage 0's sum follows from that of its encoding (EncodedSumTerms,
+  // e.g. FOR), stage 1's fused sum gives it and stage 1 is not decoded.
+  bool FusedSum(size_t length, int64_t& sum) override {
+    if (stages.size() == 1) return stages[0]->FusedSum(length, sum);
+    if (sumFromSecond) {
+      DecodeIntermediates(nullptr, 1);
+      int64_t encodedSum = 0;
+      bool fused = stages[1]->FusedSum(inputSizes[1], encodedSum);
+      if (stages.size() > 2)
+        IntermediateBuffers<T>::Reclaim(stages[1]->GetEncoded());
+      if (fused && !__builtin_add_overflow(encodedSum, sumBias, &encodedSum)) {
+        sum = encodedSum / sumDivisor;
+        return true;
+      }
+    }
+    DecodeIntermediates();
+    if (!stages[0]->FusedSum(length, sum))
+      sum = SumDecoded(*stages[0], length);
+    IntermediateBuffers<T>::Reclaim(stages[0]->GetEncoded());
+    return true;
+  }
+
+  std::size_t EncodedNumValues() override {
+    return stages.back()->EncodedNumValues();
+  }
+
+  std::size_t EncodedSizeValue() override {
+    return stages.back()->EncodedSizeValue();
+  }
+
+  virtual ~CascadeStatefulIntegerCodec() {}
+
+  std::string name() const override {
+    if (stages.size() == 1) return stages[0]->name();
+    std::string n = "[+]_" + stages[0]->name();
+    for (size_t i = 1; i < stages.size(); ++i) n += "+" + stages[i]->name();
+    return n;
+  }
+
+  // The first stage is the last decoder, writing to the caller's buffer.
+  std::size_t GetOverflowSize(size_t length) const override {
+    return stages[0]->GetOverflowSize(length);
+  }
+
+  void clear() override {
+    for (auto& s : stages) s->clear();
+    sumFromSecond = false;
+  }
+
+  StatefulIntegerCodec<T>* CloneFresh() const override {
+    std::vector<std::unique_ptr<StatefulIntegerCodec<T>>> fresh;
+    for (auto& s : stages) fresh.emplace_back(s->CloneFresh());
+    return new CascadeStatefulIntegerCodec<T>(std::move(fresh));
+  }
+
+  std::vector<T>& GetEncoded() override { return stages.back()->GetEncoded(); }
+};
@@ -1,8 +1,13 @@
+#pragma once
+
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
+#include "cascade_codec.h"
 #include "generic_codecs.h"
+#include "intermediate_buffers.h"
 
 ///////////////////////////////////////////////////////////////////////
 // composite codec for one followed by another //
@@ -10,142 +15,112 @@
 // ! assumes both codecs encode the same type ! //
 ///////////////////////////////////////////////////////////////////////
 
+// Two-stage cascade: the first codec's encoding is encoded by the second.
 template <typename T>
-class CompositeStatefulIntegerCodec : public StatefulIntegerCodec<T> {
+class CompositeStatefulIntegerCodec : public CascadeStatefulIntegerCodec<T> {
  private:
-  std::unique_ptr<StatefulIntegerCodec<T>> firstCodec;
-  std::unique_ptr<StatefulIntegerCodec<T>> secondCodec;
-  size_t intermediateEncodedSize;  // Cache the size of the intermediate array
+  static std::vector<std::unique_ptr<StatefulIntegerCodec<T>>> Pair(
+      std::unique_ptr<StatefulIntegerCodec<T>> first,
+      std::unique_ptr<StatefulIntegerCodec<T>> second) {
+    std::vector<std::unique_ptr<StatefulIntegerCodec<T>>> stages;
+    stages.push_back(std::move(first));
+    stages.push_back(std::move(second));
+    return stages;
+  }
 
  public:
   CompositeStatefulIntegerCodec(std::unique_ptr<StatefulIntegerCodec<T>> first,
                                 std::unique_ptr<StatefulIntegerCodec<T>> second)
-      : firstCodec(std::move(first)),
-        secondCodec(std::move(second)),
-        intermediateEncodedSize(0) {}
-
-  // Need to allocate for both codecs but don't know how to allocate the
-  // intermediate data in advance, so this is not supported.
-  void AllocEncoded(const T* in, size_t length) {}
-
-  void EncodeArray(const T* in, const size_t length) override {
-    firstCodec->AllocEncoded(in, length);
-    firstCodec->EncodeArray(in, length);
-    auto& intermediateData = firstCodec->GetEncoded();
-    intermediateEncodedSize =
-        intermediateData.size();  // Cache the size of the intermediate array
-    secondCodec->AllocEncoded(intermediateData.data(), intermediateEncodedSize);
-    secondCodec->EncodeArray(intermediateData.data(), intermediateEncodedSize);
-    firstCodec->clear();
-  }
+      : CascadeStatefulIntegerCodec<T>(
+            Pair(std::move(first), std::move(second))) {}
 
-  void DecodeArray(T* out, const size_t length) override {
-    // Directly decode the second codec into the first.
-    std::vector<T>& decodedIntermediateData =
-        firstCodec->GetEncoded();  // Destination.
-    decodedIntermediateData.resize(
-        intermediateEncodedSize +
-        secondCodec->GetOverflowSize(
-            intermediateEncodedSize));  // NOTE: reserve doesn't work.
-    secondCodec->DecodeArray(decodedIntermediateData.data(),
-                             intermediateEncodedSize);
-    decodedIntermediateData.resize(intermediateEncodedSize);
-    // Now the first codec has the original intermediate data. Decode.
-    firstCodec->DecodeArray(out, length);
+  StatefulIntegerCodec<T>* CloneFresh() const override {
+    auto& stages = this->Stages();
+    return new CompositeStatefulIntegerCodec<T>(
+        std::unique_ptr<StatefulIntegerCodec<T>>(stages[0]->CloneFresh()),
+        std::unique_ptr<StatefulIntegerCodec<T>>(stages[1]->CloneFresh()));
   }
+};
 
-  size_t BenchEncode(const T* in, const size_t length) override {
-    firstCodec->AllocEncoded(in, length);
+/////////////////////////////////////////////////////////////////////
+// composite codec for a stage that emits bytes followed by a byte- //
+// oriented codec (AcceptsBytes), e.g. a shuffle into Zstd          //
+/////////////////////////////////////////////////////////////////////
 
-    auto tenc1Start = std::chrono::steady_clock::now();
-    firstCodec->EncodeArray(in, length);
-    auto tenc1End = std::chrono::steady_clock::now();
+// Reversible transform of `length` T values into exactly Size(length) bytes.
+template <typename T>
+class ByteStage {
+ public:
+  virtual size_t Size(size_t length) const = 0;
 
-    auto& intermediateData = firstCodec->GetEncoded();
-    intermediateEncodedSize =
-        intermediateData.size();  // Cache the size of the intermediate array
+  virtual void Forward(const T *in, size_t length, uint8_t *out) const = 0;
 
-    secondCodec->AllocEncoded(intermediateData.data(), intermediateEncodedSize);
+  virtual void Inverse(const uint8_t *in, size_t length, T *out) const = 0;
 
-    auto tenc2Start = std::chrono::steady_clock::now();
-    secondCodec->EncodeArray(intermediateData.data(), intermediateEncodedSize);
-    auto tenc2End = std::chrono::steady_clock::now();
+  virtual std::string name() const = 0;
 
-    firstCodec->clear();
+  virtual ByteStage<T> *Clone() const = 0;
 
-    return std::chrono::duration_cast<std::chrono::nanoseconds>(tenc1End -
-                                                                tenc1Start)
-               .count() +
-           std::chrono::duration_cast<std::chrono::nanoseconds>(tenc2End -
-                                                                tenc2Start)
-               .count();
-  }
+  virtual ~ByteStage() {}
+};
 
-  size_t BenchDecode(T* out, const size_t length) override {
-    // Directly decode the second codec into the first.
-    std::vector<T>& decodedIntermediateData =
-        firstCodec->GetEncoded();  // Destination.
-    decodedIntermediateData.reserve(
-        intermediateEncodedSize +
-        secondCodec->GetOverflowSize(intermediateEncodedSize));
-
-    auto tdec1Start = std::chrono::steady_clock::now();
-    secondCodec->DecodeArray(decodedIntermediateData.data(),
-                             intermediateEncodedSize);
-    auto tdec1End = std::chrono::steady_clock::now();
-
-    decodedIntermediateData.resize(intermediateEncodedSize);
-    // Now the first codec has the original intermediate data. Decode.
-
-    auto tdec2Start = std::chrono::steady_clock::now();
-    firstCodec->DecodeArray(out, length);
-    auto tdec2End = std::chrono::steady_clock::now();
-
-    secondCodec->clear();
-
-    return std::chrono::duration_cast<std::chrono::nanoseconds>(tdec1End -
-                                                                tdec1Start)
-               .count() +
-           std::chrono::duration_cast<std::chrono::nanoseconds>(tdec2End -
-                                                                tdec2Start)
-               .count();
-  }
+// The byte intermediate comes from the per-thread pool, as in
+// CompositeStatefulIntegerCodec.
+template <typename T>
+class ByteCompositeCodec : public StatefulIntegerCodec<T> {
+ private:
+  std::unique_ptr<ByteStage<T>> stage;
+  std::unique_ptr<StatefulIntegerCodec<T>> codec;
 
-  std::size_t EncodedNumValues() override {
-    return secondCodec->EncodedNumValues();
+ public:
+  ByteCompositeCodec(std::unique_ptr<ByteStage<T>> stage,
+                     std::unique_ptr<StatefulIntegerCodec<T>> codec)
+      : stage(std::move(stage)), codec(std::move(codec)) {
+    if (!this->codec->AcceptsBytes())
+      throw std::invalid_argument(this->codec->name() +
+                                  " cannot follow a byte stage");
   }
 
-  std::size_t EncodedSizeValue() override {
-    return secondCodec->EncodedSizeValue();
+  void AllocEncoded(const T *in, size_t length) override {}
+
+  void EncodeArray(const T *in, const size_t length) override {
+    std::vector<uint8_t> bytes;
+    IntermediateBuffers<uint8_t>::Lend(bytes, stage->Size(length));
+    stage->Forward(in, length, bytes.data());
+    codec->EncodeBytes(bytes.data(), bytes.size());
+    IntermediateBuffers<uint8_t>::Reclaim(bytes);
   }
 
-  virtual ~CompositeStatefulIntegerCodec() {
-    firstCodec.reset();
-    secondCodec.reset();
+  void DecodeArray(T *out, const size_t length) override {
+    std::vector<uint8_t> bytes;
+    IntermediateBuffers<uint8_t>::Lend(bytes, stage->Size(length));
+    codec->DecodeBytes(bytes.data(), bytes.size());
+    stage->Inverse(bytes.data(), length, out);
+    IntermediateBuffers<uint8_t>::Reclaim(bytes);
   }
 
+  std::size_t EncodedNumValues() override { return codec->EncodedNumValues(); }
+
+  std::size_t EncodedSizeValue() override { return codec->EncodedSizeValue(); }
+
+  virtual ~ByteCompositeCodec() {}
+
   std::string name() const override {
-    return "[+]_" + firstCodec->name() + "+" + secondCodec->name();
+    return "[+]_" + stage->name() + "+" + codec->name();
   }
 
-  std::size_t GetOverflowSize(size_t length) const override {
-    return firstCodec->GetOverflowSize(
-        length);  // Overflow is used for decoding, and the last decoder is the
-                  // first codec.
-  }
+  std::size_t GetOverflowSize(size_t) const override { return 0; }
 
-  void clear() override {
-    firstCodec->clear();
-    secondCodec->clear();
-  }
+  void clear() override { codec->clear(); }
 
-  StatefulIntegerCodec<T>* CloneFresh() const override {
-    auto clonedFirstCodec = firstCodec->CloneFresh();
-    auto clonedSecondCodec = secondCodec->CloneFresh();
-    return new CompositeStatefulIntegerCodec<T>(
-        std::move(std::unique_ptr<StatefulIntegerCodec<T>>(clonedFirstCodec)),
-        std::move(std::unique_ptr<StatefulIntegerCodec<T>>(clonedSecondCodec)));
+  StatefulIntegerCodec<T> *CloneFresh() const override {
+    return new ByteCompositeCodec<T>(
+        std::unique_ptr<ByteStage<T>>(stage->Clone()),
+        std::unique_ptr<StatefulIntegerCodec<T>>(codec->CloneFresh()));
   }
 
-  std::vector<T>& GetEncoded() override { return secondCodec->GetEncoded(); }
-};
\ No newline at end of file
+  std::vector<T> &GetEncoded() override {
+    throw std::runtime_error(
+        "Encoded format does not match input. Cannot forward.");
+  }
+};
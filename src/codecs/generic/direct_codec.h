@@ -12,6 +12,24 @@
 // direct access codec //
 /////////////////////////
 
+class DirectDecodeCursor : public DecodeCursor<int32_t> {
+ private:
+  const std::vector<int32_t>& raw;
+  size_t length;
+  size_t pos = 0;
+
+ public:
+  DirectDecodeCursor(const std::vector<int32_t>& raw, size_t length)
+      : raw{raw}, length{length} {}
+
+  size_t Next(int32_t* out, size_t k) override {
+    size_t n = std::min(k, length - pos);
+    std::memcpy(out, raw.data() + pos, n * sizeof(int32_t));
+    pos += n;
+    return n;
+  }
+};
+
 class DirectAccessCodec : public StatefulIntegerCodec<int32_t> {
  public:
   std::vector<int32_t> compressed;
@@ -46,4 +64,31 @@ class DirectAccessCodec : public StatefulIntegerCodec<int32_t> {
   }
 
   std::vector<int32_t>& GetEncoded() override { return compressed; };
+
+  // The "encoding" is the raw data, so both run in place on it.
+  bool FusedThreshold(size_t length, uint64_t* bitmap) override {
+    if (length == 0) return false;
+    int64_t total = 0;
+    for (size_t i = 0; i < length; ++i) total += compressed[i];
+    int32_t mean = static_cast<int32_t>(total / static_cast<int64_t>(length));
+    std::fill(bitmap, bitmap + (length + 63) / 64, 0);
+    for (size_t i = 0; i < length; ++i)
+      bitmap[i / 64] |= static_cast<uint64_t>(compressed[i] >= mean) << (i % 64);
+    return true;
+  }
+
+  bool FusedValueShift(size_t length, int32_t delta) override {
+    for (size_t i = 0; i < length; ++i) compressed[i] += delta;
+    return true;
+  }
+
+  void DecodeRange(int32_t* out, size_t begin, size_t count,
+                   size_t) override {
+    std::memcpy(out, compressed.data() + begin, count * sizeof(int32_t));
+  }
+
+  std::unique_ptr<DecodeCursor<int32_t>> NewDecodeCursor(
+      size_t length) override {
+    return std::make_unique<DirectDecodeCursor>(compressed, length);
+  }
 };
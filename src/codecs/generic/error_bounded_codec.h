@@ -0,0 +1,384 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "composite_codec.h"
+#include "generic_codecs.h"
+
+//////////////////////////////////////////////////////////////////////////
+// error-bounded lossy quantisation (SZ-style prediction + quantisation): //
+// each value is predicted from the previous *reconstructed* value, and  //
+// the prediction error is quantised to a bin of width 2e (2e + 1 for    //
+// integers with an integer e), so every decoded value lies within e of  //
+// its input. The bin indices, mostly 0 and +-1 on smooth rasters, are   //
+// zigzagged and handed to a lossless int32 codec. Values whose bin index //
+// would not fit, or whose reconstruction would leave the type's range   //
+// (or, for floats, miss the bound after rounding), are outliers: stored  //
+// beside the codes and reproduced exactly.                              //
+//////////////////////////////////////////////////////////////////////////
+
+// The bound e: an absolute value, or relative to each block's value range
+// (max - min), as in SZ's value-range-relative mode.
+struct ErrorBoundSpec {
+  enum class Kind { Absolute, Relative };
+  Kind kind = Kind::Absolute;
+  double value = 0;
+};
+
+inline ErrorBoundSpec AbsoluteErrorBound(double value) {
+  return {ErrorBoundSpec::Kind::Absolute, value};
+}
+
+inline ErrorBoundSpec RelativeErrorBound(double value) {
+  return {ErrorBoundSpec::Kind::Relative, value};
+}
+
+inline std::string ToString(const ErrorBoundSpec &spec) {
+  return std::format("{}{}",
+                     spec.kind == ErrorBoundSpec::Kind::Absolute ? "abs" : "rel",
+                     spec.value);
+}
+
+namespace error_bounded_detail {
+
+// Bin indices stay below this so their zigzag fits a non-negative int32.
+constexpr int64_t kMaxBin = int64_t{1} << 30;
+
+inline int32_t ZigzagBin(int64_t q) {
+  return static_cast<int32_t>((q << 1) ^ (q >> 63));
+}
+
+inline int32_t UnzigzagBin(uint32_t z) {
+  return static_cast<int32_t>((z >> 1) ^ -(z & 1));
+}
+
+// out[i] = out[i - 1] + unzigzag(codes[i]) * step for i in [0, n), starting
+// from `prev`, in wrapping uint32 arithmetic (exact, as every reconstruction
+// is an int32). `codes` may alias `out`. Returns the last value.
+inline uint32_t AccumulateBins(const int32_t *codes, size_t n, uint32_t step,
+                               uint32_t prev, int32_t *out) {
+  const __m128i one = _mm_set1_epi32(1), vstep = _mm_set1_epi32(step);
+  __m128i run = _mm_set1_epi32(prev);
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128i z = _mm_loadu_si128(reinterpret_cast<const __m128i *>(codes + i));
+    __m128i q = _mm_xor_si128(
+        _mm_srli_epi32(z, 1),
+        _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(z, one)));
+    __m128i d = _mm_mullo_epi32(q, vstep);
+    d = _mm_add_epi32(d, _mm_slli_si128(d, 4));
+    d = _mm_add_epi32(d, _mm_slli_si128(d, 8));
+    run = _mm_add_epi32(run, d);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), run);
+    run = _mm_shuffle_epi32(run, _MM_SHUFFLE(3, 3, 3, 3));
+  }
+  prev = static_cast<uint32_t>(_mm_cvtsi128_si32(run));
+  for (; i < n; ++i) {
+    prev += static_cast<uint32_t>(
+                UnzigzagBin(static_cast<uint32_t>(codes[i]))) * step;
+    out[i] = static_cast<int32_t>(prev);
+  }
+  return prev;
+}
+
+// Bin of v: k = floor((v - base + e) / w), with 1 / w a multiply corrected
+// by one bin. Exact in doubles, as every operand is below 2^34.
+inline double IntegerBin(int32_t v, double base, double e, double w,
+                         double inv) {
+  double d = static_cast<double>(v) - base + e;
+  double k = std::floor(d * inv);
+  return k + (d - k * w >= w) - (d - k * w < 0);
+}
+
+inline bool IntegerBinFits(double q, double r) {
+  return std::fabs(q) < kMaxBin && r >= std::numeric_limits<int32_t>::min() &&
+         r <= std::numeric_limits<int32_t>::max();
+}
+
+// Zigzagged bin differences of in[0, n) against `base`, continuing from bin
+// `prevK`, two values per step. Returns false if any value is an outlier
+// (out is then partly written and prevK unchanged); else prevK is the last
+// bin.
+inline bool QuantiseIntegerRun(const int32_t *in, size_t n, double base,
+                               double e, double w, double inv, double &prevK,
+                               int32_t *out) {
+  const __m128d vw = _mm_set1_pd(w), vinv = _mm_set1_pd(inv);
+  const __m128d offset = _mm_set1_pd(e - base), vbase = _mm_set1_pd(base);
+  const __m128d one = _mm_set1_pd(1), zero = _mm_setzero_pd();
+  const __m128d maxBin = _mm_set1_pd(static_cast<double>(kMaxBin));
+  const __m128d lo = _mm_set1_pd(std::numeric_limits<int32_t>::min());
+  const __m128d hi = _mm_set1_pd(std::numeric_limits<int32_t>::max());
+  const __m128d absMask = _mm_castsi128_pd(_mm_set1_epi64x(INT64_MAX));
+  __m128d prev = _mm_set1_pd(prevK), bad = zero;
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    __m128d d = _mm_add_pd(
+        _mm_cvtepi32_pd(_mm_loadl_epi64(
+            reinterpret_cast<const __m128i *>(in + i))),
+        offset);
+    __m128d k = _mm_floor_pd(_mm_mul_pd(d, vinv));
+    __m128d rem = _mm_sub_pd(d, _mm_mul_pd(k, vw));
+    k = _mm_add_pd(k, _mm_and_pd(_mm_cmpge_pd(rem, vw), one));
+    k = _mm_sub_pd(k, _mm_and_pd(_mm_cmplt_pd(rem, zero), one));
+    __m128d q = _mm_sub_pd(k, _mm_shuffle_pd(prev, k, 0b01));
+    __m128d r = _mm_add_pd(vbase, _mm_mul_pd(k, vw));
+    bad = _mm_or_pd(bad, _mm_cmpnlt_pd(_mm_and_pd(q, absMask), maxBin));
+    bad = _mm_or_pd(bad, _mm_or_pd(_mm_cmplt_pd(r, lo), _mm_cmpgt_pd(r, hi)));
+    __m128i qi = _mm_cvttpd_epi32(q);
+    __m128i z = _mm_xor_si128(_mm_slli_epi32(qi, 1), _mm_srai_epi32(qi, 31));
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(out + i), z);
+    prev = k;
+  }
+  if (_mm_movemask_pd(bad)) return false;
+  double last = _mm_cvtsd_f64(_mm_unpackhi_pd(prev, prev));
+  if (i == 0) last = prevK;
+  for (; i < n; ++i) {
+    double k = IntegerBin(in[i], base, e, w, inv), q = k - last;
+    if (!IntegerBinFits(q, base + k * w)) return false;
+    out[i] = ZigzagBin(static_cast<int64_t>(q));
+    last = k;
+  }
+  prevK = last;
+  return true;
+}
+
+}  // namespace error_bounded_detail
+
+// Lossy pre-stage in front of a lossless int32 codec for the bin codes, for
+// integer (T = int32_t) and float (T = float, double) values. Outliers are
+// kept as (position, patch) pairs: the exact value for floats, and for
+// integers the wrapping difference from the prediction, so integer decode is
+// one fused unzigzag/multiply/prefix-sum pass between outliers.
+//
+// An integer absolute bound is floored (e < 1 is lossless, and e = 0 is
+// plain delta coding through the code codec). Floats reconstruct with fma,
+// which is correctly rounded, so encoder and decoder agree bit for bit and
+// the encoder's check of each reconstruction is what the decoder produces.
+template <typename T>
+class ErrorBoundedCodec : public StatefulIntegerCodec<T> {
+ private:
+  static constexpr bool kIntegral = std::is_integral_v<T>;
+  static_assert(std::is_same_v<T, int32_t> || std::is_floating_point_v<T>,
+                "ErrorBoundedCodec quantises int32 or floating-point values");
+
+  ErrorBoundSpec spec;
+  std::unique_ptr<StatefulIntegerCodec<int32_t>> codes;
+  double bound = 0;  // e of the last encode
+  T step = 0;        // bin width of the last encode
+  std::vector<uint32_t> outlierPos;
+  std::vector<T> outlierPatch;
+
+  double BlockBound(const T *in, size_t length) const {
+    if (spec.kind == ErrorBoundSpec::Kind::Absolute) return spec.value;
+    if (length == 0) return 0;
+    double lo = std::numeric_limits<double>::infinity(), hi = -lo;
+    for (size_t i = 0; i < length; ++i) {
+      if constexpr (!kIntegral)
+        if (!std::isfinite(in[i])) continue;
+      lo = std::min<double>(lo, in[i]);
+      hi = std::max<double>(hi, in[i]);
+    }
+    return hi >= lo ? spec.value * (hi - lo) : 0;
+  }
+
+  void QuantiseIntegers(const int32_t *in, size_t length, int32_t *out) {
+    using namespace error_bounded_detail;
+    // Capped so the bin width fits an int32 (a tighter bound still holds).
+    const int64_t e = static_cast<int64_t>(
+        std::min(std::floor(bound), static_cast<double>(kMaxBin - 1)));
+    const int64_t w = 2 * e + 1;
+    bound = static_cast<double>(e);
+    step = static_cast<T>(w);
+    // Every reconstruction is prediction + q * w, so between outliers they
+    // all share one residue `base` mod w: reconstruction i is base + k_i * w
+    // with k_i = floor((in[i] - base + e) / w), and q_i = k_i - k_(i-1).
+    // This is the prediction-from-reconstruction scheme without its
+    // loop-carried division, so runs of values quantise two at a time; a
+    // run holding an outlier is redone value by value.
+    const double ed = static_cast<double>(e), wd = static_cast<double>(w);
+    const double inv = 1.0 / wd;
+    constexpr size_t kRun = 64;
+    double base = 0, prevK = 0;
+    for (size_t c = 0; c < length; c += kRun) {
+      const size_t n = std::min(kRun, length - c);
+      const int32_t *v = in + c;
+      if (QuantiseIntegerRun(v, n, base, ed, wd, inv, prevK, out + c))
+        continue;
+      for (size_t j = 0; j < n; ++j) {
+        double k = IntegerBin(v[j], base, ed, wd, inv), q = k - prevK;
+        if (!IntegerBinFits(q, base + k * wd)) {
+          uint32_t pred =
+              static_cast<uint32_t>(static_cast<int64_t>(base + prevK * wd));
+          outlierPos.push_back(static_cast<uint32_t>(c + j));
+          outlierPatch.push_back(
+              static_cast<int32_t>(static_cast<uint32_t>(v[j]) - pred));
+          base = v[j];
+          k = q = 0;
+        }
+        out[c + j] = ZigzagBin(static_cast<int64_t>(q));
+        prevK = k;
+      }
+    }
+  }
+
+  // Non-finite values are outliers and do not become predictions.
+  void QuantiseFloats(const T *in, size_t length, int32_t *out) {
+    using namespace error_bounded_detail;
+    step = static_cast<T>(2 * bound);
+    T pred = 0;
+    for (size_t i = 0; i < length; ++i) {
+      double d = static_cast<double>(in[i]) - static_cast<double>(pred);
+      double q = step > 0 ? std::nearbyint(d / static_cast<double>(step))
+                          : (d == 0 ? 0 : NAN);
+      T r = 0;
+      bool ok = std::fabs(q) < static_cast<double>(kMaxBin);
+      if (ok) {
+        r = std::fma(static_cast<T>(static_cast<int32_t>(q)), step, pred);
+        ok = std::fabs(static_cast<double>(in[i]) - static_cast<double>(r)) <=
+             bound;
+      }
+      if (!ok) {
+        outlierPos.push_back(static_cast<uint32_t>(i));
+        outlierPatch.push_back(in[i]);
+        q = 0;
+        r = in[i];
+      }
+      out[i] = ZigzagBin(static_cast<int64_t>(q));
+      if (std::isfinite(r)) pred = r;
+    }
+  }
+
+  void ReconstructIntegers(int32_t *out, size_t length) const {
+    using namespace error_bounded_detail;
+    const uint32_t w = static_cast<uint32_t>(step);
+    uint32_t prev = 0;
+    size_t begin = 0;
+    for (size_t k = 0; k <= outlierPos.size(); ++k) {
+      size_t end = k < outlierPos.size() ? outlierPos[k] : length;
+      prev = AccumulateBins(out + begin, end - begin, w, prev, out + begin);
+      if (end == length) break;
+      prev += static_cast<uint32_t>(outlierPatch[k]);
+      out[end] = static_cast<int32_t>(prev);
+      begin = end + 1;
+    }
+  }
+
+  void ReconstructFloats(const int32_t *bins, size_t length, T *out) const {
+    using namespace error_bounded_detail;
+    T pred = 0;
+    size_t k = 0;
+    for (size_t i = 0; i < length; ++i) {
+      T r;
+      if (k < outlierPos.size() && outlierPos[k] == i) {
+        r = outlierPatch[k++];
+      } else {
+        r = std::fma(
+            static_cast<T>(UnzigzagBin(static_cast<uint32_t>(bins[i]))), step,
+            pred);
+      }
+      out[i] = r;
+      if (std::isfinite(r)) pred = r;
+    }
+  }
+
+ public:
+  ErrorBoundedCodec(ErrorBoundSpec spec,
+                    std::unique_ptr<StatefulIntegerCodec<int32_t>> codes)
+      : spec{spec}, codes{std::move(codes)} {
+    if (!(spec.value >= 0) || !std::isfinite(spec.value))
+      throw std::invalid_argument("Error bound must be finite and >= 0");
+  }
+
+  const ErrorBoundSpec &Spec() const { return spec; }
+
+  size_t NumOutliers() const { return outlierPos.size(); }
+
+  double MaxAbsError() const override { return bound; }
+
+  void AllocEncoded(const T *, size_t) override {}
+
+  void EncodeArray(const T *in, const size_t length) override {
+    if (length > std::numeric_limits<uint32_t>::max())
+      throw std::invalid_argument("ErrorBoundedCodec blocks hold < 2^32 values");
+    outlierPos.clear();
+    outlierPatch.clear();
+    codes->clear();
+    bound = BlockBound(in, length);
+    std::vector<int32_t> bins;
+    IntermediateBuffers<int32_t>::Lend(bins, length);
+    if constexpr (kIntegral)
+      QuantiseIntegers(in, length, bins.data());
+    else
+      QuantiseFloats(in, length, bins.data());
+    codes->AllocEncoded(bins.data(), length);
+    codes->EncodeArray(bins.data(), length);
+    IntermediateBuffers<int32_t>::Reclaim(bins);
+  }
+
+  // Integers decode the codes in place (hence the code codec's overflow);
+  // floats go through a pooled buffer.
+  void DecodeArray(T *out, const size_t length) override {
+    if constexpr (kIntegral) {
+      codes->DecodeArray(out, length);
+      ReconstructIntegers(out, length);
+    } else {
+      std::vector<int32_t> bins;
+      IntermediateBuffers<int32_t>::Lend(
+          bins, length + codes->GetOverflowSize(length));
+      codes->DecodeArray(bins.data(), length);
+      ReconstructFloats(bins.data(), length, out);
+      IntermediateBuffers<int32_t>::Reclaim(bins);
+    }
+  }
+
+  // Code bytes, the bin width and outlier count, and the outliers.
+  std::size_t EncodedNumValues() override {
+    return codes->EncodedNumValues() * codes->EncodedSizeValue() + sizeof(T) +
+           sizeof(uint32_t) +
+           outlierPos.size() * (sizeof(uint32_t) + sizeof(T));
+  }
+
+  std::size_t EncodedSizeValue() override { return sizeof(uint8_t); }
+
+  virtual ~ErrorBoundedCodec() {}
+
+  std::string name() const override {
+    return "[eb_" + ToString(spec) + "]_" + codes->name();
+  }
+
+  std::size_t GetOverflowSize(size_t length) const override {
+    return kIntegral ? codes->GetOverflowSize(length) : 0;
+  }
+
+  StatefulIntegerCodec<T> *CloneFresh() const override {
+    return new ErrorBoundedCodec(
+        spec,
+        std::unique_ptr<StatefulIntegerCodec<int32_t>>(codes->CloneFresh()));
+  }
+
+  void clear() override {
+    codes->clear();
+    outlierPos.clear();
+    outlierPos.shrink_to_fit();
+    outlierPatch.clear();
+    outlierPatch.shrink_to_fit();
+    bound = 0;
+    step = 0;
+  }
+
+  std::vector<T> &GetEncoded() override {
+    throw std::runtime_error(
+        "Encoded format does not match input. Cannot forward.");
+  }
+};
@@ -1,9 +1,36 @@
 #pragma once
 
+#include <algorithm>
 #include <chrono>
 #include <cstdint>
+#include <memory>
+#include <stdexcept>
 #include <vector>
 
+//////////////////////////////////////////////////////////////////
+// incremental decoder: yields a block's values a chunk at a time //
+//////////////////////////////////////////////////////////////////
+
+template <typename T>
+class DecodeCursor {
+ public:
+  // Decodes up to `k` further values into `out` (which must hold `k` values
+  // plus the codec's overflow). Returns the number written; 0 once exhausted.
+  virtual size_t Next(T *out, size_t k) = 0;
+
+  // Native decode granularity; chunk sizes should be a multiple of it.
+  virtual size_t Granularity() const { return 1; }
+
+  virtual ~DecodeCursor() {}
+};
+
+// A run of `length` consecutive copies of `value`.
+template <typename T>
+struct ValueRun {
+  T value;
+  uint32_t length;
+};
+
 //////////////////////////
 // general single codec //
 //////////////////////////
@@ -53,4 +80,143 @@ class StatefulIntegerCodec {
   virtual void clear() = 0;
 
   virtual std::vector<T> &GetEncoded() = 0;
-};
\ No newline at end of file
+
+  // Returns a cursor over the `length` encoded values. Codecs without native
+  // incremental decoding fall back to decoding the whole block up front.
+  virtual std::unique_ptr<DecodeCursor<T>> NewDecodeCursor(size_t length);
+
+  // Partial decode: writes values [begin, begin + count) of the `length`
+  // encoded values to `out` (which must hold `count` values plus the codec's
+  // overflow). The default drains a cursor and stops once the range is
+  // covered, so prefixes are cheap; random-access codecs override it.
+  virtual void DecodeRange(T *out, size_t begin, size_t count, size_t length);
+
+  // Run-length view of the `length` encoded values, appended to `runs` with
+  // equal neighbours merged. The default decodes and scans; run-based codecs
+  // hand out their runs without expanding them.
+  virtual void DecodeRuns(size_t length, std::vector<ValueRun<T>> &runs);
+
+  // Fused mutating transformations evaluated on the encoded payload. Codecs
+  // that cannot return false and callers fall back to decode + transform.
+  //
+  // FusedThreshold writes bit i (LSB first) of the ceil(length / 64) words of
+  // `bitmap` as value[i] >= block mean, matching Threshold(data, Avg(data)).
+  virtual bool FusedThreshold(size_t length, uint64_t *bitmap) { return false; }
+
+  // FusedValueShift adds `delta` to every encoded value.
+  virtual bool FusedValueShift(size_t length, T delta) { return false; }
+
+  // FusedSum sets `sum` to the exact sum of the `length` encoded values
+  // without writing them out (stored sums, runs, FOR reference algebra).
+  // Composites fall back to summing a pooled decode of their first codec.
+  virtual bool FusedSum(size_t length, int64_t &sum) { return false; }
+
+  // For encodings whose values' sum is (sum of the encoded vector + bias) /
+  // divisor, e.g. FOR's reference and doubled offsets: reports the two
+  // terms for the current encoding, so a composite can sum through its next
+  // stage's FusedSum without decoding that stage.
+  virtual bool EncodedSumTerms(size_t length, int64_t &bias,
+                               int64_t &divisor) const {
+    return false;
+  }
+
+  // True if DecodeArray also writes the 32-bit sum of the decoded values to
+  // the first overflow slot (the *_fused codecs), which is what
+  // AccessTransformation::LinearSumFused reads.
+  virtual bool WritesOverflowSum() const { return false; }
+
+  // ConstantValue sets `value` and returns true if all `length` encoded
+  // values equal it, so consumers can fill instead of decoding.
+  virtual bool ConstantValue(size_t length, T &value) { return false; }
+
+  // Largest |decoded - input| the last encode allows: 0 for the lossless
+  // codecs, the bound in force for error-bounded ones (ErrorBoundedCodec).
+  virtual double MaxAbsError() const { return 0; }
+
+  // Byte-oriented codecs (the general-purpose compressors) also encode an
+  // opaque stream of `size` bytes, so stages that emit bytes rather than T
+  // values (shuffles) can feed them; see ByteCompositeCodec.
+  virtual bool AcceptsBytes() const { return false; }
+
+  virtual void EncodeBytes(const uint8_t *in, size_t size) {
+    throw std::runtime_error(name() + " does not encode bytes.");
+  }
+
+  virtual void DecodeBytes(uint8_t *out, size_t size) {
+    throw std::runtime_error(name() + " does not decode bytes.");
+  }
+};
+
+// Fallback cursor: decodes the whole block on the first call, then hands out
+// slices of it. Gives chunked consumers a uniform interface, not a speedup.
+template <typename T>
+class BufferedDecodeCursor : public DecodeCursor<T> {
+ private:
+  StatefulIntegerCodec<T> &codec;
+  std::vector<T> decoded;
+  size_t length;
+  size_t pos = 0;
+
+ public:
+  BufferedDecodeCursor(StatefulIntegerCodec<T> &codec, size_t length)
+      : codec{codec}, length{length} {}
+
+  size_t Next(T *out, size_t k) override {
+    if (decoded.empty() && length > 0) {
+      decoded.resize(length + codec.GetOverflowSize(length));
+      codec.DecodeArray(decoded.data(), length);
+    }
+    size_t n = std::min(k, length - pos);
+    std::copy(decoded.begin() + pos, decoded.begin() + pos + n, out);
+    pos += n;
+    return n;
+  }
+};
+
+template <typename T>
+std::unique_ptr<DecodeCursor<T>> StatefulIntegerCodec<T>::NewDecodeCursor(
+    size_t length) {
+  return std::make_unique<BufferedDecodeCursor<T>>(*this, length);
+}
+
+template <typename T>
+void StatefulIntegerCodec<T>::DecodeRange(T *out, size_t begin, size_t count,
+                                          size_t length) {
+  if (begin == 0 && count == length) return DecodeArray(out, length);
+  auto cursor = NewDecodeCursor(length);
+  size_t g = cursor->Granularity();
+  size_t k = (std::max<size_t>(count, 1024) + g - 1) / g * g;
+  std::vector<T> buf(k + GetOverflowSize(length));
+  size_t pos = 0, end = begin + count;
+  while (pos < end) {
+    size_t got = cursor->Next(buf.data(), k);
+    if (got == 0) break;
+    size_t lo = std::max(pos, begin), hi = std::min(pos + got, end);
+    if (lo < hi) std::copy(buf.begin() + (lo - pos), buf.begin() + (hi - pos),
+                           out + (lo - begin));
+    pos += got;
+  }
+}
+
+// Appends a run, merging it into the previous one when the values match.
+template <typename T>
+void AppendRun(std::vector<ValueRun<T>> &runs, T value, uint32_t length) {
+  if (length == 0) return;
+  if (!runs.empty() && runs.back().value == value)
+    runs.back().length += length;
+  else
+    runs.push_back({value, length});
+}
+
+template <typename T>
+void StatefulIntegerCodec<T>::DecodeRuns(size_t length,
+                                         std::vector<ValueRun<T>> &runs) {
+  std::vector<T> decoded(length + GetOverflowSize(length));
+  DecodeRange(decoded.data(), 0, length, length);
+  for (size_t i = 0; i < length;) {
+    size_t j = i + 1;
+    while (j < length && decoded[j] == decoded[i]) ++j;
+    AppendRun(runs, decoded[i], static_cast<uint32_t>(j - i));
+    i = j;
+  }
+}
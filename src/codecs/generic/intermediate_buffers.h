@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "generic_codecs.h"
+
+// Per-thread pool of intermediate buffers. A buffer is lent to a stage by
+// swapping it into the stage's encoding and reclaimed the same way, so a
+// composite allocates only while the pool warms up to the block size, and no
+// block keeps its decoded intermediate once it has been decoded. Nested
+// composites each take their own buffer from the pool.
+template <typename T>
+class IntermediateBuffers {
+ private:
+  static std::vector<std::vector<T>>& Pool() {
+    thread_local std::vector<std::vector<T>> pool;
+    return pool;
+  }
+
+ public:
+  // Swaps a pooled buffer resized to `size` into `dest`, dropping dest's
+  // previous contents. Only growth past the buffer's last size is written.
+  static void Lend(std::vector<T>& dest, size_t size) {
+    auto& pool = Pool();
+    std::vector<T> buf;
+    if (!pool.empty()) {
+      buf.swap(pool.back());
+      pool.pop_back();
+    }
+    buf.resize(size);
+    dest.swap(buf);
+  }
+
+  // Moves `src`'s buffer back into the pool, leaving `src` empty.
+  static void Reclaim(std::vector<T>& src) {
+    auto& pool = Pool();
+    pool.emplace_back();
+    pool.back().swap(src);
+  }
+};
+
+// Decodes `codec` into a pooled buffer and returns the sum of its `length`
+// values.
+template <typename T>
+int64_t SumDecoded(StatefulIntegerCodec<T>& codec, size_t length) {
+  std::vector<T> values;
+  IntermediateBuffers<T>::Lend(values, length + codec.GetOverflowSize(length));
+  codec.DecodeArray(values.data(), length);
+  int64_t sum = 0;
+  for (size_t i = 0; i < length; ++i) sum += values[i];
+  IntermediateBuffers<T>::Reclaim(values);
+  return sum;
+}
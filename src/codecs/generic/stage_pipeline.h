@@ -0,0 +1,368 @@
+#pragma once
+
+#include <array>
+#include <concepts>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "composite_codec.h"
+#include "generic_codecs.h"
+
+///////////////////////////////////////////////////////////////////////////
+// typed stage pipeline: int32 -> int32 -> bytes -> bytes. Unlike the     //
+// composite and cascade codecs, a stage may hand on bytes rather than   //
+// values, so bit packers can feed general-purpose compressors (delta -> //
+// simdcomp -> LZ4). Stages are concrete types: each declares its input  //
+// and output element types, and a pipeline whose neighbouring stages do //
+// not match, or whose non-final stage cannot hand on its encoding, does //
+// not compile.                                                          //
+///////////////////////////////////////////////////////////////////////////
+
+// Complements the run-time chains, which cannot hand on a packer's bytes.
+
+// Codec capabilities, opted into by the codec classes:
+//   kForwardsValues: GetEncoded() holds the encoding as input-type values.
+//   kAcceptsBytes: EncodeBytes/DecodeBytes take a byte stream.
+//   ReleaseBytes/DecodeFromBytes: the encoding can be handed over as bytes
+//     (header included) and decoded from a byte view.
+template <typename C>
+concept ValueForwardingCodec =
+    std::derived_from<C, StatefulIntegerCodec<int32_t>> &&
+    requires { requires C::kForwardsValues; };
+
+template <typename C>
+concept ByteStreamCodec =
+    std::derived_from<C, StatefulIntegerCodec<int32_t>> &&
+    requires { requires C::kAcceptsBytes; };
+
+template <typename C, typename Decoded>
+concept ByteSerialisingCodec =
+    requires(C c, std::vector<uint8_t> &bytes, const uint8_t *in, Decoded *out,
+             size_t n) {
+      c.ReleaseBytes(bytes);
+      c.DecodeFromBytes(in, n, out, n);
+    };
+
+// An empty codec configured like `codec`, made through its CloneFresh.
+template <typename C>
+C FreshCodec(const C &codec) {
+  std::unique_ptr<StatefulIntegerCodec<int32_t>> clone(codec.CloneFresh());
+  auto *fresh = dynamic_cast<C *>(clone.get());
+  if (!fresh)
+    throw std::runtime_error(codec.name() + " does not clone to its own type");
+  return std::move(*fresh);
+}
+
+// Stages. Each has In/Out element types and kHandsOn (whether a following
+// stage can take its encoding), and implements
+//   Encode(in, n) / Decode(out, n): the stage's codec keeps the encoding
+//     (final stage);
+//   EncodeTo(in, n, out) / DecodeFrom(encoded, out, n): the encoding is
+//     handed to / taken from the next stage as a vector of Out (kHandsOn);
+//   Fresh(): an unencoded stage configured like this one.
+// A stage's Decode may write Overflow(n) elements past `out + n`.
+
+// int32 -> int32 through a logical codec (delta, FOR, RLE).
+template <ValueForwardingCodec C>
+class ValueStage {
+ public:
+  using In = int32_t;
+  using Out = int32_t;
+  static constexpr bool kHandsOn = true;
+  C codec;
+
+  explicit ValueStage(C codec = C()) : codec(std::move(codec)) {}
+
+  ValueStage Fresh() const { return ValueStage(FreshCodec(codec)); }
+
+  void Encode(const In *in, size_t n) {
+    codec.AllocEncoded(in, n);
+    codec.EncodeArray(in, n);
+  }
+
+  void Decode(In *out, size_t n) { codec.DecodeArray(out, n); }
+
+  // The codec encodes straight into `out` (a pooled buffer).
+  void EncodeTo(const In *in, size_t n, std::vector<Out> &out) {
+    codec.GetEncoded().swap(out);
+    Encode(in, n);
+    codec.GetEncoded().swap(out);
+  }
+
+  void DecodeFrom(std::vector<Out> &encoded, In *out, size_t n) {
+    codec.GetEncoded().swap(encoded);
+    codec.DecodeArray(out, n);
+    codec.GetEncoded().swap(encoded);
+  }
+
+  size_t Overflow(size_t n) const { return codec.GetOverflowSize(n); }
+  std::string name() const { return codec.name(); }
+  size_t EncodedBytes() {
+    return codec.EncodedNumValues() * codec.EncodedSizeValue();
+  }
+  void clear() { codec.clear(); }
+};
+
+// int32 -> bytes through a physical codec (bit packers, varint). Any int32
+// codec can end a pipeline; handing on needs byte serialisation.
+template <typename C>
+  requires std::derived_from<C, StatefulIntegerCodec<int32_t>>
+class PackStage {
+ public:
+  using In = int32_t;
+  using Out = uint8_t;
+  static constexpr bool kHandsOn = ByteSerialisingCodec<C, int32_t>;
+  C codec;
+
+  explicit PackStage(C codec = C()) : codec(std::move(codec)) {}
+
+  PackStage Fresh() const { return PackStage(FreshCodec(codec)); }
+
+  void Encode(const In *in, size_t n) {
+    codec.AllocEncoded(in, n);
+    codec.EncodeArray(in, n);
+  }
+
+  void Decode(In *out, size_t n) { codec.DecodeArray(out, n); }
+
+  void EncodeTo(const In *in, size_t n, std::vector<Out> &out)
+    requires kHandsOn
+  {
+    Encode(in, n);
+    codec.ReleaseBytes(out);
+  }
+
+  void DecodeFrom(std::vector<Out> &encoded, In *out, size_t n)
+    requires kHandsOn
+  {
+    codec.DecodeFromBytes(encoded.data(), encoded.size(), out, n);
+  }
+
+  size_t Overflow(size_t n) const { return codec.GetOverflowSize(n); }
+  std::string name() const { return codec.name(); }
+  size_t EncodedBytes() {
+    return codec.EncodedNumValues() * codec.EncodedSizeValue();
+  }
+  void clear() { codec.clear(); }
+};
+
+// bytes -> bytes through a general-purpose compressor.
+template <ByteStreamCodec C>
+class ByteCodecStage {
+ public:
+  using In = uint8_t;
+  using Out = uint8_t;
+  static constexpr bool kHandsOn = ByteSerialisingCodec<C, uint8_t>;
+  C codec;
+
+  explicit ByteCodecStage(C codec = C()) : codec(std::move(codec)) {}
+
+  ByteCodecStage Fresh() const { return ByteCodecStage(FreshCodec(codec)); }
+
+  void Encode(const In *in, size_t n) { codec.EncodeBytes(in, n); }
+
+  void Decode(In *out, size_t n) { codec.DecodeBytes(out, n); }
+
+  void EncodeTo(const In *in, size_t n, std::vector<Out> &out)
+    requires kHandsOn
+  {
+    Encode(in, n);
+    codec.ReleaseBytes(out);
+  }
+
+  void DecodeFrom(std::vector<Out> &encoded, In *out, size_t n)
+    requires kHandsOn
+  {
+    codec.DecodeFromBytes(encoded.data(), encoded.size(), out, n);
+  }
+
+  size_t Overflow(size_t) const { return 0; }
+  std::string name() const { return codec.name(); }
+  size_t EncodedBytes() {
+    return codec.EncodedNumValues() * codec.EncodedSizeValue();
+  }
+  void clear() { codec.clear(); }
+};
+
+// int32 -> bytes through a reversible ByteStage (shuffles). Its output is
+// the transformed bytes themselves, so it belongs before a compressor.
+template <typename S>
+  requires std::derived_from<S, ByteStage<int32_t>>
+class ByteTransformStage {
+ public:
+  using In = int32_t;
+  using Out = uint8_t;
+  static constexpr bool kHandsOn = true;
+  S stage;
+  std::vector<uint8_t> bytes;
+
+  explicit ByteTransformStage(S stage = S()) : stage(std::move(stage)) {}
+
+  ByteTransformStage Fresh() const {
+    std::unique_ptr<ByteStage<int32_t>> clone(stage.Clone());
+    auto *fresh = dynamic_cast<S *>(clone.get());
+    if (!fresh)
+      throw std::runtime_error(stage.name() + " does not clone to its own type");
+    return ByteTransformStage(std::move(*fresh));
+  }
+
+  void Encode(const In *in, size_t n) {
+    bytes.resize(stage.Size(n));
+    stage.Forward(in, n, bytes.data());
+  }
+
+  void Decode(In *out, size_t n) { stage.Inverse(bytes.data(), n, out); }
+
+  void EncodeTo(const In *in, size_t n, std::vector<Out> &out) {
+    out.resize(stage.Size(n));
+    stage.Forward(in, n, out.data());
+  }
+
+  void DecodeFrom(std::vector<Out> &encoded, In *out, size_t n) {
+    stage.Inverse(encoded.data(), n, out);
+  }
+
+  size_t Overflow(size_t) const { return 0; }
+  std::string name() const { return stage.name(); }
+  size_t EncodedBytes() { return bytes.size(); }
+  void clear() {
+    bytes.clear();
+    bytes.shrink_to_fit();
+  }
+};
+
+// The pipeline itself, an int32 codec usable wherever the others are. Every
+// intermediate is a buffer lent by the per-thread IntermediateBuffers pool
+// of its element type and returned once the next stage has consumed it, so
+// only the final stage's encoding stays with the block.
+template <typename... Stages>
+class StagePipeline : public StatefulIntegerCodec<int32_t> {
+ private:
+  static constexpr size_t N = sizeof...(Stages);
+  static_assert(N > 0, "A pipeline needs at least one stage");
+
+  template <size_t I>
+  using StageAt = std::tuple_element_t<I, std::tuple<Stages...>>;
+
+  template <size_t... I>
+  static constexpr bool Chained(std::index_sequence<I...>) {
+    return (std::is_same_v<typename StageAt<I>::Out,
+                           typename StageAt<I + 1>::In> &&
+            ...);
+  }
+  template <size_t... I>
+  static constexpr bool HandsOn(std::index_sequence<I...>) {
+    return (StageAt<I>::kHandsOn && ...);
+  }
+  static_assert(std::is_same_v<typename StageAt<0>::In, int32_t>,
+                "The first stage must take int32 values");
+  static_assert(Chained(std::make_index_sequence<N - 1>{}),
+                "Each stage's output type must be the next stage's input");
+  static_assert(HandsOn(std::make_index_sequence<N - 1>{}),
+                "Every stage but the last must hand on its encoding "
+                "(kForwardsValues, or ReleaseBytes/DecodeFromBytes)");
+
+  std::tuple<Stages...> stages;
+  // inputSizes[i]: number of elements stage i encoded (inputSizes[0] is the
+  // block length).
+  std::array<size_t, N> inputSizes{};
+
+  template <size_t I>
+  void EncodeFrom(const typename StageAt<I>::In *in, size_t n) {
+    inputSizes[I] = n;
+    auto &stage = std::get<I>(stages);
+    if constexpr (I + 1 == N) {
+      stage.Encode(in, n);
+    } else {
+      using Out = typename StageAt<I>::Out;
+      std::vector<Out> intermediate;
+      IntermediateBuffers<Out>::Lend(intermediate, 0);
+      stage.EncodeTo(in, n, intermediate);
+      stage.clear();
+      EncodeFrom<I + 1>(intermediate.data(), intermediate.size());
+      IntermediateBuffers<Out>::Reclaim(intermediate);
+    }
+  }
+
+  template <size_t I>
+  void DecodeInto(typename StageAt<I>::In *out, size_t n) {
+    auto &stage = std::get<I>(stages);
+    if constexpr (I + 1 == N) {
+      stage.Decode(out, n);
+    } else {
+      using Out = typename StageAt<I>::Out;
+      const size_t size = inputSizes[I + 1];
+      std::vector<Out> intermediate;
+      IntermediateBuffers<Out>::Lend(
+          intermediate, size + std::get<I + 1>(stages).Overflow(size));
+      DecodeInto<I + 1>(intermediate.data(), size);
+      intermediate.resize(size);
+      stage.DecodeFrom(intermediate, out, n);
+      IntermediateBuffers<Out>::Reclaim(intermediate);
+    }
+  }
+
+  template <size_t... I>
+  std::string Names(std::index_sequence<I...>) const {
+    std::string n;
+    ((n += (I ? "+" : "") + std::get<I>(stages).name()), ...);
+    return n;
+  }
+
+ public:
+  StagePipeline() = default;
+
+  explicit StagePipeline(Stages... s) : stages(std::move(s)...) {}
+
+  // Intermediate sizes are unknown until each stage has run.
+  void AllocEncoded(const int32_t *in, size_t length) override {}
+
+  void EncodeArray(const int32_t *in, const size_t length) override {
+    EncodeFrom<0>(in, length);
+  }
+
+  void DecodeArray(int32_t *out, const size_t length) override {
+    DecodeInto<0>(out, length);
+  }
+
+  std::size_t EncodedNumValues() override {
+    return std::get<N - 1>(stages).EncodedBytes();
+  }
+
+  std::size_t EncodedSizeValue() override { return sizeof(uint8_t); }
+
+  virtual ~StagePipeline() {}
+
+  // Named like the cascade: "[+]_delta+simdcomp+LZ4".
+  std::string name() const override {
+    if constexpr (N == 1) return std::get<0>(stages).name();
+    return "[+]_" + Names(std::make_index_sequence<N>{});
+  }
+
+  // The first stage is the last decoder, writing to the caller's buffer.
+  std::size_t GetOverflowSize(size_t length) const override {
+    return std::get<0>(stages).Overflow(length);
+  }
+
+  StatefulIntegerCodec<int32_t> *CloneFresh() const override {
+    return std::apply(
+        [](const auto &...s) { return new StagePipeline(s.Fresh()...); },
+        stages);
+  }
+
+  void clear() override {
+    std::apply([](auto &...s) { (s.clear(), ...); }, stages);
+    inputSizes.fill(0);
+  }
+
+  std::vector<int32_t> &GetEncoded() override {
+    throw std::runtime_error(
+        "Encoded format does not match input. Cannot forward.");
+  }
+};
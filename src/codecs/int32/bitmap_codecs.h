@@ -0,0 +1,763 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "generic_codecs.h"
+#include "transformations_simd.h"
+
+//////////////////////////////////////////////////////////////////////////
+// bitmap codecs for 0/1 rasters (Threshold output, masks). Values are   //
+// bits: non-zero encodes as 1 and decodes as 1. Masks can be combined   //
+// with BitmapAnd/BitmapOr and counted without decoding to int32.        //
+//////////////////////////////////////////////////////////////////////////
+
+// Word kernels over plain bitsets, dispatched on TransformationSimdLevel().
+// The AVX-512 popcount also needs VPOPCNTDQ, which the level does not imply.
+
+inline bool HasAvx512Popcnt() {
+  static const bool has = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx512vpopcntdq") != 0;
+  }();
+  return has;
+}
+
+enum class BitwiseOp { And, Or };
+
+inline uint64_t ApplyBitwiseOp(BitwiseOp op, uint64_t a, uint64_t b) {
+  return op == BitwiseOp::And ? a & b : a | b;
+}
+
+inline void WordsOpScalar(BitwiseOp op, const uint64_t *a, const uint64_t *b,
+                          uint64_t *out, size_t n) {
+  for (size_t i = 0; i < n; ++i) out[i] = ApplyBitwiseOp(op, a[i], b[i]);
+}
+
+inline void WordsOpSSE41(BitwiseOp op, const uint64_t *a, const uint64_t *b,
+                         uint64_t *out, size_t n) {
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+    __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i),
+                     op == BitwiseOp::And ? _mm_and_si128(va, vb)
+                                          : _mm_or_si128(va, vb));
+  }
+  for (; i < n; ++i) out[i] = ApplyBitwiseOp(op, a[i], b[i]);
+}
+
+TRANSFORM_TARGET_AVX2
+inline void WordsOpAVX2(BitwiseOp op, const uint64_t *a, const uint64_t *b,
+                        uint64_t *out, size_t n) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+    __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i),
+                        op == BitwiseOp::And ? _mm256_and_si256(va, vb)
+                                             : _mm256_or_si256(va, vb));
+  }
+  for (; i < n; ++i) out[i] = ApplyBitwiseOp(op, a[i], b[i]);
+}
+
+TRANSFORM_TARGET_AVX512
+inline void WordsOpAVX512(BitwiseOp op, const uint64_t *a, const uint64_t *b,
+                          uint64_t *out, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m512i va = _mm512_loadu_si512(a + i);
+    __m512i vb = _mm512_loadu_si512(b + i);
+    _mm512_storeu_si512(out + i, op == BitwiseOp::And
+                                     ? _mm512_and_si512(va, vb)
+                                     : _mm512_or_si512(va, vb));
+  }
+  for (; i < n; ++i) out[i] = ApplyBitwiseOp(op, a[i], b[i]);
+}
+
+// out[i] = a[i] op b[i]; `out` may alias either input.
+inline void WordsOp(BitwiseOp op, const uint64_t *a, const uint64_t *b,
+                    uint64_t *out, size_t n) {
+  switch (TransformationSimdLevel()) {
+    case SimdLevel::Scalar:
+      return WordsOpScalar(op, a, b, out, n);
+    case SimdLevel::SSE41:
+      return WordsOpSSE41(op, a, b, out, n);
+    case SimdLevel::AVX2:
+      return WordsOpAVX2(op, a, b, out, n);
+    default:
+      return WordsOpAVX512(op, a, b, out, n);
+  }
+}
+
+__attribute__((target("popcnt")))
+inline size_t WordsPopcountScalar(const uint64_t *a, size_t n) {
+  size_t count = 0;
+  for (size_t i = 0; i < n; ++i) count += __builtin_popcountll(a[i]);
+  return count;
+}
+
+// Nibble-lookup popcount (Muła et al.), summed per 64-bit lane with SAD.
+TRANSFORM_TARGET_AVX2
+inline size_t WordsPopcountAVX2(const uint64_t *a, size_t n) {
+  const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2,
+                                       3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2,
+                                       2, 3, 2, 3, 3, 4);
+  const __m256i low = _mm256_set1_epi8(0x0F);
+  __m256i acc = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+    __m256i cnt = _mm256_add_epi8(
+        _mm256_shuffle_epi8(lut, _mm256_and_si256(v, low)),
+        _mm256_shuffle_epi8(lut,
+                            _mm256_and_si256(_mm256_srli_epi16(v, 4), low)));
+    acc = _mm256_add_epi64(acc, _mm256_sad_epu8(cnt, _mm256_setzero_si256()));
+  }
+  alignas(32) uint64_t lanes[4];
+  _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), acc);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+         WordsPopcountScalar(a + i, n - i);
+}
+
+__attribute__((target("avx512f,avx512vpopcntdq")))
+inline size_t WordsPopcountAVX512(const uint64_t *a, size_t n) {
+  __m512i acc = _mm512_setzero_si512();
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_loadu_si512(a + i)));
+  return _mm512_reduce_add_epi64(acc) + WordsPopcountScalar(a + i, n - i);
+}
+
+inline size_t WordsPopcount(const uint64_t *a, size_t n) {
+  switch (TransformationSimdLevel()) {
+    case SimdLevel::Scalar:
+    case SimdLevel::SSE41:
+      return WordsPopcountScalar(a, n);
+    case SimdLevel::AVX2:
+      return WordsPopcountAVX2(a, n);
+    default:
+      return HasAvx512Popcnt() ? WordsPopcountAVX512(a, n)
+                               : WordsPopcountAVX2(a, n);
+  }
+}
+
+// int32 <-> bit conversion, 16 values per movemask.
+inline void PackBits(const int32_t *in, size_t length, uint64_t *words) {
+  size_t numWords = (length + 63) / 64;
+  std::fill(words, words + numWords, 0);
+  const __m128i zero = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 16 <= length; i += 16) {
+    const __m128i *v = reinterpret_cast<const __m128i *>(in + i);
+    __m128i nz[4];
+    for (int q = 0; q < 4; ++q)
+      nz[q] = _mm_cmpeq_epi32(_mm_loadu_si128(v + q), zero);
+    __m128i bytes = _mm_packs_epi16(_mm_packs_epi32(nz[0], nz[1]),
+                                    _mm_packs_epi32(nz[2], nz[3]));
+    uint64_t bits = static_cast<uint16_t>(~_mm_movemask_epi8(bytes));
+    words[i / 64] |= bits << (i % 64);
+  }
+  for (; i < length; ++i)
+    words[i / 64] |= static_cast<uint64_t>(in[i] != 0) << (i % 64);
+}
+
+inline void UnpackBits(const uint64_t *words, size_t length, int32_t *out) {
+  const __m128i select = _mm_setr_epi32(1, 2, 4, 8);
+  const __m128i one = _mm_set1_epi32(1);
+  size_t i = 0;
+  for (; i + 4 <= length; i += 4) {
+    __m128i nibble = _mm_set1_epi32(
+        static_cast<int32_t>((words[i / 64] >> (i % 64)) & 0xF));
+    __m128i set = _mm_cmpeq_epi32(_mm_and_si128(nibble, select), select);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i),
+                     _mm_and_si128(set, one));
+  }
+  for (; i < length; ++i)
+    out[i] = static_cast<int32_t>((words[i / 64] >> (i % 64)) & 1);
+}
+
+// Common interface of the bitmap codecs. `length` (bits) is fixed by
+// AllocEncoded/FromWords; bits past it are always zero.
+class BitmapCodec : public StatefulIntegerCodec<int32_t> {
+ protected:
+  size_t length = 0;
+
+  size_t NumWords() const { return (length + 63) / 64; }
+
+  void CheckSameLength(const BitmapCodec &other) const {
+    if (other.length != length)
+      throw std::invalid_argument("Bitmap lengths differ: " +
+                                  std::to_string(length) + " vs " +
+                                  std::to_string(other.length));
+  }
+
+  // Fallback for mixed codec types: expand both, combine, re-encode as ours.
+  std::unique_ptr<BitmapCodec> CombineViaWords(const BitmapCodec &other,
+                                               BitwiseOp op) const {
+    CheckSameLength(other);
+    std::vector<uint64_t> a(NumWords()), b(NumWords());
+    ToWords(a.data());
+    other.ToWords(b.data());
+    WordsOp(op, a.data(), b.data(), a.data(), a.size());
+    std::unique_ptr<BitmapCodec> out(
+        static_cast<BitmapCodec *>(CloneFresh()));
+    out->FromWords(a.data(), length);
+    return out;
+  }
+
+ public:
+  size_t NumBits() const { return length; }
+
+  // Writes ceil(NumBits() / 64) words, LSB first.
+  virtual void ToWords(uint64_t *words) const = 0;
+
+  virtual void FromWords(const uint64_t *words, size_t numBits) = 0;
+
+  // Number of set bits.
+  virtual size_t Cardinality() const {
+    std::vector<uint64_t> words(NumWords());
+    ToWords(words.data());
+    return WordsPopcount(words.data(), words.size());
+  }
+
+  // Result is encoded with this codec's type. Same-type operands use the
+  // codec's native algorithm; mixed types go through plain words.
+  virtual std::unique_ptr<BitmapCodec> Combine(const BitmapCodec &other,
+                                               BitwiseOp op) const {
+    return CombineViaWords(other, op);
+  }
+
+  void EncodeArray(const int32_t *in, const size_t length) override {
+    std::vector<uint64_t> words((length + 63) / 64);
+    PackBits(in, length, words.data());
+    FromWords(words.data(), length);
+  }
+
+  void DecodeArray(int32_t *out, const std::size_t length) override {
+    std::vector<uint64_t> words(NumWords());
+    ToWords(words.data());
+    UnpackBits(words.data(), std::min(length, this->length), out);
+  }
+
+  std::size_t EncodedSizeValue() override { return sizeof(uint8_t); }
+
+  std::size_t GetOverflowSize(size_t) const override { return 0; }
+
+  std::vector<int32_t> &GetEncoded() override {
+    throw std::runtime_error(
+        "Encoded format does not match input. Cannot forward.");
+  };
+};
+
+inline std::unique_ptr<BitmapCodec> BitmapAnd(const BitmapCodec &a,
+                                              const BitmapCodec &b) {
+  return a.Combine(b, BitwiseOp::And);
+}
+
+inline std::unique_ptr<BitmapCodec> BitmapOr(const BitmapCodec &a,
+                                             const BitmapCodec &b) {
+  return a.Combine(b, BitwiseOp::Or);
+}
+
+////////////////////
+// plain bitset   //
+////////////////////
+
+// Bit i of word i / 64, LSB first.
+class BitsetCodec : public BitmapCodec {
+ public:
+  std::vector<uint64_t> words;
+
+  void ToWords(uint64_t *out) const override {
+    std::copy(words.begin(), words.end(), out);
+  }
+
+  void FromWords(const uint64_t *in, size_t numBits) override {
+    length = numBits;
+    words.assign(in, in + NumWords());
+  }
+
+  void EncodeArray(const int32_t *in, const size_t length) override {
+    this->length = length;
+    words.resize(NumWords());
+    PackBits(in, length, words.data());
+  }
+
+  void DecodeArray(int32_t *out, const std::size_t length) override {
+    UnpackBits(words.data(), std::min(length, this->length), out);
+  }
+
+  size_t Cardinality() const override {
+    return WordsPopcount(words.data(), words.size());
+  }
+
+  std::unique_ptr<BitmapCodec> Combine(const BitmapCodec &other,
+                                       BitwiseOp op) const override {
+    auto *o = dynamic_cast<const BitsetCodec *>(&other);
+    if (!o) return CombineViaWords(other, op);
+    CheckSameLength(other);
+    auto out = std::make_unique<BitsetCodec>();
+    out->length = length;
+    out->words.resize(words.size());
+    WordsOp(op, words.data(), o->words.data(), out->words.data(),
+            words.size());
+    return out;
+  }
+
+  std::size_t EncodedNumValues() override { return words.size(); }
+
+  std::size_t EncodedSizeValue() override { return sizeof(uint64_t); }
+
+  virtual ~BitsetCodec() {}
+
+  std::string name() const override { return "bitset"; }
+
+  StatefulIntegerCodec<int32_t> *CloneFresh() const override {
+    return new BitsetCodec();
+  }
+
+  void AllocEncoded(const int32_t *, size_t length) override {
+    this->length = length;
+    words.assign(NumWords(), 0);
+  };
+
+  void clear() override {
+    words.clear();
+    words.shrink_to_fit();
+  }
+};
+
+///////////////////////////////
+// Roaring-style containers  //
+///////////////////////////////
+
+// Bits are split into 2^16-bit chunks; each non-empty chunk is stored as
+// whichever container is smallest: a sorted array of low 16-bit positions
+// (at most 4096), a 1024-word bitmap, or (start, length - 1) runs.
+class RoaringCodec : public BitmapCodec {
+ public:
+  static constexpr size_t kChunkBits = 1 << 16;
+  static constexpr size_t kChunkWords = kChunkBits / 64;
+  static constexpr size_t kMaxArray = 4096;
+
+  enum class ContainerType : uint8_t { Array, Bitmap, Run };
+
+  struct Container {
+    uint16_t key;  // chunk index
+    ContainerType type;
+    uint32_t cardinality;
+    std::vector<uint16_t> values;  // array positions, or run (start, len-1)
+    std::vector<uint64_t> bits;    // bitmap container
+
+    size_t Bytes() const {
+      return type == ContainerType::Bitmap ? kChunkWords * sizeof(uint64_t)
+                                           : values.size() * sizeof(uint16_t);
+    }
+  };
+
+  std::vector<Container> containers;
+
+  void ToWords(uint64_t *out) const override {
+    std::fill(out, out + NumWords(), 0);
+    for (const auto &c : containers) {
+      uint64_t *chunk = out + c.key * kChunkWords;
+      size_t limit = std::min(kChunkWords, NumWords() - c.key * kChunkWords);
+      ExpandContainer(c, chunk, limit);
+    }
+  }
+
+  void FromWords(const uint64_t *in, size_t numBits) override {
+    length = numBits;
+    containers.clear();
+    size_t numWords = NumWords();
+    std::vector<uint64_t> chunk(kChunkWords);
+    for (size_t start = 0; start < numWords; start += kChunkWords) {
+      size_t n = std::min(kChunkWords, numWords - start);
+      std::fill(std::copy(in + start, in + start + n, chunk.begin()),
+                chunk.end(), 0);
+      AddChunk(static_cast<uint16_t>(start / kChunkWords), chunk.data());
+    }
+  }
+
+  size_t Cardinality() const override {
+    size_t total = 0;
+    for (const auto &c : containers) total += c.cardinality;
+    return total;
+  }
+
+  std::unique_ptr<BitmapCodec> Combine(const BitmapCodec &other,
+                                       BitwiseOp op) const override {
+    auto *o = dynamic_cast<const RoaringCodec *>(&other);
+    if (!o) return CombineViaWords(other, op);
+    CheckSameLength(other);
+    auto out = std::make_unique<RoaringCodec>();
+    out->length = length;
+    std::vector<uint64_t> wa(kChunkWords), wb(kChunkWords);
+    auto ia = containers.begin(), ib = o->containers.begin();
+    while (ia != containers.end() || ib != o->containers.end()) {
+      bool hasA = ia != containers.end(), hasB = ib != o->containers.end();
+      if (hasA && (!hasB || ia->key < ib->key)) {
+        if (op == BitwiseOp::Or) out->containers.push_back(*ia);
+        ++ia;
+      } else if (hasB && (!hasA || ib->key < ia->key)) {
+        if (op == BitwiseOp::Or) out->containers.push_back(*ib);
+        ++ib;
+      } else {
+        CombineContainers(*ia, *ib, op, wa, wb, *out);
+        ++ia;
+        ++ib;
+      }
+    }
+    return out;
+  }
+
+  std::size_t EncodedNumValues() override {
+    // Per container: key, type and cardinality headers plus the payload.
+    size_t bytes = 0;
+    for (const auto &c : containers) bytes += 8 + c.Bytes();
+    return bytes;
+  }
+
+  virtual ~RoaringCodec() {}
+
+  std::string name() const override { return "roaring"; }
+
+  StatefulIntegerCodec<int32_t> *CloneFresh() const override {
+    return new RoaringCodec();
+  }
+
+  void AllocEncoded(const int32_t *, size_t length) override {
+    this->length = length;
+    containers.clear();
+  };
+
+  void clear() override {
+    containers.clear();
+    containers.shrink_to_fit();
+  }
+
+ private:
+  static void ExpandContainer(const Container &c, uint64_t *chunk,
+                              size_t limit) {
+    switch (c.type) {
+      case ContainerType::Bitmap:
+        std::copy(c.bits.begin(), c.bits.begin() + limit, chunk);
+        break;
+      case ContainerType::Array:
+        for (uint16_t v : c.values) chunk[v / 64] |= uint64_t{1} << (v % 64);
+        break;
+      case ContainerType::Run:
+        for (size_t r = 0; r < c.values.size(); r += 2)
+          SetRange(chunk, c.values[r], size_t{c.values[r]} + c.values[r + 1] + 1);
+        break;
+    }
+  }
+
+  // Sets bits [begin, end) of a chunk.
+  static void SetRange(uint64_t *chunk, size_t begin, size_t end) {
+    while (begin < end) {
+      size_t w = begin / 64, lo = begin % 64;
+      size_t hi = std::min<size_t>(64, lo + (end - begin));
+      uint64_t mask = (hi == 64 ? ~uint64_t{0} : (uint64_t{1} << hi) - 1) &
+                      ~((uint64_t{1} << lo) - 1);
+      chunk[w] |= mask;
+      begin += hi - lo;
+    }
+  }
+
+  // Appends the chunk as its smallest container (nothing if empty).
+  void AddChunk(uint16_t key, const uint64_t *chunk) {
+    size_t card = WordsPopcount(chunk, kChunkWords);
+    if (card == 0) return;
+    // A run starts wherever a set bit follows a clear one.
+    size_t runs = 0;
+    uint64_t carry = 0;
+    for (size_t w = 0; w < kChunkWords; ++w) {
+      runs += __builtin_popcountll(chunk[w] & ~((chunk[w] << 1) | carry));
+      carry = chunk[w] >> 63;
+    }
+    Container c{key, ContainerType::Bitmap, static_cast<uint32_t>(card), {}, {}};
+    size_t arrayBytes = card * 2, runBytes = runs * 4,
+           bitmapBytes = kChunkWords * 8;
+    if (runBytes <= arrayBytes && runBytes < bitmapBytes) {
+      c.type = ContainerType::Run;
+      c.values.reserve(runs * 2);
+      size_t i = 0;
+      while (i < kChunkBits) {
+        if (!((chunk[i / 64] >> (i % 64)) & 1)) {
+          // Skip clear words quickly.
+          if (chunk[i / 64] >> (i % 64) == 0) {
+            i = (i / 64 + 1) * 64;
+            continue;
+          }
+          ++i;
+          continue;
+        }
+        size_t start = i;
+        while (i < kChunkBits && ((chunk[i / 64] >> (i % 64)) & 1)) ++i;
+        c.values.push_back(static_cast<uint16_t>(start));
+        c.values.push_back(static_cast<uint16_t>(i - start - 1));
+      }
+    } else if (card <= kMaxArray) {
+      c.type = ContainerType::Array;
+      c.values.reserve(card);
+      for (size_t w = 0; w < kChunkWords; ++w)
+        for (uint64_t bits = chunk[w]; bits; bits &= bits - 1)
+          c.values.push_back(
+              static_cast<uint16_t>(w * 64 + __builtin_ctzll(bits)));
+    } else {
+      c.bits.assign(chunk, chunk + kChunkWords);
+    }
+    containers.push_back(std::move(c));
+  }
+
+  static bool Contains(const Container &c, uint16_t v) {
+    switch (c.type) {
+      case ContainerType::Bitmap:
+        return (c.bits[v / 64] >> (v % 64)) & 1;
+      case ContainerType::Array:
+        return std::binary_search(c.values.begin(), c.values.end(), v);
+      case ContainerType::Run: {
+        for (size_t r = 0; r < c.values.size(); r += 2)
+          if (v >= c.values[r] && v <= size_t{c.values[r]} + c.values[r + 1])
+            return true;
+        return false;
+      }
+    }
+    return false;
+  }
+
+  static void CombineContainers(const Container &a, const Container &b,
+                                BitwiseOp op, std::vector<uint64_t> &wa,
+                                std::vector<uint64_t> &wb, RoaringCodec &out) {
+    // Intersections with a small array only probe the other side.
+    if (op == BitwiseOp::And &&
+        (a.type == ContainerType::Array || b.type == ContainerType::Array)) {
+      const Container &arr = a.type == ContainerType::Array ? a : b;
+      const Container &probe = &arr == &a ? b : a;
+      Container c{a.key, ContainerType::Array, 0, {}, {}};
+      if (probe.type == ContainerType::Array)
+        std::set_intersection(arr.values.begin(), arr.values.end(),
+                              probe.values.begin(), probe.values.end(),
+                              std::back_inserter(c.values));
+      else
+        for (uint16_t v : arr.values)
+          if (Contains(probe, v)) c.values.push_back(v);
+      c.cardinality = static_cast<uint32_t>(c.values.size());
+      if (c.cardinality) out.containers.push_back(std::move(c));
+      return;
+    }
+    std::fill(wa.begin(), wa.end(), 0);
+    std::fill(wb.begin(), wb.end(), 0);
+    ExpandContainer(a, wa.data(), kChunkWords);
+    ExpandContainer(b, wb.data(), kChunkWords);
+    WordsOp(op, wa.data(), wb.data(), wa.data(), kChunkWords);
+    out.AddChunk(a.key, wa.data());
+  }
+};
+
+/////////////////////////////////
+// EWAH run-length bitmaps     //
+/////////////////////////////////
+
+// Enhanced Word-Aligned Hybrid: a sequence of marker words, each followed by
+// its literal words. Marker bit 0 is the run bit, bits 1-32 the number of
+// clean (all-0 or all-1) words in the run, bits 33-63 the literal count.
+// AND/OR walk both streams and skip runs without expanding them.
+class EWAHCodec : public BitmapCodec {
+ public:
+  std::vector<uint64_t> buffer;
+
+  static constexpr uint64_t kMaxRun = (uint64_t{1} << 32) - 1;
+  static constexpr uint64_t kMaxLiterals = (uint64_t{1} << 31) - 1;
+
+  // Appends words while keeping the marker structure canonical.
+  class Builder {
+   private:
+    std::vector<uint64_t> &buf;
+    size_t marker;
+
+    uint64_t RunLength() const { return (buf[marker] >> 1) & kMaxRun; }
+    uint64_t Literals() const { return buf[marker] >> 33; }
+    bool RunBit() const { return buf[marker] & 1; }
+
+    void NewMarker(bool bit) {
+      marker = buf.size();
+      buf.push_back(bit ? 1 : 0);
+    }
+
+   public:
+    explicit Builder(std::vector<uint64_t> &buf) : buf{buf} {
+      buf.clear();
+      NewMarker(false);
+    }
+
+    void AddRun(bool bit, uint64_t n) {
+      while (n > 0) {
+        if (Literals() > 0 || (RunLength() > 0 && RunBit() != bit) ||
+            RunLength() == kMaxRun)
+          NewMarker(bit);
+        if (RunLength() == 0) buf[marker] = (buf[marker] & ~uint64_t{1}) | bit;
+        uint64_t take = std::min(n, kMaxRun - RunLength());
+        buf[marker] += take << 1;
+        n -= take;
+      }
+    }
+
+    void AddLiteral(uint64_t word) {
+      if (word == 0 || word == ~uint64_t{0}) return AddRun(word != 0, 1);
+      if (Literals() == kMaxLiterals) NewMarker(false);
+      buf[marker] += uint64_t{1} << 33;
+      buf.push_back(word);
+    }
+  };
+
+  // Sequential reader that can skip or copy runs without expanding them.
+  class Cursor {
+   private:
+    const std::vector<uint64_t> &buf;
+    size_t next = 0;  // next marker position
+    const uint64_t *lit = nullptr;
+
+   public:
+    uint64_t runLeft = 0, litLeft = 0;
+    bool runBit = false;
+
+    explicit Cursor(const std::vector<uint64_t> &buf) : buf{buf} { Refill(); }
+
+    // Loads markers until there is something to read.
+    void Refill() {
+      while (runLeft == 0 && litLeft == 0 && next < buf.size()) {
+        uint64_t m = buf[next];
+        runBit = m & 1;
+        runLeft = (m >> 1) & kMaxRun;
+        litLeft = m >> 33;
+        lit = buf.data() + next + 1;
+        next += 1 + litLeft;
+      }
+    }
+
+    bool Done() const { return runLeft == 0 && litLeft == 0; }
+
+    uint64_t NextLiteral() {
+      --litLeft;
+      uint64_t w = *lit++;
+      Refill();
+      return w;
+    }
+
+    // Consumes n words, forwarding them to `out` when given.
+    void Take(uint64_t n, Builder *out) {
+      while (n > 0 && !Done()) {
+        if (runLeft > 0) {
+          uint64_t k = std::min(n, runLeft);
+          if (out) out->AddRun(runBit, k);
+          runLeft -= k;
+          n -= k;
+        } else {
+          uint64_t k = std::min(n, litLeft);
+          if (out)
+            for (uint64_t i = 0; i < k; ++i) out->AddLiteral(lit[i]);
+          lit += k;
+          litLeft -= k;
+          n -= k;
+        }
+        Refill();
+      }
+    }
+  };
+
+  void ToWords(uint64_t *out) const override {
+    uint64_t *w = out;
+    for (size_t pos = 0; pos < buffer.size();) {
+      uint64_t m = buffer[pos++];
+      uint64_t run = (m >> 1) & kMaxRun, lits = m >> 33;
+      w = std::fill_n(w, run, (m & 1) ? ~uint64_t{0} : 0);
+      w = std::copy(buffer.begin() + pos, buffer.begin() + pos + lits, w);
+      pos += lits;
+    }
+    std::fill(w, out + NumWords(), 0);
+  }
+
+  void FromWords(const uint64_t *in, size_t numBits) override {
+    length = numBits;
+    Builder b(buffer);
+    for (size_t i = 0; i < NumWords(); ++i) b.AddLiteral(in[i]);
+  }
+
+  size_t Cardinality() const override {
+    size_t count = 0;
+    for (size_t pos = 0; pos < buffer.size();) {
+      uint64_t m = buffer[pos++];
+      uint64_t lits = m >> 33;
+      if (m & 1) count += ((m >> 1) & kMaxRun) * 64;
+      count += WordsPopcount(buffer.data() + pos, lits);
+      pos += lits;
+    }
+    return count;
+  }
+
+  std::unique_ptr<BitmapCodec> Combine(const BitmapCodec &other,
+                                       BitwiseOp op) const override {
+    auto *o = dynamic_cast<const EWAHCodec *>(&other);
+    if (!o) return CombineViaWords(other, op);
+    CheckSameLength(other);
+    auto out = std::make_unique<EWAHCodec>();
+    out->length = length;
+    Builder b(out->buffer);
+    Cursor ca(buffer), cb(o->buffer);
+    // A run of the absorbing bit (0 for AND, 1 for OR) decides the result
+    // for its whole span; a run of the identity bit passes the other side
+    // through unchanged.
+    bool absorbing = op == BitwiseOp::Or;
+    while (!ca.Done() && !cb.Done()) {
+      if (ca.runLeft > 0 || cb.runLeft > 0) {
+        Cursor &run = ca.runLeft >= cb.runLeft ? ca : cb;
+        Cursor &rest = &run == &ca ? cb : ca;
+        uint64_t n = run.runLeft;
+        bool bit = run.runBit;
+        run.runLeft = 0;
+        run.Refill();
+        if (bit == absorbing) {
+          b.AddRun(bit, n);
+          rest.Take(n, nullptr);
+        } else {
+          rest.Take(n, &b);
+        }
+      } else {
+        b.AddLiteral(
+            ApplyBitwiseOp(op, ca.NextLiteral(), cb.NextLiteral()));
+      }
+    }
+    return out;
+  }
+
+  std::size_t EncodedNumValues() override { return buffer.size(); }
+
+  std::size_t EncodedSizeValue() override { return sizeof(uint64_t); }
+
+  virtual ~EWAHCodec() {}
+
+  std::string name() const override { return "ewah"; }
+
+  StatefulIntegerCodec<int32_t> *CloneFresh() const override {
+    return new EWAHCodec();
+  }
+
+  void AllocEncoded(const int32_t *, size_t length) override {
+    this->length = length;
+    buffer.clear();
+  };
+
+  void clear() override {
+    buffer.clear();
+    buffer.shrink_to_fit();
+  }
+};
@@ -1,3 +1,5 @@
+#pragma once
+
 #include <vector>
 
 #include "composite_codec.h"
@@ -6,7 +8,12 @@
 #include "fastpfor_fused_codecs.h"
 #include "generic_codecs.h"
 #include "simdcomp_codecs.h"
+#include "simdcomp_d1_codecs.h"
+#include "simdcomp_for_codecs.h"
+#include "simdcomp_linear_codecs.h"
+#include "tans_codecs.h"
 #include "simdcomp_fused_codecs.h"
+#include "zstd_codecs.h"
 
 std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>>
 InitLogicalCodecs() {
@@ -25,6 +32,13 @@ InitPhysicalCodecs() {
 
   codecs.push_back(std::make_unique<SimdCompCodec>());
   codecs.push_back(std::make_unique<SimdCompFusedCodec>());
+  codecs.push_back(std::make_unique<SimdCompFORCodec>());
+  codecs.push_back(std::make_unique<SimdCompD1Codec>());
+  codecs.push_back(std::make_unique<SimdCompD1Codec>(/* zigzag */ true));
+  codecs.push_back(std::make_unique<SimdCompD1FusedCodec>());
+  codecs.push_back(std::make_unique<SimdCompD1FusedCodec>(/* zigzag */ true));
+  codecs.push_back(std::make_unique<SimdCompLinearCodec>());
+  codecs.push_back(std::make_unique<TansCodec>());
 
   // FastPFor Codecs
   CODECFactory fastpfor_codecfactory;
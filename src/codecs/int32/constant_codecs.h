@@ -0,0 +1,338 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bitmap_codecs.h"
+#include "generic_codecs.h"
+#include "transformations_simd.h"
+
+//////////////////////////////////////////////////////////////////////////
+// constant-block codecs for single-valued tiles (ocean, nodata, masked  //
+// regions): one value, plus a sorted exception list of (position,       //
+// value) pairs for a handful of outliers. Encoding is one SIMD equality //
+// scan when the block is constant; decoding is broadcast stores, or     //
+// nothing at all for consumers that ask for ConstantValue().            //
+//////////////////////////////////////////////////////////////////////////
+
+// Broadcast fill and "count values != v" kernels, dispatched on
+// TransformationSimdLevel() (the build only assumes SSE4.1).
+
+inline void FillSSE41(int32_t *out, size_t n, int32_t v) {
+  const __m128i x = _mm_set1_epi32(v);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i *o = reinterpret_cast<__m128i *>(out + i);
+    _mm_storeu_si128(o, x);
+    _mm_storeu_si128(o + 1, x);
+    _mm_storeu_si128(o + 2, x);
+    _mm_storeu_si128(o + 3, x);
+  }
+  for (; i < n; ++i) out[i] = v;
+}
+
+TRANSFORM_TARGET_AVX2
+inline void FillAVX2(int32_t *out, size_t n, int32_t v) {
+  const __m256i x = _mm256_set1_epi32(v);
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i *o = reinterpret_cast<__m256i *>(out + i);
+    _mm256_storeu_si256(o, x);
+    _mm256_storeu_si256(o + 1, x);
+    _mm256_storeu_si256(o + 2, x);
+    _mm256_storeu_si256(o + 3, x);
+  }
+  for (; i < n; ++i) out[i] = v;
+}
+
+TRANSFORM_TARGET_AVX512
+inline void FillAVX512(int32_t *out, size_t n, int32_t v) {
+  const __m512i x = _mm512_set1_epi32(v);
+  size_t i = 0;
+  for (; i + 64 <= n; i += 64) {
+    _mm512_storeu_si512(out + i, x);
+    _mm512_storeu_si512(out + i + 16, x);
+    _mm512_storeu_si512(out + i + 32, x);
+    _mm512_storeu_si512(out + i + 48, x);
+  }
+  for (; i < n; ++i) out[i] = v;
+}
+
+// out[0, n) = v.
+inline void FillConstant(int32_t *out, size_t n, int32_t v) {
+  switch (TransformationSimdLevel()) {
+    case SimdLevel::Scalar:
+      std::fill_n(out, n, v);
+      return;
+    case SimdLevel::SSE41:
+      return FillSSE41(out, n, v);
+    case SimdLevel::AVX2:
+      return FillAVX2(out, n, v);
+    default:
+      return FillAVX512(out, n, v);
+  }
+}
+
+// Stops early (returning a value > limit) once more than `limit` differ.
+inline size_t CountNotEqualSSE41(const int32_t *in, size_t n, int32_t v,
+                                 size_t limit) {
+  const __m128i x = _mm_set1_epi32(v);
+  size_t count = 0, i = 0;
+  for (; i + 16 <= n && count <= limit; i += 16) {
+    const __m128i *p = reinterpret_cast<const __m128i *>(in + i);
+    __m128i eq = _mm_packs_epi16(
+        _mm_packs_epi32(_mm_cmpeq_epi32(_mm_loadu_si128(p), x),
+                        _mm_cmpeq_epi32(_mm_loadu_si128(p + 1), x)),
+        _mm_packs_epi32(_mm_cmpeq_epi32(_mm_loadu_si128(p + 2), x),
+                        _mm_cmpeq_epi32(_mm_loadu_si128(p + 3), x)));
+    count += 16 - __builtin_popcount(_mm_movemask_epi8(eq));
+  }
+  for (; i < n; ++i) count += in[i] != v;
+  return count;
+}
+
+TRANSFORM_TARGET_AVX512
+inline size_t CountNotEqualAVX512(const int32_t *in, size_t n, int32_t v,
+                                  size_t limit) {
+  const __m512i x = _mm512_set1_epi32(v);
+  size_t count = 0, i = 0;
+  for (; i + 64 <= n && count <= limit; i += 64) {
+    uint64_t ne =
+        uint64_t{_mm512_cmpneq_epi32_mask(_mm512_loadu_si512(in + i), x)} |
+        uint64_t{_mm512_cmpneq_epi32_mask(_mm512_loadu_si512(in + i + 16), x)}
+            << 16 |
+        uint64_t{_mm512_cmpneq_epi32_mask(_mm512_loadu_si512(in + i + 32), x)}
+            << 32 |
+        uint64_t{_mm512_cmpneq_epi32_mask(_mm512_loadu_si512(in + i + 48), x)}
+            << 48;
+    count += __builtin_popcountll(ne);
+  }
+  return count + CountNotEqualSSE41(in + i, n - i, v, limit);
+}
+
+// Number of in[i] != v, or some count above `limit` once it is exceeded.
+inline size_t CountNotEqual(const int32_t *in, size_t n, int32_t v,
+                            size_t limit = SIZE_MAX) {
+  switch (TransformationSimdLevel()) {
+    case SimdLevel::Scalar:
+      return n - static_cast<size_t>(std::count(in, in + n, v));
+    case SimdLevel::SSE41:
+    case SimdLevel::AVX2:
+      return CountNotEqualSSE41(in, n, v, limit);
+    default:
+      return CountNotEqualAVX512(in, n, v, limit);
+  }
+}
+
+// Near-constant block: the majority value plus every other value as an
+// exception. Lossless for any block, but only small for near-constant ones.
+// Encoded as [value, numExceptions, pos0, value0, pos1, value1, ...] with
+// positions ascending.
+class NearConstantCodec : public StatefulIntegerCodec<int32_t> {
+ protected:
+  std::vector<int32_t> compressed;
+
+  int32_t Value() const { return compressed[0]; }
+  size_t NumExceptions() const { return static_cast<uint32_t>(compressed[1]); }
+  size_t Pos(size_t e) const {
+    return static_cast<uint32_t>(compressed[2 + 2 * e]);
+  }
+  int32_t ExceptionValue(size_t e) const { return compressed[3 + 2 * e]; }
+
+  // First exception at or after position `begin`.
+  size_t FirstException(size_t begin) const {
+    size_t lo = 0, hi = NumExceptions();
+    while (lo < hi) {
+      size_t mid = (lo + hi) / 2;
+      if (Pos(mid) < begin)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    return lo;
+  }
+
+  class Cursor : public DecodeCursor<int32_t> {
+   private:
+    const NearConstantCodec &codec;
+    size_t length;
+    size_t pos = 0;
+    size_t e = 0;
+
+   public:
+    Cursor(const NearConstantCodec &codec, size_t length)
+        : codec{codec}, length{length} {}
+
+    size_t Next(int32_t *out, size_t k) override {
+      size_t n = std::min(k, length - pos);
+      FillConstant(out, n, codec.Value());
+      for (; e < codec.NumExceptions() && codec.Pos(e) < pos + n; ++e)
+        out[codec.Pos(e) - pos] = codec.ExceptionValue(e);
+      pos += n;
+      return n;
+    }
+  };
+
+ public:
+  std::size_t ExceptionCount() const {
+    return compressed.size() < 2 ? 0 : NumExceptions();
+  }
+
+  // Fast path: one SIMD scan against in[0]. Otherwise the majority value
+  // (Boyer-Moore vote) is the base and the rest are exceptions.
+  void EncodeArray(const int32_t *in, const size_t length) override {
+    compressed.assign(2, 0);
+    if (length == 0) return;
+    int32_t value = in[0];
+    if (CountNotEqual(in, length, value, 0) != 0) {
+      size_t votes = 0;
+      for (size_t i = 0; i < length; ++i) {
+        if (votes == 0) value = in[i];
+        votes += in[i] == value ? 1 : -1;
+      }
+      for (size_t i = 0; i < length; ++i)
+        if (in[i] != value) {
+          compressed.push_back(static_cast<int32_t>(i));
+          compressed.push_back(in[i]);
+        }
+    }
+    compressed[0] = value;
+    compressed[1] = static_cast<int32_t>((compressed.size() - 2) / 2);
+  }
+
+  void DecodeArray(int32_t *out, const size_t length) override {
+    FillConstant(out, length, Value());
+    for (size_t e = 0; e < NumExceptions(); ++e)
+      out[Pos(e)] = ExceptionValue(e);
+  }
+
+  void DecodeRange(int32_t *out, size_t begin, size_t count,
+                   size_t) override {
+    FillConstant(out, count, Value());
+    for (size_t e = FirstException(begin);
+         e < NumExceptions() && Pos(e) < begin + count; ++e)
+      out[Pos(e) - begin] = ExceptionValue(e);
+  }
+
+  std::unique_ptr<DecodeCursor<int32_t>> NewDecodeCursor(
+      size_t length) override {
+    return std::make_unique<Cursor>(*this, length);
+  }
+
+  void DecodeRuns(size_t length,
+                  std::vector<ValueRun<int32_t>> &runs) override {
+    size_t pos = 0;
+    for (size_t e = 0; e < NumExceptions(); ++e) {
+      AppendRun(runs, Value(), static_cast<uint32_t>(Pos(e) - pos));
+      AppendRun(runs, ExceptionValue(e), 1u);
+      pos = Pos(e) + 1;
+    }
+    AppendRun(runs, Value(), static_cast<uint32_t>(length - pos));
+  }
+
+  bool ConstantValue(size_t, int32_t &value) override {
+    if (NumExceptions() != 0) return false;
+    value = Value();
+    return true;
+  }
+
+  bool FusedSum(size_t length, int64_t &sum) override {
+    sum = int64_t{Value()} * static_cast<int64_t>(length);
+    for (size_t e = 0; e < NumExceptions(); ++e)
+      sum += int64_t{ExceptionValue(e)} - Value();
+    return true;
+  }
+
+  // Wraps like the decoded values would.
+  bool FusedValueShift(size_t, int32_t delta) override {
+    auto shift = [delta](int32_t &v) {
+      v = static_cast<int32_t>(static_cast<uint32_t>(v) +
+                               static_cast<uint32_t>(delta));
+    };
+    shift(compressed[0]);
+    for (size_t e = 0; e < NumExceptions(); ++e) shift(compressed[3 + 2 * e]);
+    return true;
+  }
+
+  bool FusedThreshold(size_t length, uint64_t *bitmap) override {
+    if (length == 0) return true;
+    int64_t sum = 0;
+    FusedSum(length, sum);
+    const int64_t mean = sum / static_cast<int64_t>(length);
+    const size_t numWords = (length + 63) / 64;
+    std::fill(bitmap, bitmap + numWords, Value() >= mean ? ~uint64_t{0} : 0);
+    if (length % 64) bitmap[numWords - 1] &= (uint64_t{1} << (length % 64)) - 1;
+    for (size_t e = 0; e < NumExceptions(); ++e) {
+      uint64_t bit = uint64_t{1} << (Pos(e) % 64);
+      if (ExceptionValue(e) >= mean)
+        bitmap[Pos(e) / 64] |= bit;
+      else
+        bitmap[Pos(e) / 64] &= ~bit;
+    }
+    return true;
+  }
+
+  std::size_t EncodedNumValues() override { return compressed.size(); }
+
+  std::size_t EncodedSizeValue() override { return sizeof(int32_t); }
+
+  virtual ~NearConstantCodec() {}
+
+  std::string name() const override { return "near_constant"; }
+
+  std::size_t GetOverflowSize(size_t) const override { return 0; }
+
+  StatefulIntegerCodec<int32_t> *CloneFresh() const override {
+    return new NearConstantCodec();
+  }
+
+  void AllocEncoded(const int32_t *, size_t) override { compressed.reserve(2); }
+
+  void clear() override {
+    compressed.clear();
+    compressed.shrink_to_fit();
+  }
+
+  std::vector<int32_t> &GetEncoded() override { return compressed; }
+};
+
+// Strictly single-valued block: just the value. Encoding anything else
+// throws.
+class ConstantCodec : public NearConstantCodec {
+ public:
+  void EncodeArray(const int32_t *in, const size_t length) override {
+    compressed.assign(2, 0);
+    if (length == 0) return;
+    if (CountNotEqual(in, length, in[0], 0) != 0)
+      throw std::invalid_argument("Block is not constant");
+    compressed[0] = in[0];
+  }
+
+  std::string name() const override { return "constant"; }
+
+  StatefulIntegerCodec<int32_t> *CloneFresh() const override {
+    return new ConstantCodec();
+  }
+};
+
+// Base value of `in` if it has at most `maxExceptions` other values, tried
+// against the first, middle and last value (a near-constant block's majority
+// is almost always one of them). Each scan stops as soon as it exceeds the
+// limit, so ordinary blocks are rejected after a few vectors.
+inline bool FindNearConstantBase(const int32_t *in, size_t n,
+                                 size_t maxExceptions, int32_t &value) {
+  if (n == 0) return false;
+  for (size_t probe : {size_t{0}, n / 2, n - 1}) {
+    if (CountNotEqual(in, n, in[probe], maxExceptions) <= maxExceptions) {
+      value = in[probe];
+      return true;
+    }
+  }
+  return false;
+}
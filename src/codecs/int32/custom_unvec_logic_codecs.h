@@ -1,3 +1,5 @@
+#pragma once
+
 #include <algorithm>
 #include <cstdint>
 #include <cstring>
@@ -7,11 +9,95 @@
 
 #include "generic_codecs.h"
 
+// Cursors below walk the encoded vector directly, carrying only the running
+// state (previous value, reference, current run) between chunks.
+
+class DeltaDecodeCursor : public DecodeCursor<int32_t> {
+ private:
+  const std::vector<int32_t>& encoded;
+  size_t length;
+  size_t pos = 0;
+  int32_t prev = 0;
+
+ public:
+  DeltaDecodeCursor(const std::vector<int32_t>& encoded, size_t length)
+      : encoded{encoded}, length{length} {}
+
+  size_t Next(int32_t* out, size_t k) override {
+    size_t n = std::min(k, length - pos);
+    for (size_t j = 0; j < n; ++j, ++pos) {
+      if (pos == 0) {
+        prev = encoded[0];
+      } else {
+        uint32_t zigzagged = static_cast<uint32_t>(encoded[pos]);
+        prev += (zigzagged >> 1) ^ -(zigzagged & 1);
+      }
+      out[j] = prev;
+    }
+    return n;
+  }
+};
+
+class FORDecodeCursor : public DecodeCursor<int32_t> {
+ private:
+  const std::vector<int32_t>& encoded;
+  size_t length;
+  size_t pos = 0;
+
+ public:
+  FORDecodeCursor(const std::vector<int32_t>& encoded, size_t length)
+      : encoded{encoded}, length{length} {}
+
+  size_t Next(int32_t* out, size_t k) override {
+    size_t n = std::min(k, length - pos);
+    int32_t referenceValue = encoded[0];
+    const int32_t* in = encoded.data() + 1 + pos;
+    for (size_t j = 0; j < n; ++j) {
+      uint32_t zigzag = static_cast<uint32_t>(in[j]);
+      out[j] = static_cast<int32_t>((zigzag >> 1) ^ -(zigzag & 1)) +
+               referenceValue;
+    }
+    pos += n;
+    return n;
+  }
+};
+
+class RLEDecodeCursor : public DecodeCursor<int32_t> {
+ private:
+  const std::vector<int32_t>& encoded;
+  size_t run = 0;        // index of the current (value, length) pair
+  size_t remaining = 0;  // values left in the current run
+
+ public:
+  explicit RLEDecodeCursor(const std::vector<int32_t>& encoded)
+      : encoded{encoded} {
+    if (!encoded.empty()) remaining = encoded[1];
+  }
+
+  size_t Next(int32_t* out, size_t k) override {
+    size_t written = 0;
+    while (written < k && run < encoded.size()) {
+      if (remaining == 0) {
+        run += 2;
+        if (run < encoded.size()) remaining = encoded[run + 1];
+        continue;
+      }
+      size_t n = std::min(k - written, remaining);
+      std::fill_n(out + written, n, encoded[run]);
+      written += n;
+      remaining -= n;
+    }
+    return written;
+  }
+};
+
 class DeltaCodec : public StatefulIntegerCodec<int32_t> {
  private:
   std::vector<int32_t> compressed_data;
 
  public:
+  static constexpr bool kForwardsValues = true;
+
   DeltaCodec() {}
 
   void EncodeArray(const int32_t* in, const size_t length) override {
@@ -45,6 +131,20 @@ class DeltaCodec : public StatefulIntegerCodec<int32_t> {
 
   std::string name() const override { return "custom_delta_unvec"; }
 
+  // Accumulates the running (prefix) value instead of storing it.
+  bool FusedSum(size_t length, int64_t& sum) override {
+    sum = 0;
+    if (length == 0) return true;
+    uint32_t x = static_cast<uint32_t>(compressed_data[0]);
+    sum = static_cast<int32_t>(x);
+    for (size_t i = 1; i < length; ++i) {
+      uint32_t zigzagged = static_cast<uint32_t>(compressed_data[i]);
+      x += (zigzagged >> 1) ^ -(zigzagged & 1);
+      sum += static_cast<int32_t>(x);
+    }
+    return true;
+  }
+
   std::size_t GetOverflowSize(size_t) const override { return 0; }
 
   StatefulIntegerCodec<int32_t>* CloneFresh() const override {
@@ -61,13 +161,35 @@ class DeltaCodec : public StatefulIntegerCodec<int32_t> {
   }
 
   std::vector<int32_t>& GetEncoded() override { return compressed_data; };
+
+  std::unique_ptr<DecodeCursor<int32_t>> NewDecodeCursor(
+      size_t length) override {
+    return std::make_unique<DeltaDecodeCursor>(compressed_data, length);
+  }
 };
 
+// EncodedSumTerms of a FOR encoding: the reference, then the `length`
+// zigzagged offsets. It sums to ref + 2 * (offset sum) when every offset is
+// below 2^30, i.e. every zigzag is a non-negative int32, so the values' sum
+// is n * ref + (encoded sum - ref) / 2 = (encoded sum + (2n - 1) * ref) / 2.
+inline bool ForEncodedSumTerms(const std::vector<int32_t>& encoded,
+                               size_t length, int64_t& bias,
+                               int64_t& divisor) {
+  if (length == 0 || encoded.size() <= length) return false;
+  for (size_t i = 1; i <= length; ++i)
+    if (encoded[i] < 0) return false;
+  divisor = 2;
+  return !__builtin_mul_overflow(2 * static_cast<int64_t>(length) - 1,
+                                 int64_t{encoded[0]}, &bias);
+}
+
 class FORCodec : public StatefulIntegerCodec<int32_t> {
  private:
   std::vector<int32_t> compressed_data;
 
  public:
+  static constexpr bool kForwardsValues = true;
+
   FORCodec() {}
 
   void EncodeArray(const int32_t* in, const size_t length) override {
@@ -104,6 +226,31 @@ class FORCodec : public StatefulIntegerCodec<int32_t> {
 
   std::string name() const override { return "custom_for_unvec"; }
 
+  // n * reference + sum of the offsets.
+  bool FusedSum(size_t length, int64_t& sum) override {
+    sum = 0;
+    if (length == 0 || compressed_data.empty()) return true;
+    uint32_t reference = static_cast<uint32_t>(compressed_data[0]);
+    for (size_t i = 1; i <= length; ++i) {
+      uint32_t zigzag = static_cast<uint32_t>(compressed_data[i]);
+      sum += static_cast<int32_t>(reference + ((zigzag >> 1) ^ -(zigzag & 1)));
+    }
+    return true;
+  }
+
+  bool EncodedSumTerms(size_t length, int64_t& bias,
+                       int64_t& divisor) const override {
+    return ForEncodedSumTerms(compressed_data, length, bias, divisor);
+  }
+
+  // Offsets are relative to the reference, so a shift only touches it.
+  bool FusedValueShift(size_t, int32_t delta) override {
+    if (compressed_data.empty()) return false;
+    compressed_data[0] = static_cast<int32_t>(
+        static_cast<uint32_t>(compressed_data[0]) + static_cast<uint32_t>(delta));
+    return true;
+  }
+
   std::size_t GetOverflowSize(size_t) const override { return 0; }
 
   StatefulIntegerCodec<int32_t>* CloneFresh() const override {
@@ -120,6 +267,11 @@ class FORCodec : public StatefulIntegerCodec<int32_t> {
   }
 
   std::vector<int32_t>& GetEncoded() override { return compressed_data; };
+
+  std::unique_ptr<DecodeCursor<int32_t>> NewDecodeCursor(
+      size_t length) override {
+    return std::make_unique<FORDecodeCursor>(compressed_data, length);
+  }
 };
 
 class RLECodec : public StatefulIntegerCodec<int32_t> {
@@ -127,6 +279,8 @@ class RLECodec : public StatefulIntegerCodec<int32_t> {
   std::vector<int32_t> compressed_data;
 
  public:
+  static constexpr bool kForwardsValues = true;
+
   RLECodec() {}
 
   void EncodeArray(const int32_t* in, const size_t length) override {
@@ -162,6 +316,14 @@ class RLECodec : public StatefulIntegerCodec<int32_t> {
 
   std::string name() const override { return "custom_rle_unvec"; }
 
+  bool FusedSum(size_t, int64_t& sum) override {
+    sum = 0;
+    for (size_t i = 0; i < compressed_data.size(); i += 2)
+      sum += int64_t{compressed_data[i]} *
+             static_cast<uint32_t>(compressed_data[i + 1]);
+    return true;
+  }
+
   std::size_t GetOverflowSize(size_t) const override { return 0; }
 
   StatefulIntegerCodec<int32_t>* CloneFresh() const override {
@@ -178,4 +340,14 @@ class RLECodec : public StatefulIntegerCodec<int32_t> {
   }
 
   std::vector<int32_t>& GetEncoded() override { return compressed_data; };
+
+  std::unique_ptr<DecodeCursor<int32_t>> NewDecodeCursor(size_t) override {
+    return std::make_unique<RLEDecodeCursor>(compressed_data);
+  }
+
+  void DecodeRuns(size_t, std::vector<ValueRun<int32_t>>& runs) override {
+    for (size_t i = 0; i < compressed_data.size(); i += 2)
+      AppendRun(runs, compressed_data[i],
+                static_cast<uint32_t>(compressed_data[i + 1]));
+  }
 };
@@ -9,11 +9,15 @@
 #include <memory>
 #include <string>
 
+#include "custom_unvec_logic_codecs.h"
+
 class DeltaCodecSSE42 : public StatefulIntegerCodec<int32_t> {
  private:
   std::vector<int32_t> compressed_data;
 
  public:
+  static constexpr bool kForwardsValues = true;
+
   void EncodeArray(const int32_t* in, const size_t length) override {
     if (length == 0) return;
 
@@ -78,6 +82,44 @@ class DeltaCodecSSE42 : public StatefulIntegerCodec<int32_t> {
 
   std::string name() const override { return "custom_delta_vecsse"; }
 
+  // Runs the decode in registers and widens each vector into 64-bit lane sums
+  // instead of storing it.
+  bool FusedSum(size_t length, int64_t& sum) override {
+    sum = 0;
+    if (length == 0) return true;
+
+    int32_t last = (compressed_data[0] >> 1) ^ (-(compressed_data[0] & 1));
+    sum = last;
+
+    __m128i prev = _mm_set1_epi32(last);
+    __m128i acc = _mm_setzero_si128();
+    size_t i = 1;
+    for (; i + 4 < length; i += 4) {
+      __m128i zigzag = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(&compressed_data[i]));
+
+      __m128i shiftR = _mm_srai_epi32(zigzag, 1);
+      __m128i mask = _mm_and_si128(zigzag, _mm_set1_epi32(1));
+      __m128i negate = _mm_sub_epi32(_mm_setzero_si128(), mask);
+      __m128i delta = _mm_xor_si128(shiftR, negate);
+
+      __m128i current = _mm_add_epi32(delta, prev);
+      acc = _mm_add_epi64(acc, _mm_cvtepi32_epi64(current));
+      acc = _mm_add_epi64(acc, _mm_cvtepi32_epi64(_mm_srli_si128(current, 8)));
+
+      prev = _mm_shuffle_epi32(current, _MM_SHUFFLE(3, 3, 3, 3));
+      last = _mm_cvtsi128_si32(prev);
+    }
+    sum += _mm_extract_epi64(acc, 0) + _mm_extract_epi64(acc, 1);
+
+    for (; i < length; ++i) {
+      int32_t delta = (compressed_data[i] >> 1) ^ (-(compressed_data[i] & 1));
+      last += delta;
+      sum += last;
+    }
+    return true;
+  }
+
   std::size_t GetOverflowSize(size_t) const override { return 0; }
 
   StatefulIntegerCodec<int32_t>* CloneFresh() const override {
@@ -101,6 +143,8 @@ class DeltaCodecAVX2 : public StatefulIntegerCodec<int32_t> {
   std::vector<int32_t> compressed_data;
 
  public:
+  static constexpr bool kForwardsValues = true;
+
   void EncodeArray(const int32_t* in, const size_t length) override {
     if (length < 8) {
       std::copy(in, in + length, compressed_data.begin());
@@ -172,6 +216,54 @@ class DeltaCodecAVX2 : public StatefulIntegerCodec<int32_t> {
 
   std::string name() const override { return "custom_delta_vecavx"; }
 
+  // Runs the decode in registers and widens each vector into 64-bit lane sums
+  // instead of storing it.
+  bool FusedSum(size_t length, int64_t& sum) override {
+    sum = 0;
+    if (length < 8) {
+      for (size_t i = 0; i < length; ++i) sum += compressed_data[i];
+      return true;
+    }
+
+    int32_t head[8];
+    for (size_t i = 0; i < 8; ++i) {
+      int32_t value = compressed_data[i];
+      head[i] = (value >> 1) ^ (-(value & 1));
+      sum += head[i];
+    }
+    int32_t last = head[7];
+
+    __m256i prev = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(head));
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 8;
+    for (; i + 8 < length; i += 8) {
+      __m256i delta = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(compressed_data.data() + i));
+
+      __m256i sign = _mm256_and_si256(delta, _mm256_set1_epi32(1));
+      sign = _mm256_sub_epi32(_mm256_setzero_si256(), sign);
+      delta = _mm256_xor_si256(_mm256_srli_epi32(delta, 1), sign);
+
+      __m256i current = _mm256_add_epi32(delta, prev);
+      acc = _mm256_add_epi64(
+          acc, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(current)));
+      acc = _mm256_add_epi64(
+          acc, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(current, 1)));
+      prev = _mm256_permute4x64_epi64(current, _MM_SHUFFLE(3, 3, 3, 3));
+      last = _mm256_extract_epi32(current, 7);
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    sum += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+    for (; i < length; ++i) {
+      int32_t value = compressed_data[i];
+      last += (value >> 1) ^ (-(value & 1));
+      sum += last;
+    }
+    return true;
+  }
+
   std::size_t GetOverflowSize(size_t) const override { return 0; }
 
   StatefulIntegerCodec<int32_t>* CloneFresh() const override {
@@ -195,6 +287,8 @@ class DeltaCodecAVX512 : public StatefulIntegerCodec<int32_t> {
   std::vector<int32_t> compressed_data;
 
  public:
+  static constexpr bool kForwardsValues = true;
+
   DeltaCodecAVX512() {}
 
   void EncodeArray(const int32_t* in, const size_t length) override {
@@ -269,6 +363,55 @@ class DeltaCodecAVX512 : public StatefulIntegerCodec<int32_t> {
 
   std::string name() const override { return "custom_delta_vecavx512"; }
 
+  // Runs the decode in registers and widens each vector into 64-bit lane sums
+  // instead of storing it.
+  bool FusedSum(size_t length, int64_t& sum) override {
+    sum = 0;
+    if (length == 0) return true;
+
+    size_t i = 0;
+    int32_t last = 0;
+
+    if (length >= 16) {
+      int32_t head[16];
+      for (size_t j = 0; j < 16; ++j) {
+        int32_t value = compressed_data[j];
+        head[j] = (value >> 1) ^ (-(value & 1));
+        sum += head[j];
+      }
+      last = head[15];
+
+      __m512i prev =
+          _mm512_loadu_si512(reinterpret_cast<const __m512i*>(head));
+      __m512i acc = _mm512_setzero_si512();
+      i = 16;
+      for (; i + 16 < length; i += 16) {
+        __m512i delta = _mm512_loadu_si512(
+            reinterpret_cast<const __m512i*>(compressed_data.data() + i));
+
+        __m512i sign = _mm512_and_si512(delta, _mm512_set1_epi32(1));
+        sign = _mm512_sub_epi32(_mm512_setzero_si512(), sign);
+        delta = _mm512_xor_si512(_mm512_srli_epi32(delta, 1), sign);
+
+        __m512i current = _mm512_add_epi32(delta, prev);
+        acc = _mm512_add_epi64(
+            acc, _mm512_cvtepi32_epi64(_mm512_castsi512_si256(current)));
+        acc = _mm512_add_epi64(
+            acc, _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(current, 1)));
+        prev = _mm512_permutexvar_epi32(_mm512_set1_epi32(15), current);
+        last = _mm_cvtsi128_si32(_mm512_castsi512_si128(prev));
+      }
+      sum += _mm512_reduce_add_epi64(acc);
+    }
+
+    for (; i < length; ++i) {
+      int32_t value = compressed_data[i];
+      last += (value >> 1) ^ (-(value & 1));
+      sum += last;
+    }
+    return true;
+  }
+
   std::size_t GetOverflowSize(size_t) const override { return 0; }
 
   StatefulIntegerCodec<int32_t>* CloneFresh() const override {
@@ -290,6 +433,8 @@ class FORCodecSSE42 : public StatefulIntegerCodec<int32_t> {
   std::vector<int32_t> compressed_data;
 
  public:
+  static constexpr bool kForwardsValues = true;
+
   FORCodecSSE42() {}
 
   void EncodeArray(const int32_t* in, const size_t length) override {
@@ -370,6 +515,46 @@ class FORCodecSSE42 : public StatefulIntegerCodec<int32_t> {
 
   std::string name() const override { return "custom_for_vecsse"; }
 
+  bool EncodedSumTerms(size_t length, int64_t& bias,
+                       int64_t& divisor) const override {
+    return ForEncodedSumTerms(compressed_data, length, bias, divisor);
+  }
+
+  // Runs the decode in registers and widens each vector into 64-bit lane sums
+  // instead of storing it.
+  bool FusedSum(size_t length, int64_t& sum) override {
+    sum = 0;
+    if (length == 0) return true;
+
+    int32_t referenceValue = compressed_data[0];
+    __m128i refValVec = _mm_set1_epi32(referenceValue);
+    __m128i acc = _mm_setzero_si128();
+
+    size_t i = 0;
+    for (; i + 4 < length; i += 4) {
+      __m128i zigzagEncoded = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(&compressed_data[i + 1]));
+
+      __m128i shiftRight = _mm_srai_epi32(zigzagEncoded, 1);
+      __m128i negate = _mm_and_si128(zigzagEncoded, _mm_set1_epi32(1));
+      negate = _mm_sub_epi32(_mm_setzero_si128(), negate);
+      __m128i diff = _mm_xor_si128(shiftRight, negate);
+
+      __m128i originalValues = _mm_add_epi32(diff, refValVec);
+      acc = _mm_add_epi64(acc, _mm_cvtepi32_epi64(originalValues));
+      acc = _mm_add_epi64(
+          acc, _mm_cvtepi32_epi64(_mm_srli_si128(originalValues, 8)));
+    }
+    sum = _mm_extract_epi64(acc, 0) + _mm_extract_epi64(acc, 1);
+
+    for (; i < length; ++i) {
+      int32_t encoded = compressed_data[i + 1];
+      int32_t delta = (encoded >> 1) ^ -(encoded & 1);
+      sum += static_cast<int32_t>(delta + referenceValue);
+    }
+    return true;
+  }
+
   std::size_t GetOverflowSize(size_t) const override { return 0; }
 
   StatefulIntegerCodec<int32_t>* CloneFresh() const override {
@@ -391,6 +576,8 @@ class FORCodecAVX2 : public StatefulIntegerCodec<int32_t> {
   std::vector<int32_t> compressed_data;
 
  public:
+  static constexpr bool kForwardsValues = true;
+
   FORCodecAVX2() {}
 
   void EncodeArray(const int32_t* in, const size_t length) override {
@@ -476,6 +663,49 @@ class FORCodecAVX2 : public StatefulIntegerCodec<int32_t> {
 
   std::string name() const override { return "custom_for_vecavx"; }
 
+  bool EncodedSumTerms(size_t length, int64_t& bias,
+                       int64_t& divisor) const override {
+    return ForEncodedSumTerms(compressed_data, length, bias, divisor);
+  }
+
+  // Runs the decode in registers and widens each vector into 64-bit lane sums
+  // instead of storing it.
+  bool FusedSum(size_t length, int64_t& sum) override {
+    sum = 0;
+    if (length == 0) return true;
+
+    int32_t referenceValue = compressed_data[0];
+    __m256i refValVec = _mm256_set1_epi32(referenceValue);
+    __m256i acc = _mm256_setzero_si256();
+
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+      __m256i zigzagEncoded = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(&compressed_data[i + 1]));
+
+      __m256i shiftRight = _mm256_srai_epi32(zigzagEncoded, 1);
+      __m256i negate = _mm256_and_si256(zigzagEncoded, _mm256_set1_epi32(1));
+      negate = _mm256_sub_epi32(_mm256_setzero_si256(), negate);
+      __m256i diff = _mm256_xor_si256(shiftRight, negate);
+
+      __m256i originalValues = _mm256_add_epi32(diff, refValVec);
+      __m128i lo = _mm256_castsi256_si128(originalValues);
+      __m128i hi = _mm256_extracti128_si256(originalValues, 1);
+      acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(lo));
+      acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(hi));
+    }
+    int64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    sum = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+    for (; i < length; ++i) {
+      int32_t encoded = compressed_data[i + 1];
+      int32_t delta = (encoded >> 1) ^ -(encoded & 1);
+      sum += static_cast<int32_t>(delta + referenceValue);
+    }
+    return true;
+  }
+
   std::size_t GetOverflowSize(size_t) const override { return 0; }
 
   StatefulIntegerCodec<int32_t>* CloneFresh() const override {
@@ -499,6 +729,8 @@ class FORCodecAVX512 : public StatefulIntegerCodec<int32_t> {
   std::vector<int32_t> compressed_data;
 
  public:
+  static constexpr bool kForwardsValues = true;
+
   FORCodecAVX512() {}
 
   void EncodeArray(const int32_t* in, const size_t length) override {
@@ -586,6 +818,47 @@ class FORCodecAVX512 : public StatefulIntegerCodec<int32_t> {
 
   std::string name() const override { return "custom_for_vecavx512"; }
 
+  bool EncodedSumTerms(size_t length, int64_t& bias,
+                       int64_t& divisor) const override {
+    return ForEncodedSumTerms(compressed_data, length, bias, divisor);
+  }
+
+  // Runs the decode in registers and widens each vector into 64-bit lane sums
+  // instead of storing it.
+  bool FusedSum(size_t length, int64_t& sum) override {
+    sum = 0;
+    if (length == 0) return true;
+
+    int32_t referenceValue = compressed_data[0];
+    __m512i refValVec = _mm512_set1_epi32(referenceValue);
+    __m512i acc = _mm512_setzero_si512();
+
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+      __m512i zigzagEncoded = _mm512_loadu_si512(
+          reinterpret_cast<const __m512i*>(&compressed_data[i + 1]));
+
+      __m512i shiftRight = _mm512_srai_epi32(zigzagEncoded, 1);
+      __m512i negate = _mm512_and_si512(zigzagEncoded, _mm512_set1_epi32(1));
+      negate = _mm512_sub_epi32(_mm512_setzero_si512(), negate);
+      __m512i diff = _mm512_xor_si512(shiftRight, negate);
+
+      __m512i originalValues = _mm512_add_epi32(diff, refValVec);
+      __m256i lo = _mm512_castsi512_si256(originalValues);
+      __m256i hi = _mm512_extracti64x4_epi64(originalValues, 1);
+      acc = _mm512_add_epi64(acc, _mm512_cvtepi32_epi64(lo));
+      acc = _mm512_add_epi64(acc, _mm512_cvtepi32_epi64(hi));
+    }
+    sum = _mm512_reduce_add_epi64(acc);
+
+    for (; i < length; ++i) {
+      int32_t encoded = compressed_data[i + 1];
+      int32_t delta = (encoded >> 1) ^ -(encoded & 1);
+      sum += static_cast<int32_t>(delta + referenceValue);
+    }
+    return true;
+  }
+
   std::size_t GetOverflowSize(size_t) const override { return 0; }
 
   StatefulIntegerCodec<int32_t>* CloneFresh() const override {
@@ -607,6 +880,8 @@ class RLECodecSSE42 : public StatefulIntegerCodec<int32_t> {
   std::vector<int32_t> compressed_data;
 
  public:
+  static constexpr bool kForwardsValues = true;
+
   RLECodecSSE42() {}
 
   void EncodeArray(const int32_t* in, const size_t length) override {
@@ -674,6 +949,15 @@ class RLECodecSSE42 : public StatefulIntegerCodec<int32_t> {
 
   std::string name() const override { return "custom_rle_vecsse"; }
 
+  // Sums value * run length over the runs.
+  bool FusedSum(size_t, int64_t& sum) override {
+    sum = 0;
+    for (size_t i = 0; i < compressed_data.size(); i += 2)
+      sum += int64_t{compressed_data[i]} *
+             static_cast<uint32_t>(compressed_data[i + 1]);
+    return true;
+  }
+
   std::size_t GetOverflowSize(size_t) const override { return 0; }
 
   StatefulIntegerCodec<int32_t>* CloneFresh() const override {
@@ -698,6 +982,8 @@ class RLECodecAVX2 : public StatefulIntegerCodec<int32_t> {
   std::vector<int32_t> compressed_data;
 
  public:
+  static constexpr bool kForwardsValues = true;
+
   RLECodecAVX2() {}
 
   void EncodeArray(const int32_t* in, const size_t length) override {
@@ -768,6 +1054,15 @@ class RLECodecAVX2 : public StatefulIntegerCodec<int32_t> {
 
   std::string name() const override { return "custom_rle_vecavx"; }
 
+  // Sums value * run length over the runs.
+  bool FusedSum(size_t, int64_t& sum) override {
+    sum = 0;
+    for (size_t i = 0; i < compressed_data.size(); i += 2)
+      sum += int64_t{compressed_data[i]} *
+             static_cast<uint32_t>(compressed_data[i + 1]);
+    return true;
+  }
+
   std::size_t GetOverflowSize(size_t) const override { return 0; }
 
   StatefulIntegerCodec<int32_t>* CloneFresh() const override {
@@ -791,6 +1086,8 @@ class RLECodecAVX512 : public StatefulIntegerCodec<int32_t> {
   std::vector<int32_t> compressed_data;
 
  public:
+  static constexpr bool kForwardsValues = true;
+
   RLECodecAVX512() {}
 
   void EncodeArray(const int32_t* in, const size_t length) override {
@@ -861,6 +1158,15 @@ class RLECodecAVX512 : public StatefulIntegerCodec<int32_t> {
 
   std::string name() const override { return "custom_rle_vecavx512"; }
 
+  // Sums value * run length over the runs.
+  bool FusedSum(size_t, int64_t& sum) override {
+    sum = 0;
+    for (size_t i = 0; i < compressed_data.size(); i += 2)
+      sum += int64_t{compressed_data[i]} *
+             static_cast<uint32_t>(compressed_data[i + 1]);
+    return true;
+  }
+
   std::size_t GetOverflowSize(size_t) const override { return 0; }
 
   StatefulIntegerCodec<int32_t>* CloneFresh() const override {
@@ -1,6 +1,9 @@
+#pragma once
+
 #include <zlib.h>
 
 #include <cstdint>
+#include <iostream>
 #include <stdexcept>
 #include <string>
 
@@ -14,26 +17,36 @@ class DeflateCodec : public StatefulIntegerCodec<int32_t> {
  public:
   std::vector<uint8_t> compressed;
 
-  void EncodeArray(const int32_t* in, const size_t length) override {
-    uLongf outputSize = compressBound(length * sizeof(int32_t));
-    if (compress2(compressed.data(), &outputSize,
-                  reinterpret_cast<const Bytef*>(in), length * sizeof(int32_t),
+  static constexpr bool kAcceptsBytes = true;
+
+  bool AcceptsBytes() const override { return kAcceptsBytes; }
+
+  void EncodeBytes(const uint8_t* in, size_t size) override {
+    uLongf outputSize = compressBound(size);
+    compressed.resize(outputSize);
+    if (compress2(compressed.data(), &outputSize, in, size,
                   Z_BEST_COMPRESSION) != Z_OK)
       throw std::runtime_error("DEFLATE compression failed");
     compressed.resize(outputSize);
   }
 
-  void DecodeArray(int32_t* out, const std::size_t length) override {
-    uLongf outputSize = length;
-    uLongf compressedSize = length * sizeof(int32_t);
+  void EncodeArray(const int32_t* in, const size_t length) override {
+    EncodeBytes(reinterpret_cast<const uint8_t*>(in), length * sizeof(int32_t));
+  }
 
-    if (uncompress(reinterpret_cast<Bytef*>(out), &compressedSize,
-                   compressed.data(), compressed.size()) != Z_OK) {
+  void DecodeBytes(uint8_t* out, size_t size) override {
+    uLongf outputSize = size;
+    if (uncompress(out, &outputSize, compressed.data(), compressed.size()) !=
+        Z_OK) {
       std::cerr << "DEFLATE decompression failed." << std::endl;
       return;
     }
   }
 
+  void DecodeArray(int32_t* out, const std::size_t length) override {
+    DecodeBytes(reinterpret_cast<uint8_t*>(out), length * sizeof(int32_t));
+  }
+
   std::size_t EncodedNumValues() override { return compressed.size(); }
 
   std::size_t EncodedSizeValue() override { return sizeof(uint8_t); }
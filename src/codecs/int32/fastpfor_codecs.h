@@ -1,10 +1,14 @@
 #pragma once
 
+#include <algorithm>
+#include <cassert>
 #include <cstdint>
 #include <cstring>
 #include <iostream>
 #include <memory>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 #include "FastPFor/headers/codecfactory.h"
 #include "FastPFor/headers/codecs.h"
@@ -12,20 +16,71 @@
 
 using namespace FastPForLib;
 
+// Decodes one independently-encoded segment per `segmentLength` values.
+class FastPForSegmentCursor : public DecodeCursor<int32_t> {
+ private:
+  IntegerCODEC& codec;
+  const std::vector<uint32_t>& compressed;
+  const std::vector<size_t>& segmentEnds;
+  size_t segmentLength;
+  size_t length;
+  size_t segment = 0;
+
+ public:
+  FastPForSegmentCursor(IntegerCODEC& codec,
+                        const std::vector<uint32_t>& compressed,
+                        const std::vector<size_t>& segmentEnds,
+                        size_t segmentLength, size_t length)
+      : codec{codec},
+        compressed{compressed},
+        segmentEnds{segmentEnds},
+        segmentLength{segmentLength},
+        length{length} {}
+
+  size_t Next(int32_t* out, size_t k) override {
+    size_t written = 0;
+    while (segment < segmentEnds.size()) {
+      size_t n = std::min(segmentLength, length - segment * segmentLength);
+      if (written + n > k) break;
+      size_t begin = segment ? segmentEnds[segment - 1] : 0;
+      size_t recovered_size = n;
+      codec.decodeArray(compressed.data() + begin, segmentEnds[segment] - begin,
+                        reinterpret_cast<uint32_t*>(out + written),
+                        recovered_size);
+      written += n;
+      ++segment;
+    }
+    if (written == 0 && segment < segmentEnds.size())
+      throw std::invalid_argument("FastPFor cursor chunk below segment length");
+    return written;
+  }
+
+  size_t Granularity() const override { return segmentLength; }
+};
+
 class FastPForCodec : public StatefulIntegerCodec<int32_t> {
  private:
   std::shared_ptr<IntegerCODEC> codec;
+  // When non-zero, the block is encoded as independent segments of this many
+  // values so it can be decoded incrementally (see NewDecodeCursor).
+  size_t segmentLength;
+  std::vector<size_t> segmentEnds;  // end offset of each segment in compressed
 
  public:
   std::vector<uint32_t> compressed;
 
-  FastPForCodec(std::shared_ptr<IntegerCODEC> in_codec)
-      : codec{std::move(in_codec)} {}
+  FastPForCodec(std::shared_ptr<IntegerCODEC> in_codec,
+                size_t segmentLength = 0)
+      : codec{std::move(in_codec)}, segmentLength{segmentLength} {}
 
   FastPForCodec(CODECFactory& codec_factory, std::string codec_name)
       : FastPForCodec(codec_factory.getFromName(codec_name)) {}
 
   void EncodeArray(const int32_t* in, const size_t length) override {
+    if (segmentLength > 0) {
+      EncodeSegments(in, length);
+      return;
+    }
     size_t compressed_size = compressed.size();
     codec->encodeArray(reinterpret_cast<const uint32_t*>(in), length,
                        compressed.data(), compressed_size);
@@ -35,6 +90,12 @@ class FastPForCodec : public StatefulIntegerCodec<int32_t> {
   }
 
   void DecodeArray(int32_t* out, const std::size_t length) override {
+    if (segmentLength > 0) {
+      FastPForSegmentCursor(*codec, compressed, segmentEnds, segmentLength,
+                            length)
+          .Next(out, length);
+      return;
+    }
     size_t recovered_size = length;
     codec->decodeArray(compressed.data(), compressed.size(),
                        reinterpret_cast<uint32_t*>(out), recovered_size);
@@ -47,7 +108,12 @@ class FastPForCodec : public StatefulIntegerCodec<int32_t> {
 
   virtual ~FastPForCodec() {}
 
-  std::string name() const override { return "FastPFor_" + codec->name(); }
+  std::string name() const override {
+    if (segmentLength > 0)
+      return "FastPFor_" + codec->name() + "_seg" +
+             std::to_string(segmentLength);
+    return "FastPFor_" + codec->name();
+  }
 
   std::size_t GetOverflowSize(size_t) const override {
     return 32;  // Resources fail to be freed without `8`. `32` is required for
@@ -55,13 +121,15 @@ class FastPForCodec : public StatefulIntegerCodec<int32_t> {
   }
 
   StatefulIntegerCodec<int32_t>* CloneFresh() const override {
-    return new FastPForCodec(codec);
+    return new FastPForCodec(codec, segmentLength);
   }
 
   void AllocEncoded(const int32_t* in, size_t length) override {
-    compressed.resize(
-        length *
-        2);  // Emirically found that this works. NOTE: reserve doesn't work.
+    size_t segments =
+        segmentLength > 0 ? (length + segmentLength - 1) / segmentLength : 1;
+    // Emirically found that this works. NOTE: reserve doesn't work. Each
+    // extra segment carries its own headers.
+    compressed.resize(length * 2 + 64 * (segments - 1));
   };
 
   void clear() override {
@@ -72,4 +140,28 @@ class FastPForCodec : public StatefulIntegerCodec<int32_t> {
   std::vector<int32_t>& GetEncoded() override {
     return reinterpret_cast<std::vector<int32_t>&>(compressed);
   };
+
+  std::unique_ptr<DecodeCursor<int32_t>> NewDecodeCursor(
+      size_t length) override {
+    if (segmentLength == 0)
+      return StatefulIntegerCodec<int32_t>::NewDecodeCursor(length);
+    return std::make_unique<FastPForSegmentCursor>(
+        *codec, compressed, segmentEnds, segmentLength, length);
+  }
+
+ private:
+  void EncodeSegments(const int32_t* in, const size_t length) {
+    segmentEnds.clear();
+    size_t offset = 0;
+    for (size_t s = 0; s < length; s += segmentLength) {
+      size_t n = std::min(segmentLength, length - s);
+      size_t compressed_size = compressed.size() - offset;
+      codec->encodeArray(reinterpret_cast<const uint32_t*>(in + s), n,
+                         compressed.data() + offset, compressed_size);
+      offset += compressed_size;
+      segmentEnds.push_back(offset);
+    }
+    compressed.resize(offset);
+    compressed.shrink_to_fit();
+  }
 };
\ No newline at end of file
@@ -57,6 +57,8 @@ class FastPForFusedCodec : public StatefulIntegerCodec<int32_t> {
                 // Simple16.
   }
 
+  bool WritesOverflowSum() const override { return true; }
+
   StatefulIntegerCodec<int32_t>* CloneFresh() const override {
     return new FastPForFusedCodec(codec);
   }
@@ -1,9 +1,13 @@
+#pragma once
+
 #include <lz4.h>
+#include <lz4hc.h>
 
 #include <cassert>
 #include <cstdint>
 #include <iostream>
 #include <string>
+#include <vector>
 
 #include "generic_codecs.h"
 
@@ -11,15 +15,50 @@
 #pragma clang diagnostic ignored "-Wreturn-local-addr"
 #endif
 
+// Per-thread LZ4 compression states (fast and HC), reused across blocks
+// instead of being set up on the stack (fast) or heap (HC) on every call.
+inline void* ThreadLZ4State() {
+  thread_local std::vector<uint64_t> state(
+      (LZ4_sizeofState() + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+  return state.data();
+}
+
+inline void* ThreadLZ4HCState() {
+  thread_local std::vector<uint64_t> state(
+      (LZ4_sizeofStateHC() + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+  return state.data();
+}
+
+// LZ4, or LZ4 HC when `hcLevel` is set (LZ4HC_CLEVEL_MIN..MAX). Both decode
+// with the same fast decoder. `acceleration` > 1 trades ratio for encode
+// speed in the fast mode.
 class LZ4Codec : public StatefulIntegerCodec<int32_t> {
  public:
+  int acceleration;
+  int hcLevel;
   std::vector<char> compressed;
 
-  void EncodeArray(const int32_t* in, const size_t length) override {
-    int maxOutputSize = LZ4_compressBound(length * sizeof(int32_t));
-    int compressedDataSize = LZ4_compress_default(
-        reinterpret_cast<const char*>(in), compressed.data(),
-        length * sizeof(int32_t), maxOutputSize);
+  LZ4Codec(int acceleration = 1, int hcLevel = 0)
+      : acceleration{acceleration}, hcLevel{hcLevel} {
+    if (acceleration < 1)
+      throw std::invalid_argument("LZ4 acceleration must be at least 1");
+  }
+
+  static constexpr bool kAcceptsBytes = true;
+
+  bool AcceptsBytes() const override { return kAcceptsBytes; }
+
+  void EncodeBytes(const uint8_t* in, size_t size) override {
+    int maxOutputSize = LZ4_compressBound(size);
+    compressed.resize(maxOutputSize);
+    const char* src = reinterpret_cast<const char*>(in);
+    int compressedDataSize =
+        hcLevel ? LZ4_compress_HC_extStateHC(ThreadLZ4HCState(), src,
+                                             compressed.data(), size,
+                                             maxOutputSize, hcLevel)
+                : LZ4_compress_fast_extState(ThreadLZ4State(), src,
+                                             compressed.data(), size,
+                                             maxOutputSize, acceleration);
     if (compressedDataSize <= 0) {
       throw std::runtime_error("LZ4 compression failed.");
       return;
@@ -27,15 +66,24 @@ class LZ4Codec : public StatefulIntegerCodec<int32_t> {
     compressed.resize(compressedDataSize);
   }
 
-  void DecodeArray(int32_t* out, const std::size_t length) override {
+  void EncodeArray(const int32_t* in, const size_t length) override {
+    EncodeBytes(reinterpret_cast<const uint8_t*>(in), length * sizeof(int32_t));
+  }
+
+  void DecodeBytes(uint8_t* out, size_t size) override {
     int decompressedSize =
         LZ4_decompress_safe(compressed.data(), reinterpret_cast<char*>(out),
-                            compressed.size(), length * sizeof(int32_t));
+                            compressed.size(), size);
     if (decompressedSize < 0) {
-      throw std::runtime_error("LZ4 decompression failed." + decompressedSize);
+      throw std::runtime_error("LZ4 decompression failed: " +
+                               std::to_string(decompressedSize));
       return;
     }
-    assert(decompressedSize == (length * sizeof(int32_t)));
+    assert(static_cast<size_t>(decompressedSize) == size);
+  }
+
+  void DecodeArray(int32_t* out, const std::size_t length) override {
+    DecodeBytes(reinterpret_cast<uint8_t*>(out), length * sizeof(int32_t));
   }
 
   std::size_t EncodedNumValues() override { return compressed.size(); }
@@ -44,12 +92,15 @@ class LZ4Codec : public StatefulIntegerCodec<int32_t> {
 
   virtual ~LZ4Codec() {}
 
-  std::string name() const override { return "LZ4"; }
+  std::string name() const override {
+    if (hcLevel) return "LZ4HC_" + std::to_string(hcLevel);
+    return acceleration == 1 ? "LZ4" : "LZ4_a" + std::to_string(acceleration);
+  }
 
   std::size_t GetOverflowSize(size_t) const override { return 0; }
 
   StatefulIntegerCodec<int32_t>* CloneFresh() const override {
-    return new LZ4Codec();
+    return new LZ4Codec(acceleration, hcLevel);
   }
 
   void AllocEncoded(const int32_t* in, size_t length) override {
@@ -1,3 +1,5 @@
+#pragma once
+
 #include <lzma.h>
 
 #include <cassert>
@@ -15,7 +17,11 @@ class LZMACodec : public StatefulIntegerCodec<int32_t> {
  public:
   std::vector<uint8_t> compressed;
 
-  void EncodeArray(const int32_t* in, const size_t length) override {
+  static constexpr bool kAcceptsBytes = true;
+
+  bool AcceptsBytes() const override { return kAcceptsBytes; }
+
+  void EncodeBytes(const uint8_t* in, size_t size) override {
     lzma_stream strm = LZMA_STREAM_INIT;
     if (lzma_easy_encoder(&strm, LZMA_PRESET_DEFAULT, LZMA_CHECK_CRC64) !=
         LZMA_OK) {
@@ -23,8 +29,8 @@ class LZMACodec : public StatefulIntegerCodec<int32_t> {
       return;
     }
 
-    strm.next_in = reinterpret_cast<const uint8_t*>(in);
-    strm.avail_in = length * sizeof(int32_t);
+    strm.next_in = in;
+    strm.avail_in = size;
     size_t outputSize = strm.avail_in + strm.avail_in / 3 + 128;
     compressed.resize(outputSize);
     strm.next_out = compressed.data();
@@ -39,7 +45,11 @@ class LZMACodec : public StatefulIntegerCodec<int32_t> {
     lzma_end(&strm);
   }
 
-  void DecodeArray(int32_t* out, const std::size_t length) override {
+  void EncodeArray(const int32_t* in, const size_t length) override {
+    EncodeBytes(reinterpret_cast<const uint8_t*>(in), length * sizeof(int32_t));
+  }
+
+  void DecodeBytes(uint8_t* out, size_t size) override {
     lzma_stream strm = LZMA_STREAM_INIT;
     if (lzma_stream_decoder(&strm, UINT64_MAX, 0) != LZMA_OK) {
       throw std::runtime_error("LZMA decompressor initialization failed.");
@@ -49,8 +59,8 @@ class LZMACodec : public StatefulIntegerCodec<int32_t> {
     strm.next_in = compressed.data();
     strm.avail_in = compressed.size();
 
-    strm.next_out = reinterpret_cast<uint8_t*>(out);
-    strm.avail_out = length * sizeof(int32_t);
+    strm.next_out = out;
+    strm.avail_out = size;
 
     if (lzma_code(&strm, LZMA_FINISH) != LZMA_STREAM_END) {
       throw std::runtime_error(
@@ -60,6 +70,10 @@ class LZMACodec : public StatefulIntegerCodec<int32_t> {
     lzma_end(&strm);
   }
 
+  void DecodeArray(int32_t* out, const std::size_t length) override {
+    DecodeBytes(reinterpret_cast<uint8_t*>(out), length * sizeof(int32_t));
+  }
+
   std::size_t EncodedNumValues() override { return compressed.size(); }
 
   std::size_t EncodedSizeValue() override { return sizeof(uint8_t); }
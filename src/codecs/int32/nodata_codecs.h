@@ -0,0 +1,345 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "bitmap_codecs.h"
+#include "composite_codec.h"
+#include "constant_codecs.h"
+#include "generic_codecs.h"
+#include "transformations_simd.h"
+
+/////////////////////////////////////////////////////////////////////////
+// nodata-aware encoding: a block's nodata pixels are described by a    //
+// validity bitmap (bit i set = pixel i is valid) held in a bitmap      //
+// codec, and the value codec never sees the nodata value itself, which //
+// would otherwise be a huge outlier for bit widths and deltas.         //
+//   Split: only the valid values, packed densely.                      //
+//   Fill:  every position, nodata replaced by the previous valid value //
+//          (so deltas are 0), keeping positions for random access.     //
+/////////////////////////////////////////////////////////////////////////
+
+enum class NoDataMode { None, Split, Fill };
+
+inline NoDataMode ParseNoDataMode(const std::string &s) {
+  if (s == "none") return NoDataMode::None;
+  if (s == "split") return NoDataMode::Split;
+  if (s == "fill") return NoDataMode::Fill;
+  throw std::invalid_argument("Unknown nodata mode: " + s);
+}
+
+inline std::string ToString(NoDataMode m) {
+  switch (m) {
+    case NoDataMode::None:
+      return "none";
+    case NoDataMode::Split:
+      return "split";
+    case NoDataMode::Fill:
+      return "fill";
+  }
+  return "unknown";
+}
+
+// A raster's nodata value and how blocks holding it are encoded. With mode
+// None blocks are encoded as they are, but reductions still skip nodata.
+struct NoDataSpec {
+  bool present = false;
+  int32_t value = 0;
+  NoDataMode mode = NoDataMode::None;
+};
+
+// Sets bit i of the ceil(length / 64) words iff in[i] != noData; returns the
+// number of set bits.
+inline size_t ValidityWords(const int32_t *in, size_t length, int32_t noData,
+                            uint64_t *words) {
+  std::fill(words, words + (length + 63) / 64, 0);
+  const __m128i nd = _mm_set1_epi32(noData);
+  size_t i = 0;
+  for (; i + 16 <= length; i += 16) {
+    const __m128i *v = reinterpret_cast<const __m128i *>(in + i);
+    __m128i eq[4];
+    for (int q = 0; q < 4; ++q)
+      eq[q] = _mm_cmpeq_epi32(_mm_loadu_si128(v + q), nd);
+    __m128i bytes = _mm_packs_epi16(_mm_packs_epi32(eq[0], eq[1]),
+                                    _mm_packs_epi32(eq[2], eq[3]));
+    uint64_t bits = static_cast<uint16_t>(~_mm_movemask_epi8(bytes));
+    words[i / 64] |= bits << (i % 64);
+  }
+  for (; i < length; ++i)
+    words[i / 64] |= static_cast<uint64_t>(in[i] != noData) << (i % 64);
+  return WordsPopcount(words, (length + 63) / 64);
+}
+
+// out[i] = next dense value if bit i is set, else noData; returns the number
+// of dense values consumed. All-valid and all-nodata words (the common case
+// in coastal tiles) are a copy and a fill.
+inline size_t ExpandValidScalar(const uint64_t *words, size_t length,
+                                const int32_t *dense, int32_t noData,
+                                int32_t *out) {
+  size_t j = 0;
+  for (size_t i = 0; i < length; ++i) {
+    bool valid = (words[i / 64] >> (i % 64)) & 1;
+    out[i] = valid ? dense[j] : noData;
+    j += valid;
+  }
+  return j;
+}
+
+inline size_t ExpandValidSSE41(const uint64_t *words, size_t length,
+                               const int32_t *dense, int32_t noData,
+                               int32_t *out) {
+  size_t j = 0, i = 0;
+  for (; i + 64 <= length; i += 64) {
+    uint64_t w = words[i / 64];
+    if (w == ~uint64_t{0}) {
+      std::copy_n(dense + j, 64, out + i);
+      j += 64;
+    } else if (w == 0) {
+      FillConstant(out + i, 64, noData);
+    } else {
+      j += ExpandValidScalar(&w, 64, dense + j, noData, out + i);
+    }
+  }
+  uint64_t tail = i < length ? words[i / 64] : 0;
+  return j + ExpandValidScalar(&tail, length - i, dense + j, noData, out + i);
+}
+
+TRANSFORM_TARGET_AVX512
+inline size_t ExpandValidAVX512(const uint64_t *words, size_t length,
+                                const int32_t *dense, int32_t noData,
+                                int32_t *out) {
+  const __m512i nd = _mm512_set1_epi32(noData);
+  size_t j = 0, i = 0;
+  for (; i + 64 <= length; i += 64) {
+    uint64_t w = words[i / 64];
+    for (int q = 0; q < 4; ++q) {
+      __mmask16 m = static_cast<__mmask16>(w >> (16 * q));
+      _mm512_storeu_si512(out + i + 16 * q,
+                          _mm512_mask_expandloadu_epi32(nd, m, dense + j));
+      j += __builtin_popcount(m);
+    }
+  }
+  uint64_t tail = i < length ? words[i / 64] : 0;
+  return j + ExpandValidScalar(&tail, length - i, dense + j, noData, out + i);
+}
+
+inline size_t ExpandValid(const uint64_t *words, size_t length,
+                          const int32_t *dense, int32_t noData, int32_t *out) {
+  switch (TransformationSimdLevel()) {
+    case SimdLevel::Scalar:
+      return ExpandValidScalar(words, length, dense, noData, out);
+    case SimdLevel::SSE41:
+    case SimdLevel::AVX2:
+      return ExpandValidSSE41(words, length, dense, noData, out);
+    default:
+      return ExpandValidAVX512(words, length, dense, noData, out);
+  }
+}
+
+// out[i] = noData wherever bit i is clear (Fill mode's decode).
+inline void MaskInvalid(const uint64_t *words, size_t length, int32_t noData,
+                        int32_t *out) {
+  for (size_t i = 0; i < length; i += 64) {
+    uint64_t w = words[i / 64];
+    size_t n = std::min<size_t>(64, length - i);
+    if (w == ~uint64_t{0}) continue;
+    if (w == 0) {
+      FillConstant(out + i, n, noData);
+      continue;
+    }
+    for (w = ~w; w; w &= w - 1) {
+      size_t k = __builtin_ctzll(w);
+      if (k < n) out[i + k] = noData;
+    }
+  }
+}
+
+// Wraps a value codec (and a bitmap codec for the validity) so blocks
+// containing `noData` are encoded per `mode` (Split or Fill). Blocks without
+// nodata store no bitmap and go straight to the value codec; blocks of only
+// nodata store nothing.
+class NoDataCodec : public StatefulIntegerCodec<int32_t> {
+ private:
+  NoDataMode mode;
+  int32_t noData;
+  std::unique_ptr<StatefulIntegerCodec<int32_t>> values;
+  std::unique_ptr<BitmapCodec> validity;
+  size_t numValid = 0;
+  bool allValid = true;
+
+  // Decodes the values codec's `count` values into a pooled buffer.
+  template <typename F>
+  void WithDense(size_t count, F &&f) {
+    std::vector<int32_t> dense;
+    IntermediateBuffers<int32_t>::Lend(
+        dense, count + values->GetOverflowSize(count));
+    values->DecodeArray(dense.data(), count);
+    f(dense.data());
+    IntermediateBuffers<int32_t>::Reclaim(dense);
+  }
+
+ public:
+  NoDataCodec(NoDataMode mode, int32_t noData,
+              std::unique_ptr<StatefulIntegerCodec<int32_t>> values,
+              std::unique_ptr<BitmapCodec> validity =
+                  std::make_unique<EWAHCodec>())
+      : mode{mode},
+        noData{noData},
+        values{std::move(values)},
+        validity{std::move(validity)} {
+    if (mode == NoDataMode::None)
+      throw std::invalid_argument("NoDataCodec needs mode split or fill");
+  }
+
+  size_t NumValid() const { return numValid; }
+
+  int32_t NoDataValue() const { return noData; }
+
+  bool AllValid() const { return allValid; }
+
+  void AllocEncoded(const int32_t *, size_t) override {}
+
+  void EncodeArray(const int32_t *in, const size_t length) override {
+    std::vector<uint64_t> words((length + 63) / 64);
+    numValid = ValidityWords(in, length, noData, words.data());
+    allValid = numValid == length;
+    validity->clear();
+    values->clear();
+    if (allValid) {
+      values->AllocEncoded(in, length);
+      values->EncodeArray(in, length);
+      return;
+    }
+    // All nodata: nothing but the count.
+    if (numValid == 0) return;
+    validity->FromWords(words.data(), length);
+
+    std::vector<int32_t> buf;
+    IntermediateBuffers<int32_t>::Lend(buf, 0);
+    if (mode == NoDataMode::Split) {
+      buf.reserve(numValid);
+      for (size_t i = 0; i < length; ++i)
+        if (in[i] != noData) buf.push_back(in[i]);
+    } else {
+      // Leading nodata takes the first valid value.
+      int32_t fill = *std::find_if(
+          in, in + length, [this](int32_t v) { return v != noData; });
+      buf.resize(length);
+      for (size_t i = 0; i < length; ++i)
+        buf[i] = in[i] != noData ? (fill = in[i]) : fill;
+    }
+    values->AllocEncoded(buf.data(), buf.size());
+    values->EncodeArray(buf.data(), buf.size());
+    IntermediateBuffers<int32_t>::Reclaim(buf);
+  }
+
+  void DecodeArray(int32_t *out, const size_t length) override {
+    if (allValid) return values->DecodeArray(out, length);
+    if (numValid == 0) return FillConstant(out, length, noData);
+    std::vector<uint64_t> words((length + 63) / 64);
+    validity->ToWords(words.data());
+    if (mode == NoDataMode::Fill) {
+      values->DecodeArray(out, length);
+      MaskInvalid(words.data(), length, noData, out);
+      return;
+    }
+    WithDense(numValid, [&](const int32_t *dense) {
+      ExpandValid(words.data(), length, dense, noData, out);
+    });
+  }
+
+  // Exact sum of the decoded block, nodata included (see ValidSum for the
+  // sum reductions want). Split blocks add the nodata pixels to the dense
+  // values' sum; filled positions are unknown to the value codec's sum, so
+  // Fill only fuses all-valid blocks.
+  bool FusedSum(size_t length, int64_t &sum) override {
+    if (allValid) return values->FusedSum(length, sum);
+    if (mode == NoDataMode::Fill && numValid) return false;
+    int64_t dense = 0;
+    if (numValid && !values->FusedSum(numValid, dense)) return false;
+    sum = dense + int64_t{noData} * static_cast<int64_t>(length - numValid);
+    return true;
+  }
+
+  // Sum of the valid pixels only. Split and all-valid blocks use the value
+  // codec's fused sum where it has one. Otherwise `decoded`, this codec's
+  // DecodeArray output if the caller has it, is summed skipping the nodata
+  // value (no valid pixel holds it); without it the values are decoded and
+  // masked with the validity bitmap.
+  int64_t ValidSum(size_t length, const int32_t *decoded = nullptr) {
+    if (numValid == 0) return 0;
+    int64_t sum = 0;
+    size_t count = allValid ? length : numValid;
+    bool dense = allValid || mode == NoDataMode::Split;
+    if (dense && values->FusedSum(count, sum)) return sum;
+    sum = 0;
+    if (decoded) {
+      for (size_t i = 0; i < length; ++i)
+        if (decoded[i] != noData) sum += decoded[i];
+      return sum;
+    }
+    if (dense) {
+      WithDense(count, [&](const int32_t *v) {
+        for (size_t i = 0; i < count; ++i) sum += v[i];
+      });
+      return sum;
+    }
+    std::vector<uint64_t> words((length + 63) / 64);
+    validity->ToWords(words.data());
+    WithDense(length, [&](const int32_t *filled) {
+      for (size_t i = 0; i < length; ++i)
+        if ((words[i / 64] >> (i % 64)) & 1) sum += filled[i];
+    });
+    return sum;
+  }
+
+  // The validity is exact, so only the values can carry error.
+  double MaxAbsError() const override { return values->MaxAbsError(); }
+
+  std::size_t EncodedNumValues() override {
+    std::size_t bytes = values->EncodedNumValues() * values->EncodedSizeValue();
+    if (!allValid)
+      bytes += validity->EncodedNumValues() * validity->EncodedSizeValue();
+    return bytes;
+  }
+
+  std::size_t EncodedSizeValue() override { return sizeof(uint8_t); }
+
+  virtual ~NoDataCodec() {}
+
+  std::string name() const override {
+    return "[nodata_" + ToString(mode) + "]_" + values->name();
+  }
+
+  // Split decodes the value codec into a pooled buffer; Fill decodes it in
+  // place.
+  std::size_t GetOverflowSize(size_t length) const override {
+    return values->GetOverflowSize(length);
+  }
+
+  StatefulIntegerCodec<int32_t> *CloneFresh() const override {
+    return new NoDataCodec(
+        mode, noData,
+        std::unique_ptr<StatefulIntegerCodec<int32_t>>(values->CloneFresh()),
+        std::unique_ptr<BitmapCodec>(
+            static_cast<BitmapCodec *>(validity->CloneFresh())));
+  }
+
+  void clear() override {
+    values->clear();
+    validity->clear();
+    numValid = 0;
+    allValid = true;
+  }
+
+  std::vector<int32_t> &GetEncoded() override {
+    throw std::runtime_error(
+        "Encoded format does not match input. Cannot forward.");
+  }
+};
@@ -0,0 +1,359 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "composite_codec.h"
+#include "generic_codecs.h"
+#include "transformations_simd.h"
+
+//////////////////////////////////////////////////////////////////////////
+// Blosc-style shuffles: byte stages that regroup a block's int32 bytes  //
+// so the byte-oriented codecs (Zstd, LZ4, DEFLATE, LZMA) see long runs  //
+// of the mostly-zero high bytes (byte shuffle) or bit planes (bit       //
+// shuffle) instead of them interleaved with noisy low bytes. Used as    //
+// the first stage of a ByteCompositeCodec; the output is 4 * n bytes.   //
+// Kernels follow TransformationSimdLevel(); AVX-512 runs the AVX2 ones. //
+//////////////////////////////////////////////////////////////////////////
+
+// Byte shuffle: out[b * n + i] = byte b of in[i] (byte planes of n bytes).
+
+inline void ByteShuffleScalar(const int32_t *in, size_t begin, size_t n,
+                              uint8_t *out) {
+  auto *bytes = reinterpret_cast<const uint8_t *>(in);
+  for (size_t i = begin; i < n; ++i)
+    for (size_t b = 0; b < sizeof(int32_t); ++b)
+      out[b * n + i] = bytes[i * sizeof(int32_t) + b];
+}
+
+inline void ByteUnshuffleScalar(const uint8_t *in, size_t begin, size_t n,
+                                int32_t *out) {
+  auto *bytes = reinterpret_cast<uint8_t *>(out);
+  for (size_t i = begin; i < n; ++i)
+    for (size_t b = 0; b < sizeof(int32_t); ++b)
+      bytes[i * sizeof(int32_t) + b] = in[b * n + i];
+}
+
+// Gathers byte b of each of 4 ints into dword b; its own inverse.
+inline __m128i ShuffleGatherMask() {
+  return _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+}
+
+// 4x4 dword transpose of a0..a3 in place; its own inverse.
+inline void Transpose4x4Epi32(__m128i &a0, __m128i &a1, __m128i &a2,
+                              __m128i &a3) {
+  __m128i t0 = _mm_unpacklo_epi32(a0, a1), t1 = _mm_unpackhi_epi32(a0, a1);
+  __m128i t2 = _mm_unpacklo_epi32(a2, a3), t3 = _mm_unpackhi_epi32(a2, a3);
+  a0 = _mm_unpacklo_epi64(t0, t2);
+  a1 = _mm_unpackhi_epi64(t0, t2);
+  a2 = _mm_unpacklo_epi64(t1, t3);
+  a3 = _mm_unpackhi_epi64(t1, t3);
+}
+
+inline void ByteShuffleSSE41(const int32_t *in, size_t n, uint8_t *out) {
+  const __m128i gather = ShuffleGatherMask();
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    auto *v = reinterpret_cast<const __m128i *>(in + i);
+    __m128i a0 = _mm_shuffle_epi8(_mm_loadu_si128(v), gather);
+    __m128i a1 = _mm_shuffle_epi8(_mm_loadu_si128(v + 1), gather);
+    __m128i a2 = _mm_shuffle_epi8(_mm_loadu_si128(v + 2), gather);
+    __m128i a3 = _mm_shuffle_epi8(_mm_loadu_si128(v + 3), gather);
+    Transpose4x4Epi32(a0, a1, a2, a3);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), a0);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + n + i), a1);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 2 * n + i), a2);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + 3 * n + i), a3);
+  }
+  ByteShuffleScalar(in, i, n, out);
+}
+
+inline void ByteUnshuffleSSE41(const uint8_t *in, size_t n, int32_t *out) {
+  const __m128i gather = ShuffleGatherMask();
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+    __m128i a1 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + n + i));
+    __m128i a2 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + 2 * n + i));
+    __m128i a3 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + 3 * n + i));
+    Transpose4x4Epi32(a0, a1, a2, a3);
+    auto *o = reinterpret_cast<__m128i *>(out + i);
+    _mm_storeu_si128(o, _mm_shuffle_epi8(a0, gather));
+    _mm_storeu_si128(o + 1, _mm_shuffle_epi8(a1, gather));
+    _mm_storeu_si128(o + 2, _mm_shuffle_epi8(a2, gather));
+    _mm_storeu_si128(o + 3, _mm_shuffle_epi8(a3, gather));
+  }
+  ByteUnshuffleScalar(in, i, n, out);
+}
+
+// 32 ints per step: in-lane gather, then a dword permute puts each plane's
+// 8 bytes in one qword, and a 4x4 qword transpose forms the planes.
+TRANSFORM_TARGET_AVX2
+inline void ByteShuffleAVX2(const int32_t *in, size_t n, uint8_t *out) {
+  const __m256i gather = _mm256_broadcastsi128_si256(ShuffleGatherMask());
+  const __m256i interleave = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    auto *v = reinterpret_cast<const __m256i *>(in + i);
+    __m256i r[4];
+    for (int k = 0; k < 4; ++k)
+      r[k] = _mm256_permutevar8x32_epi32(
+          _mm256_shuffle_epi8(_mm256_loadu_si256(v + k), gather), interleave);
+    __m256i lo01 = _mm256_unpacklo_epi64(r[0], r[1]);
+    __m256i hi01 = _mm256_unpackhi_epi64(r[0], r[1]);
+    __m256i lo23 = _mm256_unpacklo_epi64(r[2], r[3]);
+    __m256i hi23 = _mm256_unpackhi_epi64(r[2], r[3]);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i),
+                        _mm256_permute2x128_si256(lo01, lo23, 0x20));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + n + i),
+                        _mm256_permute2x128_si256(hi01, hi23, 0x20));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + 2 * n + i),
+                        _mm256_permute2x128_si256(lo01, lo23, 0x31));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + 3 * n + i),
+                        _mm256_permute2x128_si256(hi01, hi23, 0x31));
+  }
+  ByteShuffleScalar(in, i, n, out);
+}
+
+TRANSFORM_TARGET_AVX2
+inline void ByteUnshuffleAVX2(const uint8_t *in, size_t n, int32_t *out) {
+  const __m256i gather = _mm256_broadcastsi128_si256(ShuffleGatherMask());
+  const __m256i deinterleave = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    __m256i p[4];
+    for (int b = 0; b < 4; ++b)
+      p[b] = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i *>(in + b * n + i));
+    __m256i lo01 = _mm256_permute2x128_si256(p[0], p[2], 0x20);
+    __m256i lo23 = _mm256_permute2x128_si256(p[0], p[2], 0x31);
+    __m256i hi01 = _mm256_permute2x128_si256(p[1], p[3], 0x20);
+    __m256i hi23 = _mm256_permute2x128_si256(p[1], p[3], 0x31);
+    __m256i r[4] = {_mm256_unpacklo_epi64(lo01, hi01),
+                    _mm256_unpackhi_epi64(lo01, hi01),
+                    _mm256_unpacklo_epi64(lo23, hi23),
+                    _mm256_unpackhi_epi64(lo23, hi23)};
+    auto *o = reinterpret_cast<__m256i *>(out + i);
+    for (int k = 0; k < 4; ++k)
+      _mm256_storeu_si256(
+          o + k, _mm256_shuffle_epi8(
+                     _mm256_permutevar8x32_epi32(r[k], deinterleave), gather));
+  }
+  ByteUnshuffleScalar(in, i, n, out);
+}
+
+inline void ByteShuffle(const int32_t *in, size_t n, uint8_t *out) {
+  switch (TransformationSimdLevel()) {
+    case SimdLevel::Scalar:
+      return ByteShuffleScalar(in, 0, n, out);
+    case SimdLevel::SSE41:
+      return ByteShuffleSSE41(in, n, out);
+    default:
+      return ByteShuffleAVX2(in, n, out);
+  }
+}
+
+inline void ByteUnshuffle(const uint8_t *in, size_t n, int32_t *out) {
+  switch (TransformationSimdLevel()) {
+    case SimdLevel::Scalar:
+      return ByteUnshuffleScalar(in, 0, n, out);
+    case SimdLevel::SSE41:
+      return ByteUnshuffleSSE41(in, n, out);
+    default:
+      return ByteUnshuffleAVX2(in, n, out);
+  }
+}
+
+// Bit shuffle: the byte planes, each transposed into 8 bit planes. With
+// m = n rounded down to a multiple of 8, bit plane 8 * b + k holds bit k of
+// byte b of values [0, m) (LSB first, m / 8 bytes); the n - m tail values
+// follow as byte planes of n - m bytes.
+
+// Bit planes k of bytes [i, i + 8) of `plane`, one output byte each.
+inline void BitTranspose8Scalar(const uint8_t *plane, size_t i, size_t m,
+                                uint8_t *out) {
+  for (int k = 0; k < 8; ++k) {
+    uint8_t bits = 0;
+    for (int j = 0; j < 8; ++j) bits |= ((plane[i + j] >> k) & 1) << j;
+    out[k * (m / 8) + i / 8] = bits;
+  }
+}
+
+inline void BitUntranspose8Scalar(const uint8_t *in, size_t i, size_t m,
+                                  uint8_t *plane) {
+  for (int j = 0; j < 8; ++j) {
+    uint8_t byte = 0;
+    for (int k = 0; k < 8; ++k)
+      byte |= ((in[k * (m / 8) + i / 8] >> j) & 1) << k;
+    plane[i + j] = byte;
+  }
+}
+
+// movemask takes bit 7 of 16 bytes at once; each bit k is first shifted up
+// to bit 7 (shifts are independent, so they overlap).
+inline void BitTransposeSSE41(const uint8_t *plane, size_t m, uint8_t *out) {
+  size_t i = 0;
+  for (; i + 16 <= m; i += 16) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(plane + i));
+    for (int k = 0; k < 8; ++k) {
+      uint16_t bits = static_cast<uint16_t>(
+          _mm_movemask_epi8(_mm_slli_epi16(x, 7 - k)));
+      std::memcpy(out + k * (m / 8) + i / 8, &bits, sizeof(bits));
+    }
+  }
+  if (i < m) BitTranspose8Scalar(plane, i, m, out);
+}
+
+TRANSFORM_TARGET_AVX2
+inline void BitTransposeAVX2(const uint8_t *plane, size_t m, uint8_t *out) {
+  size_t i = 0;
+  for (; i + 32 <= m; i += 32) {
+    __m256i x =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(plane + i));
+    for (int k = 0; k < 8; ++k) {
+      uint32_t bits = static_cast<uint32_t>(
+          _mm256_movemask_epi8(_mm256_slli_epi16(x, 7 - k)));
+      std::memcpy(out + k * (m / 8) + i / 8, &bits, sizeof(bits));
+    }
+  }
+  for (; i < m; i += 8) BitTranspose8Scalar(plane, i, m, out);
+}
+
+// Each plane's 16 bits are broadcast to 16 bytes and tested against the
+// byte's own bit, then merged in as bit k.
+inline void BitUntransposeSSE41(const uint8_t *in, size_t m, uint8_t *plane) {
+  const __m128i spread =
+      _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1);
+  const __m128i select = _mm_set1_epi64x(0x8040201008040201LL);
+  size_t i = 0;
+  for (; i + 16 <= m; i += 16) {
+    __m128i acc = _mm_setzero_si128();
+    for (int k = 0; k < 8; ++k) {
+      uint16_t bits;
+      std::memcpy(&bits, in + k * (m / 8) + i / 8, sizeof(bits));
+      __m128i x = _mm_shuffle_epi8(_mm_cvtsi32_si128(bits), spread);
+      __m128i set = _mm_cmpeq_epi8(_mm_and_si128(x, select), select);
+      acc = _mm_or_si128(acc, _mm_and_si128(set, _mm_set1_epi8(1 << k)));
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(plane + i), acc);
+  }
+  if (i < m) BitUntranspose8Scalar(in, i, m, plane);
+}
+
+TRANSFORM_TARGET_AVX2
+inline void BitUntransposeAVX2(const uint8_t *in, size_t m, uint8_t *plane) {
+  const __m256i spread =
+      _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2,
+                       2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+  const __m256i select = _mm256_set1_epi64x(0x8040201008040201LL);
+  size_t i = 0;
+  for (; i + 32 <= m; i += 32) {
+    __m256i acc = _mm256_setzero_si256();
+    for (int k = 0; k < 8; ++k) {
+      uint32_t bits;
+      std::memcpy(&bits, in + k * (m / 8) + i / 8, sizeof(bits));
+      __m256i x = _mm256_shuffle_epi8(
+          _mm256_set1_epi32(static_cast<int32_t>(bits)), spread);
+      __m256i set = _mm256_cmpeq_epi8(_mm256_and_si256(x, select), select);
+      acc = _mm256_or_si256(acc,
+                            _mm256_and_si256(set, _mm256_set1_epi8(1 << k)));
+    }
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(plane + i), acc);
+  }
+  for (; i < m; i += 8) BitUntranspose8Scalar(in, i, m, plane);
+}
+
+inline void BitTranspose(const uint8_t *plane, size_t m, uint8_t *out) {
+  switch (TransformationSimdLevel()) {
+    case SimdLevel::Scalar:
+      for (size_t i = 0; i < m; i += 8) BitTranspose8Scalar(plane, i, m, out);
+      return;
+    case SimdLevel::SSE41:
+      return BitTransposeSSE41(plane, m, out);
+    default:
+      return BitTransposeAVX2(plane, m, out);
+  }
+}
+
+inline void BitUntranspose(const uint8_t *in, size_t m, uint8_t *plane) {
+  switch (TransformationSimdLevel()) {
+    case SimdLevel::Scalar:
+      for (size_t i = 0; i < m; i += 8) BitUntranspose8Scalar(in, i, m, plane);
+      return;
+    case SimdLevel::SSE41:
+      return BitUntransposeSSE41(in, m, plane);
+    default:
+      return BitUntransposeAVX2(in, m, plane);
+  }
+}
+
+inline void BitShuffle(const int32_t *in, size_t n, uint8_t *out) {
+  std::vector<uint8_t> planes;
+  IntermediateBuffers<uint8_t>::Lend(planes, n * sizeof(int32_t));
+  ByteShuffle(in, n, planes.data());
+  const size_t m = n & ~size_t{7};
+  for (size_t b = 0; b < sizeof(int32_t); ++b) {
+    BitTranspose(planes.data() + b * n, m, out + b * m);
+    std::memcpy(out + sizeof(int32_t) * m + b * (n - m),
+                planes.data() + b * n + m, n - m);
+  }
+  IntermediateBuffers<uint8_t>::Reclaim(planes);
+}
+
+inline void BitUnshuffle(const uint8_t *in, size_t n, int32_t *out) {
+  std::vector<uint8_t> planes;
+  IntermediateBuffers<uint8_t>::Lend(planes, n * sizeof(int32_t));
+  const size_t m = n & ~size_t{7};
+  for (size_t b = 0; b < sizeof(int32_t); ++b) {
+    BitUntranspose(in + b * m, m, planes.data() + b * n);
+    std::memcpy(planes.data() + b * n + m,
+                in + sizeof(int32_t) * m + b * (n - m), n - m);
+  }
+  ByteUnshuffle(planes.data(), n, out);
+  IntermediateBuffers<uint8_t>::Reclaim(planes);
+}
+
+class ByteShuffleStage : public ByteStage<int32_t> {
+ public:
+  size_t Size(size_t length) const override {
+    return length * sizeof(int32_t);
+  }
+
+  void Forward(const int32_t *in, size_t length, uint8_t *out) const override {
+    ByteShuffle(in, length, out);
+  }
+
+  void Inverse(const uint8_t *in, size_t length, int32_t *out) const override {
+    ByteUnshuffle(in, length, out);
+  }
+
+  std::string name() const override { return "byteshuffle"; }
+
+  ByteStage<int32_t> *Clone() const override { return new ByteShuffleStage(); }
+};
+
+class BitShuffleStage : public ByteStage<int32_t> {
+ public:
+  size_t Size(size_t length) const override {
+    return length * sizeof(int32_t);
+  }
+
+  void Forward(const int32_t *in, size_t length, uint8_t *out) const override {
+    BitShuffle(in, length, out);
+  }
+
+  void Inverse(const uint8_t *in, size_t length, int32_t *out) const override {
+    BitUnshuffle(in, length, out);
+  }
+
+  std::string name() const override { return "bitshuffle"; }
+
+  ByteStage<int32_t> *Clone() const override { return new BitShuffleStage(); }
+};
@@ -1,6 +1,10 @@
+#pragma once
+
 #include <cassert>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <stdexcept>
 #include <string>
 
 #include "generic_codecs.h"
@@ -10,6 +14,78 @@
 #pragma clang diagnostic ignored "-Wreturn-local-addr"
 #endif
 
+// simdpack stores b = 32 blocks raw, but the vendored 32-bit unpacker
+// advances its input twice per vector (copying every other one and reading
+// past the payload), so b = 32 blocks are copied back here instead.
+inline void SimdCompUnpackBlock(const __m128i *in, uint32_t *out, uint32_t b) {
+  if (b == 32) {
+    std::memcpy(out, in, SIMDBlockSize * sizeof(uint32_t));
+    return;
+  }
+  __m128i unused_lo = _mm_setzero_si128(), unused_hi = _mm_setzero_si128();
+  simdunpack(in, out, b, &unused_lo, &unused_hi);
+}
+
+// simdunpack_length with the b = 32 guard; `sum` (if given) receives the sum
+// of the decoded values modulo 2^64.
+inline const __m128i *SimdCompUnpackLength(const __m128i *in, size_t length,
+                                           uint32_t *out, uint32_t b,
+                                           uint64_t *sum = nullptr) {
+  uint64_t checksum = 0;
+  if (b != 32) {
+    in = simdunpack_length(in, length, out, b, &checksum);
+  } else {
+    std::memcpy(out, in, length * sizeof(uint32_t));
+    in = reinterpret_cast<const __m128i *>(
+        reinterpret_cast<const uint32_t *>(in) + length);
+    if (sum)
+      for (size_t i = 0; i < length; ++i) checksum += out[i];
+  }
+  if (sum) *sum = checksum;
+  return in;
+}
+
+// Unpacks whole 128-value SIMD blocks (each `b` vectors long) per call; the
+// final partial block goes through simdunpack_shortlength.
+class SimdCompDecodeCursor : public DecodeCursor<int32_t> {
+ private:
+  const __m128i *in;
+  uint32_t b;
+  size_t length;
+  size_t pos = 0;
+
+ public:
+  SimdCompDecodeCursor(const uint8_t *compressed, uint32_t b, size_t length)
+      : in{reinterpret_cast<const __m128i *>(compressed)},
+        b{b},
+        length{length} {}
+
+  size_t Next(int32_t *out, size_t k) override {
+    size_t remaining = length - pos;
+    if (remaining == 0) return 0;
+    if (remaining < SIMDBlockSize) {
+      if (k < remaining)
+        throw std::invalid_argument("SimdComp cursor chunk below tail size");
+      in = simdunpack_shortlength(in, remaining, reinterpret_cast<uint32_t *>(out),
+                                  b);
+      pos = length;
+      return remaining;
+    }
+    size_t blocks = std::min(k, remaining) / SIMDBlockSize;
+    if (blocks == 0)
+      throw std::invalid_argument("SimdComp cursor chunk must be >= 128");
+    for (size_t blk = 0; blk < blocks; ++blk) {
+      SimdCompUnpackBlock(
+          in, reinterpret_cast<uint32_t *>(out) + blk * SIMDBlockSize, b);
+      in += b;
+    }
+    pos += blocks * SIMDBlockSize;
+    return blocks * SIMDBlockSize;
+  }
+
+  size_t Granularity() const override { return SIMDBlockSize; }
+};
+
 class SimdCompCodec : public StatefulIntegerCodec<int32_t> {
  public:
   std::vector<uint8_t> compressed;
@@ -25,9 +101,22 @@ class SimdCompCodec : public StatefulIntegerCodec<int32_t> {
   }
 
   void DecodeArray(int32_t *out, const std::size_t length) override {
-    uint64_t checksum = 0;
-    simdunpack_length((const __m128i *)compressed.data(), length,
-                      reinterpret_cast<uint32_t *>(out), b, &checksum);
+    SimdCompUnpackLength((const __m128i *)compressed.data(), length,
+                         reinterpret_cast<uint32_t *>(out), b);
+  }
+
+  // Hands the packed bytes, with the bit width appended, to a following
+  // stage (stage_pipeline.h), leaving the codec empty.
+  void ReleaseBytes(std::vector<uint8_t> &bytes) {
+    compressed.push_back(static_cast<uint8_t>(b));
+    bytes.swap(compressed);
+    compressed.clear();
+  }
+
+  void DecodeFromBytes(const uint8_t *in, size_t size, int32_t *out,
+                       size_t length) {
+    SimdCompUnpackLength(reinterpret_cast<const __m128i *>(in), length,
+                         reinterpret_cast<uint32_t *>(out), in[size - 1]);
   }
 
   std::size_t EncodedNumValues() override { return compressed.size(); }
@@ -58,4 +147,9 @@ class SimdCompCodec : public StatefulIntegerCodec<int32_t> {
     throw std::runtime_error(
         "Encoded format does not match input. Cannot forward.");
   };
+
+  std::unique_ptr<DecodeCursor<int32_t>> NewDecodeCursor(
+      size_t length) override {
+    return std::make_unique<SimdCompDecodeCursor>(compressed.data(), b, length);
+  }
 };
\ No newline at end of file
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include "generic_codecs.h"
+#include "simdcomp.h"
+
+// SimdComp frame-of-reference codec: values are bit-packed as offsets from
+// the block minimum, one 128-value SIMD block at a time (simdpackFOR), with
+// the tail through simdpackFOR_length. A 16-byte header (reference, bit width,
+// block sum) keeps the payload aligned and lets the fused transformations
+// run without unpacking to int32:
+//  - FusedSum reads the stored sum;
+//  - FusedValueShift only rewrites the reference and sum;
+//  - FusedThreshold compares packed offsets against threshold - reference one
+//    L1-resident block at a time and emits a bitmap, or fills it outright
+//    when the threshold lies outside [min, min + 2^b).
+class SimdCompFORCodec : public StatefulIntegerCodec<int32_t> {
+ private:
+  struct Header {
+    int32_t reference;
+    uint32_t b;
+    int64_t sum;
+  };
+  static_assert(sizeof(Header) == sizeof(__m128i));
+
+  Header &header() { return *reinterpret_cast<Header *>(compressed.data()); }
+
+  const __m128i *payload() const {
+    return reinterpret_cast<const __m128i *>(compressed.data()) + 1;
+  }
+
+ public:
+  std::vector<uint8_t> compressed;
+
+  void EncodeArray(const int32_t *in, const size_t length) override {
+    const uint32_t *uin = reinterpret_cast<const uint32_t *>(in);
+    Header &h = header();
+    h.sum = 0;
+    for (size_t i = 0; i < length; ++i) h.sum += in[i];
+
+    __m128i *out = reinterpret_cast<__m128i *>(compressed.data()) + 1;
+    size_t full = length / SIMDBlockSize * SIMDBlockSize;
+    for (size_t i = 0; i < full; i += SIMDBlockSize) {
+      simdpackFOR(h.reference, uin + i, out, h.b);
+      out += h.b;
+    }
+    out = simdpackFOR_length(h.reference, uin + full,
+                             static_cast<int>(length - full), out, h.b);
+    compressed.resize((out - reinterpret_cast<__m128i *>(compressed.data())) *
+                      sizeof(__m128i));
+  }
+
+  void DecodeArray(int32_t *out, const std::size_t length) override {
+    const Header &h = header();
+    uint32_t *uout = reinterpret_cast<uint32_t *>(out);
+    const __m128i *in = payload();
+    size_t full = length / SIMDBlockSize * SIMDBlockSize;
+    for (size_t i = 0; i < full; i += SIMDBlockSize) {
+      simdunpackFOR(h.reference, in, uout + i, h.b);
+      in += h.b;
+    }
+    simdunpackFOR_length(h.reference, in, static_cast<int>(length - full),
+                         uout + full, h.b);
+  }
+
+  // Every 128-value block occupies b vectors, so only the blocks overlapping
+  // the range are unpacked.
+  void DecodeRange(int32_t *out, size_t begin, size_t count,
+                   size_t length) override {
+    const Header &h = header();
+    alignas(16) uint32_t block[SIMDBlockSize];
+    size_t full = length / SIMDBlockSize * SIMDBlockSize;
+    size_t end = begin + count;
+    for (size_t start = begin / SIMDBlockSize * SIMDBlockSize; start < end;
+         start += SIMDBlockSize) {
+      const __m128i *in = payload() + start / SIMDBlockSize * h.b;
+      if (start < full)
+        simdunpackFOR(h.reference, in, block, h.b);
+      else
+        simdunpackFOR_length(h.reference, in,
+                             static_cast<int>(length - full), block, h.b);
+      size_t lo = std::max(start, begin);
+      size_t hi = std::min(start + SIMDBlockSize, end);
+      std::memcpy(out + (lo - begin), block + (lo - start),
+                  (hi - lo) * sizeof(int32_t));
+    }
+  }
+
+  bool FusedValueShift(size_t length, int32_t delta) override {
+    Header &h = header();
+    // A 32-bit payload is stored raw, and the shifted range must still fit
+    // in int32 for the reference to stay the minimum.
+    int64_t maxOffset = (int64_t{1} << h.b) - 1;
+    int64_t lo = int64_t{h.reference} + delta;
+    if (h.b == 32 || lo < std::numeric_limits<int32_t>::min() ||
+        lo + maxOffset > std::numeric_limits<int32_t>::max())
+      return false;
+    h.reference = static_cast<int32_t>(lo);
+    h.sum += int64_t{delta} * static_cast<int64_t>(length);
+    return true;
+  }
+
+  // The block sum is kept in the header.
+  bool FusedSum(size_t length, int64_t &sum) override {
+    sum = length == 0 ? 0 : header().sum;
+    return true;
+  }
+
+  bool FusedThreshold(size_t length, uint64_t *bitmap) override {
+    const Header &h = header();
+    if (h.b == 32 || length == 0) return false;
+    size_t numWords = (length + 63) / 64;
+    int64_t mean = h.sum / static_cast<int64_t>(length);
+    int64_t cut = mean - h.reference;  // value >= mean <=> offset >= cut
+    if (cut <= 0 || cut > (int64_t{1} << h.b) - 1) {
+      std::fill(bitmap, bitmap + numWords, cut <= 0 ? ~uint64_t{0} : 0);
+      if (cut <= 0 && length % 64)
+        bitmap[numWords - 1] = (uint64_t{1} << (length % 64)) - 1;
+      return true;
+    }
+
+    // b < 32, so offsets fit a signed compare: offset >= cut <=> > cut - 1.
+    const __m128i vcut = _mm_set1_epi32(static_cast<int32_t>(cut - 1));
+    alignas(16) uint32_t offsets[SIMDBlockSize];
+    const __m128i *in = payload();
+    size_t full = length / SIMDBlockSize * SIMDBlockSize;
+    for (size_t i = 0; i < full; i += SIMDBlockSize) {
+      simdunpackFOR(0, in, offsets, h.b);
+      in += h.b;
+      // Narrow four 32-bit compare masks to bytes: 16 bits per movemask.
+      const __m128i *v = reinterpret_cast<const __m128i *>(offsets);
+      for (size_t w = 0; w < SIMDBlockSize / 64; ++w) {
+        uint64_t word = 0;
+        for (size_t j = 0; j < 4; ++j, v += 4) {
+          __m128i ge[4];
+          for (int q = 0; q < 4; ++q)
+            ge[q] = _mm_cmpgt_epi32(v[q], vcut);
+          __m128i bytes = _mm_packs_epi16(_mm_packs_epi32(ge[0], ge[1]),
+                                          _mm_packs_epi32(ge[2], ge[3]));
+          word |= static_cast<uint64_t>(static_cast<uint16_t>(
+                      _mm_movemask_epi8(bytes)))
+                  << (j * 16);
+        }
+        bitmap[i / 64 + w] = word;
+      }
+    }
+    size_t tail = length - full;
+    if (tail) {
+      simdunpackFOR_length(0, in, static_cast<int>(tail), offsets, h.b);
+      for (size_t w = full / 64; w < numWords; ++w) bitmap[w] = 0;
+      for (size_t j = 0; j < tail; ++j)
+        bitmap[(full + j) / 64] |=
+            static_cast<uint64_t>(offsets[j] >= static_cast<uint32_t>(cut))
+            << ((full + j) % 64);
+    }
+    return true;
+  }
+
+  std::size_t EncodedNumValues() override { return compressed.size(); }
+
+  std::size_t EncodedSizeValue() override { return sizeof(uint8_t); }
+
+  virtual ~SimdCompFORCodec() {}
+
+  std::string name() const override { return "simdcomp_for"; }
+
+  std::size_t GetOverflowSize(size_t) const override { return 0; }
+
+  StatefulIntegerCodec<int32_t> *CloneFresh() const override {
+    return new SimdCompFORCodec();
+  }
+
+  void AllocEncoded(const int32_t *in, size_t length) override {
+    Header h{};
+    if (length > 0) {
+      auto [lo, hi] = std::minmax_element(in, in + length);
+      h.reference = *lo;
+      uint32_t range = static_cast<uint32_t>(*hi) - static_cast<uint32_t>(*lo);
+      h.b = range == 0 ? 0 : 32 - __builtin_clz(range);
+    }
+    compressed.resize(sizeof(Header) +
+                      simdpackFOR_compressedbytes(static_cast<int>(length),
+                                                  h.b) +
+                      sizeof(__m128i));
+    header() = h;
+  };
+
+  void clear() override {
+    compressed.clear();
+    compressed.shrink_to_fit();
+  }
+
+  std::vector<int32_t> &GetEncoded() override {
+    throw std::runtime_error(
+        "Encoded format does not match input. Cannot forward.");
+  };
+};
@@ -6,6 +6,7 @@
 
 #include "generic_codecs.h"
 #include "simdcomp.h"
+#include "simdcomp_codecs.h"
 
 // SimdComp variant that writes the decode-time 32-bit checksum (lower 32 bits
 // of the SIMD sum) into the two overflow slots following the decoded data.
@@ -26,8 +27,8 @@ class SimdCompFusedCodec : public StatefulIntegerCodec<int32_t> {
 
   void DecodeArray(int32_t *out, const std::size_t length) override {
     uint64_t checksum = 0;
-    simdunpack_length((const __m128i *)compressed.data(), length,
-                      reinterpret_cast<uint32_t *>(out), b, &checksum);
+    SimdCompUnpackLength((const __m128i *)compressed.data(), length,
+                         reinterpret_cast<uint32_t *>(out), b, &checksum);
     out[length]     = static_cast<int32_t>(checksum & 0xFFFFFFFF);
     out[length + 1] = static_cast<int32_t>(checksum >> 32);
   }
@@ -42,6 +43,8 @@ class SimdCompFusedCodec : public StatefulIntegerCodec<int32_t> {
 
   std::size_t GetOverflowSize(size_t) const override { return 2; }
 
+  bool WritesOverflowSum() const override { return true; }
+
   StatefulIntegerCodec<int32_t> *CloneFresh() const override {
     return new SimdCompFusedCodec();
   }
@@ -0,0 +1,266 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include "generic_codecs.h"
+#include "simdcomp.h"
+#include "transformations_simd.h"
+
+// SimdComp piecewise-linear frame-of-reference codec (LeCo-style learned
+// FOR): each 128-value SIMD block gets a least-squares line, and only the
+// residuals from it are bit-packed (simdpackFOR against the block's lowest
+// residual). Smooth terrain, rows or Morton runs that drift steadily pack
+// below delta coding, whose residuals are the full step between neighbours.
+//
+// Value j of a segment is
+//   base + trunc(fma(slope, j, intercept)) + packed residual j,
+// with base an int32 and slope/intercept floats (intercept in [0, 1]).
+// fma is correctly rounded, so the scalar std::fmaf and the AVX2 FMA kernel
+// give bit-identical predictions and encoder and decoder always agree.
+// Segments where a line does not fit the range (e.g. values spanning all of
+// int32) fall back to a flat line, i.e. plain FOR.
+//
+// The segment table comes first (16 bytes per segment, holding the payload
+// offset), so any value decodes in O(1) with one simdselectFOR and one fma
+// (ValueAt); DecodeRange unpacks only the segments it overlaps.
+
+namespace simdcomp_linear_detail {
+
+struct Segment {
+  int32_t base;
+  float slope;
+  float intercept;
+  uint32_t offsetAndBits;  // payload offset in vectors << 6 | bit width
+
+  uint32_t b() const { return offsetAndBits & 63; }
+  uint32_t offset() const { return offsetAndBits >> 6; }
+};
+static_assert(sizeof(Segment) == sizeof(__m128i));
+
+// Lines steeper than this over one block are not worth the float range.
+constexpr float kMaxRise = 1 << 30;
+
+inline int32_t LinearTerm(float slope, float intercept, size_t j) {
+  return static_cast<int32_t>(
+      std::fmaf(slope, static_cast<float>(j), intercept));
+}
+
+// out[j] += trunc(fma(slope, j, intercept)), j in [0, n).
+inline void AddLinearTermsScalar(uint32_t *out, size_t n, float slope,
+                                 float intercept) {
+  for (size_t j = 0; j < n; ++j)
+    out[j] += static_cast<uint32_t>(LinearTerm(slope, intercept, j));
+}
+
+__attribute__((target("avx2,fma"))) inline void AddLinearTermsAVX2(
+    uint32_t *out, size_t n, float slope, float intercept) {
+  const __m256 vs = _mm256_set1_ps(slope), vc = _mm256_set1_ps(intercept);
+  const __m256 step = _mm256_set1_ps(8.0f);
+  __m256 j = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i *p = reinterpret_cast<__m256i *>(out + i);
+    __m256i t = _mm256_cvttps_epi32(_mm256_fmadd_ps(vs, j, vc));
+    _mm256_storeu_si256(p, _mm256_add_epi32(_mm256_loadu_si256(p), t));
+    j = _mm256_add_ps(j, step);
+  }
+  for (; i < n; ++i)
+    out[i] += static_cast<uint32_t>(LinearTerm(slope, intercept, i));
+}
+
+// Follows TransformationSimdLevel(); the AVX2 kernel also needs FMA, which
+// the level does not imply.
+inline void AddLinearTerms(uint32_t *out, size_t n, float slope,
+                           float intercept) {
+  static const bool fma = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("fma") != 0;
+  }();
+  if (slope == 0.0f && intercept < 1.0f) return;  // flat: every term is 0
+  if (TransformationSimdLevel() >= SimdLevel::AVX2 && fma)
+    AddLinearTermsAVX2(out, n, slope, intercept);
+  else
+    AddLinearTermsScalar(out, n, slope, intercept);
+}
+
+// Least-squares line through in[0..n). The intercept's integer part is left
+// to the segment base, which absorbs it with the lowest residual.
+inline void FitLine(const int32_t *in, size_t n, float &slope,
+                    float &intercept) {
+  double sy = 0, sxy = 0;
+  for (size_t j = 0; j < n; ++j) {
+    sy += in[j];
+    sxy += static_cast<double>(j) * in[j];
+  }
+  double xm = (static_cast<double>(n) - 1) / 2, ym = sy / n;
+  double sxx = static_cast<double>(n) * (static_cast<double>(n) * n - 1) / 12;
+  slope = n > 1 ? static_cast<float>((sxy - xm * sy) / sxx) : 0;
+  if (!(std::fabs(slope) * float{SIMDBlockSize} < kMaxRise)) slope = 0;
+  double a = ym - static_cast<double>(slope) * xm;
+  intercept = static_cast<float>(a - std::floor(a));
+}
+
+}  // namespace simdcomp_linear_detail
+
+class SimdCompLinearCodec : public StatefulIntegerCodec<int32_t> {
+ private:
+  using Segment = simdcomp_linear_detail::Segment;
+
+  size_t NumSegments() const {
+    return numValues / SIMDBlockSize + (numValues % SIMDBlockSize != 0);
+  }
+
+  const Segment *segments() const {
+    return reinterpret_cast<const Segment *>(compressed.data());
+  }
+
+  const __m128i *payload(const Segment &s) const {
+    return reinterpret_cast<const __m128i *>(compressed.data()) +
+           NumSegments() + s.offset();
+  }
+
+  // Unpacks segment k (all 128 slots) into `out`.
+  void DecodeSegment(size_t k, uint32_t *out) const {
+    const Segment &s = segments()[k];
+    simdunpackFOR(static_cast<uint32_t>(s.base), payload(s), out, s.b());
+    simdcomp_linear_detail::AddLinearTerms(out, SIMDBlockSize, s.slope,
+                                           s.intercept);
+  }
+
+ public:
+  std::vector<uint8_t> compressed;
+  size_t numValues = 0;
+
+  void EncodeArray(const int32_t *in, const size_t length) override {
+    using namespace simdcomp_linear_detail;
+    numValues = length;
+    const size_t numSegments = NumSegments();
+    auto *table = reinterpret_cast<Segment *>(compressed.data());
+    __m128i *out =
+        reinterpret_cast<__m128i *>(compressed.data()) + numSegments;
+    alignas(16) uint32_t block[SIMDBlockSize];
+    alignas(16) uint32_t terms[SIMDBlockSize];
+    uint32_t offset = 0;
+    for (size_t k = 0; k < numSegments; ++k) {
+      const int32_t *v = in + k * SIMDBlockSize;
+      const size_t n =
+          std::min<size_t>(SIMDBlockSize, length - k * SIMDBlockSize);
+      Segment s{};
+      FitLine(v, n, s.slope, s.intercept);
+      std::fill_n(terms, SIMDBlockSize, 0);
+      AddLinearTerms(terms, n, s.slope, s.intercept);
+
+      // Residuals against the line, relative to the lowest one.
+      int64_t lo = std::numeric_limits<int64_t>::max();
+      int64_t hi = std::numeric_limits<int64_t>::min();
+      for (size_t j = 0; j < n; ++j) {
+        int64_t r = int64_t{v[j]} - static_cast<int32_t>(terms[j]);
+        lo = std::min(lo, r);
+        hi = std::max(hi, r);
+      }
+      if (lo < std::numeric_limits<int32_t>::min() ||
+          lo > std::numeric_limits<int32_t>::max() ||
+          hi - lo > std::numeric_limits<uint32_t>::max()) {
+        // Flat line: FOR on the values themselves.
+        s.slope = s.intercept = 0;
+        std::fill_n(terms, n, 0);
+        auto [mn, mx] = std::minmax_element(v, v + n);
+        lo = *mn;
+        hi = *mx;
+      }
+      s.base = static_cast<int32_t>(lo);
+      uint32_t range = static_cast<uint32_t>(hi - lo);
+      uint32_t b = range == 0 ? 0 : 32 - __builtin_clz(range);
+      s.offsetAndBits = offset << 6 | b;
+      for (size_t j = 0; j < n; ++j)
+        block[j] = static_cast<uint32_t>(v[j]) - terms[j];
+      std::fill(block + n, block + SIMDBlockSize,
+                static_cast<uint32_t>(s.base));
+      simdpackFOR(static_cast<uint32_t>(s.base), block, out + offset, b);
+      offset += b;
+      table[k] = s;
+    }
+    compressed.resize((numSegments + offset) * sizeof(__m128i));
+  }
+
+  // Whole segments are written, so up to 127 values past `length`
+  // (GetOverflowSize).
+  void DecodeArray(int32_t *out, const std::size_t length) override {
+    uint32_t *uout = reinterpret_cast<uint32_t *>(out);
+    for (size_t k = 0; k < NumSegments(); ++k)
+      DecodeSegment(k, uout + k * SIMDBlockSize);
+  }
+
+  // Value i in O(1): one packed slot plus its point on the line.
+  int32_t ValueAt(size_t i) const {
+    const Segment &s = segments()[i / SIMDBlockSize];
+    size_t j = i % SIMDBlockSize;
+    uint32_t r = simdselectFOR(static_cast<uint32_t>(s.base), payload(s),
+                               s.b(), static_cast<int>(j));
+    return static_cast<int32_t>(
+        r + static_cast<uint32_t>(
+                simdcomp_linear_detail::LinearTerm(s.slope, s.intercept, j)));
+  }
+
+  // Short stretches are selected value by value; longer ones unpack only the
+  // segments they overlap.
+  void DecodeRange(int32_t *out, size_t begin, size_t count,
+                   size_t length) override {
+    constexpr size_t kSelectBelow = 16;
+    alignas(16) uint32_t block[SIMDBlockSize];
+    size_t end = begin + count;
+    for (size_t start = begin / SIMDBlockSize * SIMDBlockSize; start < end;
+         start += SIMDBlockSize) {
+      size_t lo = std::max(start, begin);
+      size_t hi = std::min(start + SIMDBlockSize, end);
+      if (hi - lo < kSelectBelow) {
+        for (size_t i = lo; i < hi; ++i) out[i - begin] = ValueAt(i);
+        continue;
+      }
+      DecodeSegment(start / SIMDBlockSize, block);
+      std::memcpy(out + (lo - begin), block + (lo - start),
+                  (hi - lo) * sizeof(int32_t));
+    }
+  }
+
+  std::size_t EncodedNumValues() override { return compressed.size(); }
+
+  std::size_t EncodedSizeValue() override { return sizeof(uint8_t); }
+
+  virtual ~SimdCompLinearCodec() {}
+
+  std::string name() const override { return "simdcomp_linear"; }
+
+  std::size_t GetOverflowSize(size_t length) const override {
+    return (SIMDBlockSize - length % SIMDBlockSize) % SIMDBlockSize;
+  }
+
+  StatefulIntegerCodec<int32_t> *CloneFresh() const override {
+    return new SimdCompLinearCodec();
+  }
+
+  void AllocEncoded(const int32_t *in, size_t length) override {
+    numValues = length;
+    // Segment table plus up to 32 vectors per segment.
+    compressed.resize(NumSegments() * 33 * sizeof(__m128i));
+  };
+
+  void clear() override {
+    compressed.clear();
+    compressed.shrink_to_fit();
+    numValues = 0;
+  }
+
+  std::vector<int32_t> &GetEncoded() override {
+    throw std::runtime_error(
+        "Encoded format does not match input. Cannot forward.");
+  };
+};
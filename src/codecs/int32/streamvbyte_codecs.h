@@ -29,6 +29,17 @@ class StreamVByteCodec : public StatefulIntegerCodec<int32_t> {
                               length) == compsize);
   }
 
+  // Hands the encoding to a following stage (stage_pipeline.h).
+  void ReleaseBytes(std::vector<uint8_t> &bytes) {
+    bytes.swap(compressed);
+    compressed.clear();
+  }
+
+  void DecodeFromBytes(const uint8_t *in, size_t, int32_t *out,
+                       size_t length) {
+    streamvbyte_decode(in, reinterpret_cast<uint32_t *>(out), length);
+  }
+
   std::size_t EncodedNumValues() override { return compressed.size(); }
 
   std::size_t EncodedSizeValue() override { return sizeof(uint8_t); }
@@ -0,0 +1,379 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "generic_codecs.h"
+
+// Table-ANS entropy codec for residual streams (delta, FOR and other logical
+// codecs' output), cascaded like any physical codec:
+// [+]_custom_delta_unvec+tans. Bit packing spends the block's widest
+// residual on every value; tANS spends about -log2(p) bits per value, which
+// for the geometric residuals of smooth rasters is a few bits less.
+//
+// Values are tokenised as in DEFLATE's distance codes: 0..15 are their own
+// symbol; larger values are symbol 11 + bit length with the bits below the
+// leading one stored raw in a separate stream. The 44 symbols are coded with
+// FSE-style tANS (normalised counts spread over 2^R states, R <= 9, as zstd
+// does for its literal lengths) through four interleaved states with a bit
+// stream each (as Huffman-4X in zstd), so the decoder runs four independent
+// chains of lookups and refills.
+//
+// Layout: R, symbol count, varint normalised counts, the four lanes' stream
+// byte sizes (uint32), the lane streams (an R-bit initial state, then the
+// lane's transition bits in decode order; value i is in lane i % 4), the
+// raw-bits stream, and 8 bytes of padding for the decoder's unaligned 64-bit
+// loads.
+
+namespace tans_detail {
+
+constexpr uint32_t kDirect = 16;
+constexpr uint32_t kNumSymbols = kDirect + 28;  // bit lengths 5..32
+constexpr uint32_t kMaxTableLog = 9;
+constexpr uint32_t kMinTableLog = 6;
+constexpr size_t kLanes = 4;
+// Transitions decoded per lane from one refill: a byte-aligned 64-bit load
+// holds at least 56 bits.
+constexpr size_t kStepsPerRefill = 4;
+static_assert(kStepsPerRefill * kMaxTableLog <= 56);
+constexpr size_t kPadding = 8;
+
+inline uint32_t BitLength(uint32_t v) { return 32 - __builtin_clz(v); }
+
+inline uint32_t Symbol(uint32_t v) {
+  return v < kDirect ? v : BitLength(v) + 11;
+}
+
+// Number of raw bits below the leading one for symbol s.
+inline uint32_t ExtraBits(uint32_t s) { return s < kDirect ? 0 : s - 12; }
+
+inline uint64_t Load64(const uint8_t *p) {
+  uint64_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+// LSB-first bit stream.
+class BitWriter {
+ public:
+  std::vector<uint8_t> &out;
+  uint64_t acc = 0;
+  uint32_t fill = 0;
+
+  explicit BitWriter(std::vector<uint8_t> &out) : out{out} {}
+
+  // nb <= 32.
+  void Put(uint32_t bits, uint32_t nb) {
+    acc |= static_cast<uint64_t>(bits) << fill;
+    fill += nb;
+    while (fill >= 8) {
+      out.push_back(static_cast<uint8_t>(acc));
+      acc >>= 8;
+      fill -= 8;
+    }
+  }
+
+  void Flush() {
+    if (fill) out.push_back(static_cast<uint8_t>(acc));
+    acc = 0;
+    fill = 0;
+  }
+};
+
+// Scales counts to sum to 2^tableLog, keeping every present symbol >= 1.
+inline void Normalise(const std::array<uint32_t, kNumSymbols> &counts,
+                      size_t total, uint32_t tableLog,
+                      std::array<uint32_t, kNumSymbols> &norm) {
+  const uint64_t L = uint64_t{1} << tableLog;
+  int64_t sum = 0;
+  for (uint32_t s = 0; s < kNumSymbols; ++s) {
+    norm[s] = counts[s] == 0
+                  ? 0
+                  : std::max<uint32_t>(
+                        1, static_cast<uint32_t>(
+                               (counts[s] * L + total / 2) / total));
+    sum += norm[s];
+  }
+  // Settle the rounding on the most frequent symbol, where a count off by
+  // one costs least. At most 44 symbols share >= 64 states, so the largest
+  // always has room to give.
+  while (sum != static_cast<int64_t>(L)) {
+    uint32_t best = 0;
+    for (uint32_t s = 1; s < kNumSymbols; ++s)
+      if (norm[s] > norm[best]) best = s;
+    int64_t adjust = std::max<int64_t>(static_cast<int64_t>(L) - sum,
+                                       1 - static_cast<int64_t>(norm[best]));
+    norm[best] = static_cast<uint32_t>(norm[best] + adjust);
+    sum += adjust;
+  }
+}
+
+// FSE's spread: symbol s takes norm[s] states visited with an odd step,
+// calling visit(s, k, x) for its k-th state x. Encoder and decoder number a
+// symbol's states in this visiting order (rather than by x), so both tables
+// are built in one pass without a symbol-per-state table.
+template <typename F>
+inline void Spread(const std::array<uint32_t, kNumSymbols> &norm,
+                   uint32_t tableLog, F &&visit) {
+  const uint32_t L = 1u << tableLog, mask = L - 1;
+  const uint32_t step = (L >> 1) + (L >> 3) + 3;
+  uint32_t pos = 0;
+  for (uint32_t s = 0; s < kNumSymbols; ++s)
+    for (uint32_t k = 0; k < norm[s]; ++k) {
+      visit(s, k, pos);
+      pos = (pos + step) & mask;
+    }
+}
+
+struct DecodeEntry {
+  uint16_t base;  // next state, before adding the nb bits read
+  uint8_t symbol;
+  uint8_t nb;
+};
+
+// State x decodes its symbol s and moves to (n << nb) - L + (nb bits), where
+// n = norm[s] + k for x the k-th state of s and n << nb lies in [L, 2L).
+inline void BuildDecodeTable(const std::array<uint32_t, kNumSymbols> &norm,
+                             uint32_t tableLog,
+                             std::vector<DecodeEntry> &table) {
+  const uint32_t L = 1u << tableLog;
+  table.resize(L);
+  DecodeEntry *t = table.data();
+  Spread(norm, tableLog, [&](uint32_t s, uint32_t k, uint32_t x) {
+    uint32_t n = norm[s] + k;
+    uint32_t nb = tableLog + 1 - BitLength(n);
+    t[x] = {static_cast<uint16_t>((n << nb) - L), static_cast<uint8_t>(s),
+            static_cast<uint8_t>(nb)};
+  });
+}
+
+// Encoder tables: symbol s's k-th state is stateTable[start[s] + k], and the
+// number of bits flushed from state x (in [L, 2L)) is
+// (x + deltaNbBits[s]) >> 16.
+struct EncodeTables {
+  std::vector<uint16_t> stateTable;
+  std::array<uint32_t, kNumSymbols> start{};
+  std::array<uint32_t, kNumSymbols> deltaNbBits{};
+};
+
+inline void BuildEncodeTables(const std::array<uint32_t, kNumSymbols> &norm,
+                              uint32_t tableLog, EncodeTables &t) {
+  const uint32_t L = 1u << tableLog;
+  uint32_t cum = 0;
+  for (uint32_t s = 0; s < kNumSymbols; ++s) {
+    t.start[s] = cum;
+    cum += norm[s];
+    if (norm[s] == 0) continue;
+    uint32_t maxBitsOut = tableLog + 1 - BitLength(norm[s]);
+    t.deltaNbBits[s] = (maxBitsOut << 16) - (norm[s] << maxBitsOut);
+  }
+  t.stateTable.resize(L);
+  Spread(norm, tableLog, [&](uint32_t s, uint32_t k, uint32_t x) {
+    t.stateTable[t.start[s] + k] = static_cast<uint16_t>(L + x);
+  });
+}
+
+inline void PutVarint(std::vector<uint8_t> &out, uint32_t v) {
+  while (v >= 0x80) {
+    out.push_back(static_cast<uint8_t>(v | 0x80));
+    v >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(v));
+}
+
+inline uint32_t GetVarint(const uint8_t *&p) {
+  uint32_t v = 0;
+  for (uint32_t shift = 0;; shift += 7) {
+    uint8_t byte = *p++;
+    v |= static_cast<uint32_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) return v;
+  }
+}
+
+}  // namespace tans_detail
+
+class TansCodec : public StatefulIntegerCodec<int32_t> {
+ public:
+  std::vector<uint8_t> compressed;
+
+  void EncodeArray(const int32_t *in, const size_t length) override {
+    using namespace tans_detail;
+    compressed.clear();
+    if (length == 0) return;
+    const uint32_t *uin = reinterpret_cast<const uint32_t *>(in);
+
+    std::array<uint32_t, kNumSymbols> counts{}, norm{};
+    for (size_t i = 0; i < length; ++i) ++counts[Symbol(uin[i])];
+    uint32_t tableLog = std::clamp<uint32_t>(
+        BitLength(static_cast<uint32_t>(std::min<size_t>(length, 1u << 30))),
+        kMinTableLog, kMaxTableLog);
+    Normalise(counts, length, tableLog, norm);
+    EncodeTables enc;
+    BuildEncodeTables(norm, tableLog, enc);
+
+    uint32_t numSymbols = kNumSymbols;
+    while (norm[numSymbols - 1] == 0) --numSymbols;
+    compressed.push_back(static_cast<uint8_t>(tableLog));
+    compressed.push_back(static_cast<uint8_t>(numSymbols));
+    for (uint32_t s = 0; s < numSymbols; ++s) PutVarint(compressed, norm[s]);
+    const size_t sizesAt = compressed.size();
+    compressed.resize(sizesAt + kLanes * sizeof(uint32_t));
+
+    // Encode back to front, recording each value's flushed bits so each lane
+    // can write them in decode order.
+    const uint32_t L = 1u << tableLog;
+    std::vector<uint32_t> flushed(length);
+    std::vector<uint8_t> flushedBits(length);
+    std::array<uint32_t, kLanes> state;
+    state.fill(L);
+    for (size_t i = length; i-- > 0;) {
+      uint32_t s = Symbol(uin[i]);
+      uint32_t &x = state[i % kLanes];
+      uint32_t nb = (x + enc.deltaNbBits[s]) >> 16;
+      flushed[i] = x & ((1u << nb) - 1);
+      flushedBits[i] = static_cast<uint8_t>(nb);
+      x = enc.stateTable[enc.start[s] + (x >> nb) - norm[s]];
+    }
+
+    BitWriter w(compressed);
+    for (size_t lane = 0; lane < kLanes; ++lane) {
+      size_t begin = compressed.size();
+      w.Put(state[lane] - L, tableLog);
+      for (size_t i = lane; i < length; i += kLanes)
+        w.Put(flushed[i], flushedBits[i]);
+      w.Flush();
+      uint32_t laneBytes = static_cast<uint32_t>(compressed.size() - begin);
+      std::memcpy(compressed.data() + sizesAt + lane * sizeof(uint32_t),
+                  &laneBytes, sizeof(laneBytes));
+    }
+
+    for (size_t i = 0; i < length; ++i) {
+      uint32_t nb = ExtraBits(Symbol(uin[i]));
+      if (nb) w.Put(uin[i] & ((1u << nb) - 1), nb);
+    }
+    w.Flush();
+    compressed.resize(compressed.size() + kPadding);
+  }
+
+  void DecodeArray(int32_t *out, const std::size_t length) override {
+    using namespace tans_detail;
+    if (length == 0) return;
+    const uint8_t *p = compressed.data();
+    const uint32_t tableLog = *p++;
+    const uint32_t numSymbols = *p++;
+    std::array<uint32_t, kNumSymbols> norm{};
+    for (uint32_t s = 0; s < numSymbols; ++s) norm[s] = GetVarint(p);
+    std::vector<DecodeEntry> &table = DecodeTable();
+    BuildDecodeTable(norm, tableLog, table);
+    const DecodeEntry *t = table.data();
+
+    // Each lane reads its own stream, so the four chains of table lookup,
+    // bit count and refill run independently.
+    const uint8_t *stream[kLanes];
+    const uint8_t *next = p + kLanes * sizeof(uint32_t);
+    for (size_t lane = 0; lane < kLanes; ++lane) {
+      uint32_t laneBytes;
+      std::memcpy(&laneBytes, p + lane * sizeof(uint32_t), sizeof(laneBytes));
+      stream[lane] = next;
+      next += laneBytes;
+    }
+    const uint8_t *raw = next;
+    const uint32_t stateMask = (1u << tableLog) - 1;
+    size_t pos[kLanes];
+    uint32_t x[kLanes];
+    uint64_t bits[kLanes];
+    for (size_t lane = 0; lane < kLanes; ++lane) {
+      x[lane] = static_cast<uint32_t>(Load64(stream[lane])) & stateMask;
+      pos[lane] = tableLog;
+    }
+
+    auto refill = [&](size_t lane) {
+      bits[lane] = Load64(stream[lane] + (pos[lane] >> 3)) >> (pos[lane] & 7);
+    };
+    auto step = [&](size_t lane, uint32_t *o) {
+      DecodeEntry e = t[x[lane]];
+      *o = e.symbol;
+      x[lane] = e.base + static_cast<uint32_t>(_bzhi_u64(bits[lane], e.nb));
+      bits[lane] >>= e.nb;
+      pos[lane] += e.nb;
+    };
+    uint32_t *uout = reinterpret_cast<uint32_t *>(out);
+    size_t i = 0;
+    for (; i + kStepsPerRefill * kLanes <= length;
+         i += kStepsPerRefill * kLanes) {
+      for (size_t lane = 0; lane < kLanes; ++lane) refill(lane);
+      for (size_t r = 0; r < kStepsPerRefill; ++r)
+        for (size_t lane = 0; lane < kLanes; ++lane)
+          step(lane, uout + i + r * kLanes + lane);
+    }
+    for (; i < length; ++i) {
+      refill(i % kLanes);
+      step(i % kLanes, uout + i);
+    }
+
+    // Symbols above the direct range take their raw bits; they are rare, so
+    // 16 symbols at a time are checked with one compare mask.
+    size_t rawPos = 0;
+    auto expand = [&](size_t j) {
+      uint32_t nb = ExtraBits(uout[j]);
+      uint64_t r = Load64(raw + (rawPos >> 3)) >> (rawPos & 7);
+      uout[j] = (1u << nb) | static_cast<uint32_t>(_bzhi_u64(r, nb));
+      rawPos += nb;
+    };
+    const __m128i direct = _mm_set1_epi32(kDirect - 1);
+    for (i = 0; i + 16 <= length; i += 16) {
+      const __m128i *v = reinterpret_cast<const __m128i *>(uout + i);
+      __m128i gt[4];
+      for (int q = 0; q < 4; ++q)
+        gt[q] = _mm_cmpgt_epi32(_mm_loadu_si128(v + q), direct);
+      uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(
+          _mm_packs_epi16(_mm_packs_epi32(gt[0], gt[1]),
+                          _mm_packs_epi32(gt[2], gt[3]))));
+      for (; mask; mask &= mask - 1) expand(i + __builtin_ctz(mask));
+    }
+    for (; i < length; ++i)
+      if (uout[i] >= kDirect) expand(i);
+  }
+
+  std::size_t EncodedNumValues() override { return compressed.size(); }
+
+  std::size_t EncodedSizeValue() override { return sizeof(uint8_t); }
+
+  virtual ~TansCodec() {}
+
+  std::string name() const override { return "tans"; }
+
+  std::size_t GetOverflowSize(size_t) const override { return 0; }
+
+  StatefulIntegerCodec<int32_t> *CloneFresh() const override {
+    return new TansCodec();
+  }
+
+  void AllocEncoded(const int32_t *in, size_t length) override {
+    compressed.reserve(length * sizeof(int32_t) + 128);
+  };
+
+  void clear() override {
+    compressed.clear();
+    compressed.shrink_to_fit();
+  }
+
+  std::vector<int32_t> &GetEncoded() override {
+    throw std::runtime_error(
+        "Encoded format does not match input. Cannot forward.");
+  };
+
+ private:
+  // Decode table rebuilt per block into a per-thread buffer.
+  static std::vector<tans_detail::DecodeEntry> &DecodeTable() {
+    thread_local std::vector<tans_detail::DecodeEntry> table;
+    return table;
+  }
+};
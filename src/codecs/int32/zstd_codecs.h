@@ -1,9 +1,14 @@
+#pragma once
+
+#include <zdict.h>
 #include <zstd.h>
 
 #include <cassert>
 #include <cstdint>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "generic_codecs.h"
 
@@ -11,21 +16,104 @@
 #pragma clang diagnostic ignored "-Wreturn-local-addr"
 #endif
 
-// TODO: Add option to provide a pre-trained zstd dictionary.
+// One compression and one decompression context per thread, reused by every
+// ZstdCodec on that thread. Creating a context per block costs more than
+// compressing a small tile.
+inline ZSTD_CCtx* ThreadZstdCCtx() {
+  thread_local std::unique_ptr<ZSTD_CCtx, size_t (*)(ZSTD_CCtx*)> cctx{
+      ZSTD_createCCtx(), ZSTD_freeCCtx};
+  return cctx.get();
+}
+
+inline ZSTD_DCtx* ThreadZstdDCtx() {
+  thread_local std::unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx*)> dctx{
+      ZSTD_createDCtx(), ZSTD_freeDCtx};
+  return dctx.get();
+}
+
+// A trained zstd dictionary, digested once for decompression. Shared
+// read-only by codecs (and their clones) on any thread.
+class ZstdDictionary {
+ public:
+  std::vector<char> bytes;
+  std::shared_ptr<ZSTD_DDict> ddict;
+
+  explicit ZstdDictionary(std::vector<char> dictBytes)
+      : bytes{std::move(dictBytes)},
+        ddict{ZSTD_createDDict(bytes.data(), bytes.size()), ZSTD_freeDDict} {
+    if (!ddict) throw std::runtime_error("Zstd dictionary load failed.");
+  }
+
+  // Digested compression dictionary for `compressionLevel`.
+  std::shared_ptr<ZSTD_CDict> CreateCDict(int compressionLevel) const {
+    std::shared_ptr<ZSTD_CDict> cdict{
+        ZSTD_createCDict(bytes.data(), bytes.size(), compressionLevel),
+        ZSTD_freeCDict};
+    if (!cdict) throw std::runtime_error("Zstd dictionary load failed.");
+    return cdict;
+  }
+};
+
+// Trains a dictionary of at most `capacity` bytes from sample blocks (as
+// they will be handed to the codec, i.e. after any remapping). zstd needs a
+// few dozen samples; too few or too uniform throws.
+inline std::shared_ptr<const ZstdDictionary> TrainZstdDictionary(
+    const std::vector<std::vector<int32_t>>& samples, size_t capacity) {
+  std::vector<char> concatenated;
+  std::vector<size_t> sampleSizes;
+  for (auto& s : samples) {
+    auto* p = reinterpret_cast<const char*>(s.data());
+    concatenated.insert(concatenated.end(), p, p + s.size() * sizeof(int32_t));
+    sampleSizes.push_back(s.size() * sizeof(int32_t));
+  }
+  std::vector<char> dict(capacity);
+  size_t dictSize = ZDICT_trainFromBuffer(
+      dict.data(), dict.size(), concatenated.data(), sampleSizes.data(),
+      static_cast<unsigned>(sampleSizes.size()));
+  if (ZDICT_isError(dictSize))
+    throw std::runtime_error("Zstd dictionary training error: " +
+                             std::string(ZDICT_getErrorName(dictSize)));
+  dict.resize(dictSize);
+  return std::make_shared<const ZstdDictionary>(std::move(dict));
+}
+
+// Zstd on the block's bytes, through the calling thread's reusable
+// contexts. Frames omit the content size and dictionary ID (both known to
+// the caller), which matters at tile sizes. With a dictionary the digested
+// CDict/DDict are shared across clones.
 class ZstdCodec : public StatefulIntegerCodec<int32_t> {
  public:
   int compressionLevel;
   std::vector<char> compressed;
-
-  ZstdCodec(int compressionLevel) : compressionLevel{compressionLevel} {}
+  std::shared_ptr<const ZstdDictionary> dictionary;
+  std::shared_ptr<ZSTD_CDict> cdict;
+
+  ZstdCodec(int compressionLevel,
+            std::shared_ptr<const ZstdDictionary> dictionary = nullptr)
+      : compressionLevel{compressionLevel}, dictionary{std::move(dictionary)} {
+    if (this->dictionary)
+      cdict = this->dictionary->CreateCDict(compressionLevel);
+  }
 
   ZstdCodec() : ZstdCodec(/* compressionLevel */ 3) {}
 
-  void EncodeArray(const int32_t* in, const size_t length) override {
-    size_t maxOutputSize = ZSTD_compressBound(length * sizeof(int32_t));
+  static constexpr bool kAcceptsBytes = true;
+
+  bool AcceptsBytes() const override { return kAcceptsBytes; }
+
+  void EncodeBytes(const uint8_t* in, size_t size) override {
+    size_t maxOutputSize = ZSTD_compressBound(size);
+    compressed.resize(maxOutputSize);
+    ZSTD_CCtx* cctx = ThreadZstdCCtx();
+    ZSTD_CCtx_reset(cctx, ZSTD_reset_session_and_parameters);
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_contentSizeFlag, 0);
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_dictIDFlag, 0);
+    if (cdict)
+      ZSTD_CCtx_refCDict(cctx, cdict.get());
+    else
+      ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, compressionLevel);
     size_t compressedSize =
-        ZSTD_compress(compressed.data(), maxOutputSize, in,
-                      length * sizeof(int32_t), compressionLevel);
+        ZSTD_compress2(cctx, compressed.data(), maxOutputSize, in, size);
     if (ZSTD_isError(compressedSize)) {
       throw std::runtime_error("Zstd compression error: " +
                                std::string(ZSTD_getErrorName(compressedSize)));
@@ -34,17 +122,37 @@ class ZstdCodec : public StatefulIntegerCodec<int32_t> {
     compressed.resize(compressedSize);
   }
 
-  void DecodeArray(int32_t* out, const std::size_t length) override {
-    size_t const decompressedSize = ZSTD_decompress(
-        out, length * sizeof(int32_t), compressed.data(), compressed.size());
+  void EncodeArray(const int32_t* in, const size_t length) override {
+    EncodeBytes(reinterpret_cast<const uint8_t*>(in), length * sizeof(int32_t));
+  }
+
+  void DecodeBytes(uint8_t* out, size_t size) override {
+    ZSTD_DCtx* dctx = ThreadZstdDCtx();
+    size_t const decompressedSize =
+        dictionary ? ZSTD_decompress_usingDDict(dctx, out, size,
+                                                compressed.data(),
+                                                compressed.size(),
+                                                dictionary->ddict.get())
+                   : ZSTD_decompressDCtx(dctx, out, size, compressed.data(),
+                                         compressed.size());
     if (ZSTD_isError(decompressedSize)) {
       throw std::runtime_error(
           "Zstd decompression error: " +
           std::string(ZSTD_getErrorName(decompressedSize)));
       return;
     }
+    // A short frame would leave the tail of `out` unwritten.
+    if (decompressedSize != size)
+      throw std::runtime_error("Zstd frame holds " +
+                               std::to_string(decompressedSize) +
+                               " bytes, expected " + std::to_string(size));
+  }
+
+  void DecodeArray(int32_t* out, const std::size_t length) override {
+    DecodeBytes(reinterpret_cast<uint8_t*>(out), length * sizeof(int32_t));
   }
 
+  // Excludes the shared dictionary, which is stored once per raster.
   std::size_t EncodedNumValues() override { return compressed.size(); }
 
   std::size_t EncodedSizeValue() override { return sizeof(char); }
@@ -52,13 +160,17 @@ class ZstdCodec : public StatefulIntegerCodec<int32_t> {
   virtual ~ZstdCodec() {}
 
   std::string name() const override {
-    return "Zstd_" + std::to_string(compressionLevel);
+    return "Zstd_" + std::to_string(compressionLevel) +
+           (dictionary ? "_dict" : "");
   }
 
   std::size_t GetOverflowSize(size_t) const override { return 0; }
 
   StatefulIntegerCodec<int32_t>* CloneFresh() const override {
-    return new ZstdCodec(compressionLevel);
+    auto* codec = new ZstdCodec(compressionLevel);
+    codec->dictionary = dictionary;
+    codec->cdict = cdict;
+    return codec;
   }
 
   void AllocEncoded(const int32_t* in, size_t length) override {
@@ -75,4 +187,4 @@ class ZstdCodec : public StatefulIntegerCodec<int32_t> {
     throw std::runtime_error(
         "Encoded format does not match input. Cannot forward.");
   };
-};
\ No newline at end of file
+};
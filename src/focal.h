@@ -0,0 +1,567 @@
+#pragma once
+
+#include <omp.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numbers>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "block_grid.h"
+#include "transformations_simd.h"
+
+////////////////////////////////////////////////////////////////////////////
+// 3x3 focal (neighbourhood) operations over a compressed BlockGrid. The  //
+// grid is streamed one band (tile row) at a time: the band's tiles are   //
+// decoded, the row above is carried over from the previous band and the  //
+// row below is read from the next band through a one-row partial decode. //
+// The raster is never materialised; raster edges are clamped.            //
+////////////////////////////////////////////////////////////////////////////
+
+enum class FocalOp {
+  Mean,    // truncated mean of the 3x3 window
+  Max,     // maximum of the 3x3 window
+  Slope,   // Horn slope, hundredths of a degree
+  Aspect,  // Horn aspect (azimuth of the downslope direction), hundredths of
+           // a degree in [0, 36000), kFlatAspect where the window is flat
+  Sobel,   // gradient magnitude sqrt(gx^2 + gy^2), rounded
+};
+
+constexpr int32_t kFocalAngleScale = 100;
+constexpr int32_t kFlatAspect = -1;
+
+inline FocalOp ParseFocalOp(const std::string& s) {
+  if (s == "Mean") return FocalOp::Mean;
+  if (s == "Max") return FocalOp::Max;
+  if (s == "Slope") return FocalOp::Slope;
+  if (s == "Aspect") return FocalOp::Aspect;
+  if (s == "Sobel") return FocalOp::Sobel;
+  throw std::invalid_argument("Unknown focal operation: " + s);
+}
+
+inline std::string ToString(FocalOp op) {
+  switch (op) {
+    case FocalOp::Mean:
+      return "Mean";
+    case FocalOp::Max:
+      return "Max";
+    case FocalOp::Slope:
+      return "Slope";
+    case FocalOp::Aspect:
+      return "Aspect";
+    case FocalOp::Sobel:
+      return "Sobel";
+  }
+  return "";
+}
+
+struct FocalParams {
+  double cellSize = 1.0;  // pixel spacing, in the units of the values
+};
+
+/////////////////
+// row kernels //
+/////////////////
+
+// Each kernel computes one output row from the rows above (r0), at (r1) and
+// below (r2) it; r[-1] and r[w] must be readable (the halo columns). The
+// gradients are the Sobel/Horn sums gx = right - left and gy = below - above
+// with weights 1-2-1. Division by 9 is two exact truncating divisions by 3.
+
+inline int32_t FocalMeanPixel(const int32_t* r0, const int32_t* r1,
+                              const int32_t* r2, std::size_t x) {
+  int32_t s = 0;
+  for (const int32_t* r : {r0, r1, r2}) s += r[x - 1] + r[x] + r[x + 1];
+  return s / 9;
+}
+
+inline int32_t FocalMaxPixel(const int32_t* r0, const int32_t* r1,
+                             const int32_t* r2, std::size_t x) {
+  int32_t m = r0[x - 1];
+  for (const int32_t* r : {r0, r1, r2})
+    m = std::max({m, r[x - 1], r[x], r[x + 1]});
+  return m;
+}
+
+inline void FocalGradPixel(const int32_t* r0, const int32_t* r1,
+                           const int32_t* r2, std::size_t x, int32_t& gx,
+                           int32_t& gy) {
+  gx = (r0[x + 1] + 2 * r1[x + 1] + r2[x + 1]) -
+       (r0[x - 1] + 2 * r1[x - 1] + r2[x - 1]);
+  gy = (r2[x - 1] + 2 * r2[x] + r2[x + 1]) - (r0[x - 1] + 2 * r0[x] + r0[x + 1]);
+}
+
+inline int32_t SobelMagnitude(int32_t gx, int32_t gy) {
+  double g2 = static_cast<double>(gx) * gx + static_cast<double>(gy) * gy;
+  return static_cast<int32_t>(std::nearbyint(std::sqrt(g2)));
+}
+
+inline void FocalMeanRowSSE41(const int32_t* r0, const int32_t* r1,
+                              const int32_t* r2, std::size_t w, int32_t* out) {
+  std::size_t x = 0;
+  for (; x + 4 <= w; x += 4) {
+    __m128i s = _mm_setzero_si128();
+    for (const int32_t* r : {r0, r1, r2})
+      for (int dx = -1; dx <= 1; ++dx)
+        s = _mm_add_epi32(s, _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+                                 r + x + dx)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x),
+                     Div3SSE41(Div3SSE41(s)));
+  }
+  for (; x < w; ++x) out[x] = FocalMeanPixel(r0, r1, r2, x);
+}
+
+inline void FocalMaxRowSSE41(const int32_t* r0, const int32_t* r1,
+                             const int32_t* r2, std::size_t w, int32_t* out) {
+  std::size_t x = 0;
+  for (; x + 4 <= w; x += 4) {
+    __m128i m = _mm_set1_epi32(std::numeric_limits<int32_t>::min());
+    for (const int32_t* r : {r0, r1, r2})
+      for (int dx = -1; dx <= 1; ++dx)
+        m = _mm_max_epi32(m, _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+                                 r + x + dx)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), m);
+  }
+  for (; x < w; ++x) out[x] = FocalMaxPixel(r0, r1, r2, x);
+}
+
+// Weighted 1-2-1 sum of three vectors.
+inline __m128i Sum121SSE41(__m128i a, __m128i b, __m128i c) {
+  return _mm_add_epi32(_mm_add_epi32(a, c), _mm_add_epi32(b, b));
+}
+
+inline void FocalGradSSE41(const int32_t* r0, const int32_t* r1,
+                           const int32_t* r2, std::size_t x, __m128i& gx,
+                           __m128i& gy) {
+  auto at = [x](const int32_t* r, int dx) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(r + x + dx));
+  };
+  gx = _mm_sub_epi32(Sum121SSE41(at(r0, 1), at(r1, 1), at(r2, 1)),
+                     Sum121SSE41(at(r0, -1), at(r1, -1), at(r2, -1)));
+  gy = _mm_sub_epi32(Sum121SSE41(at(r2, -1), at(r2, 0), at(r2, 1)),
+                     Sum121SSE41(at(r0, -1), at(r0, 0), at(r0, 1)));
+}
+
+inline void FocalGradRowSSE41(const int32_t* r0, const int32_t* r1,
+                              const int32_t* r2, std::size_t w, int32_t* gx,
+                              int32_t* gy) {
+  std::size_t x = 0;
+  for (; x + 4 <= w; x += 4) {
+    __m128i vx, vy;
+    FocalGradSSE41(r0, r1, r2, x, vx, vy);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(gx + x), vx);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(gy + x), vy);
+  }
+  for (; x < w; ++x) FocalGradPixel(r0, r1, r2, x, gx[x], gy[x]);
+}
+
+// sqrt(gx^2 + gy^2) for two lanes, in double like SobelMagnitude.
+inline __m128i SobelMagnitude2SSE41(__m128i gx, __m128i gy) {
+  __m128d x = _mm_cvtepi32_pd(gx), y = _mm_cvtepi32_pd(gy);
+  return _mm_cvtpd_epi32(
+      _mm_sqrt_pd(_mm_add_pd(_mm_mul_pd(x, x), _mm_mul_pd(y, y))));
+}
+
+inline void FocalSobelRowSSE41(const int32_t* r0, const int32_t* r1,
+                               const int32_t* r2, std::size_t w, int32_t* out) {
+  std::size_t x = 0;
+  for (; x + 4 <= w; x += 4) {
+    __m128i vx, vy;
+    FocalGradSSE41(r0, r1, r2, x, vx, vy);
+    __m128i lo = SobelMagnitude2SSE41(vx, vy);
+    __m128i hi = SobelMagnitude2SSE41(_mm_unpackhi_epi64(vx, vx),
+                                      _mm_unpackhi_epi64(vy, vy));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x),
+                     _mm_unpacklo_epi64(lo, hi));
+  }
+  for (int32_t gx, gy; x < w; ++x) {
+    FocalGradPixel(r0, r1, r2, x, gx, gy);
+    out[x] = SobelMagnitude(gx, gy);
+  }
+}
+
+TRANSFORM_TARGET_AVX2
+inline void FocalMeanRowAVX2(const int32_t* r0, const int32_t* r1,
+                             const int32_t* r2, std::size_t w, int32_t* out) {
+  std::size_t x = 0;
+  for (; x + 8 <= w; x += 8) {
+    __m256i s = _mm256_setzero_si256();
+    for (const int32_t* r : {r0, r1, r2})
+      for (int dx = -1; dx <= 1; ++dx)
+        s = _mm256_add_epi32(s, _mm256_loadu_si256(
+                                    reinterpret_cast<const __m256i*>(r + x + dx)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x),
+                        Div3AVX2(Div3AVX2(s)));
+  }
+  for (; x < w; ++x) out[x] = FocalMeanPixel(r0, r1, r2, x);
+}
+
+TRANSFORM_TARGET_AVX2
+inline void FocalMaxRowAVX2(const int32_t* r0, const int32_t* r1,
+                            const int32_t* r2, std::size_t w, int32_t* out) {
+  std::size_t x = 0;
+  for (; x + 8 <= w; x += 8) {
+    __m256i m = _mm256_set1_epi32(std::numeric_limits<int32_t>::min());
+    for (const int32_t* r : {r0, r1, r2})
+      for (int dx = -1; dx <= 1; ++dx)
+        m = _mm256_max_epi32(m, _mm256_loadu_si256(
+                                    reinterpret_cast<const __m256i*>(r + x + dx)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), m);
+  }
+  for (; x < w; ++x) out[x] = FocalMaxPixel(r0, r1, r2, x);
+}
+
+TRANSFORM_TARGET_AVX2
+inline __m256i Sum121AVX2(__m256i a, __m256i b, __m256i c) {
+  return _mm256_add_epi32(_mm256_add_epi32(a, c), _mm256_add_epi32(b, b));
+}
+
+TRANSFORM_TARGET_AVX2
+inline void FocalGradAVX2(const int32_t* r0, const int32_t* r1,
+                          const int32_t* r2, std::size_t x, __m256i& gx,
+                          __m256i& gy) {
+  const int32_t *a = r0 + x, *b = r1 + x, *c = r2 + x;
+  auto at = [](const int32_t* p) {
+    return reinterpret_cast<const __m256i*>(p);
+  };
+  gx = _mm256_sub_epi32(
+      Sum121AVX2(_mm256_loadu_si256(at(a + 1)), _mm256_loadu_si256(at(b + 1)),
+                 _mm256_loadu_si256(at(c + 1))),
+      Sum121AVX2(_mm256_loadu_si256(at(a - 1)), _mm256_loadu_si256(at(b - 1)),
+                 _mm256_loadu_si256(at(c - 1))));
+  gy = _mm256_sub_epi32(
+      Sum121AVX2(_mm256_loadu_si256(at(c - 1)), _mm256_loadu_si256(at(c)),
+                 _mm256_loadu_si256(at(c + 1))),
+      Sum121AVX2(_mm256_loadu_si256(at(a - 1)), _mm256_loadu_si256(at(a)),
+                 _mm256_loadu_si256(at(a + 1))));
+}
+
+TRANSFORM_TARGET_AVX2
+inline void FocalGradRowAVX2(const int32_t* r0, const int32_t* r1,
+                             const int32_t* r2, std::size_t w, int32_t* gx,
+                             int32_t* gy) {
+  std::size_t x = 0;
+  for (; x + 8 <= w; x += 8) {
+    __m256i vx, vy;
+    FocalGradAVX2(r0, r1, r2, x, vx, vy);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(gx + x), vx);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(gy + x), vy);
+  }
+  for (; x < w; ++x) FocalGradPixel(r0, r1, r2, x, gx[x], gy[x]);
+}
+
+TRANSFORM_TARGET_AVX2
+inline __m128i SobelMagnitude4AVX2(__m128i gx, __m128i gy) {
+  __m256d x = _mm256_cvtepi32_pd(gx), y = _mm256_cvtepi32_pd(gy);
+  return _mm256_cvtpd_epi32(_mm256_sqrt_pd(
+      _mm256_add_pd(_mm256_mul_pd(x, x), _mm256_mul_pd(y, y))));
+}
+
+TRANSFORM_TARGET_AVX2
+inline void FocalSobelRowAVX2(const int32_t* r0, const int32_t* r1,
+                              const int32_t* r2, std::size_t w, int32_t* out) {
+  std::size_t x = 0;
+  for (; x + 8 <= w; x += 8) {
+    __m256i vx, vy;
+    FocalGradAVX2(r0, r1, r2, x, vx, vy);
+    __m128i lo = SobelMagnitude4AVX2(_mm256_castsi256_si128(vx),
+                                     _mm256_castsi256_si128(vy));
+    __m128i hi = SobelMagnitude4AVX2(_mm256_extracti128_si256(vx, 1),
+                                     _mm256_extracti128_si256(vy, 1));
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i*>(out + x),
+        _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1));
+  }
+  for (int32_t gx, gy; x < w; ++x) {
+    FocalGradPixel(r0, r1, r2, x, gx, gy);
+    out[x] = SobelMagnitude(gx, gy);
+  }
+}
+
+TRANSFORM_TARGET_AVX512
+inline void FocalMeanRowAVX512(const int32_t* r0, const int32_t* r1,
+                               const int32_t* r2, std::size_t w, int32_t* out) {
+  std::size_t x = 0;
+  for (; x + 16 <= w; x += 16) {
+    __m512i s = _mm512_setzero_si512();
+    for (const int32_t* r : {r0, r1, r2})
+      for (int dx = -1; dx <= 1; ++dx)
+        s = _mm512_add_epi32(s, _mm512_loadu_si512(r + x + dx));
+    _mm512_storeu_si512(out + x, Div3AVX512(Div3AVX512(s)));
+  }
+  for (; x < w; ++x) out[x] = FocalMeanPixel(r0, r1, r2, x);
+}
+
+TRANSFORM_TARGET_AVX512
+inline void FocalMaxRowAVX512(const int32_t* r0, const int32_t* r1,
+                              const int32_t* r2, std::size_t w, int32_t* out) {
+  std::size_t x = 0;
+  for (; x + 16 <= w; x += 16) {
+    __m512i m = _mm512_set1_epi32(std::numeric_limits<int32_t>::min());
+    for (const int32_t* r : {r0, r1, r2})
+      for (int dx = -1; dx <= 1; ++dx)
+        m = _mm512_max_epi32(m, _mm512_loadu_si512(r + x + dx));
+    _mm512_storeu_si512(out + x, m);
+  }
+  for (; x < w; ++x) out[x] = FocalMaxPixel(r0, r1, r2, x);
+}
+
+TRANSFORM_TARGET_AVX512
+inline __m512i Sum121AVX512(__m512i a, __m512i b, __m512i c) {
+  return _mm512_add_epi32(_mm512_add_epi32(a, c), _mm512_add_epi32(b, b));
+}
+
+TRANSFORM_TARGET_AVX512
+inline void FocalGradAVX512(const int32_t* r0, const int32_t* r1,
+                            const int32_t* r2, std::size_t x, __m512i& gx,
+                            __m512i& gy) {
+  const int32_t *a = r0 + x, *b = r1 + x, *c = r2 + x;
+  gx = _mm512_sub_epi32(
+      Sum121AVX512(_mm512_loadu_si512(a + 1), _mm512_loadu_si512(b + 1),
+                   _mm512_loadu_si512(c + 1)),
+      Sum121AVX512(_mm512_loadu_si512(a - 1), _mm512_loadu_si512(b - 1),
+                   _mm512_loadu_si512(c - 1)));
+  gy = _mm512_sub_epi32(
+      Sum121AVX512(_mm512_loadu_si512(c - 1), _mm512_loadu_si512(c),
+                   _mm512_loadu_si512(c + 1)),
+      Sum121AVX512(_mm512_loadu_si512(a - 1), _mm512_loadu_si512(a),
+                   _mm512_loadu_si512(a + 1)));
+}
+
+TRANSFORM_TARGET_AVX512
+inline void FocalGradRowAVX512(const int32_t* r0, const int32_t* r1,
+                               const int32_t* r2, std::size_t w, int32_t* gx,
+                               int32_t* gy) {
+  std::size_t x = 0;
+  for (; x + 16 <= w; x += 16) {
+    __m512i vx, vy;
+    FocalGradAVX512(r0, r1, r2, x, vx, vy);
+    _mm512_storeu_si512(gx + x, vx);
+    _mm512_storeu_si512(gy + x, vy);
+  }
+  for (; x < w; ++x) FocalGradPixel(r0, r1, r2, x, gx[x], gy[x]);
+}
+
+TRANSFORM_TARGET_AVX512
+inline __m256i SobelMagnitude8AVX512(__m256i gx, __m256i gy) {
+  __m512d x = _mm512_cvtepi32_pd(gx), y = _mm512_cvtepi32_pd(gy);
+  return _mm512_cvtpd_epi32(_mm512_sqrt_pd(
+      _mm512_add_pd(_mm512_mul_pd(x, x), _mm512_mul_pd(y, y))));
+}
+
+TRANSFORM_TARGET_AVX512
+inline void FocalSobelRowAVX512(const int32_t* r0, const int32_t* r1,
+                                const int32_t* r2, std::size_t w,
+                                int32_t* out) {
+  std::size_t x = 0;
+  for (; x + 16 <= w; x += 16) {
+    __m512i vx, vy;
+    FocalGradAVX512(r0, r1, r2, x, vx, vy);
+    __m256i lo = SobelMagnitude8AVX512(_mm512_castsi512_si256(vx),
+                                       _mm512_castsi512_si256(vy));
+    __m256i hi = SobelMagnitude8AVX512(_mm512_extracti64x4_epi64(vx, 1),
+                                       _mm512_extracti64x4_epi64(vy, 1));
+    _mm512_storeu_si512(
+        out + x, _mm512_inserti64x4(_mm512_castsi256_si512(lo), hi, 1));
+  }
+  for (int32_t gx, gy; x < w; ++x) {
+    FocalGradPixel(r0, r1, r2, x, gx, gy);
+    out[x] = SobelMagnitude(gx, gy);
+  }
+}
+
+// Horn slope/aspect from the gradient sums (GDAL's gdaldem conventions).
+inline int32_t HornSlope(int32_t gx, int32_t gy, double cellSize) {
+  double dx = gx / (8 * cellSize), dy = gy / (8 * cellSize);
+  double deg = std::atan(std::sqrt(dx * dx + dy * dy)) * 180 / std::numbers::pi;
+  return static_cast<int32_t>(std::nearbyint(deg * kFocalAngleScale));
+}
+
+inline int32_t HornAspect(int32_t gx, int32_t gy) {
+  if (gx == 0 && gy == 0) return kFlatAspect;
+  double deg = std::atan2(static_cast<double>(gy), -static_cast<double>(gx)) *
+               180 / std::numbers::pi;
+  deg = deg > 90 ? 450 - deg : 90 - deg;
+  int32_t a = static_cast<int32_t>(std::nearbyint(deg * kFocalAngleScale));
+  return a == 360 * kFocalAngleScale ? 0 : a;
+}
+
+// Computes one output row of width `w`; `gx`/`gy` are `w`-value scratch rows
+// used by Slope and Aspect. Dispatches on TransformationSimdLevel().
+inline void FocalRow(FocalOp op, const int32_t* r0, const int32_t* r1,
+                     const int32_t* r2, std::size_t w, int32_t* out,
+                     int32_t* gx, int32_t* gy, const FocalParams& params) {
+  SimdLevel level = TransformationSimdLevel();
+  switch (op) {
+    case FocalOp::Mean:
+      if (level == SimdLevel::AVX512)
+        return FocalMeanRowAVX512(r0, r1, r2, w, out);
+      if (level == SimdLevel::AVX2) return FocalMeanRowAVX2(r0, r1, r2, w, out);
+      if (level == SimdLevel::SSE41)
+        return FocalMeanRowSSE41(r0, r1, r2, w, out);
+      for (std::size_t x = 0; x < w; ++x) out[x] = FocalMeanPixel(r0, r1, r2, x);
+      return;
+    case FocalOp::Max:
+      if (level == SimdLevel::AVX512)
+        return FocalMaxRowAVX512(r0, r1, r2, w, out);
+      if (level == SimdLevel::AVX2) return FocalMaxRowAVX2(r0, r1, r2, w, out);
+      if (level == SimdLevel::SSE41) return FocalMaxRowSSE41(r0, r1, r2, w, out);
+      for (std::size_t x = 0; x < w; ++x) out[x] = FocalMaxPixel(r0, r1, r2, x);
+      return;
+    case FocalOp::Sobel:
+      if (level == SimdLevel::AVX512)
+        return FocalSobelRowAVX512(r0, r1, r2, w, out);
+      if (level == SimdLevel::AVX2)
+        return FocalSobelRowAVX2(r0, r1, r2, w, out);
+      if (level == SimdLevel::SSE41)
+        return FocalSobelRowSSE41(r0, r1, r2, w, out);
+      for (std::size_t x = 0; x < w; ++x) {
+        FocalGradPixel(r0, r1, r2, x, gx[x], gy[x]);
+        out[x] = SobelMagnitude(gx[x], gy[x]);
+      }
+      return;
+    case FocalOp::Slope:
+    case FocalOp::Aspect:
+      if (level == SimdLevel::AVX512)
+        FocalGradRowAVX512(r0, r1, r2, w, gx, gy);
+      else if (level == SimdLevel::AVX2)
+        FocalGradRowAVX2(r0, r1, r2, w, gx, gy);
+      else if (level == SimdLevel::SSE41)
+        FocalGradRowSSE41(r0, r1, r2, w, gx, gy);
+      else
+        for (std::size_t x = 0; x < w; ++x)
+          FocalGradPixel(r0, r1, r2, x, gx[x], gy[x]);
+      // The trigonometry has no SIMD intrinsic; finish per pixel.
+      for (std::size_t x = 0; x < w; ++x)
+        out[x] = op == FocalOp::Slope ? HornSlope(gx[x], gy[x], params.cellSize)
+                                      : HornAspect(gx[x], gy[x]);
+      return;
+  }
+}
+
+//////////////////////////
+// block grid traversal //
+//////////////////////////
+
+struct FocalStats {
+  std::size_t decodeTime = 0;   // band tiles, ns (wall)
+  std::size_t haloTime = 0;     // partial decode of the row below, ns (wall)
+  std::size_t stencilTime = 0;  // ns (wall)
+  std::size_t encodeTime = 0;   // output tiles, ns (wall)
+  std::size_t haloValues = 0;   // values decoded for halos
+};
+
+// Applies `op` to every pixel of `in` and returns the result encoded tile by
+// tile with fresh clones of `outProto`. Tiles of a band are decoded, filtered
+// and encoded on `numThreads` OpenMP threads.
+inline BlockGrid FocalBlockGrid(const BlockGrid& in, FocalOp op,
+                                const StatefulIntegerCodec<int32_t>& outProto,
+                                const FocalParams& params = {},
+                                int numThreads = 1,
+                                FocalStats* stats = nullptr) {
+  const int bs = in.blockSize;
+  const std::size_t n = in.TileLength();
+  const std::size_t overflow = in.MaxOverflow();
+  // Band buffer: bs + 2 rows (halo, band, halo) of width + 2 columns.
+  const std::size_t stride = static_cast<std::size_t>(in.Width()) + 2;
+  std::vector<int32_t> band(stride * (bs + 2));
+  auto row = [&](int y) { return band.data() + stride * y; };
+
+  BlockGrid out;
+  out.blockSize = bs;
+  out.blocksX = in.blocksX;
+  out.blocksY = in.blocksY;
+  out.tiles.resize(in.tiles.size());
+
+  FocalStats local;
+  auto elapsed = [](auto t0) {
+    return static_cast<std::size_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - t0)
+            .count());
+  };
+
+  OmpExceptionGuard guard;
+  for (int by = 0; by < in.blocksY; ++by) {
+    // The last row of the previous band is the halo above this one.
+    if (by > 0) std::copy_n(row(bs), stride, row(0));
+
+    auto t0 = std::chrono::steady_clock::now();
+#pragma omp parallel num_threads(numThreads)
+    {
+      std::vector<int32_t> tile(n + overflow);
+#pragma omp for schedule(dynamic)
+      for (int bx = 0; bx < in.blocksX; ++bx)
+        guard.Run([&] {
+          in.DecodeTile(bx, by, tile.data());
+          for (int y = 0; y < bs; ++y)
+            std::copy_n(tile.data() + static_cast<std::size_t>(y) * bs, bs,
+                        row(y + 1) + 1 + static_cast<std::size_t>(bx) * bs);
+        });
+    }
+    guard.Rethrow();
+    local.decodeTime += elapsed(t0);
+
+    t0 = std::chrono::steady_clock::now();
+    if (by + 1 < in.blocksY) {
+#pragma omp parallel num_threads(numThreads)
+      {
+        std::vector<int32_t> strip(bs + overflow);
+#pragma omp for schedule(dynamic)
+        for (int bx = 0; bx < in.blocksX; ++bx)
+          guard.Run([&] {
+            in.DecodeRows(bx, by + 1, 0, 1, strip.data());
+            std::copy_n(strip.data(), bs,
+                        row(bs + 1) + 1 + static_cast<std::size_t>(bx) * bs);
+          });
+      }
+      guard.Rethrow();
+      local.haloValues += static_cast<std::size_t>(in.Width());
+    } else {
+      std::copy_n(row(bs), stride, row(bs + 1));
+    }
+    if (by == 0) std::copy_n(row(1), stride, row(0));
+    for (int y = 0; y < bs + 2; ++y) {
+      row(y)[0] = row(y)[1];
+      row(y)[stride - 1] = row(y)[stride - 2];
+    }
+    local.haloTime += elapsed(t0);
+
+    std::size_t stencil = 0, encode = 0;
+#pragma omp parallel num_threads(numThreads) reduction(max : stencil, encode)
+    {
+      std::vector<int32_t> tile(n), gx(bs), gy(bs);
+#pragma omp for schedule(dynamic)
+      for (int bx = 0; bx < in.blocksX; ++bx)
+        guard.Run([&] {
+          auto s0 = std::chrono::steady_clock::now();
+          std::size_t x0 = 1 + static_cast<std::size_t>(bx) * bs;
+          for (int y = 0; y < bs; ++y)
+            FocalRow(op, row(y) + x0, row(y + 1) + x0, row(y + 2) + x0, bs,
+                     tile.data() + static_cast<std::size_t>(y) * bs,
+                     gx.data(), gy.data(), params);
+          stencil += elapsed(s0);
+
+          auto e0 = std::chrono::steady_clock::now();
+          auto& dst =
+              out.tiles[static_cast<std::size_t>(by) * in.blocksX + bx];
+          dst.reset(outProto.CloneFresh());
+          dst->AllocEncoded(tile.data(), n);
+          dst->EncodeArray(tile.data(), n);
+          encode += elapsed(e0);
+        });
+    }
+    guard.Rethrow();
+    // Per-thread busy time; the slowest thread bounds the phase.
+    local.stencilTime += stencil;
+    local.encodeTime += encode;
+  }
+
+  if (stats) *stats = local;
+  return out;
+}
@@ -0,0 +1,366 @@
+#pragma once
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "generic_codecs.h"
+#include "util.h"
+
+////////////////////////////////////////////////////////////////////////////
+// multi-band compressed raster. Bands of a tile are correlated, so band  //
+// k > 0 can be stored as a residual against band k-1 (plainly, or after  //
+// a per-tile linear fit) before the physical codec runs. Tiles are kept  //
+// band-sequential (BSQ: one stream per band, so a band can be decoded on //
+// its own) or band-interleaved (BIP: one stream of pixel-interleaved     //
+// values per tile). Decoded tiles are always planar, band after band.    //
+////////////////////////////////////////////////////////////////////////////
+
+enum class BandPrediction {
+  None,      // bands coded independently
+  Previous,  // band k - band k-1
+  Linear,    // band k - (slope * band k-1 + offset), fitted per tile
+};
+
+enum class BandLayout { BSQ, BIP };
+
+inline BandPrediction ParseBandPrediction(const std::string& s) {
+  if (s == "None") return BandPrediction::None;
+  if (s == "Previous") return BandPrediction::Previous;
+  if (s == "Linear") return BandPrediction::Linear;
+  throw std::invalid_argument("Unknown band prediction: " + s);
+}
+
+inline std::string ToString(BandPrediction p) {
+  switch (p) {
+    case BandPrediction::None:
+      return "None";
+    case BandPrediction::Previous:
+      return "Previous";
+    case BandPrediction::Linear:
+      return "Linear";
+  }
+  return "";
+}
+
+inline BandLayout ParseBandLayout(const std::string& s) {
+  if (s == "BSQ") return BandLayout::BSQ;
+  if (s == "BIP") return BandLayout::BIP;
+  throw std::invalid_argument("Unknown band layout: " + s);
+}
+
+inline std::string ToString(BandLayout l) {
+  return l == BandLayout::BSQ ? "BSQ" : "BIP";
+}
+
+//////////////////////////
+// inter-band predictor //
+//////////////////////////
+
+constexpr int kBandSlopeShift = 16;  // slope is fixed point Q16
+
+struct BandPredictor {
+  int32_t slope = 1 << kBandSlopeShift;
+  int32_t offset = 0;
+};
+
+inline int32_t PredictFromBand(int32_t prev, BandPredictor p) {
+  int64_t scaled = (static_cast<int64_t>(p.slope) * prev +
+                    (int64_t{1} << (kBandSlopeShift - 1))) >>
+                   kBandSlopeShift;
+  return static_cast<int32_t>(static_cast<uint32_t>(scaled) +
+                              static_cast<uint32_t>(p.offset));
+}
+
+// Least-squares fit of `cur` on `prev`, quantised to the fixed-point form.
+inline BandPredictor FitBandPredictor(const int32_t* prev, const int32_t* cur,
+                                      std::size_t n) {
+  double sp = 0, sc = 0;
+  for (std::size_t i = 0; i < n; ++i) {
+    sp += prev[i];
+    sc += cur[i];
+  }
+  const double mp = sp / n, mc = sc / n;
+  double cov = 0, var = 0;
+  for (std::size_t i = 0; i < n; ++i) {
+    cov += (prev[i] - mp) * (cur[i] - mc);
+    var += (prev[i] - mp) * (prev[i] - mp);
+  }
+  auto clamp32 = [](double v) {
+    return static_cast<int32_t>(
+        std::clamp(std::nearbyint(v),
+                   double(std::numeric_limits<int32_t>::min()),
+                   double(std::numeric_limits<int32_t>::max())));
+  };
+  BandPredictor p;
+  p.slope = var > 0 ? clamp32(cov / var * (1 << kBandSlopeShift)) : 0;
+  p.offset =
+      clamp32(mc - static_cast<double>(p.slope) / (1 << kBandSlopeShift) * mp);
+  return p;
+}
+
+// Residual kernels, in wrapping arithmetic so every int32 round-trips.
+// Residuals are zigzagged so small negative ones stay small for the
+// physical codecs (bit packers size a block by its largest unsigned value).
+// `stride` is the distance between consecutive pixels of `res` (1 for BSQ,
+// the band count for BIP).
+
+inline int32_t ZigzagResidual(int32_t cur, int32_t pred) {
+  uint32_t d = static_cast<uint32_t>(cur) - static_cast<uint32_t>(pred);
+  return static_cast<int32_t>((d << 1) ^ (0u - (d >> 31)));
+}
+
+inline int32_t UnzigzagResidual(int32_t res, int32_t pred) {
+  uint32_t z = static_cast<uint32_t>(res);
+  return static_cast<int32_t>(((z >> 1) ^ (0u - (z & 1))) +
+                              static_cast<uint32_t>(pred));
+}
+
+inline void BandResidual(const int32_t* prev, const int32_t* cur,
+                         std::size_t n, BandPrediction mode, BandPredictor p,
+                         int32_t* res, std::size_t stride) {
+  if (mode == BandPrediction::Previous) {
+    for (std::size_t i = 0; i < n; ++i)
+      res[i * stride] = ZigzagResidual(cur[i], prev[i]);
+  } else {
+    for (std::size_t i = 0; i < n; ++i)
+      res[i * stride] = ZigzagResidual(cur[i], PredictFromBand(prev[i], p));
+  }
+}
+
+inline void BandReconstruct(const int32_t* prev, const int32_t* res,
+                            std::size_t stride, std::size_t n,
+                            BandPrediction mode, BandPredictor p,
+                            int32_t* cur) {
+  if (mode == BandPrediction::Previous) {
+    for (std::size_t i = 0; i < n; ++i)
+      cur[i] = UnzigzagResidual(res[i * stride], prev[i]);
+  } else {
+    for (std::size_t i = 0; i < n; ++i)
+      cur[i] = UnzigzagResidual(res[i * stride], PredictFromBand(prev[i], p));
+  }
+}
+
+/////////////////////
+// multi-band grid //
+/////////////////////
+
+struct MultiBandGrid {
+  int numBands = 0;
+  int blockSize = 0;
+  int blocksX = 0;
+  int blocksY = 0;
+  BandPrediction prediction = BandPrediction::None;
+  BandLayout layout = BandLayout::BSQ;
+  // BSQ: numBands streams per tile, band after band. BIP: one per tile.
+  std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>> streams;
+  // Linear only: numBands per tile (band 0's entry is unused).
+  std::vector<BandPredictor> predictors;
+
+  std::size_t TileLength() const {
+    return static_cast<std::size_t>(blockSize) * blockSize;
+  }
+  std::size_t NumTiles() const {
+    return static_cast<std::size_t>(blocksX) * blocksY;
+  }
+  int Width() const { return blocksX * blockSize; }
+  int Height() const { return blocksY * blockSize; }
+  int StreamsPerTile() const {
+    return layout == BandLayout::BSQ ? numBands : 1;
+  }
+  std::size_t StreamLength() const {
+    return layout == BandLayout::BSQ ? TileLength() : TileLength() * numBands;
+  }
+
+  StatefulIntegerCodec<int32_t>& Stream(std::size_t tile, int band = 0) const {
+    return *streams[tile * StreamsPerTile() + band];
+  }
+  BandPredictor Predictor(std::size_t tile, int band) const {
+    return prediction == BandPrediction::Linear
+               ? predictors[tile * numBands + band]
+               : BandPredictor{};
+  }
+
+  // Scratch values DecodeTile/DecodeBand need beyond their output.
+  std::size_t ScratchLength() const {
+    std::size_t overflow = 0;
+    for (auto& s : streams)
+      overflow = std::max(overflow, s->GetOverflowSize(StreamLength()));
+    return StreamLength() + overflow;
+  }
+
+  // Decodes all bands of tile (bx, by) into `out` (numBands * TileLength()
+  // values, planar), using `scratch` (ScratchLength() values).
+  void DecodeTile(int bx, int by, int32_t* out, int32_t* scratch) const {
+    const std::size_t t = static_cast<std::size_t>(by) * blocksX + bx;
+    const std::size_t n = TileLength();
+    if (layout == BandLayout::BIP) {
+      Stream(t).DecodeRange(scratch, 0, StreamLength(), StreamLength());
+      for (int b = 0; b < numBands; ++b) {
+        int32_t* cur = out + b * n;
+        if (b == 0 || prediction == BandPrediction::None) {
+          for (std::size_t i = 0; i < n; ++i)
+            cur[i] = scratch[i * numBands + b];
+        } else {
+          BandReconstruct(cur - n, scratch + b, numBands, n, prediction,
+                          Predictor(t, b), cur);
+        }
+      }
+      return;
+    }
+    for (int b = 0; b < numBands; ++b) {
+      int32_t* cur = out + b * n;
+      if (b == 0 || prediction == BandPrediction::None) {
+        DecodeStream(t, b, cur, scratch);
+      } else {
+        DecodeStream(t, b, scratch, scratch);
+        BandReconstruct(cur - n, scratch, 1, n, prediction, Predictor(t, b),
+                        cur);
+      }
+    }
+  }
+
+  // Decodes band `band` of tile (bx, by) into `out` (TileLength() values),
+  // using `scratch` (ScratchLength() values). Without prediction a BSQ tile
+  // reads one stream; otherwise the chain of bands `band` is predicted from
+  // is rebuilt in place in `out` (BIP always reads the whole tile stream).
+  void DecodeBand(int bx, int by, int band, int32_t* out,
+                  int32_t* scratch) const {
+    const std::size_t t = static_cast<std::size_t>(by) * blocksX + bx;
+    const std::size_t n = TileLength();
+    const int first = prediction == BandPrediction::None ? band : 0;
+    if (layout == BandLayout::BIP) {
+      Stream(t).DecodeRange(scratch, 0, StreamLength(), StreamLength());
+      for (std::size_t i = 0; i < n; ++i)
+        out[i] = scratch[i * numBands + first];
+      for (int b = first + 1; b <= band; ++b)
+        BandReconstruct(out, scratch + b, numBands, n, prediction,
+                        Predictor(t, b), out);
+      return;
+    }
+    DecodeStream(t, first, out, scratch);
+    for (int b = first + 1; b <= band; ++b) {
+      DecodeStream(t, b, scratch, scratch);
+      BandReconstruct(out, scratch, 1, n, prediction, Predictor(t, b), out);
+    }
+  }
+
+  std::size_t EncodedBytes() const {
+    std::size_t bytes = predictors.size() * sizeof(BandPredictor);
+    for (auto& s : streams)
+      bytes += s->EncodedNumValues() * s->EncodedSizeValue();
+    return bytes;
+  }
+
+ private:
+  // Decodes one BSQ stream into `out`; codecs may write past the tile end,
+  // so that goes through `scratch` unless `out` already is it.
+  void DecodeStream(std::size_t t, int band, int32_t* out,
+                    int32_t* scratch) const {
+    auto& s = Stream(t, band);
+    const std::size_t n = TileLength();
+    if (out == scratch || s.GetOverflowSize(n) == 0) {
+      s.DecodeRange(out, 0, n, n);
+    } else {
+      s.DecodeRange(scratch, 0, n, n);
+      std::copy_n(scratch, n, out);
+    }
+  }
+};
+
+// Fills one planar tile (numBands * blockSize^2 values) given its position.
+using MultiBandTileReader = std::function<void(int bx, int by, int32_t* tile)>;
+
+// Encodes a multi-band grid with fresh clones of `proto`; `read` must be
+// safe to call concurrently on `numThreads` OpenMP threads. The first
+// exception thrown by `read` or a codec is rethrown once the threads stop.
+inline MultiBandGrid EncodeMultiBandGrid(
+    int numBands, int blocksX, int blocksY, int blockSize,
+    const StatefulIntegerCodec<int32_t>& proto, BandPrediction prediction,
+    BandLayout layout, const MultiBandTileReader& read, int numThreads = 1) {
+  if (numBands <= 0 || blocksX <= 0 || blocksY <= 0 || blockSize <= 0)
+    throw std::invalid_argument(
+        "Multi-band grid needs at least one band and tile, got " +
+        std::to_string(numBands) + " bands of " + std::to_string(blocksX) +
+        "x" + std::to_string(blocksY) + " tiles of size " +
+        std::to_string(blockSize));
+  MultiBandGrid grid;
+  grid.numBands = numBands;
+  grid.blockSize = blockSize;
+  grid.blocksX = blocksX;
+  grid.blocksY = blocksY;
+  grid.prediction = prediction;
+  grid.layout = layout;
+  grid.streams.resize(grid.NumTiles() * grid.StreamsPerTile());
+  if (prediction == BandPrediction::Linear)
+    grid.predictors.resize(grid.NumTiles() * numBands);
+
+  const std::size_t n = grid.TileLength();
+  const std::size_t streamLength = grid.StreamLength();
+  OmpExceptionGuard guard;
+#pragma omp parallel num_threads(numThreads)
+  {
+    std::vector<int32_t> tile(n * numBands), coded(n * numBands);
+#pragma omp for schedule(dynamic)
+    for (std::size_t t = 0; t < grid.NumTiles(); ++t)
+      guard.Run([&] {
+        read(static_cast<int>(t % blocksX), static_cast<int>(t / blocksX),
+             tile.data());
+        const std::size_t stride = layout == BandLayout::BIP ? numBands : 1;
+        for (int b = 0; b < numBands; ++b) {
+          const int32_t* cur = tile.data() + b * n;
+          int32_t* res = layout == BandLayout::BIP ? coded.data() + b
+                                                   : coded.data() + b * n;
+          if (b == 0 || prediction == BandPrediction::None) {
+            for (std::size_t i = 0; i < n; ++i) res[i * stride] = cur[i];
+            continue;
+          }
+          BandPredictor p;
+          if (prediction == BandPrediction::Linear)
+            p = grid.predictors[t * numBands + b] =
+                FitBandPredictor(cur - n, cur, n);
+          BandResidual(cur - n, cur, n, prediction, p, res, stride);
+        }
+        for (int s = 0; s < grid.StreamsPerTile(); ++s) {
+          auto& stream = grid.streams[t * grid.StreamsPerTile() + s];
+          const int32_t* in = coded.data() + s * streamLength;
+          stream.reset(proto.CloneFresh());
+          stream->AllocEncoded(in, streamLength);
+          stream->EncodeArray(in, streamLength);
+        }
+      });
+  }
+  guard.Rethrow();
+  return grid;
+}
+
+// Encodes `numBands` planar row-major rasters of `width` x `height` values.
+inline MultiBandGrid EncodeMultiBandGrid(
+    const int32_t* bands, int numBands, int width, int height, int blockSize,
+    const StatefulIntegerCodec<int32_t>& proto, BandPrediction prediction,
+    BandLayout layout, int numThreads = 1) {
+  const std::size_t plane = static_cast<std::size_t>(width) * height;
+  const std::size_t n = static_cast<std::size_t>(blockSize) * blockSize;
+  return EncodeMultiBandGrid(
+      numBands, width / blockSize, height / blockSize, blockSize, proto,
+      prediction, layout,
+      [&](int bx, int by, int32_t* tile) {
+        for (int b = 0; b < numBands; ++b)
+          for (int y = 0; y < blockSize; ++y)
+            std::copy_n(bands + b * plane +
+                            static_cast<std::size_t>(by * blockSize + y) *
+                                width +
+                            static_cast<std::size_t>(bx) * blockSize,
+                        blockSize,
+                        tile + b * n + static_cast<std::size_t>(y) * blockSize);
+      },
+      numThreads);
+}
@@ -0,0 +1,516 @@
+#pragma once
+
+#include <omp.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bench_utils.h"
+#include "generic_codecs.h"
+
+//////////////////////////////////////////////////////////////////////////
+// streaming tile pipeline: stages run back-to-back on one tile at a time //
+// so intermediates stay cache-resident; tiles are spread over threads. //
+//////////////////////////////////////////////////////////////////////////
+
+// Per-tile working state threaded through the stages of a pipeline.
+struct TileContext {
+  std::unique_ptr<StatefulIntegerCodec<int32_t>>* codec = nullptr;  // grid slot
+  std::vector<int32_t> buf;  // decoded tile, sized blockSize^2 + overflow
+  std::size_t blockSize = 0;
+  int64_t reduction = 0;  // accumulator written by reduction stages
+  bool decoded = false;   // buf is still the grid codec's DecodeArray output
+
+  std::size_t NumValues() const { return blockSize * blockSize; }
+};
+
+class PipelineStage {
+ public:
+  virtual void Apply(TileContext& ctx) = 0;
+
+  virtual std::string name() const = 0;
+
+  // Extra decode-buffer slots this stage needs past blockSize^2.
+  virtual std::size_t GetOverflowSize(std::size_t) const { return 0; }
+
+  // Element-wise stages can also run on a chunk of a tile straight after the
+  // chunk is decoded, while it is still in L1 (see TilePipeline::SetChunkSize).
+  virtual bool Chunkable() const { return false; }
+
+  virtual void ApplyChunk(TileContext&, int32_t*, std::size_t) {}
+
+  // Stages may keep per-thread state, so each thread works on a clone.
+  virtual PipelineStage* CloneFresh() const = 0;
+
+  virtual ~PipelineStage() {}
+};
+
+class DecodeStage : public PipelineStage {
+ public:
+  void Apply(TileContext& ctx) override {
+    auto& codec = *ctx.codec;
+    // Direct access keeps its values in the encoded vector; copy them so
+    // later stages see the same buffer layout as for real codecs.
+    if (codec->name() == "custom_direct_access") {
+      auto& raw = codec->GetEncoded();
+      std::copy(raw.begin(), raw.begin() + ctx.NumValues(), ctx.buf.begin());
+      ctx.decoded = true;
+      return;
+    }
+    codec->DecodeArray(ctx.buf.data(), ctx.NumValues());
+    ctx.decoded = true;
+  }
+
+  std::string name() const override { return "decode"; }
+
+  PipelineStage* CloneFresh() const override { return new DecodeStage(); }
+};
+
+class RemapStage : public PipelineStage {
+ private:
+  Ordering ordering;
+
+ public:
+  explicit RemapStage(Ordering ordering) : ordering{ordering} {}
+
+  void Apply(TileContext& ctx) override {
+    // Remappings expect exactly blockSize^2 values; shrinking keeps capacity.
+    std::size_t full = ctx.buf.size();
+    ctx.buf.resize(ctx.NumValues());
+    ApplyOrdering(ctx.buf, ordering, static_cast<int>(ctx.blockSize));
+    ctx.buf.resize(full);
+    ctx.decoded = false;
+  }
+
+  std::string name() const override { return "remap:" + ToString(ordering); }
+
+  PipelineStage* CloneFresh() const override {
+    return new RemapStage(ordering);
+  }
+};
+
+class TransformStage : public PipelineStage {
+ private:
+  AccessTransformation transformation;
+
+ public:
+  explicit TransformStage(AccessTransformation transformation)
+      : transformation{transformation} {}
+
+  void Apply(TileContext& ctx) override {
+    if (!AccessTransformationMutatesData(transformation)) {
+      // Read-only variants may ask the codec (LinearSumFused), as long as
+      // the buffer is still what it decoded to.
+      ApplyAccessTransformation(ctx.buf, transformation, ctx.blockSize,
+                                ctx.decoded ? ctx.codec->get() : nullptr);
+      return;
+    }
+    // Mutating variants compute block statistics, so hide the overflow.
+    std::size_t full = ctx.buf.size();
+    ctx.buf.resize(ctx.NumValues());
+    ApplyAccessTransformation(ctx.buf, transformation, ctx.blockSize);
+    ctx.buf.resize(full);
+    ctx.decoded = false;
+  }
+
+  bool Chunkable() const override {
+    return AccessTransformationIsElementwise(transformation);
+  }
+
+  void ApplyChunk(TileContext& ctx, int32_t* chunk,
+                  std::size_t count) override {
+    ApplyAccessTransformationChunk(chunk, count, transformation);
+    ctx.decoded = false;
+  }
+
+  std::string name() const override { return ToString(transformation); }
+
+  PipelineStage* CloneFresh() const override {
+    return new TransformStage(transformation);
+  }
+};
+
+// Fused access transformation applied by the tile's codec to its encoded
+// payload; replaces the grid slot (see ApplyFusedAccessTransformation). Place
+// it before `decode` so later stages see the transformed tile.
+class FusedTransformStage : public PipelineStage {
+ private:
+  AccessTransformation transformation;
+
+ public:
+  explicit FusedTransformStage(AccessTransformation transformation)
+      : transformation{transformation} {}
+
+  void Apply(TileContext& ctx) override {
+    ApplyFusedAccessTransformation(*ctx.codec, transformation, ctx.blockSize);
+    ctx.decoded = false;
+  }
+
+  std::string name() const override { return ToString(transformation); }
+
+  PipelineStage* CloneFresh() const override {
+    return new FusedTransformStage(transformation);
+  }
+};
+
+enum class Reduction { Sum, XOR, Min, Max };
+
+inline Reduction ParseReduction(const std::string& s) {
+  if (s == "sum") return Reduction::Sum;
+  if (s == "xor") return Reduction::XOR;
+  if (s == "min") return Reduction::Min;
+  if (s == "max") return Reduction::Max;
+  throw std::invalid_argument("Unknown reduction: " + s);
+}
+
+inline std::string ToString(Reduction r) {
+  switch (r) {
+    case Reduction::Sum:
+      return "sum";
+    case Reduction::XOR:
+      return "xor";
+    case Reduction::Min:
+      return "min";
+    case Reduction::Max:
+      return "max";
+  }
+  return "";
+}
+
+// Identity element so per-thread partials can be combined in any order.
+inline int64_t ReductionIdentity(Reduction r) {
+  switch (r) {
+    case Reduction::Min:
+      return std::numeric_limits<int64_t>::max();
+    case Reduction::Max:
+      return std::numeric_limits<int64_t>::min();
+    default:
+      return 0;
+  }
+}
+
+inline int64_t CombineReduction(Reduction r, int64_t a, int64_t b) {
+  switch (r) {
+    case Reduction::Sum:
+      return a + b;
+    case Reduction::XOR:
+      return a ^ b;
+    case Reduction::Min:
+      return std::min(a, b);
+    case Reduction::Max:
+      return std::max(a, b);
+  }
+  return a;
+}
+
+class ReduceStage : public PipelineStage {
+ private:
+  Reduction reduction;
+
+ public:
+  explicit ReduceStage(Reduction reduction) : reduction{reduction} {}
+
+  void Apply(TileContext& ctx) override {
+    // Sums of nodata tiles cover only the valid pixels.
+    auto* nd = ctx.decoded ? dynamic_cast<NoDataCodec*>(ctx.codec->get())
+                           : nullptr;
+    if (nd && reduction == Reduction::Sum) {
+      ctx.reduction += nd->ValidSum(ctx.NumValues(), ctx.buf.data());
+      return;
+    }
+    ApplyChunk(ctx, ctx.buf.data(), ctx.NumValues());
+  }
+
+  bool Chunkable() const override { return true; }
+
+  void ApplyChunk(TileContext& ctx, int32_t* data, std::size_t n) override {
+    int64_t acc = ReductionIdentity(reduction);
+    switch (reduction) {
+      case Reduction::Sum:
+        // Decoded nodata pixels hold the nodata value and valid ones never
+        // do, so chunks of a nodata tile skip it (see NoDataCodec::ValidSum).
+        if (auto* nd = ctx.decoded
+                           ? dynamic_cast<NoDataCodec*>(ctx.codec->get())
+                           : nullptr) {
+          for (std::size_t i = 0; i < n; ++i)
+            if (data[i] != nd->NoDataValue()) acc += data[i];
+          break;
+        }
+        for (std::size_t i = 0; i < n; ++i) acc += data[i];
+        break;
+      case Reduction::XOR: {
+        int32_t x = 0;
+        for (std::size_t i = 0; i < n; ++i) x ^= data[i];
+        acc = x;
+        break;
+      }
+      case Reduction::Min:
+        if (n > 0) acc = *std::min_element(data, data + n);
+        break;
+      case Reduction::Max:
+        if (n > 0) acc = *std::max_element(data, data + n);
+        break;
+    }
+    ctx.reduction = CombineReduction(reduction, ctx.reduction, acc);
+  }
+
+  Reduction GetReduction() const { return reduction; }
+
+  std::string name() const override { return "reduce:" + ToString(reduction); }
+
+  PipelineStage* CloneFresh() const override {
+    return new ReduceStage(reduction);
+  }
+};
+
+// Re-encodes the tile buffer with a fresh clone of `prototype` and replaces
+// the tile's codec in the grid.
+class EncodeStage : public PipelineStage {
+ private:
+  std::unique_ptr<StatefulIntegerCodec<int32_t>> prototype;
+
+ public:
+  explicit EncodeStage(const StatefulIntegerCodec<int32_t>& prototype)
+      : prototype{prototype.CloneFresh()} {}
+
+  void Apply(TileContext& ctx) override {
+    std::unique_ptr<StatefulIntegerCodec<int32_t>> reenc(
+        prototype->CloneFresh());
+    reenc->AllocEncoded(ctx.buf.data(), ctx.NumValues());
+    reenc->EncodeArray(ctx.buf.data(), ctx.NumValues());
+    *ctx.codec = std::move(reenc);
+    ctx.decoded = false;
+  }
+
+  std::string name() const override { return "encode:" + prototype->name(); }
+
+  std::size_t GetOverflowSize(std::size_t length) const override {
+    return prototype->GetOverflowSize(length);
+  }
+
+  PipelineStage* CloneFresh() const override {
+    return new EncodeStage(*prototype);
+  }
+};
+
+struct PipelineStats {
+  std::vector<std::string> stageNames;
+  std::vector<RunningStats> stageTimes;  // per-tile time of each stage (ns)
+  std::size_t wallTime = 0;              // whole run, all threads (ns)
+  int64_t reduction = 0;
+};
+
+class TilePipeline {
+ private:
+  std::vector<std::unique_ptr<PipelineStage>> stages;
+  std::size_t chunkSize = 0;
+
+  // Stages [first, last) that run chunk-by-chunk: a decode stage followed by
+  // the chunkable stages after it. Empty when chunking is off.
+  std::pair<std::size_t, std::size_t> ChunkedRange() const {
+    if (chunkSize == 0) return {0, 0};
+    for (std::size_t s = 0; s < stages.size(); ++s) {
+      if (!dynamic_cast<DecodeStage*>(stages[s].get())) continue;
+      std::size_t last = s + 1;
+      while (last < stages.size() && stages[last]->Chunkable()) ++last;
+      return {s, last};
+    }
+    return {0, 0};
+  }
+
+  // Decodes the tile through a DecodeCursor and runs the chunkable stages on
+  // each chunk. If later stages need the whole tile, chunks are decoded in
+  // place into ctx.buf; otherwise into `scratch` so the tile is never
+  // materialised.
+  void RunChunked(TileContext& ctx,
+                  std::vector<std::unique_ptr<PipelineStage>>& local,
+                  std::size_t first, std::size_t last,
+                  std::vector<int32_t>& scratch,
+                  std::vector<std::size_t>& stageTime) {
+    std::size_t n = ctx.NumValues();
+    bool materialise = last < local.size();
+
+    auto t0 = std::chrono::steady_clock::now();
+    auto cursor = (*ctx.codec)->NewDecodeCursor(n);
+    std::size_t g = cursor->Granularity();
+    std::size_t k = (chunkSize + g - 1) / g * g;
+    std::size_t need = k + (*ctx.codec)->GetOverflowSize(n);
+    if (!materialise && scratch.size() < need) scratch.resize(need);
+    auto t1 = std::chrono::steady_clock::now();
+    stageTime[first] += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            t1 - t0).count();
+
+    for (std::size_t pos = 0; pos < n;) {
+      int32_t* chunk = materialise ? ctx.buf.data() + pos : scratch.data();
+      auto td0 = std::chrono::steady_clock::now();
+      std::size_t got = cursor->Next(chunk, std::min(k, n - pos));
+      auto td1 = std::chrono::steady_clock::now();
+      stageTime[first] += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                              td1 - td0).count();
+      if (got == 0) break;
+      ctx.decoded = true;
+      for (std::size_t s = first + 1; s < last; ++s) {
+        auto ts0 = std::chrono::steady_clock::now();
+        local[s]->ApplyChunk(ctx, chunk, got);
+        auto ts1 = std::chrono::steady_clock::now();
+        stageTime[s] += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            ts1 - ts0).count();
+      }
+      pos += got;
+    }
+  }
+
+ public:
+  TilePipeline& Add(std::unique_ptr<PipelineStage> stage) {
+    stages.push_back(std::move(stage));
+    return *this;
+  }
+
+  std::size_t NumStages() const { return stages.size(); }
+
+  // Values per chunk for decode-interleaved execution; 0 decodes whole tiles.
+  // Rounded up to the codec's cursor granularity at run time.
+  void SetChunkSize(std::size_t values) { chunkSize = values; }
+
+  std::string name() const {
+    std::string out;
+    for (std::size_t s = 0; s < stages.size(); ++s)
+      out += (s ? ">" : "") + stages[s]->name();
+    return out;
+  }
+
+  // Runs every stage on each tile in turn. Tiles are distributed over
+  // `numThreads` OpenMP threads; each thread owns its stage clones, decode
+  // buffer and timing accumulators, which are merged at the end. With a chunk
+  // size set, decode and the chunkable stages after it are interleaved.
+  PipelineStats Run(
+      std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>>& tiles,
+      std::size_t blockSize, int numThreads) {
+    PipelineStats stats;
+    for (auto& stage : stages) stats.stageNames.push_back(stage->name());
+    stats.stageTimes.resize(stages.size());
+
+    // All reduction stages of a pipeline must agree on how to combine.
+    Reduction combine = Reduction::Sum;
+    const ReduceStage* first = nullptr;
+    for (auto& stage : stages) {
+      auto* r = dynamic_cast<ReduceStage*>(stage.get());
+      if (r == nullptr) continue;
+      if (first && r->GetReduction() != combine)
+        throw std::invalid_argument("Pipeline reductions disagree: " +
+                                    first->name() + " and " + r->name());
+      if (!first) first = r;
+      combine = r->GetReduction();
+    }
+    stats.reduction = ReductionIdentity(combine);
+
+    // Only fused transformations work on the encoded tile; everything else
+    // reads the decode buffer, which is stale until a decode stage has run.
+    for (auto& stage : stages) {
+      if (dynamic_cast<DecodeStage*>(stage.get())) break;
+      if (!dynamic_cast<FusedTransformStage*>(stage.get()))
+        throw std::invalid_argument("Pipeline stage " + stage->name() +
+                                    " runs before decode");
+    }
+
+    std::size_t n = blockSize * blockSize;
+    std::size_t overflow = 0;
+    for (auto& tile : tiles)
+      overflow = std::max(overflow, tile->GetOverflowSize(n));
+    for (auto& stage : stages)
+      overflow = std::max(overflow, stage->GetOverflowSize(n));
+    auto [chunkFirst, chunkLast] = ChunkedRange();
+
+    OmpExceptionGuard guard;
+    auto tStart = std::chrono::steady_clock::now();
+#pragma omp parallel num_threads(numThreads)
+    {
+      std::vector<std::unique_ptr<PipelineStage>> local;
+      for (auto& stage : stages) local.emplace_back(stage->CloneFresh());
+      std::vector<RunningStats> localTimes(stages.size());
+
+      TileContext ctx;
+      ctx.blockSize = blockSize;
+      ctx.buf.resize(n + overflow);
+      ctx.reduction = ReductionIdentity(combine);
+      std::vector<int32_t> scratch;  // grown to the rounded chunk on demand
+      std::vector<std::size_t> stageTime(local.size());
+
+#pragma omp for schedule(dynamic)
+      for (std::size_t t = 0; t < tiles.size(); ++t)
+        guard.Run([&] {
+          ctx.codec = &tiles[t];
+          ctx.decoded = false;
+          std::fill(stageTime.begin(), stageTime.end(), 0);
+          for (std::size_t s = 0; s < local.size(); ++s) {
+            if (s == chunkFirst && chunkLast > chunkFirst) {
+              RunChunked(ctx, local, chunkFirst, chunkLast, scratch,
+                         stageTime);
+              s = chunkLast - 1;
+              continue;
+            }
+            auto t0 = std::chrono::steady_clock::now();
+            local[s]->Apply(ctx);
+            auto t1 = std::chrono::steady_clock::now();
+            stageTime[s] =
+                std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0)
+                    .count();
+          }
+          for (std::size_t s = 0; s < local.size(); ++s)
+            localTimes[s].Update(stageTime[s]);
+        });
+
+#pragma omp critical
+      {
+        for (std::size_t s = 0; s < localTimes.size(); ++s)
+          stats.stageTimes[s].Merge(localTimes[s]);
+        stats.reduction =
+            CombineReduction(combine, stats.reduction, ctx.reduction);
+      }
+    }
+    guard.Rethrow();
+    auto tEnd = std::chrono::steady_clock::now();
+    stats.wallTime =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(tEnd - tStart)
+            .count();
+    return stats;
+  }
+};
+
+// Builds a pipeline from a comma-separated spec, e.g.
+// "decode,remap:morton,Threshold,reduce:sum,encode". Any other token is
+// parsed as an access transformation. `encode` uses `accessCodec`.
+inline TilePipeline ParsePipeline(
+    const std::string& spec, const StatefulIntegerCodec<int32_t>& accessCodec) {
+  TilePipeline pipeline;
+  std::stringstream ss(spec);
+  std::string token;
+  while (std::getline(ss, token, ',')) {
+    if (token == "decode")
+      pipeline.Add(std::make_unique<DecodeStage>());
+    else if (token == "encode")
+      pipeline.Add(std::make_unique<EncodeStage>(accessCodec));
+    else if (token.starts_with("remap:"))
+      pipeline.Add(std::make_unique<RemapStage>(ParseOrdering(token.substr(6))));
+    else if (token.starts_with("reduce:"))
+      pipeline.Add(
+          std::make_unique<ReduceStage>(ParseReduction(token.substr(7))));
+    else if (AccessTransformationIsFused(ParseAccessTransformation(token)))
+      pipeline.Add(std::make_unique<FusedTransformStage>(
+          ParseAccessTransformation(token)));
+    else
+      pipeline.Add(
+          std::make_unique<TransformStage>(ParseAccessTransformation(token)));
+  }
+  if (pipeline.NumStages() == 0)
+    throw std::invalid_argument("Empty pipeline: " + spec);
+  return pipeline;
+}
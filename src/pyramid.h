@@ -0,0 +1,304 @@
+#pragma once
+
+#include <omp.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "block_grid.h"
+#include "morton.h"
+#include "transformations_simd.h"
+
+//////////////////////////////////////////////////////////////////////////////
+// overview pyramid built straight from a compressed BlockGrid. Every level //
+// keeps the base block size, so a level-L tile is the 2x2 downsample of    //
+// four level-(L-1) tiles. The quadtree is walked depth first with children //
+// in Morton order: each base tile is decoded exactly once, every level's   //
+// tile is finished (and re-encoded) as soon as its four children are, and  //
+// a thread only ever holds one tile per level.                             //
+//////////////////////////////////////////////////////////////////////////////
+
+enum class Resampling {
+  Mean,     // (a + b + c + d + 2) >> 2; sums of four values must fit int32
+  Nearest,  // top-left value of each 2x2 block
+};
+
+inline Resampling ParseResampling(const std::string& s) {
+  if (s == "Mean") return Resampling::Mean;
+  if (s == "Nearest") return Resampling::Nearest;
+  throw std::invalid_argument("Unknown resampling: " + s);
+}
+
+inline std::string ToString(Resampling r) {
+  switch (r) {
+    case Resampling::Mean:
+      return "Mean";
+    case Resampling::Nearest:
+      return "Nearest";
+  }
+  return "";
+}
+
+struct PyramidStats {
+  std::size_t decodeTime = 0;      // ns (all threads)
+  std::size_t downsampleTime = 0;  // ns (all threads)
+  std::size_t encodeTime = 0;      // ns (all threads)
+  std::size_t wallTime = 0;        // ns
+  std::size_t tilesDecoded = 0;    // base tiles
+};
+
+/////////////////////////
+// downsample kernels  //
+/////////////////////////
+
+// Each kernel halves one row pair: out[i] combines r0[2i], r0[2i+1], r1[2i]
+// and r1[2i+1] for i < w / 2 (w even).
+
+inline void DownsampleRowsScalar(const int32_t* r0, const int32_t* r1,
+                                 std::size_t w, int32_t* out, Resampling r) {
+  if (r == Resampling::Nearest) {
+    for (std::size_t i = 0; i < w / 2; ++i) out[i] = r0[2 * i];
+    return;
+  }
+  for (std::size_t i = 0; i < w / 2; ++i) {
+    // Wrapping adds keep the scalar path identical to the vector ones.
+    uint32_t s = static_cast<uint32_t>(r0[2 * i]) + r0[2 * i + 1] +
+                 r1[2 * i] + r1[2 * i + 1] + 2;
+    out[i] = static_cast<int32_t>(s) >> 2;
+  }
+}
+
+inline void DownsampleRowsSSE41(const int32_t* r0, const int32_t* r1,
+                                std::size_t w, int32_t* out, Resampling r) {
+  std::size_t i = 0;
+  const __m128i two = _mm_set1_epi32(2);
+  for (; i + 8 <= w; i += 8) {
+    __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r0 + i));
+    __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r0 + i + 4));
+    __m128i res;
+    if (r == Resampling::Nearest) {
+      res = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a0),
+                                            _mm_castsi128_ps(a1),
+                                            _MM_SHUFFLE(2, 0, 2, 0)));
+    } else {
+      __m128i s0 = _mm_add_epi32(
+          a0, _mm_loadu_si128(reinterpret_cast<const __m128i*>(r1 + i)));
+      __m128i s1 = _mm_add_epi32(
+          a1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(r1 + i + 4)));
+      res = _mm_srai_epi32(_mm_add_epi32(_mm_hadd_epi32(s0, s1), two), 2);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i / 2), res);
+  }
+  DownsampleRowsScalar(r0 + i, r1 + i, w - i, out + i / 2, r);
+}
+
+TRANSFORM_TARGET_AVX2
+inline void DownsampleRowsAVX2(const int32_t* r0, const int32_t* r1,
+                               std::size_t w, int32_t* out, Resampling r) {
+  std::size_t i = 0;
+  const __m256i two = _mm256_set1_epi32(2);
+  for (; i + 16 <= w; i += 16) {
+    __m256i a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(r0 + i));
+    __m256i a1 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(r0 + i + 8));
+    __m256i res;
+    if (r == Resampling::Nearest) {
+      res = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(a0),
+                                                  _mm256_castsi256_ps(a1),
+                                                  _MM_SHUFFLE(2, 0, 2, 0)));
+    } else {
+      __m256i s0 = _mm256_add_epi32(
+          a0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(r1 + i)));
+      __m256i s1 = _mm256_add_epi32(
+          a1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(r1 + i + 8)));
+      res = _mm256_srai_epi32(_mm256_add_epi32(_mm256_hadd_epi32(s0, s1), two),
+                              2);
+    }
+    // Both ops work per 128-bit lane: restore a0-pairs, a1-pairs order.
+    res = _mm256_permute4x64_epi64(res, _MM_SHUFFLE(3, 1, 2, 0));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i / 2), res);
+  }
+  DownsampleRowsScalar(r0 + i, r1 + i, w - i, out + i / 2, r);
+}
+
+TRANSFORM_TARGET_AVX512
+inline void DownsampleRowsAVX512(const int32_t* r0, const int32_t* r1,
+                                 std::size_t w, int32_t* out, Resampling r) {
+  std::size_t i = 0;
+  const __m512i even = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 16, 18,
+                                         20, 22, 24, 26, 28, 30);
+  const __m512i odd = _mm512_add_epi32(even, _mm512_set1_epi32(1));
+  const __m512i two = _mm512_set1_epi32(2);
+  for (; i + 32 <= w; i += 32) {
+    __m512i a0 = _mm512_loadu_si512(r0 + i);
+    __m512i a1 = _mm512_loadu_si512(r0 + i + 16);
+    __m512i res;
+    if (r == Resampling::Nearest) {
+      res = _mm512_permutex2var_epi32(a0, even, a1);
+    } else {
+      __m512i s0 = _mm512_add_epi32(a0, _mm512_loadu_si512(r1 + i));
+      __m512i s1 = _mm512_add_epi32(a1, _mm512_loadu_si512(r1 + i + 16));
+      res = _mm512_add_epi32(_mm512_permutex2var_epi32(s0, even, s1),
+                             _mm512_permutex2var_epi32(s0, odd, s1));
+      res = _mm512_srai_epi32(_mm512_add_epi32(res, two), 2);
+    }
+    _mm512_storeu_si512(out + i / 2, res);
+  }
+  DownsampleRowsScalar(r0 + i, r1 + i, w - i, out + i / 2, r);
+}
+
+// Dispatches on TransformationSimdLevel().
+inline void DownsampleRows(const int32_t* r0, const int32_t* r1, std::size_t w,
+                           int32_t* out, Resampling r) {
+  switch (TransformationSimdLevel()) {
+    case SimdLevel::AVX512:
+      return DownsampleRowsAVX512(r0, r1, w, out, r);
+    case SimdLevel::AVX2:
+      return DownsampleRowsAVX2(r0, r1, w, out, r);
+    case SimdLevel::SSE41:
+      return DownsampleRowsSSE41(r0, r1, w, out, r);
+    case SimdLevel::Scalar:
+      return DownsampleRowsScalar(r0, r1, w, out, r);
+  }
+}
+
+// Halves a row-major `bs` x `bs` tile into `out`, whose rows are `stride`
+// values apart.
+inline void DownsampleTile(const int32_t* tile, int bs, int32_t* out,
+                           std::size_t stride, Resampling r) {
+  for (int y = 0; y < bs; y += 2)
+    DownsampleRows(tile + static_cast<std::size_t>(y) * bs,
+                   tile + static_cast<std::size_t>(y + 1) * bs, bs,
+                   out + static_cast<std::size_t>(y / 2) * stride, r);
+}
+
+////////////////////////
+// pyramid traversal  //
+////////////////////////
+
+// Levels a grid supports: halve until a level would have no full tile.
+inline int MaxPyramidLevels(const BlockGrid& base) {
+  int levels = 0;
+  while ((base.blocksX >> (levels + 1)) > 0 && (base.blocksY >> (levels + 1)) > 0)
+    ++levels;
+  return levels;
+}
+
+// Builds overview levels 1..numLevels (0 = MaxPyramidLevels) of `base`;
+// result[k] has factor 2^(k+1) and (blocksX >> (k+1)) x (blocksY >> (k+1))
+// tiles of base.blockSize, each encoded with a fresh clone of `proto`.
+// Base tiles outside every level-1 tile (odd remainders) are not read.
+inline std::vector<BlockGrid> BuildPyramid(
+    const BlockGrid& base, const StatefulIntegerCodec<int32_t>& proto,
+    Resampling resampling, int numLevels = 0, int numThreads = 1,
+    PyramidStats* stats = nullptr) {
+  const int bs = base.blockSize;
+  if (bs % 2 != 0)
+    throw std::invalid_argument("Pyramid needs an even block size, got " +
+                                std::to_string(bs));
+  const int maxLevels = MaxPyramidLevels(base);
+  if (numLevels == 0) numLevels = maxLevels;
+  if (numLevels < 1 || numLevels > maxLevels)
+    throw std::invalid_argument(
+        "A " + std::to_string(base.blocksX) + "x" +
+        std::to_string(base.blocksY) + " tile grid supports 1.." +
+        std::to_string(maxLevels) + " pyramid levels, got " +
+        std::to_string(numLevels));
+
+  std::vector<BlockGrid> levels(numLevels);
+  for (int l = 1; l <= numLevels; ++l) {
+    BlockGrid& g = levels[l - 1];
+    g.blockSize = bs;
+    g.blocksX = base.blocksX >> l;
+    g.blocksY = base.blocksY >> l;
+    g.tiles.resize(static_cast<std::size_t>(g.blocksX) * g.blocksY);
+  }
+
+  // Subtree roots: every top-level tile, plus lower-level tiles whose parent
+  // falls in a dropped remainder. Each root is visited in Morton order.
+  std::vector<std::tuple<int, int, int>> roots;  // level, x, y
+  for (int l = numLevels; l >= 1; --l) {
+    const BlockGrid& g = levels[l - 1];
+    const int coveredX = l < numLevels ? 2 * levels[l].blocksX : 0;
+    const int coveredY = l < numLevels ? 2 * levels[l].blocksY : 0;
+    std::vector<std::pair<uint_fast32_t, std::pair<int, int>>> order;
+    for (int y = 0; y < g.blocksY; ++y)
+      for (int x = 0; x < g.blocksX; ++x)
+        if (x >= coveredX || y >= coveredY)
+          order.push_back({libmorton::morton2D_32_encode(x, y), {x, y}});
+    std::sort(order.begin(), order.end());
+    for (auto& [code, xy] : order) roots.emplace_back(l, xy.first, xy.second);
+  }
+
+  const std::size_t n = base.TileLength();
+  const std::size_t overflow = base.MaxOverflow();
+  const std::size_t half = static_cast<std::size_t>(bs / 2);
+  std::size_t decodeTime = 0, downsampleTime = 0, encodeTime = 0,
+              tilesDecoded = 0;
+  auto elapsed = [](auto t0) {
+    return static_cast<std::size_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - t0)
+            .count());
+  };
+  OmpExceptionGuard guard;
+  auto tStart = std::chrono::steady_clock::now();
+#pragma omp parallel num_threads(numThreads) \
+    reduction(+ : decodeTime, downsampleTime, encodeTime, tilesDecoded)
+  {
+    // scratch[l]: the level-l tile under construction (scratch[0]: decoded
+    // base tile). Fits in cache for the usual block sizes.
+    std::vector<std::vector<int32_t>> scratch(numLevels + 1);
+    scratch[0].resize(n + overflow);
+    for (int l = 1; l <= numLevels; ++l) scratch[l].resize(n);
+
+    // Leaves tile (x, y) of level l in scratch[l].
+    auto build = [&](auto& self, int l, int x, int y) -> void {
+      if (l == 0) {
+        auto t0 = std::chrono::steady_clock::now();
+        base.DecodeTile(x, y, scratch[0].data());
+        decodeTime += elapsed(t0);
+        ++tilesDecoded;
+        return;
+      }
+      int32_t* parent = scratch[l].data();
+      for (int q = 0; q < 4; ++q) {  // Morton order: NW, NE, SW, SE
+        const int dx = q & 1, dy = q >> 1;
+        self(self, l - 1, 2 * x + dx, 2 * y + dy);
+        auto t0 = std::chrono::steady_clock::now();
+        DownsampleTile(scratch[l - 1].data(), bs,
+                       parent + dy * half * bs + dx * half, bs, resampling);
+        downsampleTime += elapsed(t0);
+      }
+      auto t0 = std::chrono::steady_clock::now();
+      BlockGrid& g = levels[l - 1];
+      auto& tile = g.tiles[static_cast<std::size_t>(y) * g.blocksX + x];
+      tile.reset(proto.CloneFresh());
+      tile->AllocEncoded(parent, n);
+      tile->EncodeArray(parent, n);
+      encodeTime += elapsed(t0);
+    };
+
+#pragma omp for schedule(dynamic)
+    for (std::size_t r = 0; r < roots.size(); ++r)
+      guard.Run([&] {
+        auto [l, x, y] = roots[r];
+        build(build, l, x, y);
+      });
+  }
+  guard.Rethrow();
+
+  if (stats) {
+    stats->decodeTime = decodeTime;
+    stats->downsampleTime = downsampleTime;
+    stats->encodeTime = encodeTime;
+    stats->wallTime = elapsed(tStart);
+    stats->tilesDecoded = tilesDecoded;
+  }
+  return levels;
+}
@@ -0,0 +1,305 @@
+#pragma once
+
+#include <omp.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "generic_codecs.h"
+#include "multiband.h"
+#include "util.h"
+
+////////////////////////////////////////////////////////////////////////////
+// time-series raster stack: the same grid observed day after day. Day t  //
+// of a tile is stored against day t-1 (by XOR or by zigzagged            //
+// subtraction) as a change bitmap over square sub-blocks plus the        //
+// residuals of the changed sub-blocks only, so sub-blocks that did not   //
+// change cost one bit. Every `keyframeInterval` days a tile is stored    //
+// whole (a keyframe), which bounds how many days a random read of day k  //
+// replays.                                                               //
+////////////////////////////////////////////////////////////////////////////
+
+enum class TemporalPrediction {
+  Xor,       // day t ^ day t-1
+  Subtract,  // zigzag(day t - day t-1)
+};
+
+inline TemporalPrediction ParseTemporalPrediction(const std::string& s) {
+  if (s == "Xor") return TemporalPrediction::Xor;
+  if (s == "Subtract") return TemporalPrediction::Subtract;
+  throw std::invalid_argument("Unknown temporal prediction: " + s);
+}
+
+inline std::string ToString(TemporalPrediction p) {
+  return p == TemporalPrediction::Xor ? "Xor" : "Subtract";
+}
+
+// Residual kernels over one sub-block row; both leave unchanged pixels 0.
+
+inline void TemporalResidual(const int32_t* prev, const int32_t* cur,
+                             std::size_t n, TemporalPrediction mode,
+                             int32_t* res) {
+  if (mode == TemporalPrediction::Xor) {
+    for (std::size_t i = 0; i < n; ++i) res[i] = cur[i] ^ prev[i];
+  } else {
+    for (std::size_t i = 0; i < n; ++i)
+      res[i] = ZigzagResidual(cur[i], prev[i]);
+  }
+}
+
+// Turns day t-1 into day t in place.
+inline void TemporalApply(const int32_t* res, std::size_t n,
+                          TemporalPrediction mode, int32_t* cur) {
+  if (mode == TemporalPrediction::Xor) {
+    for (std::size_t i = 0; i < n; ++i) cur[i] ^= res[i];
+  } else {
+    for (std::size_t i = 0; i < n; ++i)
+      cur[i] = UnzigzagResidual(res[i], cur[i]);
+  }
+}
+
+// One tile on one day. A keyframe holds the tile in `values`; a delta frame
+// holds the changed sub-blocks' residuals, sub-block after sub-block in
+// bitmap order (no stream when nothing changed).
+struct TimeStackFrame {
+  std::vector<uint64_t> changed;  // delta frames: bit s = sub-block s changed
+  std::size_t numValues = 0;
+  std::unique_ptr<StatefulIntegerCodec<int32_t>> values;
+};
+
+struct TimeStack {
+  int numDays = 0;
+  int blockSize = 0;
+  int blocksX = 0;
+  int blocksY = 0;
+  int subBlockSize = 0;
+  int keyframeInterval = 1;
+  TemporalPrediction prediction = TemporalPrediction::Subtract;
+  // Day-major: frames[day * NumTiles() + tile].
+  std::vector<TimeStackFrame> frames;
+
+  std::size_t TileLength() const {
+    return static_cast<std::size_t>(blockSize) * blockSize;
+  }
+  std::size_t NumTiles() const {
+    return static_cast<std::size_t>(blocksX) * blocksY;
+  }
+  int Width() const { return blocksX * blockSize; }
+  int Height() const { return blocksY * blockSize; }
+  int SubBlocksPerSide() const { return blockSize / subBlockSize; }
+  std::size_t NumSubBlocks() const {
+    return static_cast<std::size_t>(SubBlocksPerSide()) * SubBlocksPerSide();
+  }
+  bool IsKeyframe(int day) const { return day % keyframeInterval == 0; }
+
+  const TimeStackFrame& Frame(int day, std::size_t tile) const {
+    return frames[static_cast<std::size_t>(day) * NumTiles() + tile];
+  }
+
+  // Scratch values DecodeTile needs beyond its output.
+  std::size_t ScratchLength() const {
+    std::size_t overflow = 0;
+    for (auto& f : frames)
+      if (f.values)
+        overflow = std::max(overflow, f.values->GetOverflowSize(f.numValues));
+    return TileLength() + overflow;
+  }
+
+  // Decodes tile (bx, by) on `day` into `out` (TileLength() values), using
+  // `scratch` (ScratchLength() values): the last keyframe at or before `day`,
+  // then each later day's changed sub-blocks.
+  void DecodeTile(int day, int bx, int by, int32_t* out,
+                  int32_t* scratch) const {
+    if (day < 0 || day >= numDays)
+      throw std::out_of_range("Day " + std::to_string(day) + " of " +
+                              std::to_string(numDays));
+    if (bx < 0 || bx >= blocksX || by < 0 || by >= blocksY)
+      throw std::out_of_range("Tile " + std::to_string(bx) + "," +
+                              std::to_string(by) + " outside the " +
+                              std::to_string(blocksX) + "x" +
+                              std::to_string(blocksY) + " grid");
+    const std::size_t t = static_cast<std::size_t>(by) * blocksX + bx;
+    const int key = day - day % keyframeInterval;
+    const TimeStackFrame& keyframe = Frame(key, t);
+    const std::size_t n = TileLength();
+    if (keyframe.values->GetOverflowSize(n) == 0) {
+      keyframe.values->DecodeArray(out, n);
+    } else {
+      keyframe.values->DecodeArray(scratch, n);
+      std::copy_n(scratch, n, out);
+    }
+    for (int d = key + 1; d <= day; ++d) ApplyDay(Frame(d, t), out, scratch);
+  }
+
+  // Encoded bytes of one day (all tiles), change bitmaps included.
+  std::size_t DayBytes(int day) const {
+    std::size_t bytes = 0;
+    for (std::size_t t = 0; t < NumTiles(); ++t) {
+      const TimeStackFrame& f = Frame(day, t);
+      bytes += f.changed.size() * sizeof(uint64_t);
+      if (f.values)
+        bytes += f.values->EncodedNumValues() * f.values->EncodedSizeValue();
+    }
+    return bytes;
+  }
+
+  std::size_t EncodedBytes() const {
+    std::size_t bytes = 0;
+    for (int d = 0; d < numDays; ++d) bytes += DayBytes(d);
+    return bytes;
+  }
+
+ private:
+  // Applies a delta frame's residuals to the previous day's tile in `out`.
+  void ApplyDay(const TimeStackFrame& f, int32_t* out,
+                int32_t* scratch) const {
+    if (!f.values) return;
+    f.values->DecodeArray(scratch, f.numValues);
+    const int s = subBlockSize, perSide = SubBlocksPerSide();
+    const int32_t* res = scratch;
+    for (std::size_t w = 0; w < f.changed.size(); ++w)
+      for (uint64_t bits = f.changed[w]; bits; bits &= bits - 1) {
+        const std::size_t sb = w * 64 + __builtin_ctzll(bits);
+        const int sx = static_cast<int>(sb % perSide) * s;
+        const int sy = static_cast<int>(sb / perSide) * s;
+        for (int y = 0; y < s; ++y, res += s)
+          TemporalApply(
+              res, s, prediction,
+              out + static_cast<std::size_t>(sy + y) * blockSize + sx);
+      }
+  }
+};
+
+// Fills one tile (blockSize^2 values, row-major) of `day`.
+using TimeStackTileReader =
+    std::function<void(int day, int bx, int by, int32_t* tile)>;
+
+// Encodes `numDays` days of a blocksX x blocksY tile grid with fresh clones
+// of `proto`. Each tile's days are encoded in order against the day before.
+// The residuals are XORs or zigzagged differences, where a small error in
+// the code is not a small error in the value, so `proto` must be lossless
+// (MaxAbsError() == 0 after every encode, else invalid_argument); the
+// previous input is then exactly what a decoder rebuilds. Tiles run in
+// parallel, and `read` must be safe to call concurrently on `numThreads`
+// OpenMP threads. The first exception thrown by `read` or a codec is
+// rethrown once the threads stop.
+inline TimeStack EncodeTimeStack(int numDays, int blocksX, int blocksY,
+                                 int blockSize, int subBlockSize,
+                                 int keyframeInterval,
+                                 const StatefulIntegerCodec<int32_t>& proto,
+                                 TemporalPrediction prediction,
+                                 const TimeStackTileReader& read,
+                                 int numThreads = 1) {
+  if (numDays <= 0 || blocksX <= 0 || blocksY <= 0 || blockSize <= 0)
+    throw std::invalid_argument(
+        "Time stack needs at least one day and tile, got " +
+        std::to_string(numDays) + " days of " + std::to_string(blocksX) + "x" +
+        std::to_string(blocksY) + " tiles of size " +
+        std::to_string(blockSize));
+  if (subBlockSize <= 0 || blockSize % subBlockSize != 0)
+    throw std::invalid_argument("Sub-block size " +
+                                std::to_string(subBlockSize) +
+                                " must divide the block size " +
+                                std::to_string(blockSize));
+  if (keyframeInterval <= 0)
+    throw std::invalid_argument("Keyframe interval must be positive");
+  TimeStack stack;
+  stack.numDays = numDays;
+  stack.blockSize = blockSize;
+  stack.blocksX = blocksX;
+  stack.blocksY = blocksY;
+  stack.subBlockSize = subBlockSize;
+  stack.keyframeInterval = keyframeInterval;
+  stack.prediction = prediction;
+  stack.frames.resize(static_cast<std::size_t>(numDays) * stack.NumTiles());
+
+  const std::size_t n = stack.TileLength();
+  const int s = subBlockSize, perSide = stack.SubBlocksPerSide();
+  const std::size_t words = (stack.NumSubBlocks() + 63) / 64;
+  OmpExceptionGuard guard;
+#pragma omp parallel num_threads(numThreads)
+  {
+    std::vector<int32_t> prev(n), cur(n), res(n);
+#pragma omp for schedule(dynamic)
+    for (std::size_t t = 0; t < stack.NumTiles(); ++t)
+      guard.Run([&] {
+        const int bx = static_cast<int>(t % blocksX);
+        const int by = static_cast<int>(t / blocksX);
+        for (int day = 0; day < numDays; ++day) {
+          read(day, bx, by, cur.data());
+          TimeStackFrame& f = stack.frames[static_cast<std::size_t>(day) *
+                                               stack.NumTiles() +
+                                           t];
+          const int32_t* in = cur.data();
+          if (stack.IsKeyframe(day)) {
+            f.numValues = n;
+          } else {
+            f.changed.assign(words, 0);
+            std::size_t m = 0;
+            for (std::size_t sb = 0; sb < stack.NumSubBlocks(); ++sb) {
+              const std::size_t origin =
+                  (sb / perSide) * s * static_cast<std::size_t>(blockSize) +
+                  (sb % perSide) * s;
+              bool same = true;
+              for (int y = 0; y < s && same; ++y) {
+                const std::size_t row = origin + static_cast<std::size_t>(y) *
+                                                     blockSize;
+                same = std::memcmp(&cur[row], &prev[row],
+                                   s * sizeof(int32_t)) == 0;
+              }
+              if (same) continue;
+              f.changed[sb / 64] |= uint64_t{1} << (sb % 64);
+              for (int y = 0; y < s; ++y, m += s) {
+                const std::size_t row = origin + static_cast<std::size_t>(y) *
+                                                     blockSize;
+                TemporalResidual(&prev[row], &cur[row], s, prediction, &res[m]);
+              }
+            }
+            f.numValues = m;
+            in = res.data();
+          }
+          if (f.numValues > 0) {
+            f.values.reset(proto.CloneFresh());
+            f.values->AllocEncoded(in, f.numValues);
+            f.values->EncodeArray(in, f.numValues);
+            if (f.values->MaxAbsError() != 0)
+              throw std::invalid_argument(
+                  "Time stacks need a lossless codec, " + f.values->name() +
+                  " is lossy");
+          }
+          prev.swap(cur);
+        }
+      });
+  }
+  guard.Rethrow();
+  return stack;
+}
+
+// Encodes `numDays` row-major rasters of `width` x `height` values, day
+// after day.
+inline TimeStack EncodeTimeStack(const int32_t* days, int numDays, int width,
+                                 int height, int blockSize, int subBlockSize,
+                                 int keyframeInterval,
+                                 const StatefulIntegerCodec<int32_t>& proto,
+                                 TemporalPrediction prediction,
+                                 int numThreads = 1) {
+  const std::size_t plane = static_cast<std::size_t>(width) * height;
+  return EncodeTimeStack(
+      numDays, width / blockSize, height / blockSize, blockSize, subBlockSize,
+      keyframeInterval, proto, prediction,
+      [&](int day, int bx, int by, int32_t* tile) {
+        for (int y = 0; y < blockSize; ++y)
+          std::copy_n(days + day * plane +
+                          static_cast<std::size_t>(by * blockSize + y) * width +
+                          static_cast<std::size_t>(bx) * blockSize,
+                      blockSize,
+                      tile + static_cast<std::size_t>(y) * blockSize);
+      },
+      numThreads);
+}
@@ -4,31 +4,74 @@
 #include <cstdint>
 #include <vector>
 
+#include "transformations_simd.h"
+
+// The vectorisable transformations dispatch on TransformationSimdLevel();
+// SimdLevel::Scalar keeps the plain loops as a reference.
+
+inline void ValueShift(int32_t* data, std::size_t n, int32_t delta) {
+  switch (TransformationSimdLevel()) {
+    case SimdLevel::AVX512:
+      return ValueShiftAVX512(data, n, delta);
+    case SimdLevel::AVX2:
+      return ValueShiftAVX2(data, n, delta);
+    case SimdLevel::SSE41:
+      return ValueShiftSSE41(data, n, delta);
+    case SimdLevel::Scalar:
+      for (std::size_t i = 0; i < n; ++i) data[i] += delta;
+  }
+}
+
 // EXPECTED BEST FOLLOWING COMPRESSION METHOD: bitpack
 inline void Threshold(std::vector<int32_t>& data, int32_t threshold_value) {
-  for (auto& v : data) v = v >= threshold_value ? 1 : 0;
+  switch (TransformationSimdLevel()) {
+    case SimdLevel::AVX512:
+      return ThresholdAVX512(data.data(), data.size(), threshold_value);
+    case SimdLevel::AVX2:
+      return ThresholdAVX2(data.data(), data.size(), threshold_value);
+    case SimdLevel::SSE41:
+      return ThresholdSSE41(data.data(), data.size(), threshold_value);
+    case SimdLevel::Scalar:
+      for (auto& v : data) v = v >= threshold_value ? 1 : 0;
+  }
 }
 
 // EXPECTED BEST FOLLOWING COMPRESSION METHOD: delta
+// Smooths in place: the interior is overwritten left to right while the
+// original left neighbour is carried along, so no temporary is allocated.
 inline void SmoothAndShift(std::vector<int32_t>& data) {
   if (data.size() < 2) return;
+  std::size_t n = data.size();
+  int32_t* d = data.data();
 
-  std::vector<int32_t> smoothed(data.size(), 0);
-
-  for (std::size_t i = 1; i < data.size() - 1; ++i) {
-    smoothed[i] = (data[i - 1] + data[i] + data[i + 1]) / 3;
-  }
-  smoothed[0] = (data[0] + data[1]) / 2;
-  smoothed.back() = (data[data.size() - 2] + data.back()) / 2;
-
-  int32_t minVal = *std::ranges::min_element(smoothed);
-  if (minVal < 0) {
-    int32_t shift = -minVal;
-    for (std::size_t i = 0; i < smoothed.size(); ++i)
-      data[i] = smoothed[i] + shift;
-  } else {
-    std::ranges::copy(smoothed, data.begin());
+  int32_t first = (d[0] + d[1]) / 2;
+  int32_t last = (d[n - 2] + d[n - 1]) / 2;
+  int32_t minVal = std::min(first, last);
+  switch (TransformationSimdLevel()) {
+    case SimdLevel::AVX512:
+      minVal = std::min(minVal, Smooth3AVX512(d, n));
+      break;
+    case SimdLevel::AVX2:
+      minVal = std::min(minVal, Smooth3AVX2(d, n));
+      break;
+    case SimdLevel::SSE41:
+      minVal = std::min(minVal, Smooth3SSE41(d, n));
+      break;
+    case SimdLevel::Scalar: {
+      int32_t left = d[0];
+      for (std::size_t i = 1; i + 1 < n; ++i) {
+        int32_t cur = d[i];
+        d[i] = (left + cur + d[i + 1]) / 3;
+        minVal = std::min(minVal, d[i]);
+        left = cur;
+      }
+      break;
+    }
   }
+  d[0] = first;
+  d[n - 1] = last;
+
+  if (minVal < 0) ValueShift(d, n, -minVal);
 }
 
 // EXPECTED BEST FOLLOWING COMPRESSION METHOD: rle
@@ -46,18 +89,48 @@ inline void IndexBasedClassification(std::vector<int32_t>& data,
 // EXPECTED BEST FOLLOWING COMPRESSION METHOD: dict or rle
 inline void ValueBasedClassification(std::vector<int32_t>& data,
                                      int num_classes) {
-  int32_t minVal = *std::ranges::min_element(data);
-  int32_t maxVal = *std::ranges::max_element(data);
+  if (data.empty()) return;
+  SimdLevel level = TransformationSimdLevel();
+  int32_t minVal, maxVal;
+  switch (level) {
+    case SimdLevel::AVX512:
+      MinMaxAVX512(data.data(), data.size(), minVal, maxVal);
+      break;
+    case SimdLevel::AVX2:
+      MinMaxAVX2(data.data(), data.size(), minVal, maxVal);
+      break;
+    case SimdLevel::SSE41:
+      MinMaxSSE41(data.data(), data.size(), minVal, maxVal);
+      break;
+    default:  // Scalar
+      minVal = *std::ranges::min_element(data);
+      maxVal = *std::ranges::max_element(data);
+      break;
+  }
   int32_t range = maxVal - minVal;
   int32_t binSize = range / (num_classes - 1);
 
-  for (auto& val : data) {
-    val = (range == 0 || binSize == 0) ? 0 : (val - minVal) / binSize;
-    val = std::min(val, num_classes - 1);
+  if (range == 0 || binSize == 0) {
+    std::ranges::fill(data, 0);
+    return;
+  }
+  switch (level) {
+    case SimdLevel::AVX512:
+      return ClassifyAVX512(data.data(), data.size(), minVal, binSize,
+                            num_classes - 1);
+    case SimdLevel::AVX2:
+      return ClassifyAVX2(data.data(), data.size(), minVal, binSize,
+                          num_classes - 1);
+    case SimdLevel::SSE41:
+      return ClassifySSE41(data.data(), data.size(), minVal, binSize,
+                           num_classes - 1);
+    case SimdLevel::Scalar:
+      for (auto& val : data)
+        val = std::min((val - minVal) / binSize, num_classes - 1);
   }
 }
 
 // EXPECTED BEST FOLLOWING COMPRESSION METHOD: for
 inline void ValueShift(std::vector<int32_t>& data, int32_t delta) {
-  for (auto& v : data) v += delta;
+  ValueShift(data.data(), data.size(), delta);
 }
@@ -0,0 +1,392 @@
+#pragma once
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+// Explicitly vectorised kernels behind the transformations in
+// transformations.h. The build only assumes SSE4.1, so AVX2/AVX-512 kernels
+// are compiled per function with target attributes and chosen at run time.
+
+#define TRANSFORM_TARGET_AVX2 __attribute__((target("avx2")))
+#define TRANSFORM_TARGET_AVX512 __attribute__((target("avx512f")))
+
+enum class SimdLevel { Scalar, SSE41, AVX2, AVX512 };
+
+inline SimdLevel DetectSimdLevel() {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) return SimdLevel::AVX512;
+  if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+  return SimdLevel::SSE41;  // baseline of the build flags
+}
+
+inline SimdLevel ParseSimdLevel(const std::string& s) {
+  if (s == "auto") return DetectSimdLevel();
+  if (s == "scalar") return SimdLevel::Scalar;
+  if (s == "sse41") return SimdLevel::SSE41;
+  if (s == "avx2") return SimdLevel::AVX2;
+  if (s == "avx512") return SimdLevel::AVX512;
+  throw std::invalid_argument("Unknown SIMD level: " + s);
+}
+
+inline std::string ToString(SimdLevel l) {
+  switch (l) {
+    case SimdLevel::Scalar:
+      return "scalar";
+    case SimdLevel::SSE41:
+      return "sse41";
+    case SimdLevel::AVX2:
+      return "avx2";
+    case SimdLevel::AVX512:
+      return "avx512";
+  }
+  return "";
+}
+
+// Kernel set used by the transformations; defaults to the best the CPU has.
+inline SimdLevel& TransformationSimdLevel() {
+  static SimdLevel level = DetectSimdLevel();
+  return level;
+}
+
+inline void SetTransformationSimdLevel(SimdLevel l) {
+  if (l > DetectSimdLevel())
+    throw std::invalid_argument("CPU does not support " + ToString(l));
+  TransformationSimdLevel() = l;
+}
+
+///////////////
+// threshold //
+///////////////
+
+inline void ThresholdSSE41(int32_t* d, std::size_t n, int32_t t) {
+  const __m128i vt = _mm_set1_epi32(t), one = _mm_set1_epi32(1);
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(d + i));
+    // v >= t  <=>  !(t > v)
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(d + i),
+                     _mm_andnot_si128(_mm_cmpgt_epi32(vt, v), one));
+  }
+  for (; i < n; ++i) d[i] = d[i] >= t ? 1 : 0;
+}
+
+TRANSFORM_TARGET_AVX2
+inline void ThresholdAVX2(int32_t* d, std::size_t n, int32_t t) {
+  const __m256i vt = _mm256_set1_epi32(t), one = _mm256_set1_epi32(1);
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(d + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(d + i),
+                        _mm256_andnot_si256(_mm256_cmpgt_epi32(vt, v), one));
+  }
+  for (; i < n; ++i) d[i] = d[i] >= t ? 1 : 0;
+}
+
+TRANSFORM_TARGET_AVX512
+inline void ThresholdAVX512(int32_t* d, std::size_t n, int32_t t) {
+  const __m512i vt = _mm512_set1_epi32(t), one = _mm512_set1_epi32(1);
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __mmask16 ge = _mm512_cmpge_epi32_mask(_mm512_loadu_si512(d + i), vt);
+    _mm512_storeu_si512(d + i, _mm512_maskz_mov_epi32(ge, one));
+  }
+  if (i < n) {
+    __mmask16 tail = static_cast<__mmask16>((1u << (n - i)) - 1);
+    __m512i v = _mm512_maskz_loadu_epi32(tail, d + i);
+    __mmask16 ge = _mm512_mask_cmpge_epi32_mask(tail, v, vt);
+    _mm512_mask_storeu_epi32(d + i, tail, _mm512_maskz_mov_epi32(ge, one));
+  }
+}
+
+/////////////////
+// value shift //
+/////////////////
+
+inline void ValueShiftSSE41(int32_t* d, std::size_t n, int32_t delta) {
+  const __m128i vd = _mm_set1_epi32(delta);
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(d + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(d + i), _mm_add_epi32(v, vd));
+  }
+  for (; i < n; ++i) d[i] += delta;
+}
+
+TRANSFORM_TARGET_AVX2
+inline void ValueShiftAVX2(int32_t* d, std::size_t n, int32_t delta) {
+  const __m256i vd = _mm256_set1_epi32(delta);
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(d + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(d + i),
+                        _mm256_add_epi32(v, vd));
+  }
+  for (; i < n; ++i) d[i] += delta;
+}
+
+TRANSFORM_TARGET_AVX512
+inline void ValueShiftAVX512(int32_t* d, std::size_t n, int32_t delta) {
+  const __m512i vd = _mm512_set1_epi32(delta);
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16)
+    _mm512_storeu_si512(d + i,
+                        _mm512_add_epi32(_mm512_loadu_si512(d + i), vd));
+  if (i < n) {
+    __mmask16 tail = static_cast<__mmask16>((1u << (n - i)) - 1);
+    __m512i v = _mm512_maskz_loadu_epi32(tail, d + i);
+    _mm512_mask_storeu_epi32(d + i, tail, _mm512_add_epi32(v, vd));
+  }
+}
+
+/////////////
+// min/max //
+/////////////
+
+inline void MinMaxSSE41(const int32_t* d, std::size_t n, int32_t& lo,
+                        int32_t& hi) {
+  __m128i vlo = _mm_set1_epi32(std::numeric_limits<int32_t>::max());
+  __m128i vhi = _mm_set1_epi32(std::numeric_limits<int32_t>::min());
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(d + i));
+    vlo = _mm_min_epi32(vlo, v);
+    vhi = _mm_max_epi32(vhi, v);
+  }
+  alignas(16) int32_t l[4], h[4];
+  _mm_store_si128(reinterpret_cast<__m128i*>(l), vlo);
+  _mm_store_si128(reinterpret_cast<__m128i*>(h), vhi);
+  lo = *std::min_element(l, l + 4);
+  hi = *std::max_element(h, h + 4);
+  for (; i < n; ++i) {
+    lo = std::min(lo, d[i]);
+    hi = std::max(hi, d[i]);
+  }
+}
+
+TRANSFORM_TARGET_AVX2
+inline void MinMaxAVX2(const int32_t* d, std::size_t n, int32_t& lo,
+                       int32_t& hi) {
+  __m256i vlo = _mm256_set1_epi32(std::numeric_limits<int32_t>::max());
+  __m256i vhi = _mm256_set1_epi32(std::numeric_limits<int32_t>::min());
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(d + i));
+    vlo = _mm256_min_epi32(vlo, v);
+    vhi = _mm256_max_epi32(vhi, v);
+  }
+  alignas(32) int32_t l[8], h[8];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(l), vlo);
+  _mm256_store_si256(reinterpret_cast<__m256i*>(h), vhi);
+  lo = *std::min_element(l, l + 8);
+  hi = *std::max_element(h, h + 8);
+  for (; i < n; ++i) {
+    lo = std::min(lo, d[i]);
+    hi = std::max(hi, d[i]);
+  }
+}
+
+TRANSFORM_TARGET_AVX512
+inline void MinMaxAVX512(const int32_t* d, std::size_t n, int32_t& lo,
+                         int32_t& hi) {
+  __m512i vlo = _mm512_set1_epi32(std::numeric_limits<int32_t>::max());
+  __m512i vhi = _mm512_set1_epi32(std::numeric_limits<int32_t>::min());
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m512i v = _mm512_loadu_si512(d + i);
+    vlo = _mm512_min_epi32(vlo, v);
+    vhi = _mm512_max_epi32(vhi, v);
+  }
+  lo = _mm512_reduce_min_epi32(vlo);
+  hi = _mm512_reduce_max_epi32(vhi);
+  for (; i < n; ++i) {
+    lo = std::min(lo, d[i]);
+    hi = std::max(hi, d[i]);
+  }
+}
+
+////////////////////////////////
+// value-based classification //
+////////////////////////////////
+
+// (v - minVal) / binSize is computed in double: both operands fit in 32
+// bits, so the truncated quotient is exact and matches integer division.
+
+inline void ClassifySSE41(int32_t* d, std::size_t n, int32_t minVal,
+                          int32_t binSize, int32_t maxClass) {
+  const __m128i vmin = _mm_set1_epi32(minVal), vcap = _mm_set1_epi32(maxClass);
+  const __m128d vbin = _mm_set1_pd(binSize);
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128i v = _mm_sub_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(d + i)), vmin);
+    __m128i qlo = _mm_cvttpd_epi32(_mm_div_pd(_mm_cvtepi32_pd(v), vbin));
+    __m128i qhi = _mm_cvttpd_epi32(
+        _mm_div_pd(_mm_cvtepi32_pd(_mm_unpackhi_epi64(v, v)), vbin));
+    __m128i q = _mm_unpacklo_epi64(qlo, qhi);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(d + i), _mm_min_epi32(q, vcap));
+  }
+  for (; i < n; ++i) d[i] = std::min((d[i] - minVal) / binSize, maxClass);
+}
+
+TRANSFORM_TARGET_AVX2
+inline void ClassifyAVX2(int32_t* d, std::size_t n, int32_t minVal,
+                         int32_t binSize, int32_t maxClass) {
+  const __m256i vmin = _mm256_set1_epi32(minVal),
+                vcap = _mm256_set1_epi32(maxClass);
+  const __m256d vbin = _mm256_set1_pd(binSize);
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i v = _mm256_sub_epi32(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(d + i)), vmin);
+    __m128i qlo = _mm256_cvttpd_epi32(_mm256_div_pd(
+        _mm256_cvtepi32_pd(_mm256_castsi256_si128(v)), vbin));
+    __m128i qhi = _mm256_cvttpd_epi32(_mm256_div_pd(
+        _mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1)), vbin));
+    __m256i q = _mm256_inserti128_si256(_mm256_castsi128_si256(qlo), qhi, 1);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(d + i),
+                        _mm256_min_epi32(q, vcap));
+  }
+  for (; i < n; ++i) d[i] = std::min((d[i] - minVal) / binSize, maxClass);
+}
+
+TRANSFORM_TARGET_AVX512
+inline void ClassifyAVX512(int32_t* d, std::size_t n, int32_t minVal,
+                           int32_t binSize, int32_t maxClass) {
+  const __m512i vmin = _mm512_set1_epi32(minVal),
+                vcap = _mm512_set1_epi32(maxClass);
+  const __m512d vbin = _mm512_set1_pd(binSize);
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m512i v = _mm512_sub_epi32(_mm512_loadu_si512(d + i), vmin);
+    __m256i qlo = _mm512_cvttpd_epi32(_mm512_div_pd(
+        _mm512_cvtepi32_pd(_mm512_castsi512_si256(v)), vbin));
+    __m256i qhi = _mm512_cvttpd_epi32(_mm512_div_pd(
+        _mm512_cvtepi32_pd(_mm512_extracti64x4_epi64(v, 1)), vbin));
+    __m512i q = _mm512_inserti64x4(_mm512_castsi256_si512(qlo), qhi, 1);
+    _mm512_storeu_si512(d + i, _mm512_min_epi32(q, vcap));
+  }
+  for (; i < n; ++i) d[i] = std::min((d[i] - minVal) / binSize, maxClass);
+}
+
+//////////////////////////////////
+// in-place 3-tap smoothing     //
+//////////////////////////////////
+
+// Each kernel writes (d[i-1] + d[i] + d[i+1]) / 3 for 1 <= i < n-1 over the
+// input without a temporary: the previous *original* vector is carried in a
+// register, so the left neighbour survives the store. Returns the minimum
+// written value. Edges are handled by the caller. Division by 3 uses the
+// signed multiply-high by 0x55555556 plus a sign correction (truncation).
+
+inline int32_t Div3Scalar(int32_t x) {
+  return static_cast<int32_t>((static_cast<int64_t>(x) * 0x55555556LL) >> 32) +
+         static_cast<int32_t>(static_cast<uint32_t>(x) >> 31);
+}
+
+inline __m128i Div3SSE41(__m128i x) {
+  const __m128i m = _mm_set1_epi32(0x55555556);
+  __m128i even = _mm_srli_epi64(_mm_mul_epi32(x, m), 32);
+  __m128i odd = _mm_mul_epi32(_mm_srli_epi64(x, 32), m);
+  __m128i hi = _mm_blend_epi16(even, odd, 0xCC);
+  return _mm_add_epi32(hi, _mm_srli_epi32(x, 31));
+}
+
+// Scalar tail shared by the vector kernels: smooths [i, n-1) given the
+// original value at i-1.
+inline int32_t Smooth3Tail(int32_t* d, std::size_t i, std::size_t n,
+                           int32_t left, int32_t lo) {
+  for (; i + 1 < n; ++i) {
+    int32_t cur = d[i];
+    d[i] = Div3Scalar(left + cur + d[i + 1]);
+    lo = std::min(lo, d[i]);
+    left = cur;
+  }
+  return lo;
+}
+
+inline int32_t Smooth3SSE41(int32_t* d, std::size_t n) {
+  __m128i prev = _mm_set1_epi32(d[0]);  // only the top lane is used
+  __m128i vlo = _mm_set1_epi32(std::numeric_limits<int32_t>::max());
+  std::size_t i = 1;
+  for (; i + 4 < n; i += 4) {
+    __m128i cur = _mm_loadu_si128(reinterpret_cast<const __m128i*>(d + i));
+    __m128i right =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(d + i + 1));
+    __m128i left = _mm_alignr_epi8(cur, prev, 12);
+    __m128i s = Div3SSE41(_mm_add_epi32(_mm_add_epi32(left, cur), right));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(d + i), s);
+    vlo = _mm_min_epi32(vlo, s);
+    prev = cur;
+  }
+  alignas(16) int32_t l[4];
+  _mm_store_si128(reinterpret_cast<__m128i*>(l), vlo);
+  int32_t lo = *std::min_element(l, l + 4);
+  return Smooth3Tail(d, i, n, _mm_extract_epi32(prev, 3), lo);
+}
+
+TRANSFORM_TARGET_AVX2
+inline __m256i Div3AVX2(__m256i x) {
+  const __m256i m = _mm256_set1_epi32(0x55555556);
+  __m256i even = _mm256_srli_epi64(_mm256_mul_epi32(x, m), 32);
+  __m256i odd = _mm256_mul_epi32(_mm256_srli_epi64(x, 32), m);
+  __m256i hi = _mm256_blend_epi32(even, odd, 0xAA);
+  return _mm256_add_epi32(hi, _mm256_srli_epi32(x, 31));
+}
+
+TRANSFORM_TARGET_AVX2
+inline int32_t Smooth3AVX2(int32_t* d, std::size_t n) {
+  __m256i prev = _mm256_set1_epi32(d[0]);
+  __m256i vlo = _mm256_set1_epi32(std::numeric_limits<int32_t>::max());
+  std::size_t i = 1;
+  for (; i + 8 < n; i += 8) {
+    __m256i cur = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(d + i));
+    __m256i right =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(d + i + 1));
+    // [prev.hi, cur.lo] lets alignr shift across the 128-bit lane boundary.
+    __m256i cross = _mm256_permute2x128_si256(prev, cur, 0x21);
+    __m256i left = _mm256_alignr_epi8(cur, cross, 12);
+    __m256i s = Div3AVX2(_mm256_add_epi32(_mm256_add_epi32(left, cur), right));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(d + i), s);
+    vlo = _mm256_min_epi32(vlo, s);
+    prev = cur;
+  }
+  alignas(32) int32_t l[8];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(l), vlo);
+  int32_t lo = *std::min_element(l, l + 8);
+  return Smooth3Tail(d, i, n, _mm256_extract_epi32(prev, 7), lo);
+}
+
+TRANSFORM_TARGET_AVX512
+inline __m512i Div3AVX512(__m512i x) {
+  const __m512i m = _mm512_set1_epi32(0x55555556);
+  __m512i even = _mm512_srli_epi64(_mm512_mul_epi32(x, m), 32);
+  __m512i odd = _mm512_mul_epi32(_mm512_srli_epi64(x, 32), m);
+  __m512i hi = _mm512_mask_blend_epi32(0xAAAA, even, odd);
+  return _mm512_add_epi32(hi, _mm512_srli_epi32(x, 31));
+}
+
+TRANSFORM_TARGET_AVX512
+inline int32_t Smooth3AVX512(int32_t* d, std::size_t n) {
+  __m512i prev = _mm512_set1_epi32(d[0]);
+  __m512i vlo = _mm512_set1_epi32(std::numeric_limits<int32_t>::max());
+  std::size_t i = 1;
+  for (; i + 16 < n; i += 16) {
+    __m512i cur = _mm512_loadu_si512(d + i);
+    __m512i right = _mm512_loadu_si512(d + i + 1);
+    __m512i left = _mm512_alignr_epi32(cur, prev, 15);
+    __m512i s = Div3AVX512(_mm512_add_epi32(_mm512_add_epi32(left, cur), right));
+    _mm512_storeu_si512(d + i, s);
+    vlo = _mm512_min_epi32(vlo, s);
+    prev = cur;
+  }
+  int32_t lo = _mm512_reduce_min_epi32(vlo);
+  alignas(64) int32_t p[16];
+  _mm512_store_si512(p, prev);
+  return Smooth3Tail(d, i, n, p[15], lo);
+}
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <atomic>
 #include <cmath>
+#include <exception>
 #include <numeric>
 #include <string>
 #include <vector>
@@ -44,3 +46,30 @@ inline float Variance(const std::vector<std::size_t>& values, float meanValue) {
       });
   return sq_sum / static_cast<float>(values.size());
 }
+
+// An exception escaping an OpenMP parallel region calls std::terminate, so
+// loop bodies inside one run through Run, which keeps the first exception
+// thrown on any thread and skips the iterations after it; Rethrow, called
+// once the region has ended, rethrows it on the calling thread.
+class OmpExceptionGuard {
+ private:
+  std::exception_ptr first;
+  std::atomic<bool> failed{false};
+
+ public:
+  template <typename F>
+  void Run(F&& body) {
+    if (failed.load(std::memory_order_relaxed)) return;
+    try {
+      body();
+    } catch (...) {
+#pragma omp critical(omp_exception_guard)
+      if (!first) first = std::current_exception();
+      failed.store(true, std::memory_order_relaxed);
+    }
+  }
+
+  void Rethrow() const {
+    if (first) std::rethrow_exception(first);
+  }
+};
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <omp.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "block_grid.h"
+
+/////////////////////////////////////////////////////////////////////////////
+// window queries over a compressed BlockGrid: a pixel or geo-referenced   //
+// bounding box is mapped to the tiles it intersects (the grid is its own  //
+// tile index: tile (bx, by) covers [bx * B, (bx + 1) * B) x ...), only    //
+// those tiles are decoded, and the window is assembled row-major. Tiles   //
+// cut by the window's top or bottom edge decode just the rows it needs    //
+// through the codec's partial decode; constant tiles are just filled.     //
+/////////////////////////////////////////////////////////////////////////////
+
+struct PixelWindow {
+  int x = 0;  // left column
+  int y = 0;  // top row
+  int width = 0;
+  int height = 0;
+
+  bool Empty() const { return width <= 0 || height <= 0; }
+  std::size_t Size() const {
+    return Empty() ? 0 : static_cast<std::size_t>(width) * height;
+  }
+  bool operator==(const PixelWindow&) const = default;
+};
+
+inline std::string ToString(const PixelWindow& w) {
+  return std::to_string(w.x) + "," + std::to_string(w.y) + "," +
+         std::to_string(w.width) + "x" + std::to_string(w.height);
+}
+
+// Intersection of `w` with [0, width) x [0, height); empty if disjoint.
+inline PixelWindow ClipWindow(const PixelWindow& w, int width, int height) {
+  int x0 = std::max(w.x, 0), y0 = std::max(w.y, 0);
+  int x1 = std::min(w.x + w.width, width), y1 = std::min(w.y + w.height, height);
+  if (x1 <= x0 || y1 <= y0) return {x0, y0, 0, 0};
+  return {x0, y0, x1 - x0, y1 - y0};
+}
+
+// GDAL geotransform: geoX = gt[0] + col * gt[1] + row * gt[2],
+//                    geoY = gt[3] + col * gt[4] + row * gt[5].
+struct GeoTransform {
+  std::array<double, 6> gt = {0, 1, 0, 0, 0, 1};
+
+  void ToGeo(double col, double row, double& geoX, double& geoY) const {
+    geoX = gt[0] + col * gt[1] + row * gt[2];
+    geoY = gt[3] + col * gt[4] + row * gt[5];
+  }
+
+  void ToPixel(double geoX, double geoY, double& col, double& row) const {
+    double det = gt[1] * gt[5] - gt[2] * gt[4];
+    if (det == 0) throw std::invalid_argument("Geotransform is not invertible");
+    double dx = geoX - gt[0], dy = geoY - gt[3];
+    col = (dx * gt[5] - dy * gt[2]) / det;
+    row = (dy * gt[1] - dx * gt[4]) / det;
+  }
+};
+
+// Smallest pixel window covering the geo box [minX, maxX] x [minY, maxY]
+// (all four corners are mapped, so rotated transforms are covered too).
+// Not clipped to the raster.
+inline PixelWindow GeoToPixelWindow(const GeoTransform& t, double minX,
+                                    double minY, double maxX, double maxY) {
+  if (minX > maxX || minY > maxY)
+    throw std::invalid_argument("Geo window has min > max");
+  double c0 = INFINITY, r0 = INFINITY, c1 = -INFINITY, r1 = -INFINITY;
+  for (double gx : {minX, maxX})
+    for (double gy : {minY, maxY}) {
+      double c, r;
+      t.ToPixel(gx, gy, c, r);
+      c0 = std::min(c0, c), c1 = std::max(c1, c);
+      r0 = std::min(r0, r), r1 = std::max(r1, r);
+    }
+  // Tolerate round-off so pixel-aligned boxes don't pick up an extra pixel.
+  constexpr double eps = 1e-9;
+  int x0 = static_cast<int>(std::floor(c0 + eps));
+  int y0 = static_cast<int>(std::floor(r0 + eps));
+  int x1 = static_cast<int>(std::ceil(c1 - eps));
+  int y1 = static_cast<int>(std::ceil(r1 - eps));
+  return {x0, y0, std::max(x1 - x0, 1), std::max(y1 - y0, 1)};
+}
+
+struct WindowQueryStats {
+  std::size_t tilesFull = 0;     // decoded whole
+  std::size_t tilesPartial = 0;  // decoded rows only
+  std::size_t tilesFilled = 0;   // constant, filled without decoding
+  std::size_t tilesSkipped = 0;  // outside the window, never touched
+  std::size_t rowsDecoded = 0;   // tile rows decoded across both kinds
+  std::size_t wallTime = 0;
+};
+
+// Reads `w` (inside the grid) into `out` (w.Size() values, row-major,
+// stride w.width), decoding only the intersecting tiles on `numThreads`
+// OpenMP threads.
+inline void ReadWindow(const BlockGrid& grid, const PixelWindow& w,
+                       int32_t* out, int numThreads = 1,
+                       WindowQueryStats* stats = nullptr) {
+  auto t0 = std::chrono::steady_clock::now();
+  if (w.Empty() || ClipWindow(w, grid.Width(), grid.Height()) != w)
+    throw std::invalid_argument("Window " + ToString(w) +
+                                " is empty or outside the " +
+                                std::to_string(grid.Width()) + "x" +
+                                std::to_string(grid.Height()) + " grid");
+  const int B = grid.blockSize;
+  const int bx0 = w.x / B, bx1 = (w.x + w.width - 1) / B;
+  const int by0 = w.y / B, by1 = (w.y + w.height - 1) / B;
+  const int spanX = bx1 - bx0 + 1;
+  const int numTiles = spanX * (by1 - by0 + 1);
+  std::size_t full = 0, partial = 0, filled = 0, rows = 0;
+  OmpExceptionGuard guard;
+#pragma omp parallel num_threads(numThreads) \
+    reduction(+ : full, partial, filled, rows)
+  {
+    std::vector<int32_t> tile(grid.TileLength() + grid.MaxOverflow());
+#pragma omp for schedule(dynamic)
+    for (int i = 0; i < numTiles; ++i)
+      guard.Run([&] {
+        const int bx = bx0 + i % spanX, by = by0 + i / spanX;
+        // Tile-local rows [r0, r1) and columns [c0, c1) inside the window.
+        const int r0 = std::max(w.y - by * B, 0);
+        const int r1 = std::min(w.y + w.height - by * B, B);
+        const int c0 = std::max(w.x - bx * B, 0);
+        const int c1 = std::min(w.x + w.width - bx * B, B);
+        int32_t value;
+        if (grid.TileConstant(bx, by, value)) {
+          for (int r = r0; r < r1; ++r)
+            std::fill_n(
+                out + static_cast<std::size_t>(by * B + r - w.y) * w.width +
+                    (bx * B + c0 - w.x),
+                c1 - c0, value);
+          ++filled;
+          return;
+        }
+        // Partial decodes write tile row r0 to buffer row 0.
+        int firstRow = 0;
+        if (r0 == 0 && r1 == B) {
+          grid.DecodeTile(bx, by, tile.data());
+          ++full;
+        } else {
+          grid.DecodeRows(bx, by, r0, r1 - r0, tile.data());
+          firstRow = r0;
+          ++partial;
+        }
+        rows += r1 - r0;
+        for (int r = r0; r < r1; ++r) {
+          const int32_t* src =
+              tile.data() + static_cast<std::size_t>(r - firstRow) * B;
+          std::copy(src + c0, src + c1,
+                    out + static_cast<std::size_t>(by * B + r - w.y) * w.width +
+                        (bx * B + c0 - w.x));
+        }
+      });
+  }
+  guard.Rethrow();
+  if (stats) {
+    stats->tilesFull = full;
+    stats->tilesPartial = partial;
+    stats->tilesFilled = filled;
+    stats->tilesSkipped = grid.tiles.size() - full - partial - filled;
+    stats->rowsDecoded = rows;
+    stats->wallTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now() - t0)
+                          .count();
+  }
+}
+
+inline std::vector<int32_t> ReadWindow(const BlockGrid& grid,
+                                       const PixelWindow& w,
+                                       int numThreads = 1,
+                                       WindowQueryStats* stats = nullptr) {
+  std::vector<int32_t> out(w.Size());
+  ReadWindow(grid, w, out.data(), numThreads, stats);
+  return out;
+}
+
+// Geo-referenced window: the covering pixel window clipped to the grid.
+// Returns the window actually read through `window`.
+inline std::vector<int32_t> ReadGeoWindow(const BlockGrid& grid,
+                                          const GeoTransform& t, double minX,
+                                          double minY, double maxX,
+                                          double maxY, PixelWindow& window,
+                                          int numThreads = 1,
+                                          WindowQueryStats* stats = nullptr) {
+  window = ClipWindow(GeoToPixelWindow(t, minX, minY, maxX, maxY),
+                      grid.Width(), grid.Height());
+  if (window.Empty())
+    throw std::invalid_argument("Geo window does not intersect the grid");
+  return ReadWindow(grid, window, numThreads, stats);
+}
@@ -0,0 +1,357 @@
+#pragma once
+
+#include <omp.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "block_grid.h"
+#include "transformations_simd.h"
+
+////////////////////////////////////////////////////////////////////////////
+// zonal statistics: aggregates a value grid per zone of a zone grid with //
+// the same shape. Each zone tile is read as runs (natively for RLE) and  //
+// every run aggregates its slice of the value tile in one SIMD pass,     //
+// skipping nodata pixels when the value grid has a nodata value.         //
+// Tiles are spread over threads with per-thread partial tables.          //
+////////////////////////////////////////////////////////////////////////////
+
+struct ZoneStats {
+  int64_t count = 0;
+  int64_t sum = 0;
+  int32_t min = std::numeric_limits<int32_t>::max();
+  int32_t max = std::numeric_limits<int32_t>::min();
+
+  void Add(int32_t v) {
+    ++count;
+    sum += v;
+    min = std::min(min, v);
+    max = std::max(max, v);
+  }
+
+  void Merge(const ZoneStats& o) {
+    count += o.count;
+    sum += o.sum;
+    min = std::min(min, o.min);
+    max = std::max(max, o.max);
+  }
+
+  double Mean() const {
+    return count ? static_cast<double>(sum) / static_cast<double>(count) : 0.0;
+  }
+
+  bool operator==(const ZoneStats&) const = default;
+};
+
+// Ordered by zone id so results print and compare deterministically.
+using ZoneTable = std::map<int32_t, ZoneStats>;
+
+struct ZonalTiming {
+  std::size_t decodeTime = 0;     // value tiles and zone runs, ns (all threads)
+  std::size_t aggregateTime = 0;  // ns (all threads)
+  std::size_t wallTime = 0;       // ns
+  std::size_t numRuns = 0;        // zone runs aggregated
+};
+
+/////////////////////
+// slice kernels   //
+/////////////////////
+
+// Folds v[0, n) into `s`: count, 64-bit sum, min and max in one pass.
+
+inline void AccumulateSliceScalar(const int32_t* v, std::size_t n,
+                                  ZoneStats& s) {
+  for (std::size_t i = 0; i < n; ++i) s.Add(v[i]);
+}
+
+inline void AccumulateSliceSSE41(const int32_t* v, std::size_t n,
+                                 ZoneStats& s) {
+  __m128i vsum = _mm_setzero_si128();  // two int64 lanes
+  __m128i vlo = _mm_set1_epi32(s.min), vhi = _mm_set1_epi32(s.max);
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i));
+    vsum = _mm_add_epi64(vsum, _mm_cvtepi32_epi64(x));
+    vsum = _mm_add_epi64(vsum, _mm_cvtepi32_epi64(_mm_unpackhi_epi64(x, x)));
+    vlo = _mm_min_epi32(vlo, x);
+    vhi = _mm_max_epi32(vhi, x);
+  }
+  alignas(16) int64_t sums[2];
+  alignas(16) int32_t lo[4], hi[4];
+  _mm_store_si128(reinterpret_cast<__m128i*>(sums), vsum);
+  _mm_store_si128(reinterpret_cast<__m128i*>(lo), vlo);
+  _mm_store_si128(reinterpret_cast<__m128i*>(hi), vhi);
+  s.count += static_cast<int64_t>(i);
+  s.sum += sums[0] + sums[1];
+  s.min = *std::min_element(lo, lo + 4);
+  s.max = *std::max_element(hi, hi + 4);
+  AccumulateSliceScalar(v + i, n - i, s);
+}
+
+TRANSFORM_TARGET_AVX2
+inline void AccumulateSliceAVX2(const int32_t* v, std::size_t n,
+                                ZoneStats& s) {
+  __m256i vsum = _mm256_setzero_si256();
+  __m256i vlo = _mm256_set1_epi32(s.min), vhi = _mm256_set1_epi32(s.max);
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i));
+    vsum = _mm256_add_epi64(
+        vsum, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(x)));
+    vsum = _mm256_add_epi64(
+        vsum, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(x, 1)));
+    vlo = _mm256_min_epi32(vlo, x);
+    vhi = _mm256_max_epi32(vhi, x);
+  }
+  alignas(32) int64_t sums[4];
+  alignas(32) int32_t lo[8], hi[8];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(sums), vsum);
+  _mm256_store_si256(reinterpret_cast<__m256i*>(lo), vlo);
+  _mm256_store_si256(reinterpret_cast<__m256i*>(hi), vhi);
+  s.count += static_cast<int64_t>(i);
+  s.sum += sums[0] + sums[1] + sums[2] + sums[3];
+  s.min = *std::min_element(lo, lo + 8);
+  s.max = *std::max_element(hi, hi + 8);
+  AccumulateSliceScalar(v + i, n - i, s);
+}
+
+TRANSFORM_TARGET_AVX512
+inline void AccumulateSliceAVX512(const int32_t* v, std::size_t n,
+                                  ZoneStats& s) {
+  __m512i vsum = _mm512_setzero_si512();
+  __m512i vlo = _mm512_set1_epi32(s.min), vhi = _mm512_set1_epi32(s.max);
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m512i x = _mm512_loadu_si512(v + i);
+    vsum = _mm512_add_epi64(
+        vsum, _mm512_cvtepi32_epi64(_mm512_castsi512_si256(x)));
+    vsum = _mm512_add_epi64(
+        vsum, _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(x, 1)));
+    vlo = _mm512_min_epi32(vlo, x);
+    vhi = _mm512_max_epi32(vhi, x);
+  }
+  s.count += static_cast<int64_t>(i);
+  s.sum += _mm512_reduce_add_epi64(vsum);
+  s.min = _mm512_reduce_min_epi32(vlo);
+  s.max = _mm512_reduce_max_epi32(vhi);
+  AccumulateSliceScalar(v + i, n - i, s);
+}
+
+// Dispatches on TransformationSimdLevel(); short slices stay scalar.
+inline void AccumulateSlice(const int32_t* v, std::size_t n, ZoneStats& s) {
+  if (n < 16) return AccumulateSliceScalar(v, n, s);
+  switch (TransformationSimdLevel()) {
+    case SimdLevel::AVX512:
+      return AccumulateSliceAVX512(v, n, s);
+    case SimdLevel::AVX2:
+      return AccumulateSliceAVX2(v, n, s);
+    case SimdLevel::SSE41:
+      return AccumulateSliceSSE41(v, n, s);
+    case SimdLevel::Scalar:
+      return AccumulateSliceScalar(v, n, s);
+  }
+}
+
+// Same, skipping values equal to `noData` (invalid pixels): they are swapped
+// for the identity of each statistic and left out of the count.
+
+inline void AccumulateValidSliceScalar(const int32_t* v, std::size_t n,
+                                       int32_t noData, ZoneStats& s) {
+  for (std::size_t i = 0; i < n; ++i)
+    if (v[i] != noData) s.Add(v[i]);
+}
+
+inline void AccumulateValidSliceSSE41(const int32_t* v, std::size_t n,
+                                      int32_t noData, ZoneStats& s) {
+  const __m128i nd = _mm_set1_epi32(noData);
+  const __m128i top = _mm_set1_epi32(std::numeric_limits<int32_t>::max());
+  const __m128i bottom = _mm_set1_epi32(std::numeric_limits<int32_t>::min());
+  __m128i vsum = _mm_setzero_si128();
+  __m128i vlo = _mm_set1_epi32(s.min), vhi = _mm_set1_epi32(s.max);
+  int64_t invalid = 0;
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i));
+    __m128i bad = _mm_cmpeq_epi32(x, nd);
+    invalid += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(bad)));
+    __m128i xs = _mm_andnot_si128(bad, x);
+    vsum = _mm_add_epi64(vsum, _mm_cvtepi32_epi64(xs));
+    vsum = _mm_add_epi64(vsum, _mm_cvtepi32_epi64(_mm_unpackhi_epi64(xs, xs)));
+    vlo = _mm_min_epi32(vlo, _mm_blendv_epi8(x, top, bad));
+    vhi = _mm_max_epi32(vhi, _mm_blendv_epi8(x, bottom, bad));
+  }
+  alignas(16) int64_t sums[2];
+  alignas(16) int32_t lo[4], hi[4];
+  _mm_store_si128(reinterpret_cast<__m128i*>(sums), vsum);
+  _mm_store_si128(reinterpret_cast<__m128i*>(lo), vlo);
+  _mm_store_si128(reinterpret_cast<__m128i*>(hi), vhi);
+  s.count += static_cast<int64_t>(i) - invalid;
+  s.sum += sums[0] + sums[1];
+  s.min = *std::min_element(lo, lo + 4);
+  s.max = *std::max_element(hi, hi + 4);
+  AccumulateValidSliceScalar(v + i, n - i, noData, s);
+}
+
+TRANSFORM_TARGET_AVX2
+inline void AccumulateValidSliceAVX2(const int32_t* v, std::size_t n,
+                                     int32_t noData, ZoneStats& s) {
+  const __m256i nd = _mm256_set1_epi32(noData);
+  const __m256i top = _mm256_set1_epi32(std::numeric_limits<int32_t>::max());
+  const __m256i bottom =
+      _mm256_set1_epi32(std::numeric_limits<int32_t>::min());
+  __m256i vsum = _mm256_setzero_si256();
+  __m256i vlo = _mm256_set1_epi32(s.min), vhi = _mm256_set1_epi32(s.max);
+  int64_t invalid = 0;
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i));
+    __m256i bad = _mm256_cmpeq_epi32(x, nd);
+    invalid += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(bad)));
+    __m256i xs = _mm256_andnot_si256(bad, x);
+    vsum = _mm256_add_epi64(
+        vsum, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(xs)));
+    vsum = _mm256_add_epi64(
+        vsum, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(xs, 1)));
+    vlo = _mm256_min_epi32(vlo, _mm256_blendv_epi8(x, top, bad));
+    vhi = _mm256_max_epi32(vhi, _mm256_blendv_epi8(x, bottom, bad));
+  }
+  alignas(32) int64_t sums[4];
+  alignas(32) int32_t lo[8], hi[8];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(sums), vsum);
+  _mm256_store_si256(reinterpret_cast<__m256i*>(lo), vlo);
+  _mm256_store_si256(reinterpret_cast<__m256i*>(hi), vhi);
+  s.count += static_cast<int64_t>(i) - invalid;
+  s.sum += sums[0] + sums[1] + sums[2] + sums[3];
+  s.min = *std::min_element(lo, lo + 8);
+  s.max = *std::max_element(hi, hi + 8);
+  AccumulateValidSliceScalar(v + i, n - i, noData, s);
+}
+
+TRANSFORM_TARGET_AVX512
+inline void AccumulateValidSliceAVX512(const int32_t* v, std::size_t n,
+                                       int32_t noData, ZoneStats& s) {
+  const __m512i nd = _mm512_set1_epi32(noData);
+  __m512i vsum = _mm512_setzero_si512();
+  __m512i vlo = _mm512_set1_epi32(s.min), vhi = _mm512_set1_epi32(s.max);
+  int64_t valid = 0;
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m512i x = _mm512_loadu_si512(v + i);
+    __mmask16 ok = _mm512_cmpneq_epi32_mask(x, nd);
+    valid += __builtin_popcount(ok);
+    __m512i xs = _mm512_maskz_mov_epi32(ok, x);
+    vsum = _mm512_add_epi64(
+        vsum, _mm512_cvtepi32_epi64(_mm512_castsi512_si256(xs)));
+    vsum = _mm512_add_epi64(
+        vsum, _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(xs, 1)));
+    vlo = _mm512_mask_min_epi32(vlo, ok, vlo, x);
+    vhi = _mm512_mask_max_epi32(vhi, ok, vhi, x);
+  }
+  s.count += valid;
+  s.sum += _mm512_reduce_add_epi64(vsum);
+  s.min = _mm512_reduce_min_epi32(vlo);
+  s.max = _mm512_reduce_max_epi32(vhi);
+  AccumulateValidSliceScalar(v + i, n - i, noData, s);
+}
+
+inline void AccumulateValidSlice(const int32_t* v, std::size_t n,
+                                 int32_t noData, ZoneStats& s) {
+  if (n < 16) return AccumulateValidSliceScalar(v, n, noData, s);
+  switch (TransformationSimdLevel()) {
+    case SimdLevel::AVX512:
+      return AccumulateValidSliceAVX512(v, n, noData, s);
+    case SimdLevel::AVX2:
+      return AccumulateValidSliceAVX2(v, n, noData, s);
+    case SimdLevel::SSE41:
+      return AccumulateValidSliceSSE41(v, n, noData, s);
+    case SimdLevel::Scalar:
+      return AccumulateValidSliceScalar(v, n, noData, s);
+  }
+}
+
+//////////////////////////
+// block grid traversal //
+//////////////////////////
+
+inline void CheckSameShape(const BlockGrid& a, const BlockGrid& b) {
+  if (a.blockSize != b.blockSize || a.blocksX != b.blocksX ||
+      a.blocksY != b.blocksY)
+    throw std::invalid_argument(
+        "Value and zone grids differ in shape: " + std::to_string(a.blocksX) +
+        "x" + std::to_string(a.blocksY) + " tiles of " +
+        std::to_string(a.blockSize) + " vs " + std::to_string(b.blocksX) +
+        "x" + std::to_string(b.blocksY) + " tiles of " +
+        std::to_string(b.blockSize));
+}
+
+// Per-zone count/sum/min/max of `values` over the zones of `zones`. Nodata
+// pixels of either grid (see BlockGrid::noData) are left out.
+inline ZoneTable ZonalStatistics(const BlockGrid& values,
+                                 const BlockGrid& zones, int numThreads = 1,
+                                 ZonalTiming* timing = nullptr) {
+  CheckSameShape(values, zones);
+  const std::size_t n = values.TileLength();
+  const std::size_t overflow = values.MaxOverflow();
+  ZoneTable table;
+  std::size_t decodeTime = 0, aggregateTime = 0, numRuns = 0;
+
+  auto elapsed = [](auto t0) {
+    return static_cast<std::size_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - t0)
+            .count());
+  };
+  OmpExceptionGuard guard;
+  auto tStart = std::chrono::steady_clock::now();
+#pragma omp parallel num_threads(numThreads) \
+    reduction(+ : decodeTime, aggregateTime, numRuns)
+  {
+    std::unordered_map<int32_t, ZoneStats> partial;
+    std::vector<int32_t> tile(n + overflow);
+    std::vector<ValueRun<int32_t>> runs;
+#pragma omp for schedule(dynamic)
+    for (std::size_t t = 0; t < values.tiles.size(); ++t)
+      guard.Run([&] {
+        auto t0 = std::chrono::steady_clock::now();
+        values.tiles[t]->DecodeRange(tile.data(), 0, n, n);
+        runs.clear();
+        zones.tiles[t]->DecodeRuns(n, runs);
+        decodeTime += elapsed(t0);
+
+        t0 = std::chrono::steady_clock::now();
+        // One table lookup per run; equal neighbours are already merged.
+        const int32_t* v = tile.data();
+        for (const auto& run : runs) {
+          // Runs of the zone grid's nodata belong to no zone.
+          if (!zones.noData.present || run.value != zones.noData.value) {
+            ZoneStats& stats = partial[run.value];
+            if (values.noData.present)
+              AccumulateValidSlice(v, run.length, values.noData.value, stats);
+            else
+              AccumulateSlice(v, run.length, stats);
+          }
+          v += run.length;
+        }
+        aggregateTime += elapsed(t0);
+        numRuns += runs.size();
+      });
+#pragma omp critical(zonal_merge)
+    for (const auto& [zone, stats] : partial) table[zone].Merge(stats);
+  }
+  guard.Rethrow();
+
+  if (timing) {
+    timing->decodeTime = decodeTime;
+    timing->aggregateTime = aggregateTime;
+    timing->wallTime = elapsed(tStart);
+    timing->numRuns = numRuns;
+  }
+  return table;
+}
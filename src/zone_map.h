@@ -0,0 +1,466 @@
+#pragma once
+
+#include <omp.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "block_grid.h"
+#include "transformations_simd.h"
+
+////////////////////////////////////////////////////////////////////////////
+// predicate queries over a compressed BlockGrid using its zone maps. A   //
+// value predicate is a closed interval; each tile's synopsis (min/max,   //
+// optional histogram) decides whether no value, every value or only     //
+// some values can match. Only the last kind is decoded, so selective    //
+// queries cost in proportion to the tiles that straddle the predicate.  //
+////////////////////////////////////////////////////////////////////////////
+
+enum class PredicateOp {
+  Greater,       // v > a
+  GreaterEqual,  // v >= a
+  Less,          // v < a
+  LessEqual,     // v <= a
+  Equal,         // v == a
+  Between,       // a <= v <= b
+};
+
+struct ValuePredicate {
+  PredicateOp op = PredicateOp::GreaterEqual;
+  int32_t a = 0;
+  int32_t b = 0;
+
+  // Matching values are [Lo(), Hi()]; empty when Lo() > Hi().
+  int64_t Lo() const {
+    switch (op) {
+      case PredicateOp::Greater:
+        return int64_t{a} + 1;
+      case PredicateOp::Less:
+      case PredicateOp::LessEqual:
+        return std::numeric_limits<int32_t>::min();
+      default:
+        return a;
+    }
+  }
+
+  int64_t Hi() const {
+    switch (op) {
+      case PredicateOp::Greater:
+      case PredicateOp::GreaterEqual:
+        return std::numeric_limits<int32_t>::max();
+      case PredicateOp::Less:
+        return int64_t{a} - 1;
+      case PredicateOp::Between:
+        return b;
+      default:
+        return a;
+    }
+  }
+
+  bool Matches(int32_t v) const { return v >= Lo() && v <= Hi(); }
+};
+
+// "gt:2000", "ge:0", "lt:-5", "le:7", "eq:3" or "between:100:200".
+inline ValuePredicate ParseValuePredicate(const std::string& s) {
+  auto colon = s.find(':');
+  if (colon == std::string::npos)
+    throw std::invalid_argument("Predicate needs op:value, got: " + s);
+  std::string op = s.substr(0, colon), rest = s.substr(colon + 1);
+  auto value = [&](const std::string& v) {
+    std::size_t used = 0;
+    long long x = 0;
+    try {
+      x = std::stoll(v, &used);
+    } catch (const std::exception&) {
+      used = 0;
+    }
+    if (used == 0 || used != v.size() ||
+        x < std::numeric_limits<int32_t>::min() ||
+        x > std::numeric_limits<int32_t>::max())
+      throw std::invalid_argument("Bad predicate value in: " + s);
+    return static_cast<int32_t>(x);
+  };
+  ValuePredicate p;
+  if (op == "between") {
+    auto second = rest.find(':');
+    if (second == std::string::npos)
+      throw std::invalid_argument("between needs two values: " + s);
+    p.op = PredicateOp::Between;
+    p.a = value(rest.substr(0, second));
+    p.b = value(rest.substr(second + 1));
+    return p;
+  }
+  if (op == "gt")
+    p.op = PredicateOp::Greater;
+  else if (op == "ge")
+    p.op = PredicateOp::GreaterEqual;
+  else if (op == "lt")
+    p.op = PredicateOp::Less;
+  else if (op == "le")
+    p.op = PredicateOp::LessEqual;
+  else if (op == "eq")
+    p.op = PredicateOp::Equal;
+  else
+    throw std::invalid_argument("Unknown predicate: " + s);
+  p.a = value(rest);
+  return p;
+}
+
+inline std::string ToString(const ValuePredicate& p) {
+  switch (p.op) {
+    case PredicateOp::Greater:
+      return "gt:" + std::to_string(p.a);
+    case PredicateOp::GreaterEqual:
+      return "ge:" + std::to_string(p.a);
+    case PredicateOp::Less:
+      return "lt:" + std::to_string(p.a);
+    case PredicateOp::LessEqual:
+      return "le:" + std::to_string(p.a);
+    case PredicateOp::Equal:
+      return "eq:" + std::to_string(p.a);
+    case PredicateOp::Between:
+      return "between:" + std::to_string(p.a) + ":" + std::to_string(p.b);
+  }
+  return "";
+}
+
+enum class TileMatch { None, All, Some };
+
+// What a tile's synopsis says about [lo, hi]. With a histogram, empty bins
+// narrow the answer: no match if every bin meeting [lo, hi] is empty, all
+// match if every bin reaching outside it is.
+inline TileMatch ClassifyTile(const TileSynopsis& s, int64_t lo, int64_t hi) {
+  if (lo > hi || s.max < lo || s.min > hi) return TileMatch::None;
+  if (s.min >= lo && s.max <= hi) return TileMatch::All;
+  if (!s.hasHistogram) return TileMatch::Some;
+  bool anyInside = false, anyOutside = false;
+  const int64_t w = static_cast<int64_t>(s.BinWidth());
+  for (int i = 0; i < TileSynopsis::kBins; ++i) {
+    if (s.histogram[i] == 0) continue;
+    int64_t binLo = int64_t{s.min} + i * w;
+    int64_t binHi = std::min<int64_t>(binLo + w - 1, s.max);
+    anyInside = anyInside || (binHi >= lo && binLo <= hi);
+    anyOutside = anyOutside || binLo < lo || binHi > hi;
+  }
+  if (!anyInside) return TileMatch::None;
+  if (!anyOutside) return TileMatch::All;
+  return TileMatch::Some;
+}
+
+struct ZoneMapStats {
+  std::size_t tilesSkipped = 0;  // no value can match: not decoded
+  std::size_t tilesFilled = 0;   // every value matches: not decoded
+  std::size_t tilesDecoded = 0;
+  std::size_t wallTime = 0;
+};
+
+/////////////
+// kernels //
+/////////////
+
+// Both kernels test (uint32)(v - lo) <= (uint32)(hi - lo) for a non-empty
+// int32 interval; SSE/AVX2 compare signed after flipping the sign bits.
+
+inline std::size_t CountInRangeScalar(const int32_t* v, std::size_t n,
+                                      int32_t lo, int32_t hi) {
+  const uint32_t span = static_cast<uint32_t>(hi) - static_cast<uint32_t>(lo);
+  std::size_t count = 0;
+  for (std::size_t i = 0; i < n; ++i)
+    count += static_cast<uint32_t>(v[i]) - static_cast<uint32_t>(lo) <= span;
+  return count;
+}
+
+inline void MaskInRangeScalar(const int32_t* v, std::size_t n, int32_t lo,
+                              int32_t hi, int32_t* out) {
+  const uint32_t span = static_cast<uint32_t>(hi) - static_cast<uint32_t>(lo);
+  for (std::size_t i = 0; i < n; ++i)
+    out[i] = static_cast<uint32_t>(v[i]) - static_cast<uint32_t>(lo) <= span;
+}
+
+inline std::size_t CountInRangeSSE41(const int32_t* v, std::size_t n,
+                                     int32_t lo, int32_t hi) {
+  const __m128i vlo = _mm_set1_epi32(lo), sign = _mm_set1_epi32(INT32_MIN);
+  const __m128i lim = _mm_set1_epi32(
+      static_cast<int32_t>((static_cast<uint32_t>(hi) -
+                            static_cast<uint32_t>(lo)) ^ 0x80000000u));
+  __m128i misses = _mm_setzero_si128();  // -1 per non-matching lane
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128i x = _mm_xor_si128(
+        _mm_sub_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i)),
+                      vlo),
+        sign);
+    misses = _mm_add_epi32(misses, _mm_cmpgt_epi32(x, lim));
+  }
+  misses = _mm_hadd_epi32(misses, misses);
+  misses = _mm_hadd_epi32(misses, misses);
+  std::size_t count = i - static_cast<uint32_t>(-_mm_cvtsi128_si32(misses));
+  return count + CountInRangeScalar(v + i, n - i, lo, hi);
+}
+
+inline void MaskInRangeSSE41(const int32_t* v, std::size_t n, int32_t lo,
+                             int32_t hi, int32_t* out) {
+  const __m128i vlo = _mm_set1_epi32(lo), sign = _mm_set1_epi32(INT32_MIN),
+                one = _mm_set1_epi32(1);
+  const __m128i lim = _mm_set1_epi32(
+      static_cast<int32_t>((static_cast<uint32_t>(hi) -
+                            static_cast<uint32_t>(lo)) ^ 0x80000000u));
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128i x = _mm_xor_si128(
+        _mm_sub_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i)),
+                      vlo),
+        sign);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                     _mm_andnot_si128(_mm_cmpgt_epi32(x, lim), one));
+  }
+  MaskInRangeScalar(v + i, n - i, lo, hi, out + i);
+}
+
+TRANSFORM_TARGET_AVX2
+inline std::size_t CountInRangeAVX2(const int32_t* v, std::size_t n,
+                                    int32_t lo, int32_t hi) {
+  const __m256i vlo = _mm256_set1_epi32(lo),
+                sign = _mm256_set1_epi32(INT32_MIN);
+  const __m256i lim = _mm256_set1_epi32(
+      static_cast<int32_t>((static_cast<uint32_t>(hi) -
+                            static_cast<uint32_t>(lo)) ^ 0x80000000u));
+  __m256i misses = _mm256_setzero_si256();
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i x = _mm256_xor_si256(
+        _mm256_sub_epi32(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i)), vlo),
+        sign);
+    misses = _mm256_add_epi32(misses, _mm256_cmpgt_epi32(x, lim));
+  }
+  __m128i m = _mm_add_epi32(_mm256_castsi256_si128(misses),
+                            _mm256_extracti128_si256(misses, 1));
+  m = _mm_hadd_epi32(m, m);
+  m = _mm_hadd_epi32(m, m);
+  std::size_t count = i - static_cast<uint32_t>(-_mm_cvtsi128_si32(m));
+  return count + CountInRangeScalar(v + i, n - i, lo, hi);
+}
+
+TRANSFORM_TARGET_AVX2
+inline void MaskInRangeAVX2(const int32_t* v, std::size_t n, int32_t lo,
+                            int32_t hi, int32_t* out) {
+  const __m256i vlo = _mm256_set1_epi32(lo),
+                sign = _mm256_set1_epi32(INT32_MIN), one = _mm256_set1_epi32(1);
+  const __m256i lim = _mm256_set1_epi32(
+      static_cast<int32_t>((static_cast<uint32_t>(hi) -
+                            static_cast<uint32_t>(lo)) ^ 0x80000000u));
+  std::size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i x = _mm256_xor_si256(
+        _mm256_sub_epi32(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i)), vlo),
+        sign);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i),
+                        _mm256_andnot_si256(_mm256_cmpgt_epi32(x, lim), one));
+  }
+  MaskInRangeScalar(v + i, n - i, lo, hi, out + i);
+}
+
+TRANSFORM_TARGET_AVX512
+inline std::size_t CountInRangeAVX512(const int32_t* v, std::size_t n,
+                                      int32_t lo, int32_t hi) {
+  const __m512i vlo = _mm512_set1_epi32(lo);
+  const __m512i span = _mm512_set1_epi32(
+      static_cast<int32_t>(static_cast<uint32_t>(hi) -
+                           static_cast<uint32_t>(lo)));
+  std::size_t count = 0, i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m512i x = _mm512_sub_epi32(_mm512_loadu_si512(v + i), vlo);
+    count += __builtin_popcount(_mm512_cmple_epu32_mask(x, span));
+  }
+  return count + CountInRangeScalar(v + i, n - i, lo, hi);
+}
+
+TRANSFORM_TARGET_AVX512
+inline void MaskInRangeAVX512(const int32_t* v, std::size_t n, int32_t lo,
+                              int32_t hi, int32_t* out) {
+  const __m512i vlo = _mm512_set1_epi32(lo), one = _mm512_set1_epi32(1);
+  const __m512i span = _mm512_set1_epi32(
+      static_cast<int32_t>(static_cast<uint32_t>(hi) -
+                           static_cast<uint32_t>(lo)));
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m512i x = _mm512_sub_epi32(_mm512_loadu_si512(v + i), vlo);
+    _mm512_storeu_si512(out + i,
+                        _mm512_maskz_mov_epi32(
+                            _mm512_cmple_epu32_mask(x, span), one));
+  }
+  MaskInRangeScalar(v + i, n - i, lo, hi, out + i);
+}
+
+// Number of values in [lo, hi] (non-empty). Dispatches on
+// TransformationSimdLevel().
+inline std::size_t CountInRange(const int32_t* v, std::size_t n, int32_t lo,
+                                int32_t hi) {
+  switch (TransformationSimdLevel()) {
+    case SimdLevel::AVX512:
+      return CountInRangeAVX512(v, n, lo, hi);
+    case SimdLevel::AVX2:
+      return CountInRangeAVX2(v, n, lo, hi);
+    case SimdLevel::SSE41:
+      return CountInRangeSSE41(v, n, lo, hi);
+    case SimdLevel::Scalar:
+      break;
+  }
+  return CountInRangeScalar(v, n, lo, hi);
+}
+
+// out[i] = v[i] in [lo, hi] (non-empty) ? 1 : 0.
+inline void MaskInRange(const int32_t* v, std::size_t n, int32_t lo,
+                        int32_t hi, int32_t* out) {
+  switch (TransformationSimdLevel()) {
+    case SimdLevel::AVX512:
+      return MaskInRangeAVX512(v, n, lo, hi, out);
+    case SimdLevel::AVX2:
+      return MaskInRangeAVX2(v, n, lo, hi, out);
+    case SimdLevel::SSE41:
+      return MaskInRangeSSE41(v, n, lo, hi, out);
+    case SimdLevel::Scalar:
+      break;
+  }
+  MaskInRangeScalar(v, n, lo, hi, out);
+}
+
+/////////////
+// queries //
+/////////////
+
+namespace zone_map_detail {
+
+// Per-tile verdict: from the zone map when the grid has one and it is in
+// use (constant tiles are their own zone map), otherwise Some (decode).
+// Empty predicates match nothing.
+inline TileMatch Classify(const BlockGrid& grid, std::size_t t,
+                          const ValuePredicate& p, bool useZoneMaps) {
+  if (p.Lo() > p.Hi()) return TileMatch::None;
+  if (!useZoneMaps) return TileMatch::Some;
+  if (grid.HasSynopses()) return ClassifyTile(grid.synopses[t], p.Lo(), p.Hi());
+  int32_t v;
+  if (grid.tiles[t]->ConstantValue(grid.TileLength(), v))
+    return p.Matches(v) ? TileMatch::All : TileMatch::None;
+  return TileMatch::Some;
+}
+
+inline void Count(TileMatch m, ZoneMapStats& s) {
+  if (m == TileMatch::None) ++s.tilesSkipped;
+  if (m == TileMatch::All) ++s.tilesFilled;
+  if (m == TileMatch::Some) ++s.tilesDecoded;
+}
+
+}  // namespace zone_map_detail
+
+// Number of grid values matching `p`. With `useZoneMaps` false every tile is
+// decoded (the baseline the zone maps are measured against).
+inline uint64_t CountMatching(const BlockGrid& grid, const ValuePredicate& p,
+                              int numThreads = 1, bool useZoneMaps = true,
+                              ZoneMapStats* stats = nullptr) {
+  auto t0 = std::chrono::steady_clock::now();
+  const std::size_t n = grid.TileLength();
+  const int32_t lo = static_cast<int32_t>(std::max<int64_t>(p.Lo(), INT32_MIN));
+  const int32_t hi = static_cast<int32_t>(std::min<int64_t>(p.Hi(), INT32_MAX));
+  uint64_t total = 0;
+  std::size_t skipped = 0, filled = 0, decoded = 0;
+  OmpExceptionGuard guard;
+#pragma omp parallel num_threads(numThreads) \
+    reduction(+ : total, skipped, filled, decoded)
+  {
+    std::vector<int32_t> tile(n + grid.MaxOverflow());
+    ZoneMapStats local;
+#pragma omp for schedule(dynamic)
+    for (std::size_t t = 0; t < grid.tiles.size(); ++t)
+      guard.Run([&] {
+        TileMatch m = zone_map_detail::Classify(grid, t, p, useZoneMaps);
+        zone_map_detail::Count(m, local);
+        if (m == TileMatch::All) total += n;
+        if (m != TileMatch::Some) return;
+        grid.tiles[t]->DecodeRange(tile.data(), 0, n, n);
+        total += CountInRange(tile.data(), n, lo, hi);
+      });
+    skipped += local.tilesSkipped;
+    filled += local.tilesFilled;
+    decoded += local.tilesDecoded;
+  }
+  guard.Rethrow();
+  if (stats) {
+    stats->tilesSkipped = skipped;
+    stats->tilesFilled = filled;
+    stats->tilesDecoded = decoded;
+    stats->wallTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now() - t0)
+                          .count();
+  }
+  return total;
+}
+
+// 0/1 mask grid of `p`, each tile encoded with a clone of `maskProto` (e.g.
+// a bitmap codec). Tiles the zone map settles are encoded from a constant
+// tile without decoding. The mask grid carries its own zone maps.
+inline BlockGrid PredicateMask(const BlockGrid& grid, const ValuePredicate& p,
+                               const StatefulIntegerCodec<int32_t>& maskProto,
+                               int numThreads = 1, bool useZoneMaps = true,
+                               ZoneMapStats* stats = nullptr) {
+  auto t0 = std::chrono::steady_clock::now();
+  const std::size_t n = grid.TileLength();
+  const int32_t lo = static_cast<int32_t>(std::max<int64_t>(p.Lo(), INT32_MIN));
+  const int32_t hi = static_cast<int32_t>(std::min<int64_t>(p.Hi(), INT32_MAX));
+  BlockGrid out;
+  out.blockSize = grid.blockSize;
+  out.blocksX = grid.blocksX;
+  out.blocksY = grid.blocksY;
+  out.tiles.resize(grid.tiles.size());
+  out.synopses.resize(grid.tiles.size());
+  std::size_t skipped = 0, filled = 0, decoded = 0;
+  OmpExceptionGuard guard;
+#pragma omp parallel num_threads(numThreads) \
+    reduction(+ : skipped, filled, decoded)
+  {
+    std::vector<int32_t> tile(n + grid.MaxOverflow()), mask(n);
+    const std::vector<int32_t> zeros(n, 0), ones(n, 1);
+    ZoneMapStats local;
+#pragma omp for schedule(dynamic)
+    for (std::size_t t = 0; t < grid.tiles.size(); ++t)
+      guard.Run([&] {
+        TileMatch m = zone_map_detail::Classify(grid, t, p, useZoneMaps);
+        zone_map_detail::Count(m, local);
+        const int32_t* src = m == TileMatch::All    ? ones.data()
+                             : m == TileMatch::None ? zeros.data()
+                                                    : mask.data();
+        std::size_t count = m == TileMatch::All ? n : 0;
+        if (m == TileMatch::Some) {
+          grid.tiles[t]->DecodeRange(tile.data(), 0, n, n);
+          MaskInRange(tile.data(), n, lo, hi, mask.data());
+          count = CountInRangeScalar(mask.data(), n, 1, 1);
+        }
+        out.synopses[t].min = count == n;
+        out.synopses[t].max = count > 0;
+        out.synopses[t].bitWidth = out.synopses[t].max - out.synopses[t].min;
+        out.tiles[t].reset(maskProto.CloneFresh());
+        out.tiles[t]->AllocEncoded(src, n);
+        out.tiles[t]->EncodeArray(src, n);
+      });
+    skipped += local.tilesSkipped;
+    filled += local.tilesFilled;
+    decoded += local.tilesDecoded;
+  }
+  guard.Rethrow();
+  if (stats) {
+    stats->tilesSkipped = skipped;
+    stats->tilesFilled = filled;
+    stats->tilesDecoded = decoded;
+    stats->wallTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now() - t0)
+                          .count();
+  }
+  return out;
+}
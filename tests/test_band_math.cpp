@@ -0,0 +1,184 @@
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "band_math.h"
+#include "composite_codec.h"
+#include "custom_unvec_logic_codecs.h"
+#include "simdcomp_codecs.h"
+#include "simdcomp_for_codecs.h"
+#include "test_helpers.h"
+
+namespace {
+
+constexpr int kBlockSize = 48;
+constexpr int kWidth = kBlockSize * 3;
+constexpr int kHeight = kBlockSize * 2;
+constexpr std::size_t kPixels = std::size_t(kWidth) * kHeight;
+
+// Reflectance-like bands; a few pixels are zero in both so NDVI divides by
+// zero there.
+std::vector<std::vector<int32_t>> MakeBands() {
+  std::vector<std::vector<int32_t>> bands;
+  for (unsigned seed : {8, 9, 10})
+    bands.push_back(RandomRaster(seed, kPixels, 0, 10000));
+  for (std::size_t i = 5; i < kPixels; i += 997) bands[0][i] = bands[1][i] = 0;
+  return bands;
+}
+
+// Mirrors the kernel's final rounding step.
+int32_t Quantise(float v, const BandMathParams& p) {
+  v = std::nearbyint(v * p.scale);
+  return v > -2147483648.0f && v < 2147483648.0f ? static_cast<int32_t>(v)
+                                                   : p.noData;
+}
+
+struct Case {
+  std::string expr;
+  std::function<float(float, float, float)> f;  // B1, B2, B3
+};
+
+std::vector<Case> Cases() {
+  return {
+      {"(B2 - B1) / (B2 + B1)", [](float a, float b, float) {
+         return (b - a) / (b + a);
+       }},
+      {"2.5 * (B2 - B1) / (B2 + 6 * B1 - 7.5 * B3 + 1)",
+       [](float a, float b, float c) {
+         return 2.5f * (b - a) / (b + 6 * a - 7.5f * c + 1);
+       }},
+      {"-B3 + max(B1, 100) - min(B2 * 0.5, B3) / 4",
+       [](float a, float b, float c) {
+         float mx = a < 100 ? 100 : a;
+         float h = b * 0.5f;
+         float mn = c < h ? c : h;
+         return -c + mx - mn / 4;
+       }},
+      {"1 - B1 / 10000", [](float a, float, float) { return 1 - a / 10000; }},
+      {"7", [](float, float, float) { return 7.0f; }},
+  };
+}
+
+class BandMathTest : public SimdLevelTest {};
+
+}  // namespace
+
+TEST_F(BandMathTest, CompilesToPostfixWithImmediates) {
+  auto ndvi = CompileBandMath("(B2 - B1) / (B2 + B1)");
+  ASSERT_EQ(ndvi.code.size(), 7u);
+  EXPECT_EQ(ndvi.code[0].code, BandMathOpCode::Load);
+  EXPECT_EQ(ndvi.code[0].band, 1);
+  EXPECT_EQ(ndvi.code[6].code, BandMathOpCode::Div);
+  EXPECT_EQ(ndvi.maxDepth, 3);
+  EXPECT_EQ(ndvi.bands, (std::vector<int>{0, 1}));
+
+  auto folded = CompileBandMath("2 * 3 + B1");
+  ASSERT_EQ(folded.code.size(), 2u);
+  EXPECT_TRUE(folded.code[1].immLhs);
+  EXPECT_EQ(folded.code[1].imm, 6.0f);
+  EXPECT_EQ(folded.maxDepth, 1);
+
+  auto rhs = CompileBandMath("B3 / -(4)");
+  ASSERT_EQ(rhs.code.size(), 2u);
+  EXPECT_TRUE(rhs.code[1].immRhs);
+  EXPECT_EQ(rhs.code[1].imm, -4.0f);
+}
+
+TEST_F(BandMathTest, RejectsBadExpressions) {
+  for (const char* bad : {"B1 +", "(B1", "B0", "foo", "B1 B2", "min(B1)", "",
+                          "B99999999999"})
+    EXPECT_THROW(CompileBandMath(bad), std::invalid_argument) << bad;
+}
+
+TEST_F(BandMathTest, StoresRoundToNearestEvenInEveryKernel) {
+  // Just below .5 stays down and ties go to even; 17 values reach every
+  // kernel's vector loop and its scalar tail.
+  constexpr float kInf = std::numeric_limits<float>::infinity();
+  std::vector<float> r = {0.49999997f, -0.49999997f, 0.5f,  1.5f,  2.5f,
+                          -2.5f,       -0.5f,        1.49999988f,  3.0f,
+                          -7.6f,       std::nanf(""), kInf, 3e9f, -3e9f,
+                          2147483520.0f, 0.0f,       12.5f};
+  std::vector<int32_t> expected = {0,  0,  0,  2,  2,  -2, 0,          1, 3,
+                                   -8, -1, -1, -1, -1, 2147483520, 0, 12};
+  BandMathParams p{.scale = 1.0f, .noData = -1};
+  using Store = void (*)(const float*, std::size_t, int32_t*,
+                         const BandMathParams&);
+  using namespace band_math_detail;
+  for (auto [level, store] : {std::pair<SimdLevel, Store>{SimdLevel::Scalar,
+                                                          StoreScalar},
+                              {SimdLevel::SSE41, StoreSSE41},
+                              {SimdLevel::AVX2, StoreAVX2},
+                              {SimdLevel::AVX512, StoreAVX512}}) {
+    if (level > DetectSimdLevel()) continue;
+    std::vector<int32_t> out(r.size());
+    store(r.data(), r.size(), out.data(), p);
+    EXPECT_EQ(out, expected) << ToString(level);
+  }
+}
+
+TEST_F(BandMathTest, MatchesPerPixelReference) {
+  auto rasters = MakeBands();
+  std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>> codecs;
+  codecs.push_back(std::make_unique<DeltaCodec>());
+  codecs.push_back(std::make_unique<SimdCompFORCodec>());
+  codecs.push_back(std::make_unique<CompositeStatefulIntegerCodec<int32_t>>(
+      std::make_unique<DeltaCodec>(), std::make_unique<SimdCompCodec>()));
+  DeltaCodec outCodec;
+  BandMathParams params{.scale = 1000.0f, .noData = -1};
+
+  for (auto& codec : codecs) {
+    std::vector<BlockGrid> grids;
+    for (auto& raster : rasters)
+      grids.push_back(EncodeBlockGrid(raster.data(), kWidth, kHeight,
+                                      kBlockSize, *codec));
+    std::vector<const BlockGrid*> bands;
+    for (auto& g : grids) bands.push_back(&g);
+
+    for (auto& c : Cases()) {
+      auto e = CompileBandMath(c.expr);
+      std::vector<int32_t> expected(kPixels);
+      for (std::size_t i = 0; i < kPixels; ++i)
+        expected[i] = Quantise(
+            c.f(rasters[0][i], rasters[1][i], rasters[2][i]), params);
+      for (SimdLevel l : SupportedSimdLevels()) {
+        SetTransformationSimdLevel(l);
+        for (std::size_t chunk : {std::size_t(1), std::size_t(300),
+                                  std::size_t(1024), std::size_t(1 << 20)})
+          for (int threads : {1, 3}) {
+            params.chunkValues = chunk;
+            auto out = EvaluateBandMath(e, bands, outCodec, params, threads);
+            ASSERT_EQ(DecodeGrid(out), expected)
+                << codec->name() << " \"" << c.expr << "\" " << ToString(l)
+                << " chunk=" << chunk << " t=" << threads;
+          }
+      }
+    }
+  }
+}
+
+TEST_F(BandMathTest, RethrowsTileFailures) {
+  auto rasters = MakeBands();
+  DeltaCodec delta;
+  auto b1 =
+      EncodeBlockGrid(rasters[0].data(), kWidth, kHeight, kBlockSize, delta);
+  auto b2 =
+      EncodeBlockGrid(rasters[1].data(), kWidth, kHeight, kBlockSize, delta);
+  FailTileDecodes(b2, 4);
+  for (int threads : {1, 3})
+    EXPECT_THROW(EvaluateBandMath(CompileBandMath("B1 - B2"), {&b1, &b2},
+                                  delta, {}, threads),
+                 std::runtime_error);
+}
+
+TEST_F(BandMathTest, RejectsMissingBands) {
+  auto rasters = MakeBands();
+  DeltaCodec delta;
+  auto grid =
+      EncodeBlockGrid(rasters[0].data(), kWidth, kHeight, kBlockSize, delta);
+  EXPECT_THROW(EvaluateBandMath(CompileBandMath("B1 + B2"), {&grid}, delta),
+               std::invalid_argument);
+}
@@ -5,7 +5,9 @@
 #include <gtest/gtest.h>
 
 #include "bench_utils.h"
+#include "cascade_codec.h"
 #include "codec_collection.h"  // includes zstd_codecs.h and all other codecs
+#include "error_bounded_codec.h"
 
 // ─── ParseOrdering ────────────────────────────────────────────────────────────
 
@@ -166,6 +168,34 @@ TEST(AccessTransformationMutatesData, ReadOnlyVariants) {
       AccessTransformationMutatesData(AccessTransformation::RandomSum));
 }
 
+// ─── RunningStats ─────────────────────────────────────────────────────────────
+
+TEST(RunningStats, MergeMatchesSequentialUpdates) {
+  RunningStats all, a, b;
+  for (std::size_t x : {3u, 9u, 4u, 12u, 7u}) {
+    all.Update(x);
+    a.Update(x);
+  }
+  for (std::size_t x : {1u, 20u, 6u}) {
+    all.Update(x);
+    b.Update(x);
+  }
+  a.Merge(b);
+  EXPECT_EQ(a.n, all.n);
+  EXPECT_DOUBLE_EQ(a.mean, all.mean);
+  EXPECT_NEAR(a.Variance(), all.Variance(), 1e-9);
+  EXPECT_DOUBLE_EQ(a.Total(), all.Total());
+}
+
+TEST(RunningStats, MergeIntoEmpty) {
+  RunningStats empty, b;
+  b.Update(5);
+  b.Update(7);
+  empty.Merge(b);
+  EXPECT_EQ(empty.n, 2u);
+  EXPECT_DOUBLE_EQ(empty.mean, 6.0);
+}
+
 // ─── SelectCodecsByName ───────────────────────────────────────────────────────
 
 TEST(SelectCodecsByName, AllKeyword) {
@@ -246,3 +276,248 @@ TEST(BenchmarkOneCodec, RoundTripAndStats) {
   EXPECT_GE(stats.tenc, 0.0f);
   EXPECT_GE(stats.tdec, 0.0f);
 }
+
+// Claims a tighter bound than its quantiser keeps.
+class UnderstatedBoundCodec : public ErrorBoundedCodec<int32_t> {
+ public:
+  using ErrorBoundedCodec<int32_t>::ErrorBoundedCodec;
+  double MaxAbsError() const override { return 1; }
+};
+
+TEST(BenchmarkOneCodec, ChecksErrorBound) {
+  std::vector<int32_t> data(512);
+  for (std::size_t i = 0; i < data.size(); ++i)
+    data[i] = 1000 + static_cast<int32_t>((i * 37) % 101);
+
+  std::unique_ptr<StatefulIntegerCodec<int32_t>> lossy =
+      std::make_unique<ErrorBoundedCodec<int32_t>>(
+          AbsoluteErrorBound(10), std::make_unique<SimdCompCodec>());
+  std::unique_ptr<StatefulIntegerCodec<int32_t>> exact =
+      std::make_unique<SimdCompCodec>();
+  auto lossyStats = BenchmarkOneCodec(data, lossy);
+  auto exactStats = BenchmarkOneCodec(data, exact);
+  EXPECT_GT(lossyStats.cf, 0.0f);
+  EXPECT_LT(lossyStats.cf, exactStats.cf);
+
+  // Decoded values outside the reported bound fail the round trip.
+  std::unique_ptr<StatefulIntegerCodec<int32_t>> understated =
+      std::make_unique<UnderstatedBoundCodec>(
+          AbsoluteErrorBound(10), std::make_unique<SimdCompCodec>());
+  EXPECT_EQ(BenchmarkOneCodec(data, understated).cf, 0.0f);
+}
+
+// ─── ApplyFusedAccessTransformation ───────────────────────────────────────────
+
+TEST(ApplyFusedAccessTransformation, FusedAndFallbackAgree) {
+  const std::size_t blockSize = 24;
+  std::vector<int32_t> data(blockSize * blockSize);
+  for (std::size_t i = 0; i < data.size(); ++i)
+    data[i] = 500 + static_cast<int32_t>((i * 131) % 997);
+
+  auto encode = [&](StatefulIntegerCodec<int32_t>* proto) {
+    std::unique_ptr<StatefulIntegerCodec<int32_t>> c(proto);
+    c->AllocEncoded(data.data(), data.size());
+    c->EncodeArray(data.data(), data.size());
+    return c;
+  };
+  auto decode = [&](std::unique_ptr<StatefulIntegerCodec<int32_t>>& c) {
+    std::vector<int32_t> out(data.size() + c->GetOverflowSize(data.size()));
+    c->DecodeArray(out.data(), data.size());
+    out.resize(data.size());
+    return out;
+  };
+
+  std::vector<int32_t> thresholded(data);
+  Threshold(thresholded, Avg(thresholded));
+  std::vector<int32_t> shifted(data);
+  for (auto& v : shifted) v += 1 << 23;
+
+  // SimdCompFOR and FOR run fused; Delta exercises the decode fallback.
+  for (auto make : {+[]() -> StatefulIntegerCodec<int32_t>* {
+                      return new SimdCompFORCodec();
+                    },
+                    +[]() -> StatefulIntegerCodec<int32_t>* {
+                      return new FORCodec();
+                    },
+                    +[]() -> StatefulIntegerCodec<int32_t>* {
+                      return new DeltaCodec();
+                    }}) {
+    auto c = encode(make());
+    SCOPED_TRACE(c->name());
+    ApplyFusedAccessTransformation(c, AccessTransformation::ThresholdFused,
+                                   blockSize);
+    EXPECT_EQ(c->name(), "bitset");
+    EXPECT_EQ(decode(c), thresholded);
+
+    c = encode(make());
+    std::string name = c->name();
+    ApplyFusedAccessTransformation(c, AccessTransformation::ValueShiftFused,
+                                   blockSize);
+    EXPECT_EQ(c->name(), name);
+    EXPECT_EQ(decode(c), shifted);
+  }
+}
+
+TEST(ApplyFusedAccessTransformation, RejectsBufferPath) {
+  std::vector<int32_t> data(16, 1);
+  EXPECT_THROW(ApplyAccessTransformation(
+                   data, AccessTransformation::ThresholdFused, 4),
+               std::invalid_argument);
+  EXPECT_EQ(ToString(ParseAccessTransformation("ValueShiftFused")),
+            "ValueShiftFused");
+  EXPECT_THROW(
+      ApplyAccessTransformation(data, AccessTransformation::SumFused, 4),
+      std::invalid_argument);
+}
+
+TEST(ApplyFusedAccessTransformation, SumFusedThroughComposites) {
+  const std::size_t blockSize = 40;
+  std::vector<int32_t> data(blockSize * blockSize);
+  for (std::size_t i = 0; i < data.size(); ++i)
+    data[i] = (i / 9 % 2 ? -70000 : 1 << 30) + static_cast<int32_t>(i / 9);
+  int64_t expected = 0;
+  for (int32_t v : data) expected += v;
+
+  using Ptr = std::unique_ptr<StatefulIntegerCodec<int32_t>>;
+  std::vector<Ptr> codecs;
+  codecs.push_back(std::make_unique<SimdCompFORCodec>());
+  codecs.push_back(std::make_unique<DeltaCodec>());
+  codecs.push_back(std::make_unique<FORCodec>());
+  codecs.push_back(std::make_unique<RLECodec>());
+  for (auto make : {+[]() -> Ptr { return std::make_unique<DeltaCodec>(); },
+                    +[]() -> Ptr { return std::make_unique<FORCodec>(); },
+                    +[]() -> Ptr { return std::make_unique<RLECodec>(); }})
+    codecs.push_back(std::make_unique<CompositeStatefulIntegerCodec<int32_t>>(
+        make(), std::make_unique<SimdCompFORCodec>()));
+  std::vector<Ptr> stages;
+  stages.push_back(std::make_unique<DeltaCodec>());
+  stages.push_back(std::make_unique<RLECodec>());
+  stages.push_back(std::make_unique<SimdCompFORCodec>());
+  codecs.push_back(
+      std::make_unique<CascadeStatefulIntegerCodec<int32_t>>(std::move(stages)));
+
+  for (auto& c : codecs) {
+    SCOPED_TRACE(c->name());
+    c->AllocEncoded(data.data(), data.size());
+    c->EncodeArray(data.data(), data.size());
+    int64_t sum = 0;
+    ASSERT_TRUE(c->FusedSum(data.size(), sum));
+    EXPECT_EQ(sum, expected);
+    kFusedSumSink = 0;
+    std::string name = c->name();
+    ApplyFusedAccessTransformation(c, AccessTransformation::SumFused,
+                                   blockSize);
+    EXPECT_EQ(kFusedSumSink, expected);
+    EXPECT_EQ(c->name(), name);
+    // The block is untouched.
+    std::vector<int32_t> out(data.size() + c->GetOverflowSize(data.size()));
+    c->DecodeArray(out.data(), data.size());
+    EXPECT_TRUE(std::equal(data.begin(), data.end(), out.begin()));
+  }
+}
+
+// DeltaCodec without its fused sum, as a first stage that has none.
+class UnfusedDeltaCodec : public DeltaCodec {
+ public:
+  bool FusedSum(size_t, int64_t&) override { return false; }
+};
+
+TEST(ApplyFusedAccessTransformation, SumFusedWithoutFirstStageSum) {
+  const std::size_t blockSize = 37;
+  std::vector<int32_t> data(blockSize * blockSize);
+  for (std::size_t i = 0; i < data.size(); ++i)
+    data[i] = static_cast<int32_t>(i % 50) * 40 - 900;
+  int64_t expected = std::accumulate(data.begin(), data.end(), int64_t{0});
+
+  // No fused sum on the first codec: the composite sums its own decode.
+  CompositeStatefulIntegerCodec<int32_t> composite(
+      std::make_unique<UnfusedDeltaCodec>(),
+      std::make_unique<SimdCompFORCodec>());
+  composite.AllocEncoded(data.data(), data.size());
+  composite.EncodeArray(data.data(), data.size());
+  int64_t sum = 0;
+  ASSERT_TRUE(composite.FusedSum(data.size(), sum));
+  EXPECT_EQ(sum, expected);
+}
+
+TEST(ApplyAccessTransformation, LinearSumFusedAsksTheCodec) {
+  const std::size_t blockSize = 16;
+  const std::size_t n = blockSize * blockSize;
+  std::vector<int32_t> data(n);
+  for (std::size_t i = 0; i < n; ++i) data[i] = static_cast<int32_t>(i * 3);
+  int64_t expected = std::accumulate(data.begin(), data.end(), int64_t{0});
+
+  // Codecs that do not write the overflow slot (here it does not even
+  // exist) report their FusedSum instead.
+  DeltaCodec delta;
+  delta.AllocEncoded(data.data(), n);
+  delta.EncodeArray(data.data(), n);
+  std::vector<int32_t> buf(n + delta.GetOverflowSize(n));
+  delta.DecodeArray(buf.data(), n);
+  kFusedSumSink = 0;
+  ApplyAccessTransformation(buf, AccessTransformation::LinearSumFused,
+                            blockSize, &delta);
+  EXPECT_EQ(kFusedSumSink, expected);
+
+  // Without a codec the buffer is summed.
+  kFusedSumSink = 0;
+  ApplyAccessTransformation(buf, AccessTransformation::LinearSumFused,
+                            blockSize);
+  EXPECT_EQ(kFusedSumSink, expected);
+
+  // The fused codecs' overflow slot is read as before.
+  SimdCompFusedCodec fused;
+  fused.AllocEncoded(data.data(), n);
+  fused.EncodeArray(data.data(), n);
+  std::vector<int32_t> fbuf(n + fused.GetOverflowSize(n));
+  fused.DecodeArray(fbuf.data(), n);
+  kLinearSumSink = 0;
+  ApplyAccessTransformation(fbuf, AccessTransformation::LinearSumFused,
+                            blockSize, &fused);
+  EXPECT_EQ(kLinearSumSink, static_cast<int32_t>(expected));
+}
+
+TEST(ApplyAccessTransformation, NoDataSumsSkipNoData) {
+  constexpr int32_t kNoData = -9999;
+  const std::size_t blockSize = 16;
+  const std::size_t n = blockSize * blockSize;
+  std::vector<int32_t> data(n);
+  int64_t expected = 0;
+  for (std::size_t i = 0; i < n; ++i) {
+    data[i] = i % 7 == 0 || i < 40 ? kNoData : static_cast<int32_t>(i * 3);
+    if (data[i] != kNoData) expected += data[i];
+  }
+  std::vector<int32_t> sea(n, kNoData);
+
+  for (NoDataMode mode : {NoDataMode::Split, NoDataMode::Fill})
+    for (bool fusedValues : {true, false}) {
+      std::unique_ptr<StatefulIntegerCodec<int32_t>> values;
+      if (fusedValues)
+        values = std::make_unique<DeltaCodec>();
+      else
+        values = std::make_unique<UnfusedDeltaCodec>();
+      auto codec = std::make_unique<NoDataCodec>(mode, kNoData,
+                                                 std::move(values));
+      for (auto* raster : {&data, &sea}) {
+        int64_t want = raster == &data ? expected : 0;
+        codec->AllocEncoded(raster->data(), n);
+        codec->EncodeArray(raster->data(), n);
+        EXPECT_EQ(codec->ValidSum(n), want) << ToString(mode);
+
+        std::vector<int32_t> buf(n + codec->GetOverflowSize(n));
+        codec->DecodeArray(buf.data(), n);
+        kFusedSumSink = 0;
+        ApplyAccessTransformation(buf, AccessTransformation::LinearSumFused,
+                                  blockSize, codec.get());
+        EXPECT_EQ(kFusedSumSink, want) << ToString(mode);
+
+        std::unique_ptr<StatefulIntegerCodec<int32_t>> tile(codec->CloneFresh());
+        tile->AllocEncoded(raster->data(), n);
+        tile->EncodeArray(raster->data(), n);
+        kFusedSumSink = 0;
+        ApplyFusedAccessTransformation(tile, AccessTransformation::SumFused,
+                                       blockSize);
+        EXPECT_EQ(kFusedSumSink, want) << ToString(mode);
+      }
+    }
+}
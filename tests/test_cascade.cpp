@@ -0,0 +1,169 @@
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "cascade_codec.h"
+#include "cascade_search.h"
+#include "composite_codec.h"
+#include "custom_unvec_logic_codecs.h"
+#include "simdcomp_codecs.h"
+#include "simdcomp_for_codecs.h"
+#include "test_helpers.h"
+
+namespace {
+
+using CodecPtr = std::unique_ptr<StatefulIntegerCodec<int32_t>>;
+
+template <typename... C>
+std::vector<CodecPtr> Stages(C... codecs) {
+  std::vector<CodecPtr> s;
+  (s.push_back(CodecPtr(codecs)), ...);
+  return s;
+}
+
+// Counts full decodes, so tests can see which stages were decoded.
+class CountingDeltaCodec : public DeltaCodec {
+ public:
+  int* decodes;
+
+  explicit CountingDeltaCodec(int* decodes) : decodes{decodes} {}
+
+  void DecodeArray(int32_t* out, const size_t length) override {
+    ++*decodes;
+    DeltaCodec::DecodeArray(out, length);
+  }
+
+  StatefulIntegerCodec<int32_t>* CloneFresh() const override {
+    return new CountingDeltaCodec(decodes);
+  }
+};
+
+}  // namespace
+
+TEST(Cascade, TwoStagesMatchComposite) {
+  auto data = MakeSample(1);
+  CascadeStatefulIntegerCodec<int32_t> cascade(
+      Stages(new DeltaCodec(), new SimdCompCodec()));
+  CompositeStatefulIntegerCodec<int32_t> composite(
+      std::make_unique<DeltaCodec>(), std::make_unique<SimdCompCodec>());
+  EXPECT_EQ(cascade.name(), composite.name());
+  EXPECT_EQ(RoundTrip(cascade, data), data);
+  RoundTrip(composite, data);
+  EXPECT_EQ(cascade.EncodedNumValues(), composite.EncodedNumValues());
+}
+
+TEST(Cascade, FourStagesRoundTrip) {
+  auto data = MakeSample(2, 10000);
+  CascadeStatefulIntegerCodec<int32_t> cascade(Stages(
+      new DeltaCodec(), new RLECodec(), new FORCodec(), new SimdCompFORCodec()));
+  EXPECT_EQ(cascade.name(),
+            "[+]_custom_delta_unvec+custom_rle_unvec+custom_for_unvec+" +
+                SimdCompFORCodec().name());
+  EXPECT_EQ(RoundTrip(cascade, data), data);
+  // Decoding twice must not depend on leftover intermediate state.
+  std::vector<int32_t> again(data.size() +
+                             cascade.GetOverflowSize(data.size()));
+  cascade.DecodeArray(again.data(), data.size());
+  again.resize(data.size());
+  EXPECT_EQ(again, data);
+
+  std::unique_ptr<StatefulIntegerCodec<int32_t>> fresh(cascade.CloneFresh());
+  EXPECT_EQ(fresh->name(), cascade.name());
+  EXPECT_EQ(RoundTrip(*fresh, data), data);
+
+  std::vector<ValueRun<int32_t>> runs;
+  cascade.DecodeRuns(data.size(), runs);
+  std::vector<int32_t> expanded;
+  for (auto& r : runs) expanded.insert(expanded.end(), r.length, r.value);
+  EXPECT_EQ(expanded, data);
+}
+
+TEST(Cascade, RejectsEmptyChain) {
+  EXPECT_THROW(CascadeStatefulIntegerCodec<int32_t>({}),
+               std::invalid_argument);
+}
+
+TEST(CascadeSearch, ParetoFrontKeepsUndominatedChains) {
+  auto make = [](double cf, double tdec, bool ok = true) {
+    CascadeCandidate c;
+    c.ok = ok;
+    c.cf = cf;
+    c.tdecPerValue = tdec;
+    return c;
+  };
+  std::vector<CascadeCandidate> cs = {make(0.5, 2.0), make(0.3, 3.0),
+                                      make(0.4, 4.0), make(0.9, 1.0),
+                                      make(0.1, 0.1, false), make(0.3, 3.5)};
+  EXPECT_EQ(ParetoFront(cs), (std::vector<std::size_t>{1, 0, 3}));
+}
+
+TEST(CascadeSearch, FindsMultiStageChainsThatRoundTrip) {
+  std::vector<CodecPtr> logical, physical;
+  logical.push_back(std::make_unique<DeltaCodec>());
+  logical.push_back(std::make_unique<RLECodec>());
+  logical.push_back(std::make_unique<FORCodec>());
+  physical.push_back(std::make_unique<SimdCompFORCodec>());
+  std::vector<std::vector<int32_t>> samples = {MakeSample(3), MakeSample(4)};
+
+  CascadeSearchParams params{.maxLogicalStages = 3, .beamWidth = 2,
+                             .decodeReps = 1};
+  auto all = SearchCascades(logical, physical, samples, params);
+  // Depth 0: physical alone; each deeper level: beam x logical prefixes,
+  // each with and without the physical terminator.
+  EXPECT_EQ(all.size(), 1u + 3 * 2 + 2 * 3 * 2 * 2);
+
+  bool deep = false;
+  for (auto& c : all) {
+    ASSERT_TRUE(c.ok) << c.name;
+    deep = deep || c.logical.size() == 3;
+    // Reported chains rebuild to codecs that round-trip.
+    auto codec = BuildCascade(logical, physical, c.logical, c.physical);
+    EXPECT_EQ(codec->name(), c.name);
+    EXPECT_EQ(RoundTrip(*codec, samples[0]), samples[0]) << c.name;
+  }
+  EXPECT_TRUE(deep);
+
+  auto front = ParetoFront(all);
+  ASSERT_FALSE(front.empty());
+  // Delta before the bit packer beats bit packing raw values.
+  EXPECT_LT(all[front[0]].cf, all[0].cf);
+  EXPECT_FALSE(all[front[0]].logical.empty());
+}
+
+TEST(Cascade, ForFirstSumsThroughSecondStage) {
+  auto data = MakeSample(5, 5000);
+  for (auto& v : data) v -= 900;  // negative reference
+  int64_t expected = 0;
+  for (int32_t v : data) expected += v;
+
+  int decodes = 0;
+  CompositeStatefulIntegerCodec<int32_t> composite(
+      std::make_unique<FORCodec>(),
+      std::make_unique<CountingDeltaCodec>(&decodes));
+  CascadeStatefulIntegerCodec<int32_t> cascade(
+      Stages(new FORCodec(), new CountingDeltaCodec(&decodes),
+             new SimdCompFORCodec()));
+  for (StatefulIntegerCodec<int32_t>* c :
+       {static_cast<StatefulIntegerCodec<int32_t>*>(&composite),
+        static_cast<StatefulIntegerCodec<int32_t>*>(&cascade)}) {
+    c->AllocEncoded(data.data(), data.size());
+    c->EncodeArray(data.data(), data.size());
+    int64_t sum = 0;
+    ASSERT_TRUE(c->FusedSum(data.size(), sum));
+    EXPECT_EQ(sum, expected) << c->name();
+    EXPECT_EQ(decodes, 0) << c->name();
+  }
+
+  // Offsets of 2^30 or more do not fit a non-negative zigzag, so the
+  // intermediate is decoded instead.
+  std::vector<int32_t> wide = {std::numeric_limits<int32_t>::min(), 0,
+                               std::numeric_limits<int32_t>::max(), -1};
+  composite.clear();
+  composite.EncodeArray(wide.data(), wide.size());
+  int64_t sum = 0;
+  ASSERT_TRUE(composite.FusedSum(wide.size(), sum));
+  EXPECT_EQ(sum, -2);
+  EXPECT_EQ(decodes, 1);
+}
@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "custom_unvec_logic_codecs.h"
+#include "direct_codec.h"
+#include "focal.h"
+#include "simdcomp_for_codecs.h"
+#include "test_helpers.h"
+
+namespace {
+
+// Odd sizes so every vector width leaves a tail inside each tile row.
+constexpr int kBlockSize = 21;
+constexpr int kBlocksX = 3;
+constexpr int kBlocksY = 4;
+constexpr int kWidth = kBlockSize * kBlocksX;
+constexpr int kHeight = kBlockSize * kBlocksY;
+
+// Synthetic DEM: a tilted, wavy surface with noise and a flat plateau.
+std::vector<int32_t> MakeDem() {
+  std::mt19937 gen(7);
+  std::uniform_int_distribution<int32_t> noise(-40, 40);
+  std::vector<int32_t> dem(kWidth * kHeight);
+  for (int y = 0; y < kHeight; ++y)
+    for (int x = 0; x < kWidth; ++x)
+      dem[y * kWidth + x] =
+          (x < 10 && y < 10)
+              ? 5000
+              : static_cast<int32_t>(3000 + 12 * x - 7 * y +
+                                     400 * std::sin(x / 6.0) *
+                                         std::cos(y / 9.0)) +
+                    noise(gen);
+  return dem;
+}
+
+// Whole-raster reference with clamped edges, built on the scalar kernels.
+std::vector<int32_t> Reference(const std::vector<int32_t>& dem, FocalOp op) {
+  auto at = [&](int x, int y) {
+    x = std::clamp(x, 0, kWidth - 1);
+    y = std::clamp(y, 0, kHeight - 1);
+    return dem[y * kWidth + x];
+  };
+  std::vector<int32_t> out(dem.size());
+  for (int y = 0; y < kHeight; ++y)
+    for (int x = 0; x < kWidth; ++x) {
+      int32_t r[3][3];
+      for (int j = 0; j < 3; ++j)
+        for (int i = 0; i < 3; ++i) r[j][i] = at(x + i - 1, y + j - 1);
+      int32_t gx = (r[0][2] + 2 * r[1][2] + r[2][2]) -
+                   (r[0][0] + 2 * r[1][0] + r[2][0]);
+      int32_t gy = (r[2][0] + 2 * r[2][1] + r[2][2]) -
+                   (r[0][0] + 2 * r[0][1] + r[0][2]);
+      int32_t v = 0;
+      switch (op) {
+        case FocalOp::Mean:
+          for (auto& row : r) v += row[0] + row[1] + row[2];
+          v /= 9;
+          break;
+        case FocalOp::Max:
+          v = r[0][0];
+          for (auto& row : r) v = std::max({v, row[0], row[1], row[2]});
+          break;
+        case FocalOp::Slope:
+          v = HornSlope(gx, gy, 30.0);
+          break;
+        case FocalOp::Aspect:
+          v = HornAspect(gx, gy);
+          break;
+        case FocalOp::Sobel:
+          v = static_cast<int32_t>(std::lround(std::hypot(gx, gy)));
+          break;
+      }
+      out[y * kWidth + x] = v;
+    }
+  return out;
+}
+
+// Fails every encode, on whichever thread runs it.
+class FailingCodec : public DeltaCodec {
+ public:
+  void EncodeArray(const int32_t*, size_t) override {
+    throw std::runtime_error("encode failed");
+  }
+  StatefulIntegerCodec<int32_t>* CloneFresh() const override {
+    return new FailingCodec();
+  }
+};
+
+class FocalTest : public SimdLevelTest {
+ protected:
+  std::vector<int32_t> dem = MakeDem();
+};
+
+}  // namespace
+
+TEST_F(FocalTest, ParsesOps) {
+  for (const char* s : {"Mean", "Max", "Slope", "Aspect", "Sobel"})
+    EXPECT_EQ(ToString(ParseFocalOp(s)), s);
+  EXPECT_THROW(ParseFocalOp("Median"), std::invalid_argument);
+}
+
+TEST_F(FocalTest, DecodeRowsMatchesTile) {
+  std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>> protos;
+  protos.push_back(std::make_unique<DeltaCodec>());
+  protos.push_back(std::make_unique<SimdCompFORCodec>());
+  protos.push_back(std::make_unique<DirectAccessCodec>());
+  for (auto& proto : protos) {
+    auto grid = EncodeBlockGrid(dem.data(), kWidth, kHeight, kBlockSize, *proto);
+    EXPECT_EQ(DecodeGrid(grid), dem) << proto->name();
+    std::vector<int32_t> tile(grid.TileLength() + grid.MaxOverflow());
+    std::vector<int32_t> rows(3 * kBlockSize + grid.MaxOverflow());
+    grid.DecodeTile(1, 2, tile.data());
+    for (int row : {0, 7, kBlockSize - 3}) {
+      grid.DecodeRows(1, 2, row, 3, rows.data());
+      EXPECT_TRUE(std::equal(rows.begin(), rows.begin() + 3 * kBlockSize,
+                             tile.begin() + row * kBlockSize))
+          << proto->name() << " row=" << row;
+    }
+  }
+}
+
+TEST_F(FocalTest, MatchesWholeRasterReference) {
+  DeltaCodec delta;
+  SimdCompFORCodec simdFor;
+  auto grid = EncodeBlockGrid(dem.data(), kWidth, kHeight, kBlockSize, delta);
+  for (FocalOp op : {FocalOp::Mean, FocalOp::Max, FocalOp::Slope,
+                     FocalOp::Aspect, FocalOp::Sobel}) {
+    auto expected = Reference(dem, op);
+    for (SimdLevel l : SupportedSimdLevels()) {
+      SetTransformationSimdLevel(l);
+      FocalStats stats;
+      auto out = FocalBlockGrid(grid, op, simdFor, {.cellSize = 30.0},
+                                /* numThreads */ 2, &stats);
+      EXPECT_EQ(DecodeGrid(out), expected) << ToString(op) << " " << ToString(l);
+      // One halo row per band boundary, read through partial decode.
+      EXPECT_EQ(stats.haloValues,
+                static_cast<std::size_t>(kWidth) * (kBlocksY - 1));
+    }
+  }
+}
+
+TEST_F(FocalTest, FlatWindowHasNoAspect) {
+  std::vector<int32_t> flat(kWidth * kHeight, 100);
+  DirectAccessCodec direct;
+  auto grid = EncodeBlockGrid(flat.data(), kWidth, kHeight, kBlockSize, direct);
+  auto out = DecodeGrid(FocalBlockGrid(grid, FocalOp::Aspect, direct));
+  EXPECT_TRUE(std::ranges::all_of(out, [](int32_t v) { return v == kFlatAspect; }));
+  out = DecodeGrid(FocalBlockGrid(grid, FocalOp::Slope, direct));
+  EXPECT_TRUE(std::ranges::all_of(out, [](int32_t v) { return v == 0; }));
+}
+
+TEST_F(FocalTest, RethrowsErrorsFromParallelRegions) {
+  DeltaCodec delta;
+  auto failingRead = [](int bx, int by, int32_t*) {
+    if (bx == 1 && by == 2) throw std::runtime_error("read failed");
+  };
+  EXPECT_THROW(EncodeBlockGrid(kBlocksX, kBlocksY, kBlockSize, delta,
+                               failingRead, /* numThreads */ 4),
+               std::runtime_error);
+  auto grid = EncodeBlockGrid(dem.data(), kWidth, kHeight, kBlockSize, delta);
+  FailingCodec failing;
+  EXPECT_THROW(FocalBlockGrid(grid, FocalOp::Mean, failing, {},
+                              /* numThreads */ 4),
+               std::runtime_error);
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "custom_unvec_logic_codecs.h"
+#include "generic_codecs.h"
+#include "transformations_simd.h"
+
+//////////////////////////////////////////////////////////////////////////
+// scaffolding shared by the tests: sample data and rasters, codec round //
+// trips, tiled-grid decoding and the SIMD level fixture                 //
+//////////////////////////////////////////////////////////////////////////
+
+// Rising surface with flat stretches: a wide value range but small steps,
+// so delta ahead of the bit packer pays off.
+inline std::vector<int32_t> MakeSample(unsigned seed, std::size_t n = 4096) {
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<int32_t> step(1, 4), flat(0, 3);
+  std::vector<int32_t> v(n);
+  int32_t x = 0;
+  for (std::size_t i = 0; i < n; ++i) {
+    if (flat(gen) != 0) x += step(gen);
+    v[i] = x;
+  }
+  return v;
+}
+
+// `n` values drawn uniformly from [lo, hi].
+inline std::vector<int32_t> RandomRaster(unsigned seed, std::size_t n,
+                                         int32_t lo, int32_t hi) {
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<int32_t> v(lo, hi);
+  std::vector<int32_t> r(n);
+  for (auto& x : r) x = v(gen);
+  return r;
+}
+
+inline std::vector<int32_t> RoundTrip(StatefulIntegerCodec<int32_t>& codec,
+                                      const std::vector<int32_t>& in) {
+  codec.AllocEncoded(in.data(), in.size());
+  codec.EncodeArray(in.data(), in.size());
+  std::vector<int32_t> out(in.size() + codec.GetOverflowSize(in.size()));
+  codec.DecodeArray(out.data(), in.size());
+  out.resize(in.size());
+  return out;
+}
+
+// Reassembles the row-major raster from a BlockGrid's tiles.
+template <typename Grid>
+std::vector<int32_t> DecodeGrid(const Grid& grid) {
+  const int width = grid.Width();
+  std::vector<int32_t> raster(static_cast<std::size_t>(width) * grid.Height());
+  std::vector<int32_t> tile(grid.TileLength() + grid.MaxOverflow());
+  for (int by = 0; by < grid.blocksY; ++by)
+    for (int bx = 0; bx < grid.blocksX; ++bx) {
+      grid.DecodeTile(bx, by, tile.data());
+      for (int y = 0; y < grid.blockSize; ++y)
+        std::copy_n(&tile[static_cast<std::size_t>(y) * grid.blockSize],
+                    grid.blockSize,
+                    &raster[static_cast<std::size_t>(by * grid.blockSize + y) *
+                                width +
+                            bx * grid.blockSize]);
+    }
+  return raster;
+}
+
+// Encodes like FORCodec but fails every decode, whole-tile, cursor or
+// run-length, on whichever thread runs it.
+class DecodeFailingCodec : public FORCodec {
+ public:
+  void DecodeArray(int32_t*, size_t) override {
+    throw std::runtime_error("decode failed");
+  }
+  std::unique_ptr<DecodeCursor<int32_t>> NewDecodeCursor(size_t) override {
+    throw std::runtime_error("decode failed");
+  }
+  void DecodeRuns(size_t, std::vector<ValueRun<int32_t>>&) override {
+    throw std::runtime_error("decode failed");
+  }
+  StatefulIntegerCodec<int32_t>* CloneFresh() const override {
+    return new DecodeFailingCodec();
+  }
+};
+
+// Swaps tile `t` of a BlockGrid for a DecodeFailingCodec holding the same
+// values, so the grid's synopses still hold.
+template <typename Grid>
+void FailTileDecodes(Grid& grid, std::size_t t) {
+  std::vector<int32_t> values(grid.TileLength() + grid.MaxOverflow());
+  grid.tiles[t]->DecodeArray(values.data(), grid.TileLength());
+  auto failing = std::make_unique<DecodeFailingCodec>();
+  failing->AllocEncoded(values.data(), grid.TileLength());
+  failing->EncodeArray(values.data(), grid.TileLength());
+  grid.tiles[t] = std::move(failing);
+}
+
+// The levels this machine can run, scalar first.
+inline std::vector<SimdLevel> SupportedSimdLevels() {
+  std::vector<SimdLevel> levels;
+  for (SimdLevel l : {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2,
+                      SimdLevel::AVX512})
+    if (l <= DetectSimdLevel()) levels.push_back(l);
+  return levels;
+}
+
+// Restores the process-wide kernel selection after each test.
+class SimdLevelTest : public ::testing::Test {
+ protected:
+  SimdLevel saved = TransformationSimdLevel();
+  void TearDown() override { TransformationSimdLevel() = saved; }
+};
@@ -1,25 +1,41 @@
+#include <algorithm>
+#include <bit>
 #include <cmath>
+#include <functional>
 #include <limits>
+#include <map>
 #include <memory>
+#include <numeric>
 #include <random>
 #include <ranges>
 #include <vector>
 
 #include <gtest/gtest.h>
 
+#include "bitmap_codecs.h"
 #include "composite_codec.h"
+#include "constant_codecs.h"
 #include "custom_unvec_logic_codecs.h"
 #include "custom_vec_logic_codecs.h"
 #include "deflate_codecs.h"
+#include "error_bounded_codec.h"
 #include "fastpfor_codecs.h"
 #include "frameofreference_codecs.h"
 #include "generic_codecs.h"
 #include "lz4_codecs.h"
 #include "lzma_codecs.h"
 #include "maskedvbyte_codecs.h"
+#include "nodata_codecs.h"
+#include "shuffle_codecs.h"
 #include "simdcomp_codecs.h"
+#include "simdcomp_d1_codecs.h"
+#include "simdcomp_for_codecs.h"
+#include "simdcomp_linear_codecs.h"
 #include "streamvbyte_codecs.h"
+#include "tans_codecs.h"
+#include "transformations.h"
 #include "turbopfor_codecs.h"
+#include "util.h"
 #include "zstd_codecs.h"
 
 // Returns true if codec correctly round-trips `data`.
@@ -56,6 +72,31 @@ static bool TestCodec(std::vector<int32_t>& data,
   return true;
 }
 
+// Returns true if draining a DecodeCursor in chunks of `chunk` values (rounded
+// up to the cursor's granularity) reproduces `data`.
+static bool TestCursor(std::vector<int32_t>& data,
+                       StatefulIntegerCodec<int32_t>& codec, size_t chunk) {
+  codec.clear();
+  codec.AllocEncoded(data.data(), data.size());
+  codec.EncodeArray(data.data(), data.size());
+
+  auto cursor = codec.NewDecodeCursor(data.size());
+  size_t g = cursor->Granularity();
+  size_t k = (chunk + g - 1) / g * g;
+  std::vector<int32_t> buf(k + codec.GetOverflowSize(data.size()));
+  std::vector<int32_t> data_back;
+  while (size_t got = cursor->Next(buf.data(), k))
+    data_back.insert(data_back.end(), buf.begin(), buf.begin() + got);
+
+  codec.clear();
+  if (data_back != data) {
+    ADD_FAILURE() << "Cursor mismatch in " << codec.name()
+                  << " chunk=" << chunk << " got " << data_back.size()
+                  << " of " << data.size() << " values";
+    return false;
+  }
+  return true;
+}
 
 class CodecRoundtripTest : public ::testing::Test {
  protected:
@@ -157,6 +198,48 @@ TEST_F(CodecRoundtripTest, RLECodecAVX512) {
   EXPECT_TRUE(TestCodec(large_data, c));
 }
 
+TEST_F(CodecRoundtripTest, VectorisedFusedSum) {
+  const std::size_t blockSize = 37;  // odd, so the scalar tails run
+  std::vector<int32_t> data(blockSize * blockSize);
+  std::mt19937 gen(11);
+  std::uniform_int_distribution<int32_t> step(-300, 300);
+  int32_t v = 5000;
+  for (auto& x : data) x = v += step(gen) * (gen() % 7 == 0);
+  int64_t expected = std::accumulate(data.begin(), data.end(), int64_t{0});
+
+  using Ptr = std::unique_ptr<StatefulIntegerCodec<int32_t>>;
+  std::vector<std::function<Ptr()>> makers = {
+      [] { return std::make_unique<DeltaCodecSSE42>(); },
+      [] { return std::make_unique<DeltaCodecAVX2>(); },
+      [] { return std::make_unique<DeltaCodecAVX512>(); },
+      [] { return std::make_unique<FORCodecSSE42>(); },
+      [] { return std::make_unique<FORCodecAVX2>(); },
+      [] { return std::make_unique<FORCodecAVX512>(); },
+      [] { return std::make_unique<RLECodecSSE42>(); },
+      [] { return std::make_unique<RLECodecAVX2>(); },
+      [] { return std::make_unique<RLECodecAVX512>(); }};
+  // Behind SimdCompFOR, the FOR codecs take the sum from its fused sum of
+  // the intermediate (EncodedSumTerms), the others sum the decoded one.
+  std::vector<Ptr> codecs;
+  for (auto& make : makers) {
+    codecs.push_back(make());
+    codecs.push_back(std::make_unique<CompositeStatefulIntegerCodec<int32_t>>(
+        make(), std::make_unique<SimdCompFORCodec>()));
+  }
+
+  for (auto& c : codecs) {
+    SCOPED_TRACE(c->name());
+    c->AllocEncoded(data.data(), data.size());
+    c->EncodeArray(data.data(), data.size());
+    std::vector<int32_t> out(data.size() + c->GetOverflowSize(data.size()));
+    c->DecodeArray(out.data(), data.size());
+    ASSERT_TRUE(std::equal(data.begin(), data.end(), out.begin()));
+    int64_t sum = 0;
+    ASSERT_TRUE(c->FusedSum(data.size(), sum));
+    EXPECT_EQ(sum, expected);
+  }
+}
+
 TEST_F(CodecRoundtripTest, DeflateCodec) {
   DeflateCodec c;
   EXPECT_TRUE(TestCodec(small_data, c));
@@ -197,6 +280,211 @@ TEST_F(CodecRoundtripTest, SimdCompCodec) {
   SimdCompCodec c;
   EXPECT_TRUE(TestCodec(small_data, c));
   EXPECT_TRUE(TestCodec(large_data, c));
+  // Full-range values pack at b = 32, stored raw.
+  std::mt19937 gen(7);
+  std::vector<int32_t> random(1000);
+  for (auto& v : random) v = static_cast<int32_t>(gen());
+  EXPECT_TRUE(TestCodec(random, c));
+  for (size_t chunk : {128, 300}) EXPECT_TRUE(TestCursor(random, c, chunk));
+}
+
+TEST_F(CodecRoundtripTest, SimdCompFORCodec) {
+  SimdCompFORCodec c;
+  EXPECT_TRUE(TestCodec(small_data, c));
+  EXPECT_TRUE(TestCodec(large_data, c));
+  std::vector<int32_t> negative(300);
+  for (size_t i = 0; i < negative.size(); ++i)
+    negative[i] = -5000 + static_cast<int32_t>(i * 7 % 61);
+  EXPECT_TRUE(TestCodec(negative, c));
+  std::vector<int32_t> flat(130, 42);
+  EXPECT_TRUE(TestCodec(flat, c));
+}
+
+TEST_F(CodecRoundtripTest, SimdCompD1Codecs) {
+  // Noisy ridges far from zero, with a partial tail block.
+  std::vector<int32_t> terrain(1000);
+  for (size_t i = 0; i < terrain.size(); ++i)
+    terrain[i] = 250000 + static_cast<int32_t>(i % 100 < 50 ? i % 50 * 8
+                                                            : 400 - i % 50 * 8) +
+                 static_cast<int32_t>(i * 7919 % 13);
+  std::vector<int32_t> sorted(600);
+  for (size_t i = 0; i < sorted.size(); ++i)
+    sorted[i] = -7000 + static_cast<int32_t>(i * i % 977 + i * 5);
+  std::sort(sorted.begin(), sorted.end());
+  std::vector<int32_t> flat(130, 42);
+  std::vector<int32_t> extremes = {std::numeric_limits<int32_t>::min(),
+                                   std::numeric_limits<int32_t>::max(), 0, -1};
+  // Zigzagged deltas that need b = 32, in the tail block and in whole ones.
+  std::vector<int32_t> jumps = {0, 2000000000, -2000000000, 5, 6, 7, 8, 9};
+  std::mt19937 gen(11);
+  std::vector<int32_t> random(1000);
+  for (auto& v : random) v = static_cast<int32_t>(gen());
+
+  for (bool zigzag : {false, true}) {
+    SimdCompD1Codec c(zigzag);
+    SimdCompD1FusedCodec fused(zigzag);
+    for (auto* data : {&small_data, &large_data, &terrain, &sorted, &flat,
+                       &extremes, &jumps, &random}) {
+      EXPECT_TRUE(TestCodec(*data, c));
+      EXPECT_TRUE(TestCodec(*data, fused));
+      for (size_t chunk : {1, 128, 300}) EXPECT_TRUE(TestCursor(*data, c, chunk));
+
+      // The stored sum and the one accumulated while decoding agree.
+      size_t n = data->size();
+      int64_t expected = 0;
+      for (int32_t v : *data) expected += v;
+      fused.AllocEncoded(data->data(), n);
+      fused.EncodeArray(data->data(), n);
+      int64_t stored = 0;
+      ASSERT_TRUE(fused.FusedSum(n, stored));
+      EXPECT_EQ(stored, expected) << fused.name();
+      std::vector<int32_t> back(n + fused.GetOverflowSize(n));
+      fused.DecodeArray(back.data(), n);
+      uint64_t decoded = static_cast<uint32_t>(back[n]) |
+                         uint64_t{static_cast<uint32_t>(back[n + 1])} << 32;
+      EXPECT_EQ(static_cast<int64_t>(decoded), expected) << fused.name();
+    }
+  }
+
+  // Monotonic data packs as tightly either way; data that goes down only
+  // packs with zigzag, where it matches delta followed by simdcomp.
+  auto bytes = [](StatefulIntegerCodec<int32_t>& c,
+                  std::vector<int32_t>& data) {
+    c.AllocEncoded(data.data(), data.size());
+    c.EncodeArray(data.data(), data.size());
+    return c.EncodedNumValues() * c.EncodedSizeValue();
+  };
+  SimdCompD1Codec d1, d1zz(true);
+  CompositeStatefulIntegerCodec<int32_t> composite(
+      std::make_unique<DeltaCodec>(), std::make_unique<SimdCompCodec>());
+  EXPECT_LE(bytes(d1, sorted), bytes(d1zz, sorted));
+  EXPECT_LT(bytes(d1zz, terrain), bytes(d1, terrain));
+  EXPECT_LT(bytes(d1zz, terrain), bytes(composite, terrain));
+}
+
+TEST_F(CodecRoundtripTest, SimdCompLinearCodec) {
+  // Tilted planes with a little noise, as DEM rows; a partial tail block.
+  std::vector<int32_t> slope(1000);
+  for (size_t i = 0; i < slope.size(); ++i)
+    slope[i] = 120000 + static_cast<int32_t>(i * 37 / 3 + i % 128 * 5) +
+               static_cast<int32_t>(i * 7919 % 5);
+  std::vector<int32_t> flat(130, 42);
+  std::vector<int32_t> extremes = {std::numeric_limits<int32_t>::min(),
+                                   std::numeric_limits<int32_t>::max(), 0, -1};
+  std::vector<int32_t> steep(256);
+  for (size_t i = 0; i < steep.size(); ++i)
+    steep[i] = std::numeric_limits<int32_t>::min() +
+               static_cast<int32_t>(i * 16000000);
+
+  SimdCompLinearCodec c;
+  for (auto* data : {&small_data, &large_data, &slope, &flat, &extremes,
+                     &steep}) {
+    EXPECT_TRUE(TestCodec(*data, c));
+
+    // Any value on its own, and ranges across segment boundaries.
+    size_t n = data->size();
+    c.AllocEncoded(data->data(), n);
+    c.EncodeArray(data->data(), n);
+    for (size_t i = 0; i < n; i += 7) EXPECT_EQ(c.ValueAt(i), (*data)[i]) << i;
+    for (auto [begin, count] : {std::pair<size_t, size_t>{0, n},
+                                {n / 3, n / 2},
+                                {n - 1, 1},
+                                {n / 2, std::min<size_t>(5, n - n / 2)}}) {
+      std::vector<int32_t> range(count);
+      c.DecodeRange(range.data(), begin, count, n);
+      EXPECT_TRUE(std::equal(range.begin(), range.end(),
+                             data->begin() + begin))
+          << begin << "+" << count;
+    }
+    c.clear();
+  }
+
+  // The scalar and AVX2 FMA kernels predict identically, so blocks encoded
+  // at one level decode at any other.
+  std::mt19937 gen(7);
+  std::uniform_real_distribution<float> slopes(-1e6f, 1e6f), fracs(0, 1);
+  const SimdLevel saved = TransformationSimdLevel();
+  c.AllocEncoded(slope.data(), slope.size());
+  c.EncodeArray(slope.data(), slope.size());
+  for (SimdLevel l : {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2,
+                      SimdLevel::AVX512}) {
+    if (l > DetectSimdLevel()) continue;
+    SetTransformationSimdLevel(l);
+    for (int t = 0; t < 100; ++t) {
+      float s = slopes(gen), f = fracs(gen);
+      std::vector<uint32_t> a(SIMDBlockSize, 3), b(SIMDBlockSize, 3);
+      simdcomp_linear_detail::AddLinearTermsScalar(a.data(), a.size(), s, f);
+      simdcomp_linear_detail::AddLinearTerms(b.data(), b.size(), s, f);
+      EXPECT_EQ(a, b) << ToString(l) << " " << s << " " << f;
+    }
+    std::vector<int32_t> back(slope.size() + c.GetOverflowSize(slope.size()));
+    c.DecodeArray(back.data(), slope.size());
+    back.resize(slope.size());
+    EXPECT_EQ(back, slope) << ToString(l);
+  }
+  TransformationSimdLevel() = saved;
+
+  // On a smooth slope the residuals from the line pack tighter than
+  // neighbour deltas.
+  auto bytes = [](StatefulIntegerCodec<int32_t>& codec,
+                  std::vector<int32_t>& data) {
+    codec.AllocEncoded(data.data(), data.size());
+    codec.EncodeArray(data.data(), data.size());
+    return codec.EncodedNumValues() * codec.EncodedSizeValue();
+  };
+  SimdCompD1Codec d1zz(true);
+  CompositeStatefulIntegerCodec<int32_t> delta(
+      std::make_unique<DeltaCodec>(), std::make_unique<SimdCompCodec>());
+  SimdCompFORCodec forCodec;
+  EXPECT_LT(bytes(c, slope), bytes(d1zz, slope));
+  EXPECT_LT(bytes(c, slope), bytes(delta, slope));
+  EXPECT_LT(bytes(c, slope), bytes(forCodec, slope));
+}
+
+TEST_F(CodecRoundtripTest, TansCodec) {
+  // Geometric residuals with a few large outliers, as delta leaves them.
+  std::mt19937 gen(11);
+  std::geometric_distribution<int32_t> geo(0.3);
+  std::vector<int32_t> residuals(4099);
+  for (size_t i = 0; i < residuals.size(); ++i)
+    residuals[i] = i % 500 == 7 ? 1 << 29 : geo(gen);
+  std::vector<int32_t> flat(130, 42);
+  std::vector<int32_t> one = {7};
+  std::vector<int32_t> extremes = {std::numeric_limits<int32_t>::min(),
+                                   std::numeric_limits<int32_t>::max(), 0, -1};
+  TansCodec c;
+  for (auto* data : {&small_data, &large_data, &residuals, &flat, &one,
+                     &extremes})
+    EXPECT_TRUE(TestCodec(*data, c));
+
+  auto bytes = [](StatefulIntegerCodec<int32_t>& codec,
+                  std::vector<int32_t>& data) {
+    codec.AllocEncoded(data.data(), data.size());
+    codec.EncodeArray(data.data(), data.size());
+    return codec.EncodedNumValues() * codec.EncodedSizeValue();
+  };
+  // Near the entropy of the residuals, well below packing them at the
+  // block's widest residual.
+  double entropy = 0;
+  std::map<int32_t, size_t> counts;
+  for (int32_t v : residuals) ++counts[v];
+  for (auto [v, n] : counts)
+    entropy -= n * std::log2(static_cast<double>(n) / residuals.size());
+  SimdCompCodec packed;
+  EXPECT_LT(bytes(c, residuals), entropy / 8 * 1.1 + 64);
+  EXPECT_LT(bytes(c, residuals), bytes(packed, residuals) / 4);
+
+  // Cascaded after delta on a noisy surface.
+  std::vector<int32_t> terrain(4096);
+  int32_t x = 1000;
+  for (auto& v : terrain) v = x += geo(gen) - 2;
+  CompositeStatefulIntegerCodec<int32_t> deltaTans(
+      std::make_unique<DeltaCodec>(), std::make_unique<TansCodec>());
+  CompositeStatefulIntegerCodec<int32_t> deltaPacked(
+      std::make_unique<DeltaCodec>(), std::make_unique<SimdCompCodec>());
+  EXPECT_EQ(deltaTans.name(), "[+]_custom_delta_unvec+tans");
+  EXPECT_TRUE(TestCodec(terrain, deltaTans));
+  EXPECT_LT(bytes(deltaTans, terrain), bytes(deltaPacked, terrain));
 }
 
 TEST_F(CodecRoundtripTest, LZ4Codec) {
@@ -209,6 +497,170 @@ TEST_F(CodecRoundtripTest, ZstdCodec3) {
   ZstdCodec c(3);
   EXPECT_TRUE(TestCodec(small_data, c));
   EXPECT_TRUE(TestCodec(large_data, c));
+  // A frame shorter than the requested length is an error, not a partial
+  // decode.
+  c.AllocEncoded(small_data.data(), small_data.size());
+  c.EncodeArray(small_data.data(), small_data.size());
+  std::vector<int32_t> out(2 * small_data.size());
+  EXPECT_THROW(c.DecodeArray(out.data(), out.size()), std::runtime_error);
+}
+
+TEST_F(CodecRoundtripTest, LZ4Variants) {
+  LZ4Codec fast(16), hc(1, LZ4HC_CLEVEL_DEFAULT);
+  EXPECT_EQ(fast.name(), "LZ4_a16");
+  EXPECT_EQ(hc.name(), "LZ4HC_9");
+  for (auto* c : {&fast, &hc}) {
+    EXPECT_TRUE(TestCodec(small_data, *c));
+    EXPECT_TRUE(TestCodec(large_data, *c));
+  }
+  EXPECT_THROW(LZ4Codec(0), std::invalid_argument);
+}
+
+TEST_F(CodecRoundtripTest, ZstdDictionary) {
+  // Small tiles sharing structure: a dictionary trained on some of them
+  // should shrink the others.
+  auto tile = [](int seed) {
+    std::vector<int32_t> t(256);
+    for (size_t i = 0; i < t.size(); ++i)
+      t[i] = 5000 + static_cast<int32_t>((i % 16) * 40 + (i / 16) * 3) +
+             static_cast<int32_t>((i * 2654435761u + seed * 97) % 5);
+    return t;
+  };
+  std::vector<std::vector<int32_t>> samples;
+  for (int seed = 0; seed < 64; ++seed) samples.push_back(tile(seed));
+  auto dictionary = TrainZstdDictionary(samples, 4096);
+  EXPECT_LE(dictionary->bytes.size(), 4096u);
+
+  ZstdCodec plain(3), withDict(3, dictionary);
+  EXPECT_EQ(withDict.name(), "Zstd_3_dict");
+  std::unique_ptr<StatefulIntegerCodec<int32_t>> clone(withDict.CloneFresh());
+  size_t plainBytes = 0, dictBytes = 0;
+  for (int seed = 100; seed < 110; ++seed) {
+    auto t = tile(seed);
+    for (auto* c : {&plain, &withDict}) {
+      c->AllocEncoded(t.data(), t.size());
+      c->EncodeArray(t.data(), t.size());
+    }
+    plainBytes += plain.EncodedNumValues();
+    dictBytes += withDict.EncodedNumValues();
+    EXPECT_TRUE(TestCodec(t, withDict));
+    EXPECT_TRUE(TestCodec(t, *clone));
+  }
+  EXPECT_LT(dictBytes, plainBytes);
+
+  EXPECT_THROW(TrainZstdDictionary({}, 4096), std::runtime_error);
+}
+
+TEST_F(CodecRoundtripTest, ShuffleStages) {
+  for (size_t n : {0, 1, 7, 8, 15, 16, 17, 31, 32, 33, 100, 1000, 4101}) {
+    SCOPED_TRACE("n=" + std::to_string(n));
+    std::vector<int32_t> in(n);
+    for (size_t i = 0; i < n; ++i)
+      in[i] = static_cast<int32_t>(i * 2654435761u);
+    std::vector<uint8_t> expected(4 * n), out(4 * n);
+    ByteShuffleScalar(in.data(), 0, n, expected.data());
+    ByteShuffleSSE41(in.data(), n, out.data());
+    EXPECT_EQ(out, expected);
+    ByteShuffle(in.data(), n, out.data());
+    EXPECT_EQ(out, expected);
+
+    // Bit plane 8b + k of the first m values, then the byte-planed tail.
+    const size_t m = n & ~size_t{7};
+    std::fill(expected.begin(), expected.end(), 0);
+    for (size_t i = 0; i < m; ++i)
+      for (int bit = 0; bit < 32; ++bit)
+        expected[bit * (m / 8) + i / 8] |=
+            ((static_cast<uint32_t>(in[i]) >> bit) & 1) << (i % 8);
+    for (size_t i = m; i < n; ++i)
+      for (int b = 0; b < 4; ++b)
+        expected[4 * m + b * (n - m) + (i - m)] =
+            static_cast<uint32_t>(in[i]) >> (8 * b);
+    BitShuffle(in.data(), n, out.data());
+    EXPECT_EQ(out, expected);
+    // The SSE bit transpose (the dispatch may pick AVX2) on byte plane 0.
+    std::vector<uint8_t> planes(4 * n), sse(m), dispatched(m), restored(m);
+    ByteShuffle(in.data(), n, planes.data());
+    BitTransposeSSE41(planes.data(), m, sse.data());
+    BitTranspose(planes.data(), m, dispatched.data());
+    EXPECT_EQ(sse, dispatched);
+    BitUntransposeSSE41(sse.data(), m, restored.data());
+    EXPECT_TRUE(std::equal(restored.begin(), restored.end(), planes.begin()));
+
+    std::vector<int32_t> back(n);
+    ByteShuffle(in.data(), n, out.data());
+    ByteUnshuffleSSE41(out.data(), n, back.data());
+    EXPECT_EQ(back, in);
+    ByteUnshuffle(out.data(), n, back.data());
+    EXPECT_EQ(back, in);
+    BitShuffle(in.data(), n, out.data());
+    BitUnshuffle(out.data(), n, back.data());
+    EXPECT_EQ(back, in);
+
+    // Every kernel set the dispatch can be forced to agrees.
+    const SimdLevel saved = TransformationSimdLevel();
+    std::vector<uint8_t> byteRef(4 * n), bitRef(4 * n);
+    ByteShuffleScalar(in.data(), 0, n, byteRef.data());
+    BitShuffle(in.data(), n, bitRef.data());
+    for (SimdLevel l : {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2,
+                        SimdLevel::AVX512}) {
+      if (l > DetectSimdLevel()) continue;
+      SetTransformationSimdLevel(l);
+      ByteShuffle(in.data(), n, out.data());
+      EXPECT_EQ(out, byteRef) << ToString(l);
+      ByteUnshuffle(out.data(), n, back.data());
+      EXPECT_EQ(back, in) << ToString(l);
+      BitShuffle(in.data(), n, out.data());
+      EXPECT_EQ(out, bitRef) << ToString(l);
+      BitUnshuffle(out.data(), n, back.data());
+      EXPECT_EQ(back, in) << ToString(l);
+    }
+    TransformationSimdLevel() = saved;
+  }
+
+  // Smooth terrain: shuffling groups the near-constant high bytes.
+  std::vector<int32_t> terrain(4096);
+  for (size_t i = 0; i < terrain.size(); ++i)
+    terrain[i] = 120000 + static_cast<int32_t>((i % 64) * 13 + (i / 64) * 7) +
+                 static_cast<int32_t>(i * 2654435761u % 11);
+  auto bytes = [&](StatefulIntegerCodec<int32_t>& c) {
+    c.AllocEncoded(terrain.data(), terrain.size());
+    c.EncodeArray(terrain.data(), terrain.size());
+    return c.EncodedNumValues() * c.EncodedSizeValue();
+  };
+  std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>> plain;
+  plain.push_back(std::make_unique<ZstdCodec>(3));
+  plain.push_back(std::make_unique<LZ4Codec>());
+  plain.push_back(std::make_unique<DeflateCodec>());
+  plain.push_back(std::make_unique<LZMACodec>());
+  for (auto& codec : plain) {
+    for (bool bits : {false, true}) {
+      std::unique_ptr<ByteStage<int32_t>> stage;
+      if (bits)
+        stage = std::make_unique<BitShuffleStage>();
+      else
+        stage = std::make_unique<ByteShuffleStage>();
+      ByteCompositeCodec<int32_t> shuffled(
+          std::move(stage),
+          std::unique_ptr<StatefulIntegerCodec<int32_t>>(codec->CloneFresh()));
+      EXPECT_EQ(shuffled.name(), "[+]_" +
+                                     std::string(bits ? "bit" : "byte") +
+                                     "shuffle+" + codec->name());
+      EXPECT_TRUE(TestCodec(small_data, shuffled));
+      EXPECT_TRUE(TestCodec(large_data, shuffled));
+      EXPECT_TRUE(TestCodec(terrain, shuffled));
+      std::unique_ptr<StatefulIntegerCodec<int32_t>> clone(
+          shuffled.CloneFresh());
+      EXPECT_TRUE(TestCodec(terrain, *clone));
+      // Bit planes of the noisy low bits cost more than they save for some
+      // codecs; byte planes pay off for all of them.
+      if (!bits)
+        EXPECT_LT(bytes(shuffled), bytes(*codec)) << shuffled.name();
+    }
+  }
+
+  EXPECT_THROW(ByteCompositeCodec<int32_t>(std::make_unique<ByteShuffleStage>(),
+                                           std::make_unique<SimdCompCodec>()),
+               std::invalid_argument);
 }
 
 TEST_F(CodecRoundtripTest, TurboPForAllMethods) {
@@ -258,3 +710,531 @@ TEST_F(CodecRoundtripTest, CompositeRLEAVX512PlusTurboPFor) {
     EXPECT_TRUE(TestCodec(large_data, c));
   }
 }
+
+TEST_F(CodecRoundtripTest, DecodeCursorsMatchDecodeArray) {
+  // 300 values leaves a partial SIMD block for the SimdComp tail path.
+  std::vector<int32_t> tail_data(large_data);
+  tail_data.insert(tail_data.end(), large_data.begin(), large_data.begin() + 44);
+  std::vector<int32_t> runs = {7, 7, 7, 0, 0, 5, 5, 5, 5, 1, 9, 9};
+
+  DeltaCodec delta;
+  FORCodec forc;
+  RLECodec rle;
+  SimdCompCodec simdcomp;
+  CODECFactory factory;
+  FastPForCodec segmented(factory.getFromName("simdfastpfor256"),
+                          /* segmentLength */ 128);
+  for (size_t chunk : {1, 3, 128, 200, 4096}) {
+    for (StatefulIntegerCodec<int32_t>* c :
+         std::initializer_list<StatefulIntegerCodec<int32_t>*>{
+             &delta, &forc, &rle, &simdcomp, &segmented}) {
+      EXPECT_TRUE(TestCursor(large_data, *c, chunk));
+      EXPECT_TRUE(TestCursor(tail_data, *c, chunk));
+    }
+    EXPECT_TRUE(TestCursor(runs, rle, chunk));
+    EXPECT_TRUE(TestCursor(small_data, delta, chunk));
+  }
+  EXPECT_TRUE(TestCodec(tail_data, segmented));
+}
+
+TEST_F(CodecRoundtripTest, BufferedCursorFallback) {
+  ZstdCodec c(3);
+  for (size_t chunk : {1, 100, 1000}) EXPECT_TRUE(TestCursor(large_data, c, chunk));
+}
+
+TEST_F(CodecRoundtripTest, SimdCompFORFusedTransformations) {
+  std::vector<int32_t> offset_data(300);
+  for (size_t i = 0; i < offset_data.size(); ++i)
+    offset_data[i] = 1000 + static_cast<int32_t>(i * 37 % 509);
+  std::vector<int32_t> flat(130, 42);
+  for (auto* data : {&small_data, &large_data, &offset_data, &flat}) {
+    size_t n = data->size();
+    SimdCompFORCodec c;
+    c.AllocEncoded(data->data(), n);
+    c.EncodeArray(data->data(), n);
+
+    std::vector<uint64_t> bitmap((n + 63) / 64, ~uint64_t{0});
+    ASSERT_TRUE(c.FusedThreshold(n, bitmap.data()));
+    std::vector<int32_t> expected(*data);
+    Threshold(expected, Avg(expected));
+    for (size_t i = 0; i < n; ++i)
+      ASSERT_EQ(static_cast<int32_t>((bitmap[i / 64] >> (i % 64)) & 1),
+                expected[i]) << "n=" << n << " i=" << i;
+    if (n % 64) EXPECT_EQ(bitmap.back() >> (n % 64), 0u);
+
+    ASSERT_TRUE(c.FusedValueShift(n, 1 << 23));
+    std::vector<int32_t> back(n);
+    c.DecodeArray(back.data(), n);
+    for (size_t i = 0; i < n; ++i) ASSERT_EQ(back[i], (*data)[i] + (1 << 23));
+  }
+  // Shifting past INT32_MAX would break the reference-is-minimum invariant.
+  std::vector<int32_t> high(200, std::numeric_limits<int32_t>::max() - 10);
+  high[3] -= 1000;
+  SimdCompFORCodec c;
+  c.AllocEncoded(high.data(), high.size());
+  c.EncodeArray(high.data(), high.size());
+  EXPECT_FALSE(c.FusedValueShift(high.size(), 1 << 23));
+}
+
+TEST_F(CodecRoundtripTest, FORCodecFusedValueShift) {
+  FORCodec c;
+  c.AllocEncoded(large_data.data(), large_data.size());
+  c.EncodeArray(large_data.data(), large_data.size());
+  ASSERT_TRUE(c.FusedValueShift(large_data.size(), -7));
+  std::vector<int32_t> back(large_data.size());
+  c.DecodeArray(back.data(), back.size());
+  for (size_t i = 0; i < back.size(); ++i) ASSERT_EQ(back[i], large_data[i] - 7);
+}
+
+TEST_F(CodecRoundtripTest, ConstantCodecs) {
+  std::vector<int32_t> flat(1000, -9999);
+  std::vector<int32_t> speckled(flat);
+  for (size_t i : {3, 17, 400, 998}) speckled[i] = static_cast<int32_t>(i) * 3;
+  std::vector<int32_t> unit = {7};
+
+  ConstantCodec constant;
+  NearConstantCodec near;
+  for (auto* data : {&flat, &speckled, &unit, &small_data, &large_data}) {
+    size_t n = data->size();
+    EXPECT_TRUE(TestCodec(*data, near));
+    for (size_t chunk : {1, 100, 1000}) EXPECT_TRUE(TestCursor(*data, near, chunk));
+    near.AllocEncoded(data->data(), n);
+    near.EncodeArray(data->data(), n);
+    for (size_t begin : {size_t{0}, n / 3, n - 1}) {
+      size_t count = std::min<size_t>(n - begin, 130);
+      std::vector<int32_t> part(count);
+      near.DecodeRange(part.data(), begin, count, n);
+      EXPECT_TRUE(std::equal(part.begin(), part.end(), data->begin() + begin));
+    }
+    std::vector<ValueRun<int32_t>> runs;
+    near.DecodeRuns(n, runs);
+    std::vector<int32_t> expanded;
+    for (auto& r : runs) expanded.insert(expanded.end(), r.length, r.value);
+    EXPECT_EQ(expanded, *data);
+
+    int64_t sum = 0, expected = 0;
+    for (int32_t v : *data) expected += v;
+    ASSERT_TRUE(near.FusedSum(n, sum));
+    EXPECT_EQ(sum, expected);
+
+    std::vector<uint64_t> bitmap((n + 63) / 64, ~uint64_t{0});
+    ASSERT_TRUE(near.FusedThreshold(n, bitmap.data()));
+    std::vector<int32_t> mask(*data);
+    Threshold(mask, Avg(mask));
+    for (size_t i = 0; i < n; ++i)
+      ASSERT_EQ(static_cast<int32_t>((bitmap[i / 64] >> (i % 64)) & 1), mask[i])
+          << "n=" << n << " i=" << i;
+
+    ASSERT_TRUE(near.FusedValueShift(n, -5));
+    std::vector<int32_t> back(n);
+    near.DecodeArray(back.data(), n);
+    for (size_t i = 0; i < n; ++i)
+      ASSERT_EQ(back[i], static_cast<int32_t>(
+                             static_cast<uint32_t>((*data)[i]) - 5u));
+  }
+
+  // Only single-valued blocks report a constant, and only they are accepted
+  // by the strict codec; outliers are the only thing stored.
+  int32_t value = 0;
+  EXPECT_TRUE(TestCodec(flat, constant));
+  constant.EncodeArray(flat.data(), flat.size());
+  EXPECT_TRUE(constant.ConstantValue(flat.size(), value));
+  EXPECT_EQ(value, -9999);
+  EXPECT_EQ(constant.EncodedNumValues(), 2u);
+  EXPECT_THROW(constant.EncodeArray(speckled.data(), speckled.size()),
+               std::invalid_argument);
+  near.EncodeArray(speckled.data(), speckled.size());
+  EXPECT_FALSE(near.ConstantValue(speckled.size(), value));
+  EXPECT_EQ(near.ExceptionCount(), 4u);
+
+  // Every kernel level fills and counts alike.
+  const SimdLevel saved = TransformationSimdLevel();
+  for (SimdLevel l : {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2,
+                      SimdLevel::AVX512}) {
+    if (l > DetectSimdLevel()) continue;
+    SetTransformationSimdLevel(l);
+    EXPECT_EQ(CountNotEqual(speckled.data(), speckled.size(), -9999), 4u)
+        << ToString(l);
+    EXPECT_GT(CountNotEqual(large_data.data(), large_data.size(), 0, 8), 8u)
+        << ToString(l);
+    for (size_t n : {size_t{0}, size_t{5}, size_t{131}}) {
+      std::vector<int32_t> filled(n + 1, 1);
+      FillConstant(filled.data(), n, -3);
+      EXPECT_EQ(CountNotEqual(filled.data(), n, -3), 0u) << ToString(l);
+      EXPECT_EQ(filled[n], 1) << ToString(l);
+    }
+  }
+  TransformationSimdLevel() = saved;
+  EXPECT_TRUE(FindNearConstantBase(speckled.data(), speckled.size(), 4, value));
+  EXPECT_EQ(value, -9999);
+  EXPECT_FALSE(FindNearConstantBase(speckled.data(), speckled.size(), 3, value));
+  EXPECT_FALSE(
+      FindNearConstantBase(large_data.data(), large_data.size(), 16, value));
+}
+
+TEST_F(CodecRoundtripTest, NoDataCodec) {
+  constexpr int32_t kNoData = -9999;
+  // Coastal block: nodata sea on the left of each 64-wide row, plus stray
+  // nodata pixels on land and a partial last word.
+  std::vector<int32_t> coastal(64 * 50 + 13);
+  for (size_t i = 0; i < coastal.size(); ++i)
+    coastal[i] = i % 64 < 20 + i / 64 % 9
+                     ? kNoData
+                     : 1200 + static_cast<int32_t>(i % 64 * 3 + i / 64);
+  for (size_t i = 40; i < coastal.size(); i += 301) coastal[i] = kNoData;
+  std::vector<int32_t> sea(500, kNoData);
+  sea[0] = 3;
+  std::vector<int32_t> all_nodata(77, kNoData);
+
+  for (NoDataMode mode : {NoDataMode::Split, NoDataMode::Fill}) {
+    std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>> codecs;
+    codecs.push_back(std::make_unique<NoDataCodec>(
+        mode, kNoData, std::make_unique<SimdCompFORCodec>()));
+    codecs.push_back(std::make_unique<NoDataCodec>(
+        mode, kNoData,
+        std::make_unique<CompositeStatefulIntegerCodec<int32_t>>(
+            std::make_unique<DeltaCodec>(), std::make_unique<SimdCompCodec>()),
+        std::make_unique<BitsetCodec>()));
+    codecs.push_back(std::make_unique<NoDataCodec>(
+        mode, kNoData, std::make_unique<DeltaCodec>(),
+        std::make_unique<RoaringCodec>()));
+    for (auto& c : codecs)
+      for (auto* data : {&coastal, &sea, &all_nodata, &small_data}) {
+        EXPECT_TRUE(TestCodec(*data, *c)) << ToString(mode);
+        std::unique_ptr<StatefulIntegerCodec<int32_t>> clone(c->CloneFresh());
+        EXPECT_TRUE(TestCursor(*data, *clone, 100));
+
+        int64_t expected = 0, sum = 0;
+        for (int32_t v : *data) expected += v;
+        c->AllocEncoded(data->data(), data->size());
+        c->EncodeArray(data->data(), data->size());
+        if (c->FusedSum(data->size(), sum)) {
+          EXPECT_EQ(sum, expected);
+        }
+      }
+  }
+
+  // The nodata outliers no longer set the bit width.
+  auto bytes = [&](StatefulIntegerCodec<int32_t>& c) {
+    c.AllocEncoded(coastal.data(), coastal.size());
+    c.EncodeArray(coastal.data(), coastal.size());
+    return c.EncodedNumValues() * c.EncodedSizeValue();
+  };
+  SimdCompFORCodec plain;
+  NoDataCodec split(NoDataMode::Split, kNoData,
+                    std::make_unique<SimdCompFORCodec>());
+  NoDataCodec fill(NoDataMode::Fill, kNoData,
+                   std::make_unique<SimdCompFORCodec>());
+  EXPECT_LT(bytes(split), bytes(plain) / 2);
+  EXPECT_LT(bytes(fill), bytes(plain));
+  int64_t sum = 0;
+  EXPECT_TRUE(split.FusedSum(coastal.size(), sum));
+  EXPECT_EQ(split.NumValid(),
+            static_cast<size_t>(std::count_if(
+                coastal.begin(), coastal.end(),
+                [](int32_t v) { return v != kNoData; })));
+  EXPECT_THROW(NoDataCodec(NoDataMode::None, kNoData,
+                           std::make_unique<DeltaCodec>()),
+               std::invalid_argument);
+
+  // Dense expansion kernels agree with the scalar reference.
+  std::vector<uint64_t> words((coastal.size() + 63) / 64);
+  size_t valid = ValidityWords(coastal.data(), coastal.size(), kNoData,
+                               words.data());
+  std::vector<int32_t> dense;
+  for (int32_t v : coastal)
+    if (v != kNoData) dense.push_back(v);
+  ASSERT_EQ(valid, dense.size());
+  const SimdLevel saved = TransformationSimdLevel();
+  for (SimdLevel l : {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2,
+                      SimdLevel::AVX512}) {
+    if (l > DetectSimdLevel()) continue;
+    SetTransformationSimdLevel(l);
+    std::vector<int32_t> out(coastal.size());
+    EXPECT_EQ(ExpandValid(words.data(), out.size(), dense.data(), kNoData,
+                          out.data()),
+              valid)
+        << ToString(l);
+    EXPECT_EQ(out, coastal) << ToString(l);
+  }
+  TransformationSimdLevel() = saved;
+}
+
+// Round-trips `data` and returns the largest |decoded - input| (infinity on
+// a NaN mismatch).
+template <typename T>
+static double RoundTripError(std::vector<T>& data,
+                             StatefulIntegerCodec<T>& codec) {
+  codec.clear();
+  codec.AllocEncoded(data.data(), data.size());
+  codec.EncodeArray(data.data(), data.size());
+  std::vector<T> back(data.size() + codec.GetOverflowSize(data.size()));
+  codec.DecodeArray(back.data(), data.size());
+  double worst = 0;
+  for (size_t i = 0; i < data.size(); ++i) {
+    double in = static_cast<double>(data[i]), out = static_cast<double>(back[i]);
+    if (std::isnan(in) || std::isnan(out)) {
+      if (std::isnan(in) != std::isnan(out))
+        return std::numeric_limits<double>::infinity();
+      continue;
+    }
+    worst = std::max(worst, in == out ? 0 : std::fabs(in - out));
+  }
+  return worst;
+}
+
+TEST_F(CodecRoundtripTest, ErrorBoundedCodec) {
+  // Smooth terrain in centimetres with a cliff and int32 extremes.
+  std::mt19937 gen(5);
+  std::normal_distribution<double> noise(0, 3);
+  std::vector<int32_t> terrain(4096 + 9);
+  for (size_t i = 0; i < terrain.size(); ++i)
+    terrain[i] = static_cast<int32_t>(
+        150000 + 4000 * std::sin(i / 300.0) + noise(gen) +
+        (i > 2000 ? 90000 : 0));
+  std::vector<int32_t> extremes = {std::numeric_limits<int32_t>::min(),
+                                   std::numeric_limits<int32_t>::max(),
+                                   std::numeric_limits<int32_t>::max() - 1, 0,
+                                   std::numeric_limits<int32_t>::min() + 3};
+
+  auto bytes = [](auto& codec, auto& data) {
+    codec.AllocEncoded(data.data(), data.size());
+    codec.EncodeArray(data.data(), data.size());
+    return codec.EncodedNumValues() * codec.EncodedSizeValue();
+  };
+
+  for (double e : {0.0, 0.5, 1.0, 50.0, 4e9}) {
+    ErrorBoundedCodec<int32_t> c(AbsoluteErrorBound(e),
+                                 std::make_unique<SimdCompCodec>());
+    for (auto* data : {&terrain, &extremes, &small_data, &large_data}) {
+      double err = RoundTripError(*data, c);
+      EXPECT_LE(err, std::floor(e)) << c.name();
+      c.AllocEncoded(data->data(), data->size());
+      c.EncodeArray(data->data(), data->size());
+      EXPECT_LE(c.MaxAbsError(), e);
+    }
+  }
+  // Below 1 an integer bound is lossless.
+  ErrorBoundedCodec<int32_t> exact(AbsoluteErrorBound(0.5),
+                                   std::make_unique<DeltaCodec>());
+  EXPECT_TRUE(TestCodec(terrain, exact));
+  EXPECT_EQ(exact.name(), "[eb_abs0.5]_custom_delta_unvec");
+
+  // A 0.5 m bound on centimetres shrinks the codes well below lossless
+  // (e = 0, i.e. delta + tANS).
+  ErrorBoundedCodec<int32_t> lossless(AbsoluteErrorBound(0),
+                                      std::make_unique<TansCodec>());
+  ErrorBoundedCodec<int32_t> lossy(AbsoluteErrorBound(50),
+                                   std::make_unique<TansCodec>());
+  EXPECT_LT(bytes(lossy, terrain), bytes(lossless, terrain) / 3);
+  ErrorBoundedCodec<int32_t> rel(RelativeErrorBound(1e-3),
+                                 std::make_unique<SimdCompCodec>());
+  double range = *std::ranges::max_element(terrain) -
+                 *std::ranges::min_element(terrain);
+  EXPECT_LE(RoundTripError(terrain, rel), 1e-3 * range);
+  rel.AllocEncoded(terrain.data(), terrain.size());
+  rel.EncodeArray(terrain.data(), terrain.size());
+  EXPECT_EQ(rel.MaxAbsError(), std::floor(1e-3 * range));
+  EXPECT_EQ(rel.NumOutliers(), 0u);
+
+  // Nodata stays exact outside the bound.
+  constexpr int32_t kNoData = -9999;
+  std::vector<int32_t> holes = terrain;
+  for (size_t i = 0; i < holes.size(); i += 97) holes[i] = kNoData;
+  NoDataCodec masked(NoDataMode::Split, kNoData,
+                     std::make_unique<ErrorBoundedCodec<int32_t>>(
+                         AbsoluteErrorBound(20),
+                         std::make_unique<SimdCompCodec>()));
+  EXPECT_LE(RoundTripError(holes, masked), 20);
+  EXPECT_EQ(masked.MaxAbsError(), 20);
+  std::vector<int32_t> back(holes.size() + masked.GetOverflowSize(holes.size()));
+  masked.DecodeArray(back.data(), holes.size());
+  for (size_t i = 0; i < holes.size(); i += 97) EXPECT_EQ(back[i], kNoData);
+
+  // Float elevations in metres, with NaN/inf and huge outliers.
+  std::vector<float> metres(3000);
+  for (size_t i = 0; i < metres.size(); ++i)
+    metres[i] = terrain[i] / 100.0f;
+  metres[10] = std::numeric_limits<float>::quiet_NaN();
+  metres[11] = std::numeric_limits<float>::infinity();
+  metres[500] = 3e38f;
+  metres[501] = -3e38f;
+  for (double e : {0.0, 1e-3, 0.5}) {
+    ErrorBoundedCodec<float> c(AbsoluteErrorBound(e),
+                               std::make_unique<SimdCompCodec>());
+    EXPECT_LE(RoundTripError(metres, c), e);
+    EXPECT_GE(c.NumOutliers(), 4u);
+  }
+  ErrorBoundedCodec<float> half(AbsoluteErrorBound(0.5),
+                                std::make_unique<TansCodec>());
+  EXPECT_LT(bytes(half, metres), metres.size() * sizeof(float) / 8);
+  std::vector<double> doubles(metres.begin(), metres.end());
+  ErrorBoundedCodec<double> relDouble(RelativeErrorBound(1e-4),
+                                      std::make_unique<DeltaCodec>());
+  double err = RoundTripError(doubles, relDouble);
+  EXPECT_LE(err, relDouble.MaxAbsError());
+  EXPECT_GT(relDouble.MaxAbsError(), 0);
+
+  EXPECT_THROW(ErrorBoundedCodec<int32_t>(AbsoluteErrorBound(-1),
+                                          std::make_unique<DeltaCodec>()),
+               std::invalid_argument);
+}
+
+// 0/1 masks spanning several 2^16-bit Roaring chunks: sparse points, long
+// runs of ones and dense noise, each in its own region.
+static std::vector<int32_t> MakeMask(unsigned seed, size_t n = 200000) {
+  std::mt19937 gen(seed);
+  std::vector<int32_t> mask(n, 0);
+  std::uniform_int_distribution<size_t> pos(0, n / 3 - 1);
+  for (int i = 0; i < 500; ++i) mask[pos(gen)] = 1;
+  size_t runStart = n / 3 + seed % 1000;
+  std::fill(mask.begin() + runStart, mask.begin() + runStart + 20000, 1);
+  std::bernoulli_distribution coin(0.5);
+  for (size_t i = 2 * n / 3; i < n; ++i) mask[i] = coin(gen);
+  return mask;
+}
+
+static std::vector<std::unique_ptr<BitmapCodec>> AllBitmapCodecs() {
+  std::vector<std::unique_ptr<BitmapCodec>> codecs;
+  codecs.push_back(std::make_unique<BitsetCodec>());
+  codecs.push_back(std::make_unique<RoaringCodec>());
+  codecs.push_back(std::make_unique<EWAHCodec>());
+  return codecs;
+}
+
+TEST_F(CodecRoundtripTest, BitmapCodecs) {
+  std::vector<int32_t> small_mask = {1, 0, 0, 1, 1, 1, 0, 1, 0};
+  auto mask = MakeMask(1);
+  std::vector<int32_t> zeros(70000, 0), ones(70000, 1);
+  for (auto& c : AllBitmapCodecs())
+    for (auto* data : {&small_mask, &mask, &zeros, &ones})
+      EXPECT_TRUE(TestCodec(*data, *c)) << c->name() << " n=" << data->size();
+}
+
+TEST_F(CodecRoundtripTest, BitmapAlgebraAcrossCodecs) {
+  auto a = MakeMask(1), b = MakeMask(2);
+  std::vector<int32_t> expectAnd(a.size()), expectOr(a.size());
+  for (size_t i = 0; i < a.size(); ++i) {
+    expectAnd[i] = a[i] & b[i];
+    expectOr[i] = a[i] | b[i];
+  }
+  auto count = [](const std::vector<int32_t>& v) {
+    return static_cast<size_t>(std::ranges::count(v, 1));
+  };
+  auto lhs = AllBitmapCodecs(), rhs = AllBitmapCodecs();
+  for (auto& x : lhs) {
+    x->AllocEncoded(a.data(), a.size());
+    x->EncodeArray(a.data(), a.size());
+    EXPECT_EQ(x->Cardinality(), count(a)) << x->name();
+  }
+  for (auto& y : rhs) {
+    y->AllocEncoded(b.data(), b.size());
+    y->EncodeArray(b.data(), b.size());
+  }
+  std::vector<int32_t> back(a.size());
+  for (auto& x : lhs)
+    for (auto& y : rhs) {
+      auto both = BitmapAnd(*x, *y);
+      EXPECT_EQ(both->name(), x->name());
+      EXPECT_EQ(both->Cardinality(), count(expectAnd))
+          << x->name() << " & " << y->name();
+      both->DecodeArray(back.data(), back.size());
+      EXPECT_EQ(back, expectAnd) << x->name() << " & " << y->name();
+
+      auto either = BitmapOr(*x, *y);
+      EXPECT_EQ(either->Cardinality(), count(expectOr))
+          << x->name() << " | " << y->name();
+      either->DecodeArray(back.data(), back.size());
+      EXPECT_EQ(back, expectOr) << x->name() << " | " << y->name();
+    }
+
+  BitsetCodec shorter;
+  shorter.AllocEncoded(a.data(), 100);
+  shorter.EncodeArray(a.data(), 100);
+  EXPECT_THROW(BitmapAnd(*lhs[0], shorter), std::invalid_argument);
+}
+
+TEST_F(CodecRoundtripTest, BitmapWordKernels) {
+  std::mt19937_64 gen(7);
+  std::vector<uint64_t> a(37), b(37);
+  for (size_t i = 0; i < a.size(); ++i) {
+    a[i] = gen();
+    b[i] = i % 5 ? gen() : 0;
+  }
+  size_t ones = 0;
+  std::vector<uint64_t> expectAnd(a.size()), expectOr(a.size());
+  for (size_t i = 0; i < a.size(); ++i) {
+    expectAnd[i] = a[i] & b[i];
+    expectOr[i] = a[i] | b[i];
+    ones += std::popcount(a[i]);
+  }
+  const SimdLevel saved = TransformationSimdLevel();
+  for (SimdLevel l : {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2,
+                      SimdLevel::AVX512}) {
+    if (l > DetectSimdLevel()) continue;
+    SetTransformationSimdLevel(l);
+    std::vector<uint64_t> out(a.size());
+    WordsOp(BitwiseOp::And, a.data(), b.data(), out.data(), a.size());
+    EXPECT_EQ(out, expectAnd) << ToString(l);
+    WordsOp(BitwiseOp::Or, a.data(), b.data(), out.data(), a.size());
+    EXPECT_EQ(out, expectOr) << ToString(l);
+    EXPECT_EQ(WordsPopcount(a.data(), a.size()), ones) << ToString(l);
+  }
+  TransformationSimdLevel() = saved;
+}
+
+TEST_F(CodecRoundtripTest, DecodeRangeMatchesDecodeArray) {
+  std::vector<int32_t> data(1000);
+  for (size_t i = 0; i < data.size(); ++i)
+    data[i] = static_cast<int32_t>(i * 7919 % 4001) - 2000;
+  std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>> codecs;
+  codecs.push_back(std::make_unique<DeltaCodec>());
+  codecs.push_back(std::make_unique<RLECodec>());
+  codecs.push_back(std::make_unique<SimdCompFORCodec>());
+  codecs.push_back(std::make_unique<SimdCompD1Codec>(/* zigzag */ true));
+  codecs.push_back(std::make_unique<ZstdCodec>(3));
+  for (auto& c : codecs) {
+    c->AllocEncoded(data.data(), data.size());
+    c->EncodeArray(data.data(), data.size());
+    for (auto [begin, count] : {std::pair<size_t, size_t>{0, 1000},
+                                {0, 5}, {127, 2}, {128, 128}, {900, 100},
+                                {999, 1}}) {
+      std::vector<int32_t> out(count + c->GetOverflowSize(data.size()));
+      c->DecodeRange(out.data(), begin, count, data.size());
+      EXPECT_TRUE(std::equal(out.begin(), out.begin() + count,
+                             data.begin() + begin))
+          << c->name() << " begin=" << begin << " count=" << count;
+    }
+  }
+}
+
+TEST_F(CodecRoundtripTest, CompositeReusesPooledIntermediates) {
+  std::vector<int32_t> data(3000);
+  for (size_t i = 0; i < data.size(); ++i)
+    data[i] = static_cast<int32_t>(i / 7 * 3);
+  std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>> codecs;
+  codecs.push_back(std::make_unique<CompositeStatefulIntegerCodec<int32_t>>(
+      std::make_unique<DeltaCodec>(), std::make_unique<SimdCompFORCodec>()));
+  // Nested: the inner composite takes its own buffer from the pool.
+  codecs.push_back(std::make_unique<CompositeStatefulIntegerCodec<int32_t>>(
+      std::make_unique<DeltaCodec>(),
+      std::make_unique<CompositeStatefulIntegerCodec<int32_t>>(
+          std::make_unique<RLECodec>(), std::make_unique<SimdCompFORCodec>())));
+  for (auto& c : codecs) {
+    c->AllocEncoded(data.data(), data.size());
+    c->EncodeArray(data.data(), data.size());
+    std::vector<int32_t> out(data.size() + c->GetOverflowSize(data.size()));
+    // BenchDecode and repeated decodes all see the encoded block intact.
+    c->BenchDecode(out.data(), data.size());
+    EXPECT_TRUE(std::equal(data.begin(), data.end(), out.begin())) << c->name();
+    for (int rep = 0; rep < 3; ++rep) {
+      std::fill(out.begin(), out.end(), -1);
+      c->DecodeArray(out.data(), data.size());
+      EXPECT_TRUE(std::equal(data.begin(), data.end(), out.begin()))
+          << c->name() << " rep=" << rep;
+    }
+    std::vector<ValueRun<int32_t>> runs;
+    c->DecodeRuns(data.size(), runs);
+    EXPECT_EQ(runs.size(), (data.size() + 6) / 7) << c->name();
+  }
+}
@@ -0,0 +1,143 @@
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "composite_codec.h"
+#include "custom_unvec_logic_codecs.h"
+#include "multiband.h"
+#include "simdcomp_for_codecs.h"
+#include "test_helpers.h"
+
+namespace {
+
+constexpr int kBlockSize = 32;
+constexpr int kWidth = kBlockSize * 3;
+constexpr int kHeight = kBlockSize * 2;
+constexpr int kBands = 4;
+constexpr std::size_t kPlane = std::size_t(kWidth) * kHeight;
+
+// Multispectral-like: each band is a scaled, shifted copy of a shared
+// surface plus a little band-specific noise.
+std::vector<int32_t> MakeBands() {
+  std::mt19937 gen(6);
+  std::uniform_int_distribution<int32_t> noise(-3, 3);
+  std::vector<int32_t> base = RandomRaster(5, kPlane, 0, 4000);
+  std::vector<int32_t> bands(kPlane * kBands);
+  for (int b = 0; b < kBands; ++b)
+    for (std::size_t i = 0; i < kPlane; ++i)
+      bands[b * kPlane + i] = (b + 2) * base[i] / 2 + 100 * b + noise(gen);
+  return bands;
+}
+
+// Planar tile (bx, by) of `bands`.
+std::vector<int32_t> Tile(const std::vector<int32_t>& bands, int numBands,
+                          int bx, int by) {
+  std::vector<int32_t> tile;
+  for (int b = 0; b < numBands; ++b)
+    for (int y = 0; y < kBlockSize; ++y) {
+      auto row = bands.begin() + b * kPlane +
+                 (by * kBlockSize + y) * kWidth + bx * kBlockSize;
+      tile.insert(tile.end(), row, row + kBlockSize);
+    }
+  return tile;
+}
+
+std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>> Codecs() {
+  std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>> codecs;
+  codecs.push_back(std::make_unique<DeltaCodec>());
+  codecs.push_back(std::make_unique<SimdCompFORCodec>());
+  codecs.push_back(std::make_unique<CompositeStatefulIntegerCodec<int32_t>>(
+      std::make_unique<DeltaCodec>(), std::make_unique<SimdCompFORCodec>()));
+  return codecs;
+}
+
+void ExpectRoundTrip(const std::vector<int32_t>& bands, int numBands,
+                     const MultiBandGrid& grid, const std::string& what) {
+  const std::size_t n = grid.TileLength();
+  std::vector<int32_t> out(n * numBands), band(n),
+      scratch(grid.ScratchLength());
+  for (int by = 0; by < grid.blocksY; ++by)
+    for (int bx = 0; bx < grid.blocksX; ++bx) {
+      auto expected = Tile(bands, numBands, bx, by);
+      grid.DecodeTile(bx, by, out.data(), scratch.data());
+      ASSERT_EQ(out, expected) << what << " tile " << bx << "," << by;
+      for (int b = 0; b < numBands; ++b) {
+        grid.DecodeBand(bx, by, b, band.data(), scratch.data());
+        ASSERT_TRUE(std::equal(band.begin(), band.end(),
+                               expected.begin() + b * n))
+            << what << " band " << b;
+      }
+    }
+}
+
+}  // namespace
+
+TEST(MultiBand, ParsesOptions) {
+  for (auto p : {BandPrediction::None, BandPrediction::Previous,
+                 BandPrediction::Linear})
+    EXPECT_EQ(ParseBandPrediction(ToString(p)), p);
+  for (auto l : {BandLayout::BSQ, BandLayout::BIP})
+    EXPECT_EQ(ParseBandLayout(ToString(l)), l);
+  EXPECT_THROW(ParseBandPrediction("Next"), std::invalid_argument);
+  EXPECT_THROW(ParseBandLayout("BIL"), std::invalid_argument);
+}
+
+TEST(MultiBand, RoundTripsEveryPredictionAndLayout) {
+  auto bands = MakeBands();
+  for (auto& codec : Codecs())
+    for (auto p : {BandPrediction::None, BandPrediction::Previous,
+                   BandPrediction::Linear})
+      for (auto l : {BandLayout::BSQ, BandLayout::BIP})
+        for (int threads : {1, 3}) {
+          auto grid = EncodeMultiBandGrid(bands.data(), kBands, kWidth,
+                                          kHeight, kBlockSize, *codec, p, l,
+                                          threads);
+          EXPECT_EQ(grid.streams.size(),
+                    grid.NumTiles() * (l == BandLayout::BSQ ? kBands : 1));
+          ExpectRoundTrip(bands, kBands, grid,
+                          codec->name() + " " + ToString(p) + " " +
+                              ToString(l));
+        }
+}
+
+TEST(MultiBand, ExtremeValuesRoundTrip) {
+  std::vector<int32_t> bands(kPlane * 2);
+  std::mt19937 gen(7);
+  for (auto& v : bands) v = static_cast<int32_t>(gen());
+  bands[0] = std::numeric_limits<int32_t>::min();
+  bands[kPlane] = std::numeric_limits<int32_t>::max();
+  DeltaCodec delta;
+  for (auto p : {BandPrediction::Previous, BandPrediction::Linear})
+    for (auto l : {BandLayout::BSQ, BandLayout::BIP})
+      ExpectRoundTrip(bands, 2,
+                      EncodeMultiBandGrid(bands.data(), 2, kWidth, kHeight,
+                                          kBlockSize, delta, p, l),
+                      ToString(p) + " " + ToString(l));
+}
+
+TEST(MultiBand, PredictionShrinksCorrelatedBands) {
+  auto bands = MakeBands();
+  SimdCompFORCodec bitpacked;
+  auto bytes = [&](BandPrediction p) {
+    return EncodeMultiBandGrid(bands.data(), kBands, kWidth, kHeight,
+                               kBlockSize, bitpacked, p, BandLayout::BSQ)
+        .EncodedBytes();
+  };
+  // Bands scale differently, so a plain difference helps less than a fit.
+  EXPECT_LT(bytes(BandPrediction::Previous), bytes(BandPrediction::None));
+  EXPECT_LT(bytes(BandPrediction::Linear), bytes(BandPrediction::Previous));
+}
+
+TEST(MultiBand, RethrowsReaderErrors) {
+  DeltaCodec delta;
+  auto failingRead = [](int bx, int by, int32_t*) {
+    if (bx == 1 && by == 1) throw std::runtime_error("read failed");
+  };
+  EXPECT_THROW(EncodeMultiBandGrid(kBands, 3, 2, kBlockSize, delta,
+                                   BandPrediction::Previous, BandLayout::BSQ,
+                                   failingRead, /* numThreads */ 4),
+               std::runtime_error);
+}
@@ -0,0 +1,181 @@
+#include <memory>
+#include <numeric>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "custom_unvec_logic_codecs.h"
+#include "pipeline.h"
+#include "test_helpers.h"
+
+namespace {
+
+constexpr std::size_t kBlockSize = 16;
+constexpr std::size_t kNumTiles = 12;
+
+// Tiles hold consecutive ramps so each has a distinct, known content.
+std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>> MakeTiles(
+    std::vector<std::vector<int32_t>>& raw) {
+  std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>> tiles;
+  for (std::size_t t = 0; t < kNumTiles; ++t) {
+    std::vector<int32_t> data(kBlockSize * kBlockSize);
+    std::iota(data.begin(), data.end(), static_cast<int32_t>(t * 1000));
+    auto codec = std::make_unique<FORCodec>();
+    codec->AllocEncoded(data.data(), data.size());
+    codec->EncodeArray(data.data(), data.size());
+    tiles.push_back(std::move(codec));
+    raw.push_back(std::move(data));
+  }
+  return tiles;
+}
+
+}  // namespace
+
+TEST(TilePipeline, ParsesStageNames) {
+  DeltaCodec access;
+  auto pipeline =
+      ParsePipeline("decode,remap:morton,Threshold,reduce:sum,encode", access);
+  EXPECT_EQ(pipeline.NumStages(), 5u);
+  EXPECT_EQ(pipeline.name(),
+            "decode>remap:morton>Threshold>reduce:sum>encode:custom_delta_unvec");
+}
+
+TEST(TilePipeline, ThrowsOnUnknownStage) {
+  DeltaCodec access;
+  EXPECT_THROW(ParsePipeline("decode,no_such_stage", access),
+               std::invalid_argument);
+  EXPECT_THROW(ParsePipeline("decode,reduce:avg", access),
+               std::invalid_argument);
+}
+
+TEST(TilePipeline, ThrowsOnDisagreeingReductions) {
+  std::vector<std::vector<int32_t>> raw;
+  auto tiles = MakeTiles(raw);
+  DeltaCodec access;
+  auto pipeline = ParsePipeline("decode,reduce:sum,reduce:max", access);
+  EXPECT_THROW(pipeline.Run(tiles, kBlockSize, 1), std::invalid_argument);
+  auto same = ParsePipeline("decode,reduce:max,reduce:max", access);
+  EXPECT_EQ(same.Run(tiles, kBlockSize, 1).reduction,
+            static_cast<int64_t>(raw.back().back()));
+}
+
+TEST(TilePipeline, ParallelSumMatchesSequential) {
+  std::vector<std::vector<int32_t>> raw;
+  auto tiles = MakeTiles(raw);
+  int64_t expected = 0;
+  for (auto& data : raw)
+    expected = std::accumulate(data.begin(), data.end(), expected);
+
+  DeltaCodec access;
+  auto pipeline = ParsePipeline("decode,reduce:sum", access);
+  for (int threads : {1, 4}) {
+    PipelineStats stats = pipeline.Run(tiles, kBlockSize, threads);
+    EXPECT_EQ(stats.reduction, expected) << "threads=" << threads;
+    ASSERT_EQ(stats.stageTimes.size(), 2u);
+    EXPECT_EQ(stats.stageTimes[0].n, kNumTiles);
+  }
+}
+
+TEST(TilePipeline, EncodeStageReplacesTiles) {
+  std::vector<std::vector<int32_t>> raw;
+  auto tiles = MakeTiles(raw);
+
+  DeltaCodec access;
+  auto pipeline = ParsePipeline("decode,ValueShift,encode", access);
+  pipeline.Run(tiles, kBlockSize, 3);
+
+  std::vector<int32_t> back(kBlockSize * kBlockSize);
+  for (std::size_t t = 0; t < kNumTiles; ++t) {
+    EXPECT_EQ(tiles[t]->name(), "custom_delta_unvec");
+    tiles[t]->DecodeArray(back.data(), back.size());
+    for (std::size_t i = 0; i < back.size(); ++i)
+      ASSERT_EQ(back[i], raw[t][i] + (1 << 23)) << "tile " << t << " i=" << i;
+  }
+}
+
+TEST(TilePipeline, ChunkedDecodeMatchesWholeTile) {
+  std::vector<std::vector<int32_t>> raw;
+  auto tiles = MakeTiles(raw);
+  int64_t expected = 0;
+  for (auto& data : raw)
+    for (int32_t v : data) expected += v + (1 << 23);
+
+  DeltaCodec access;
+  // Fully fused: decode, shift and reduce run chunk-by-chunk in scratch.
+  auto fused = ParsePipeline("decode,ValueShift,reduce:sum", access);
+  // A trailing encode needs the whole tile, so chunks decode in place.
+  auto inPlace = ParsePipeline("decode,ValueShift,reduce:sum,encode", access);
+  for (std::size_t chunk : {1, 7, 64, 1024}) {
+    fused.SetChunkSize(chunk);
+    EXPECT_EQ(fused.Run(tiles, kBlockSize, 2).reduction, expected)
+        << "chunk=" << chunk;
+  }
+  inPlace.SetChunkSize(32);
+  PipelineStats stats = inPlace.Run(tiles, kBlockSize, 2);
+  EXPECT_EQ(stats.reduction, expected);
+  EXPECT_EQ(stats.stageTimes[1].n, kNumTiles);
+
+  std::vector<int32_t> back(kBlockSize * kBlockSize);
+  tiles[3]->DecodeArray(back.data(), back.size());
+  EXPECT_EQ(back[5], raw[3][5] + (1 << 23));
+}
+
+TEST(TilePipeline, ThrowsOnStageBeforeDecode) {
+  std::vector<std::vector<int32_t>> raw;
+  auto tiles = MakeTiles(raw);
+  DeltaCodec access;
+  for (const char* spec : {"ValueShift,decode,encode", "reduce:sum",
+                           "remap:morton,decode", "encode,decode"}) {
+    auto pipeline = ParsePipeline(spec, access);
+    EXPECT_THROW(pipeline.Run(tiles, kBlockSize, 1), std::invalid_argument)
+        << spec;
+  }
+  // Fused transformations work on the encoded tile, so they may lead.
+  int64_t expected = 0;
+  for (auto& data : raw)
+    for (int32_t v : data) expected += v + (1 << 23);
+  auto fused = ParsePipeline("ValueShiftFused,decode,reduce:sum", access);
+  EXPECT_EQ(fused.Run(tiles, kBlockSize, 2).reduction, expected);
+}
+
+TEST(TilePipeline, RethrowsTileFailures) {
+  std::vector<std::vector<int32_t>> raw;
+  auto tiles = MakeTiles(raw);
+  auto failing = std::make_unique<DecodeFailingCodec>();
+  failing->AllocEncoded(raw[5].data(), raw[5].size());
+  failing->EncodeArray(raw[5].data(), raw[5].size());
+  tiles[5] = std::move(failing);
+
+  DeltaCodec access;
+  auto pipeline = ParsePipeline("decode,reduce:sum", access);
+  EXPECT_THROW(pipeline.Run(tiles, kBlockSize, 4), std::runtime_error);
+  pipeline.SetChunkSize(64);
+  EXPECT_THROW(pipeline.Run(tiles, kBlockSize, 4), std::runtime_error);
+}
+
+TEST(TilePipeline, NoDataSumsSkipNoData) {
+  constexpr int32_t kNoData = -9999;
+  std::vector<std::vector<int32_t>> raw;
+  auto tiles = MakeTiles(raw);
+  int64_t expected = 0;
+  for (std::size_t t = 0; t < kNumTiles; ++t) {
+    auto& data = raw[t];
+    for (std::size_t i = 0; i < data.size(); i += 3) data[i] = kNoData;
+    for (int32_t v : data)
+      if (v != kNoData) expected += v;
+    NoDataMode mode = t % 2 ? NoDataMode::Split : NoDataMode::Fill;
+    tiles[t] = std::make_unique<NoDataCodec>(mode, kNoData,
+                                             std::make_unique<DeltaCodec>());
+    tiles[t]->AllocEncoded(data.data(), data.size());
+    tiles[t]->EncodeArray(data.data(), data.size());
+  }
+
+  DeltaCodec access;
+  auto pipeline = ParsePipeline("decode,reduce:sum", access);
+  EXPECT_EQ(pipeline.Run(tiles, kBlockSize, 2).reduction, expected);
+  for (std::size_t chunk : {7, 64}) {
+    pipeline.SetChunkSize(chunk);
+    EXPECT_EQ(pipeline.Run(tiles, kBlockSize, 2).reduction, expected)
+        << "chunk=" << chunk;
+  }
+}
@@ -0,0 +1,119 @@
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "custom_unvec_logic_codecs.h"
+#include "pyramid.h"
+#include "simdcomp_for_codecs.h"
+#include "test_helpers.h"
+
+namespace {
+
+constexpr int kBlockSize = 40;
+
+std::vector<int32_t> MakeRaster(int width, int height) {
+  std::mt19937 gen(5);
+  std::uniform_int_distribution<int32_t> noise(-30, 30);
+  std::vector<int32_t> raster(static_cast<std::size_t>(width) * height);
+  for (int y = 0; y < height; ++y)
+    for (int x = 0; x < width; ++x)
+      raster[static_cast<std::size_t>(y) * width + x] =
+          -1000 + 3 * x - 2 * y + noise(gen);
+  return raster;
+}
+
+// Whole-raster 2x2 downsample, the reference for one pyramid level.
+std::vector<int32_t> Halve(const std::vector<int32_t>& in, int width,
+                           int height, Resampling r) {
+  std::vector<int32_t> out(static_cast<std::size_t>(width / 2) * (height / 2));
+  for (int y = 0; y < height / 2; ++y)
+    for (int x = 0; x < width / 2; ++x) {
+      const int32_t* p = &in[static_cast<std::size_t>(2 * y) * width + 2 * x];
+      out[static_cast<std::size_t>(y) * (width / 2) + x] =
+          r == Resampling::Nearest
+              ? p[0]
+              : (p[0] + p[1] + p[width] + p[width + 1] + 2) >> 2;
+    }
+  return out;
+}
+
+class PyramidTest : public SimdLevelTest {};
+
+}  // namespace
+
+TEST_F(PyramidTest, ParsesResampling) {
+  for (Resampling r : {Resampling::Mean, Resampling::Nearest})
+    EXPECT_EQ(ParseResampling(ToString(r)), r);
+  EXPECT_THROW(ParseResampling("Cubic"), std::invalid_argument);
+}
+
+TEST_F(PyramidTest, MatchesWholeRasterReference) {
+  // 5x3 tiles: level 1 is 2x1 and leaves a remainder column of base tiles
+  // that no level-1 tile covers; level 2 is 1x0, so only one level exists.
+  // 6x5 tiles exercise lower-level roots next to a top-level root.
+  for (auto [blocksX, blocksY] : {std::pair{5, 3}, std::pair{6, 5}}) {
+    const int width = blocksX * kBlockSize, height = blocksY * kBlockSize;
+    auto raster = MakeRaster(width, height);
+    DeltaCodec delta;
+    auto base = EncodeBlockGrid(raster.data(), width, height, kBlockSize, delta);
+    SimdCompFORCodec out;
+    for (Resampling r : {Resampling::Mean, Resampling::Nearest})
+      for (SimdLevel l : SupportedSimdLevels()) {
+        SetTransformationSimdLevel(l);
+        for (int threads : {1, 3}) {
+          PyramidStats stats;
+          auto levels = BuildPyramid(base, out, r, 0, threads, &stats);
+          ASSERT_EQ(levels.size(), std::size_t(MaxPyramidLevels(base)));
+          EXPECT_EQ(stats.tilesDecoded,
+                    std::size_t(levels[0].blocksX * levels[0].blocksY * 4));
+
+          auto expected = raster;
+          int w = width, h = height;
+          for (std::size_t k = 0; k < levels.size(); ++k) {
+            const BlockGrid& level = levels[k];
+            expected = Halve(expected, w, h, r);
+            w /= 2;
+            h /= 2;
+            ASSERT_EQ(level.blocksX, base.blocksX >> (k + 1));
+            ASSERT_EQ(level.blocksY, base.blocksY >> (k + 1));
+            // The tiled part of the reference level.
+            std::vector<int32_t> covered;
+            for (int y = 0; y < level.Height(); ++y) {
+              auto row = expected.begin() + static_cast<std::ptrdiff_t>(y) * w;
+              covered.insert(covered.end(), row, row + level.Width());
+            }
+            EXPECT_EQ(DecodeGrid(level), covered)
+                << blocksX << "x" << blocksY << " " << ToString(r) << " "
+                << ToString(l) << " t=" << threads;
+          }
+        }
+      }
+  }
+}
+
+TEST_F(PyramidTest, RethrowsTileFailures) {
+  auto raster = MakeRaster(4 * kBlockSize, 4 * kBlockSize);
+  DeltaCodec delta;
+  auto base = EncodeBlockGrid(raster.data(), 4 * kBlockSize, 4 * kBlockSize,
+                              kBlockSize, delta);
+  FailTileDecodes(base, 5);
+  for (int threads : {1, 3})
+    EXPECT_THROW(BuildPyramid(base, delta, Resampling::Mean, 0, threads),
+                 std::runtime_error);
+}
+
+TEST_F(PyramidTest, RejectsUnsupportedShapes) {
+  auto raster = MakeRaster(4 * kBlockSize, 4 * kBlockSize);
+  DeltaCodec delta;
+  auto base = EncodeBlockGrid(raster.data(), 4 * kBlockSize, 4 * kBlockSize,
+                              kBlockSize, delta);
+  EXPECT_EQ(MaxPyramidLevels(base), 2);
+  EXPECT_THROW(BuildPyramid(base, delta, Resampling::Mean, 3),
+               std::invalid_argument);
+  auto odd = EncodeBlockGrid(raster.data(), 4 * kBlockSize, 4 * kBlockSize,
+                             kBlockSize - 1, delta);
+  EXPECT_THROW(BuildPyramid(odd, delta, Resampling::Mean),
+               std::invalid_argument);
+}
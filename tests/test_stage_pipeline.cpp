@@ -0,0 +1,140 @@
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "cascade_codec.h"
+#include "custom_unvec_logic_codecs.h"
+#include "lz4_codecs.h"
+#include "pipeline.h"
+#include "shuffle_codecs.h"
+#include "simdcomp_codecs.h"
+#include "stage_pipeline.h"
+#include "streamvbyte_codecs.h"
+#include "test_helpers.h"
+#include "zstd_codecs.h"
+
+namespace {
+
+using CodecPtr = std::unique_ptr<StatefulIntegerCodec<int32_t>>;
+
+}  // namespace
+
+// Mismatched or non-forwarding stages are compile errors, not runtime ones.
+static_assert(ValueForwardingCodec<DeltaCodec>);
+static_assert(!ValueForwardingCodec<SimdCompCodec>);
+static_assert(ByteStreamCodec<LZ4Codec>);
+static_assert(!ByteStreamCodec<DeltaCodec>);
+static_assert(PackStage<SimdCompCodec>::kHandsOn);
+static_assert(!PackStage<FORCodec>::kHandsOn);
+static_assert(!ByteCodecStage<ZstdCodec>::kHandsOn);
+
+TEST(StagePipeline, ValueStagesMatchCascade) {
+  auto data = MakeSample(1);
+  StagePipeline<ValueStage<DeltaCodec>, ValueStage<FORCodec>,
+                PackStage<SimdCompCodec>>
+      pipeline;
+  std::vector<CodecPtr> stages;
+  stages.emplace_back(new DeltaCodec());
+  stages.emplace_back(new FORCodec());
+  stages.emplace_back(new SimdCompCodec());
+  CascadeStatefulIntegerCodec<int32_t> cascade(std::move(stages));
+  EXPECT_EQ(pipeline.name(), cascade.name());
+  EXPECT_EQ(RoundTrip(pipeline, data), data);
+  RoundTrip(cascade, data);
+  EXPECT_EQ(pipeline.EncodedNumValues(), cascade.EncodedNumValues());
+}
+
+TEST(StagePipeline, PackerFeedsCompressor) {
+  auto data = MakeSample(2, 10000);
+  StagePipeline<ValueStage<DeltaCodec>, PackStage<SimdCompCodec>,
+                ByteCodecStage<LZ4Codec>>
+      lz4;
+  EXPECT_EQ(lz4.name(), "[+]_custom_delta_unvec+simdcomp+LZ4");
+  EXPECT_EQ(RoundTrip(lz4, data), data);
+
+  StagePipeline<ValueStage<DeltaCodec>, PackStage<StreamVByteCodec>,
+                ByteCodecStage<ZstdCodec>>
+      zstd{ValueStage<DeltaCodec>(), PackStage<StreamVByteCodec>(),
+           ByteCodecStage<ZstdCodec>(ZstdCodec(1))};
+  EXPECT_EQ(zstd.name(), "[+]_custom_delta_unvec+STREAMVBYTE+Zstd_1");
+  EXPECT_EQ(RoundTrip(zstd, data), data);
+
+  LZ4Codec plain;
+  RoundTrip(plain, data);
+  EXPECT_LT(lz4.EncodedNumValues(), plain.EncodedNumValues());
+}
+
+TEST(StagePipeline, ShuffleFeedsCompressor) {
+  auto data = MakeSample(3);
+  StagePipeline<ByteTransformStage<ByteShuffleStage>,
+                ByteCodecStage<LZ4Codec>>
+      shuffled;
+  EXPECT_EQ(shuffled.name(), "[+]_byteshuffle+LZ4");
+  EXPECT_EQ(RoundTrip(shuffled, data), data);
+
+  LZ4Codec plain;
+  RoundTrip(plain, data);
+  EXPECT_LT(shuffled.EncodedNumValues(), plain.EncodedNumValues());
+}
+
+TEST(StagePipeline, CloneAndDecodeTwice) {
+  auto data = MakeSample(4, 1000);
+  StagePipeline<ValueStage<FORCodec>, PackStage<SimdCompCodec>,
+                ByteCodecStage<ZstdCodec>>
+      pipeline;
+  EXPECT_EQ(RoundTrip(pipeline, data), data);
+  // Decoding twice must not depend on leftover intermediate state.
+  std::vector<int32_t> again(data.size());
+  pipeline.DecodeArray(again.data(), data.size());
+  EXPECT_EQ(again, data);
+
+  std::unique_ptr<StatefulIntegerCodec<int32_t>> fresh(pipeline.CloneFresh());
+  EXPECT_EQ(fresh->name(), pipeline.name());
+  EXPECT_EQ(fresh->EncodedNumValues(), 0u);
+  EXPECT_EQ(RoundTrip(*fresh, data), data);
+  EXPECT_THROW(fresh->GetEncoded(), std::runtime_error);
+  // The clone starts from fresh stages and leaves the original's encoding.
+  std::fill(again.begin(), again.end(), 0);
+  pipeline.DecodeArray(again.data(), data.size());
+  EXPECT_EQ(again, data);
+
+  StagePipeline<ByteTransformStage<ByteShuffleStage>,
+                ByteCodecStage<LZ4Codec>>
+      shuffled;
+  std::unique_ptr<StatefulIntegerCodec<int32_t>> shuffledFresh(
+      shuffled.CloneFresh());
+  EXPECT_EQ(shuffledFresh->name(), shuffled.name());
+  EXPECT_EQ(RoundTrip(*shuffledFresh, data), data);
+}
+
+TEST(StagePipeline, SingleStage) {
+  auto data = MakeSample(5, 300);
+  StagePipeline<PackStage<SimdCompCodec>> pipeline;
+  EXPECT_EQ(pipeline.name(), "simdcomp");
+  EXPECT_EQ(RoundTrip(pipeline, data), data);
+}
+
+// pipeline.h has its own (tile) TransformStage; both headers must coexist,
+// and a StagePipeline can be a tile codec like any other.
+TEST(StagePipeline, RunsAsTilePipelineCodec) {
+  const std::size_t blockSize = 32;
+  using Shuffled = StagePipeline<ValueStage<DeltaCodec>,
+                                 ByteTransformStage<ByteShuffleStage>,
+                                 ByteCodecStage<LZ4Codec>>;
+  std::vector<CodecPtr> tiles;
+  int64_t expected = 0;
+  for (unsigned t = 0; t < 6; ++t) {
+    auto data = MakeSample(10 + t, blockSize * blockSize);
+    for (int32_t v : data) expected += v + (1 << 23);  // ValueShift
+    auto codec = std::make_unique<Shuffled>();
+    codec->AllocEncoded(data.data(), data.size());
+    codec->EncodeArray(data.data(), data.size());
+    tiles.push_back(std::move(codec));
+  }
+  TilePipeline pipeline;
+  pipeline.Add(std::make_unique<DecodeStage>())
+      .Add(std::make_unique<TransformStage>(AccessTransformation::ValueShift))
+      .Add(std::make_unique<ReduceStage>(Reduction::Sum));
+  EXPECT_EQ(pipeline.Run(tiles, blockSize, 2).reduction, expected);
+}
@@ -0,0 +1,200 @@
+#include <bit>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "composite_codec.h"
+#include "custom_unvec_logic_codecs.h"
+#include "error_bounded_codec.h"
+#include "simdcomp_for_codecs.h"
+#include "test_helpers.h"
+#include "time_stack.h"
+
+namespace {
+
+constexpr int kBlockSize = 32;
+constexpr int kWidth = kBlockSize * 3;
+constexpr int kHeight = kBlockSize * 2;
+constexpr int kDays = 9;
+constexpr std::size_t kPlane = std::size_t(kWidth) * kHeight;
+
+// Daily rasters over one grid: a surface where each day a few small patches
+// change, one day repeats the day before, and the last day shifts
+// everything.
+std::vector<int32_t> MakeDays() {
+  std::mt19937 gen(8);
+  std::uniform_int_distribution<int32_t> step(-20, 20);
+  std::uniform_int_distribution<int> px(0, kWidth - 4), py(0, kHeight - 4);
+  std::vector<int32_t> days = RandomRaster(7, kPlane, 0, 4000);
+  days.resize(kPlane * kDays);
+  for (int d = 1; d < kDays; ++d) {
+    int32_t* cur = days.data() + d * kPlane;
+    std::copy_n(cur - kPlane, kPlane, cur);
+    if (d == 4) continue;
+    if (d == kDays - 1) {
+      for (std::size_t i = 0; i < kPlane; ++i) cur[i] += 7;
+      continue;
+    }
+    for (int patch = 0; patch < 3; ++patch) {
+      int x0 = px(gen), y0 = py(gen);
+      for (int y = y0; y < y0 + 3; ++y)
+        for (int x = x0; x < x0 + 3; ++x) cur[y * kWidth + x] += step(gen);
+    }
+  }
+  return days;
+}
+
+std::vector<int32_t> Tile(const std::vector<int32_t>& days, int day, int bx,
+                          int by) {
+  std::vector<int32_t> tile;
+  for (int y = 0; y < kBlockSize; ++y) {
+    auto row = days.begin() + day * kPlane + (by * kBlockSize + y) * kWidth +
+               bx * kBlockSize;
+    tile.insert(tile.end(), row, row + kBlockSize);
+  }
+  return tile;
+}
+
+std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>> Codecs() {
+  std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>> codecs;
+  codecs.push_back(std::make_unique<DeltaCodec>());
+  codecs.push_back(std::make_unique<SimdCompFORCodec>());
+  codecs.push_back(std::make_unique<CompositeStatefulIntegerCodec<int32_t>>(
+      std::make_unique<DeltaCodec>(), std::make_unique<SimdCompFORCodec>()));
+  return codecs;
+}
+
+void ExpectRoundTrip(const std::vector<int32_t>& days, const TimeStack& stack,
+                     const std::string& what) {
+  std::vector<int32_t> out(stack.TileLength()),
+      scratch(stack.ScratchLength());
+  for (int d = 0; d < stack.numDays; ++d)
+    for (int by = 0; by < stack.blocksY; ++by)
+      for (int bx = 0; bx < stack.blocksX; ++bx) {
+        stack.DecodeTile(d, bx, by, out.data(), scratch.data());
+        ASSERT_EQ(out, Tile(days, d, bx, by))
+            << what << " day " << d << " tile " << bx << "," << by;
+      }
+}
+
+}  // namespace
+
+TEST(TimeStack, ParsesOptions) {
+  for (auto p : {TemporalPrediction::Xor, TemporalPrediction::Subtract})
+    EXPECT_EQ(ParseTemporalPrediction(ToString(p)), p);
+  EXPECT_THROW(ParseTemporalPrediction("Divide"), std::invalid_argument);
+}
+
+TEST(TimeStack, RoundTripsEveryPredictionAndKeyframeInterval) {
+  auto days = MakeDays();
+  for (auto& codec : Codecs())
+    for (auto p : {TemporalPrediction::Xor, TemporalPrediction::Subtract})
+      for (int interval : {1, 3, kDays})
+        for (int sub : {4, 8, kBlockSize})
+          for (int threads : {1, 3}) {
+            auto stack =
+                EncodeTimeStack(days.data(), kDays, kWidth, kHeight,
+                                kBlockSize, sub, interval, *codec, p, threads);
+            ExpectRoundTrip(days, stack,
+                            codec->name() + " " + ToString(p) + " every " +
+                                std::to_string(interval) + " sub " +
+                                std::to_string(sub));
+          }
+}
+
+TEST(TimeStack, ExtremeValuesRoundTrip) {
+  std::vector<int32_t> days(kPlane * 3);
+  std::mt19937 gen(9);
+  for (auto& v : days) v = static_cast<int32_t>(gen());
+  days[0] = std::numeric_limits<int32_t>::min();
+  days[kPlane] = std::numeric_limits<int32_t>::max();
+  DeltaCodec delta;
+  for (auto p : {TemporalPrediction::Xor, TemporalPrediction::Subtract})
+    ExpectRoundTrip(days,
+                    EncodeTimeStack(days.data(), 3, kWidth, kHeight,
+                                    kBlockSize, 8, 2, delta, p),
+                    ToString(p));
+}
+
+TEST(TimeStack, UnchangedSubBlocksCostOnlyTheirBit) {
+  auto days = MakeDays();
+  SimdCompFORCodec bitpacked;
+  auto stack = EncodeTimeStack(days.data(), kDays, kWidth, kHeight,
+                               kBlockSize, 8, kDays, bitpacked,
+                               TemporalPrediction::Subtract);
+  // Day 4 repeats day 3: one bitmap word per tile and no streams.
+  EXPECT_EQ(stack.DayBytes(4), stack.NumTiles() * sizeof(uint64_t));
+  for (std::size_t t = 0; t < stack.NumTiles(); ++t)
+    EXPECT_EQ(stack.Frame(4, t).values, nullptr);
+  // A few 3x3 patches touch at most 4 sub-blocks each.
+  std::size_t changed = 0;
+  for (std::size_t t = 0; t < stack.NumTiles(); ++t)
+    for (uint64_t w : stack.Frame(2, t).changed) changed += std::popcount(w);
+  EXPECT_GE(changed, 3u);
+  EXPECT_LE(changed, 12u);
+
+  // Deltas beat storing every day whole, and more keyframes cost more.
+  auto bytes = [&](int interval) {
+    return EncodeTimeStack(days.data(), kDays, kWidth, kHeight, kBlockSize, 8,
+                           interval, bitpacked, TemporalPrediction::Subtract)
+        .EncodedBytes();
+  };
+  EXPECT_LT(bytes(kDays), bytes(1) / 4);
+  EXPECT_LT(bytes(kDays), bytes(3));
+  EXPECT_LT(bytes(3), bytes(1));
+}
+
+TEST(TimeStack, RejectsBadShapes) {
+  std::vector<int32_t> days(kPlane);
+  DeltaCodec delta;
+  EXPECT_THROW(EncodeTimeStack(days.data(), 1, kWidth, kHeight, kBlockSize, 5,
+                               1, delta, TemporalPrediction::Xor),
+               std::invalid_argument);
+  EXPECT_THROW(EncodeTimeStack(days.data(), 1, kWidth, kHeight, kBlockSize, 8,
+                               0, delta, TemporalPrediction::Xor),
+               std::invalid_argument);
+  auto stack = EncodeTimeStack(days.data(), 1, kWidth, kHeight, kBlockSize, 8,
+                               1, delta, TemporalPrediction::Xor);
+  std::vector<int32_t> out(stack.TileLength()), scratch(stack.ScratchLength());
+  EXPECT_THROW(stack.DecodeTile(1, 0, 0, out.data(), scratch.data()),
+               std::out_of_range);
+  EXPECT_THROW(stack.DecodeTile(0, 3, 0, out.data(), scratch.data()),
+               std::out_of_range);
+  EXPECT_THROW(stack.DecodeTile(0, 0, -1, out.data(), scratch.data()),
+               std::out_of_range);
+}
+
+TEST(TimeStack, RejectsLossyCodecs) {
+  // Residual codes are XORs or zigzagged differences, so a bounded error in
+  // the code is not a bounded error in the value.
+  auto days = MakeDays();
+  ErrorBoundedCodec<int32_t> lossy(AbsoluteErrorBound(2),
+                                   std::make_unique<DeltaCodec>());
+  for (int threads : {1, 3})
+    EXPECT_THROW(EncodeTimeStack(days.data(), kDays, kWidth, kHeight,
+                                 kBlockSize, 8, 3, lossy,
+                                 TemporalPrediction::Subtract, threads),
+                 std::invalid_argument);
+  ErrorBoundedCodec<int32_t> exact(AbsoluteErrorBound(0),
+                                   std::make_unique<DeltaCodec>());
+  ExpectRoundTrip(days,
+                  EncodeTimeStack(days.data(), kDays, kWidth, kHeight,
+                                  kBlockSize, 8, 3, exact,
+                                  TemporalPrediction::Subtract),
+                  exact.name());
+}
+
+TEST(TimeStack, RethrowsReaderErrors) {
+  DeltaCodec delta;
+  auto failingRead = [](int day, int bx, int by, int32_t*) {
+    if (day == 2 && bx == 1 && by == 1)
+      throw std::runtime_error("read failed");
+  };
+  EXPECT_THROW(EncodeTimeStack(kDays, 3, 2, kBlockSize, 8, 3, delta,
+                               TemporalPrediction::Xor, failingRead,
+                               /* numThreads */ 4),
+               std::runtime_error);
+}
@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "test_helpers.h"
+#include "transformations.h"
+
+namespace {
+
+// Allocating reference of the original SmoothAndShift.
+std::vector<int32_t> ReferenceSmoothAndShift(std::vector<int32_t> data) {
+  if (data.size() < 2) return data;
+  std::vector<int32_t> smoothed(data.size(), 0);
+  for (std::size_t i = 1; i < data.size() - 1; ++i)
+    smoothed[i] = (data[i - 1] + data[i] + data[i + 1]) / 3;
+  smoothed[0] = (data[0] + data[1]) / 2;
+  smoothed.back() = (data[data.size() - 2] + data.back()) / 2;
+  int32_t minVal = *std::ranges::min_element(smoothed);
+  if (minVal < 0)
+    for (auto& v : smoothed) v += -minVal;
+  return smoothed;
+}
+
+class TransformationKernels : public SimdLevelTest {
+ protected:
+  // Sizes around every vector width, including tails and tiny inputs.
+  const std::vector<std::size_t> sizes = {0, 1, 2, 3, 5, 15, 16, 17,
+                                          33, 100, 4096};
+};
+
+}  // namespace
+
+TEST(SimdLevel, ParsesAndRoundTrips) {
+  for (const char* s : {"scalar", "sse41", "avx2", "avx512"})
+    EXPECT_EQ(ToString(ParseSimdLevel(s)), s);
+  EXPECT_EQ(ParseSimdLevel("auto"), DetectSimdLevel());
+  EXPECT_THROW(ParseSimdLevel("neon"), std::invalid_argument);
+}
+
+TEST_F(TransformationKernels, ThresholdMatchesScalar) {
+  for (std::size_t n : sizes) {
+    auto data = RandomRaster(static_cast<unsigned>(n), n, -1000, 1000);
+    std::vector<int32_t> expected(n);
+    std::ranges::transform(data, expected.begin(),
+                           [](int32_t v) { return v >= 17 ? 1 : 0; });
+    for (SimdLevel l : SupportedSimdLevels()) {
+      SetTransformationSimdLevel(l);
+      auto got = data;
+      Threshold(got, 17);
+      EXPECT_EQ(got, expected) << ToString(l) << " n=" << n;
+    }
+  }
+}
+
+TEST_F(TransformationKernels, ValueShiftMatchesScalar) {
+  for (std::size_t n : sizes) {
+    auto data = RandomRaster(static_cast<unsigned>(n), n, 0, 1 << 20);
+    for (SimdLevel l : SupportedSimdLevels()) {
+      SetTransformationSimdLevel(l);
+      auto got = data;
+      ValueShift(got, 1 << 23);
+      for (std::size_t i = 0; i < n; ++i)
+        ASSERT_EQ(got[i], data[i] + (1 << 23)) << ToString(l) << " i=" << i;
+    }
+  }
+}
+
+TEST_F(TransformationKernels, ValueBasedClassificationMatchesScalar) {
+  for (std::size_t n : sizes) {
+    if (n == 0) continue;
+    auto data = RandomRaster(static_cast<unsigned>(n), n, -50000, 1 << 24);
+    SetTransformationSimdLevel(SimdLevel::Scalar);
+    auto expected = data;
+    ValueBasedClassification(expected, 8);
+    for (SimdLevel l : SupportedSimdLevels()) {
+      SetTransformationSimdLevel(l);
+      auto got = data;
+      ValueBasedClassification(got, 8);
+      EXPECT_EQ(got, expected) << ToString(l) << " n=" << n;
+    }
+  }
+  std::vector<int32_t> flat(40, 7);
+  ValueBasedClassification(flat, 8);
+  EXPECT_TRUE(std::ranges::all_of(flat, [](int32_t v) { return v == 0; }));
+}
+
+TEST_F(TransformationKernels, SmoothAndShiftMatchesReference) {
+  for (std::size_t n : sizes) {
+    // Negative values exercise the truncating division and the shift.
+    auto data = RandomRaster(static_cast<unsigned>(n), n, -100000, 100000);
+    auto expected = ReferenceSmoothAndShift(data);
+    for (SimdLevel l : SupportedSimdLevels()) {
+      SetTransformationSimdLevel(l);
+      auto got = data;
+      SmoothAndShift(got);
+      EXPECT_EQ(got, expected) << ToString(l) << " n=" << n;
+    }
+  }
+}
+
+TEST_F(TransformationKernels, RejectsUnsupportedLevel) {
+  if (DetectSimdLevel() == SimdLevel::AVX512) GTEST_SKIP();
+  EXPECT_THROW(SetTransformationSimdLevel(SimdLevel::AVX512),
+               std::invalid_argument);
+}
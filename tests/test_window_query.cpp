@@ -0,0 +1,161 @@
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "composite_codec.h"
+#include "custom_unvec_logic_codecs.h"
+#include "simdcomp_codecs.h"
+#include "simdcomp_for_codecs.h"
+#include "test_helpers.h"
+#include "window_query.h"
+
+namespace {
+
+constexpr int kBlockSize = 32;
+constexpr int kWidth = kBlockSize * 5;
+constexpr int kHeight = kBlockSize * 4;
+
+std::vector<int32_t> MakeRaster() {
+  return RandomRaster(6, kWidth * kHeight, -1000, 100000);
+}
+
+std::vector<int32_t> Reference(const std::vector<int32_t>& raster,
+                               const PixelWindow& w) {
+  std::vector<int32_t> out;
+  for (int y = w.y; y < w.y + w.height; ++y)
+    for (int x = w.x; x < w.x + w.width; ++x)
+      out.push_back(raster[static_cast<std::size_t>(y) * kWidth + x]);
+  return out;
+}
+
+}  // namespace
+
+TEST(WindowQuery, MatchesRasterForAnyWindow) {
+  auto raster = MakeRaster();
+  // Cursor-based partial decode (delta), random access (SimdComp FOR) and
+  // the decode-everything fallback through a composite.
+  std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>> codecs;
+  codecs.push_back(std::make_unique<DeltaCodec>());
+  codecs.push_back(std::make_unique<SimdCompFORCodec>());
+  codecs.push_back(std::make_unique<CompositeStatefulIntegerCodec<int32_t>>(
+      std::make_unique<DeltaCodec>(), std::make_unique<SimdCompCodec>()));
+  std::mt19937 gen(7);
+  for (auto& codec : codecs) {
+    auto grid =
+        EncodeBlockGrid(raster.data(), kWidth, kHeight, kBlockSize, *codec);
+    std::vector<PixelWindow> windows = {{0, 0, kWidth, kHeight},
+                                        {0, 0, 1, 1},
+                                        {kWidth - 1, kHeight - 1, 1, 1},
+                                        {kBlockSize, kBlockSize, kBlockSize,
+                                         kBlockSize},
+                                        {5, 40, 100, 3}};
+    for (int i = 0; i < 20; ++i) {
+      int x = std::uniform_int_distribution<int>(0, kWidth - 1)(gen);
+      int y = std::uniform_int_distribution<int>(0, kHeight - 1)(gen);
+      windows.push_back(
+          {x, y, std::uniform_int_distribution<int>(1, kWidth - x)(gen),
+           std::uniform_int_distribution<int>(1, kHeight - y)(gen)});
+    }
+    for (auto& w : windows)
+      for (int threads : {1, 3})
+        EXPECT_EQ(ReadWindow(grid, w, threads), Reference(raster, w))
+            << codec->name() << " " << ToString(w) << " t=" << threads;
+  }
+}
+
+TEST(WindowQuery, PrunesTilesAndDecodesOnlyNeededRows) {
+  auto raster = MakeRaster();
+  DeltaCodec delta;
+  auto grid = EncodeBlockGrid(raster.data(), kWidth, kHeight, kBlockSize, delta);
+  WindowQueryStats stats;
+  // Rows 40..42 sit inside tile row 1; columns 5..104 span tiles 0..3.
+  ReadWindow(grid, {5, 40, 100, 3}, 1, &stats);
+  EXPECT_EQ(stats.tilesPartial, 4u);
+  EXPECT_EQ(stats.tilesFull, 0u);
+  EXPECT_EQ(stats.tilesSkipped, grid.tiles.size() - 4);
+  EXPECT_EQ(stats.rowsDecoded, 4u * 3);
+
+  // Tile-aligned 2x2 block of tiles: whole-tile decodes only.
+  ReadWindow(grid, {kBlockSize, 0, 2 * kBlockSize, 2 * kBlockSize}, 2, &stats);
+  EXPECT_EQ(stats.tilesFull, 4u);
+  EXPECT_EQ(stats.tilesPartial, 0u);
+
+  EXPECT_THROW(ReadWindow(grid, {kWidth - 4, 0, 5, 1}), std::invalid_argument);
+  EXPECT_THROW(ReadWindow(grid, {0, 0, 0, 3}), std::invalid_argument);
+}
+
+TEST(WindowQuery, GeoWindowsUseTheGeotransform) {
+  auto raster = MakeRaster();
+  DeltaCodec delta;
+  auto grid = EncodeBlockGrid(raster.data(), kWidth, kHeight, kBlockSize, delta);
+  // 30 m pixels, north-up, origin at (100000, 200000).
+  GeoTransform t{{100000, 30, 0, 200000, 0, -30}};
+  double gx, gy;
+  t.ToGeo(10, 20, gx, gy);
+  EXPECT_DOUBLE_EQ(gx, 100300);
+  EXPECT_DOUBLE_EQ(gy, 199400);
+
+  // Pixel-aligned box over columns 10..19 and rows 20..24.
+  PixelWindow w;
+  auto values = ReadGeoWindow(grid, t, 100300, 200000 - 25 * 30, 100600,
+                              200000 - 20 * 30, w);
+  EXPECT_EQ(w, (PixelWindow{10, 20, 10, 5}));
+  EXPECT_EQ(values, Reference(raster, w));
+
+  // A box inside one pixel reads that pixel; one hanging off the raster is
+  // clipped to it.
+  EXPECT_EQ(GeoToPixelWindow(t, 100301, 199390, 100302, 199391),
+            (PixelWindow{10, 20, 1, 1}));
+  ReadGeoWindow(grid, t, 90000, 190000, 100000 + 3 * 30, 210000, w);
+  EXPECT_EQ(w, (PixelWindow{0, 0, 3, kHeight}));
+  EXPECT_THROW(ReadGeoWindow(grid, t, 0, 0, 10, 10, w), std::invalid_argument);
+}
+
+TEST(WindowQuery, ConstantTilesAreFilledWithoutDecoding) {
+  auto raster = MakeRaster();
+  // Tile row 0 is nodata except for a few pixels in tile (2, 0) and a column
+  // of them in tile (3, 0).
+  for (int y = 0; y < kBlockSize; ++y)
+    for (int x = 0; x < kWidth; ++x) raster[y * kWidth + x] = -9999;
+  raster[5 * kWidth + 2 * kBlockSize + 7] = 12;
+  raster[30 * kWidth + 2 * kBlockSize + 1] = 13;
+  for (int y = 0; y < kBlockSize; ++y) raster[y * kWidth + 3 * kBlockSize] = y;
+
+  DeltaCodec delta;
+  auto grid = EncodeBlockGrid(raster.data(), kWidth, kHeight, kBlockSize, delta);
+  EXPECT_EQ(grid.Tile(0, 0).name(), "constant");
+  EXPECT_EQ(grid.Tile(2, 0).name(), "near_constant");
+  EXPECT_EQ(grid.Tile(3, 0).name(), delta.name());
+  EXPECT_EQ(grid.Tile(0, 1).name(), delta.name());
+  int32_t value;
+  EXPECT_TRUE(grid.TileConstant(4, 0, value));
+  EXPECT_EQ(value, -9999);
+  EXPECT_FALSE(grid.TileConstant(2, 0, value));
+  EXPECT_LT(grid.EncodedBytes(),
+            EncodeBlockGrid(raster.data(), kWidth, kHeight, kBlockSize, delta,
+                            1, false, /* constantTiles */ false)
+                .EncodedBytes());
+
+  // Tile row 0 plus part of row 1: three constant tiles are filled.
+  PixelWindow w{0, 10, kWidth, 30};
+  WindowQueryStats stats;
+  EXPECT_EQ(ReadWindow(grid, w, 2, &stats), Reference(raster, w));
+  EXPECT_EQ(stats.tilesFilled, 3u);
+  EXPECT_EQ(stats.tilesPartial, 7u);
+  EXPECT_EQ(ReadWindow(grid, {0, 0, kWidth, kHeight}),
+            Reference(raster, {0, 0, kWidth, kHeight}));
+}
+
+TEST(WindowQuery, RethrowsTileFailures) {
+  auto raster = MakeRaster();
+  DeltaCodec delta;
+  auto grid = EncodeBlockGrid(raster.data(), kWidth, kHeight, kBlockSize, delta);
+  FailTileDecodes(grid, 6);  // tile (1, 1)
+  // Whole-tile decode, then a partial one through the cursor.
+  for (PixelWindow w : {PixelWindow{0, 0, kWidth, kHeight},
+                        PixelWindow{40, 40, 10, 10}})
+    for (int threads : {1, 3})
+      EXPECT_THROW(ReadWindow(grid, w, threads), std::runtime_error);
+}
@@ -0,0 +1,140 @@
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "composite_codec.h"
+#include "custom_unvec_logic_codecs.h"
+#include "simdcomp_codecs.h"
+#include "test_helpers.h"
+#include "zonal.h"
+
+namespace {
+
+constexpr int kBlockSize = 40;
+constexpr int kWidth = kBlockSize * 3;
+constexpr int kHeight = kBlockSize * 2;
+
+// Land-cover-like zones: horizontal stripes of varying length, plus a few
+// isolated pixels so some runs are shorter than a vector.
+std::vector<int32_t> MakeZones() {
+  std::mt19937 gen(3);
+  std::uniform_int_distribution<int32_t> zone(0, 6), len(1, 90);
+  std::vector<int32_t> zones(kWidth * kHeight);
+  for (std::size_t i = 0; i < zones.size();) {
+    int32_t z = zone(gen);
+    for (int n = len(gen); n > 0 && i < zones.size(); --n) zones[i++] = z;
+  }
+  for (std::size_t i = 17; i < zones.size(); i += 613) zones[i] = 100 + i % 3;
+  return zones;
+}
+
+ZoneTable Reference(const std::vector<int32_t>& values,
+                    const std::vector<int32_t>& zones) {
+  ZoneTable table;
+  for (std::size_t i = 0; i < values.size(); ++i) table[zones[i]].Add(values[i]);
+  return table;
+}
+
+std::unique_ptr<StatefulIntegerCodec<int32_t>> RLEPlusSimdComp() {
+  return std::make_unique<CompositeStatefulIntegerCodec<int32_t>>(
+      std::make_unique<RLECodec>(), std::make_unique<SimdCompCodec>());
+}
+
+class ZonalTest : public SimdLevelTest {
+ protected:
+  std::vector<int32_t> zones = MakeZones();
+  std::vector<int32_t> values =
+      RandomRaster(4, kWidth * kHeight, -50000, 2000000);
+};
+
+}  // namespace
+
+TEST_F(ZonalTest, MatchesPerPixelReference) {
+  auto expected = Reference(values, zones);
+  DeltaCodec delta;
+  auto valueGrid =
+      EncodeBlockGrid(values.data(), kWidth, kHeight, kBlockSize, delta);
+
+  // Native runs (RLE, RLE inside a composite) and decode-and-scan (Delta).
+  std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>> zoneCodecs;
+  zoneCodecs.push_back(std::make_unique<RLECodec>());
+  zoneCodecs.push_back(RLEPlusSimdComp());
+  zoneCodecs.push_back(std::make_unique<DeltaCodec>());
+  for (auto& zoneCodec : zoneCodecs) {
+    auto zoneGrid =
+        EncodeBlockGrid(zones.data(), kWidth, kHeight, kBlockSize, *zoneCodec);
+    for (SimdLevel l : SupportedSimdLevels()) {
+      SetTransformationSimdLevel(l);
+      for (int threads : {1, 3}) {
+        ZonalTiming timing;
+        EXPECT_EQ(ZonalStatistics(valueGrid, zoneGrid, threads, &timing),
+                  expected)
+            << zoneCodec->name() << " " << ToString(l) << " t=" << threads;
+        EXPECT_GT(timing.numRuns, expected.size());
+      }
+    }
+  }
+}
+
+TEST_F(ZonalTest, RunsAreMergedAcrossRows) {
+  std::vector<int32_t> flat(kWidth * kHeight, 9);
+  RLECodec rle;
+  auto zoneGrid = EncodeBlockGrid(flat.data(), kWidth, kHeight, kBlockSize, rle);
+  auto valueGrid =
+      EncodeBlockGrid(values.data(), kWidth, kHeight, kBlockSize, rle);
+  ZonalTiming timing;
+  auto table = ZonalStatistics(valueGrid, zoneGrid, 1, &timing);
+  EXPECT_EQ(timing.numRuns, zoneGrid.tiles.size());  // one run per tile
+  ASSERT_EQ(table.size(), 1u);
+  EXPECT_EQ(table[9], Reference(values, flat)[9]);
+}
+
+TEST_F(ZonalTest, RejectsMismatchedGrids) {
+  RLECodec rle;
+  auto a = EncodeBlockGrid(values.data(), kWidth, kHeight, kBlockSize, rle);
+  auto b = EncodeBlockGrid(values.data(), kWidth, kHeight, kBlockSize / 2, rle);
+  EXPECT_THROW(ZonalStatistics(a, b), std::invalid_argument);
+}
+
+TEST_F(ZonalTest, RethrowsTileFailures) {
+  RLECodec rle;
+  DeltaCodec delta;
+  auto zoneGrid = EncodeBlockGrid(zones.data(), kWidth, kHeight, kBlockSize, rle);
+  auto valueGrid =
+      EncodeBlockGrid(values.data(), kWidth, kHeight, kBlockSize, delta);
+  FailTileDecodes(zoneGrid, 4);
+  EXPECT_THROW(ZonalStatistics(valueGrid, zoneGrid, 3), std::runtime_error);
+}
+
+TEST_F(ZonalTest, SkipsNoDataPixels) {
+  // A nodata "sea" over the left third, a few scattered nodata pixels, and a
+  // nodata zone that belongs to no zone.
+  constexpr int32_t kNoData = -9999;
+  for (int y = 0; y < kHeight; ++y)
+    for (int x = 0; x < kWidth / 3 + y % 7; ++x) values[y * kWidth + x] = kNoData;
+  for (std::size_t i = 5; i < values.size(); i += 97) values[i] = kNoData;
+  for (std::size_t i = 0; i < 200; ++i) zones[i] = -1;
+
+  ZoneTable expected;
+  for (std::size_t i = 0; i < values.size(); ++i)
+    if (values[i] != kNoData && zones[i] != -1)
+      expected[zones[i]].Add(values[i]);
+
+  RLECodec rle;
+  auto zoneGrid = EncodeBlockGrid(zones.data(), kWidth, kHeight, kBlockSize,
+                                  rle, 1, false, true, {true, -1});
+  DeltaCodec delta;
+  for (NoDataMode mode :
+       {NoDataMode::None, NoDataMode::Split, NoDataMode::Fill}) {
+    auto valueGrid =
+        EncodeBlockGrid(values.data(), kWidth, kHeight, kBlockSize, delta, 1,
+                        false, true, {true, kNoData, mode});
+    for (SimdLevel l : SupportedSimdLevels()) {
+      SetTransformationSimdLevel(l);
+      EXPECT_EQ(ZonalStatistics(valueGrid, zoneGrid, 2), expected)
+          << ToString(mode) << " " << ToString(l);
+    }
+  }
+}
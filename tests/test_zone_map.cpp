@@ -0,0 +1,198 @@
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "bitmap_codecs.h"
+#include "composite_codec.h"
+#include "custom_unvec_logic_codecs.h"
+#include "simdcomp_codecs.h"
+#include "test_helpers.h"
+#include "zone_map.h"
+
+namespace {
+
+constexpr int kBlockSize = 40;
+constexpr int kWidth = kBlockSize * 4;
+constexpr int kHeight = kBlockSize * 3;
+
+// Elevation-like raster: a flat sea (0) over the left column of tiles, a
+// plateau of 5000 over the right one, and noisy terrain between them whose
+// tiles each sit in their own band of values.
+std::vector<int32_t> MakeRaster() {
+  std::mt19937 gen(5);
+  std::uniform_int_distribution<int32_t> noise(0, 300);
+  std::vector<int32_t> r(kWidth * kHeight);
+  for (int y = 0; y < kHeight; ++y)
+    for (int x = 0; x < kWidth; ++x) {
+      int bx = x / kBlockSize, by = y / kBlockSize;
+      int32_t& v = r[static_cast<std::size_t>(y) * kWidth + x];
+      if (bx == 0)
+        v = 0;
+      else if (bx == 3)
+        v = 5000;
+      else
+        v = 1000 * (bx + by) + noise(gen);
+    }
+  return r;
+}
+
+std::unique_ptr<StatefulIntegerCodec<int32_t>> DeltaPlusSimdComp() {
+  return std::make_unique<CompositeStatefulIntegerCodec<int32_t>>(
+      std::make_unique<DeltaCodec>(), std::make_unique<SimdCompCodec>());
+}
+
+class ZoneMapTest : public SimdLevelTest {
+ protected:
+  std::vector<int32_t> raster = MakeRaster();
+};
+
+}  // namespace
+
+TEST(ValuePredicate, ParsesAndNormalises) {
+  auto p = ParseValuePredicate("gt:2000");
+  EXPECT_EQ(p.Lo(), 2001);
+  EXPECT_EQ(p.Hi(), INT32_MAX);
+  p = ParseValuePredicate("lt:-5");
+  EXPECT_EQ(p.Lo(), INT32_MIN);
+  EXPECT_EQ(p.Hi(), -6);
+  p = ParseValuePredicate("between:100:200");
+  EXPECT_EQ(p.Lo(), 100);
+  EXPECT_EQ(p.Hi(), 200);
+  EXPECT_EQ(ToString(p), "between:100:200");
+  EXPECT_EQ(ToString(ParseValuePredicate("eq:7")), "eq:7");
+  // Nothing is below INT32_MIN.
+  EXPECT_GT(ParseValuePredicate("lt:-2147483648").Lo(),
+            ParseValuePredicate("lt:-2147483648").Hi());
+  EXPECT_THROW(ParseValuePredicate("gt"), std::invalid_argument);
+  EXPECT_THROW(ParseValuePredicate("ne:3"), std::invalid_argument);
+  EXPECT_THROW(ParseValuePredicate("ge:12x"), std::invalid_argument);
+  EXPECT_THROW(ParseValuePredicate("between:1"), std::invalid_argument);
+}
+
+TEST(ZoneMap, ClassifiesTilesFromRangeAndHistogram) {
+  // Two clusters, [0, 9] and [150, 159], with nothing in between.
+  std::vector<int32_t> tile;
+  for (int i = 0; i < 10; ++i) {
+    tile.push_back(i);
+    tile.push_back(150 + i);
+  }
+  auto plain = ComputeTileSynopsis(tile.data(), tile.size(), false);
+  auto hist = ComputeTileSynopsis(tile.data(), tile.size(), true);
+  EXPECT_EQ(plain.min, 0);
+  EXPECT_EQ(plain.max, 159);
+  EXPECT_EQ(plain.bitWidth, 8u);
+  EXPECT_FALSE(plain.hasHistogram);
+  uint32_t total = 0;
+  for (auto c : hist.histogram) total += c;
+  EXPECT_EQ(total, tile.size());
+
+  EXPECT_EQ(ClassifyTile(plain, 200, 300), TileMatch::None);
+  EXPECT_EQ(ClassifyTile(plain, -10, 159), TileMatch::All);
+  // The gap: min/max alone cannot tell, the histogram can.
+  EXPECT_EQ(ClassifyTile(plain, 40, 100), TileMatch::Some);
+  EXPECT_EQ(ClassifyTile(hist, 40, 100), TileMatch::None);
+  EXPECT_EQ(ClassifyTile(plain, 0, 9), TileMatch::Some);
+  EXPECT_EQ(ClassifyTile(hist, 0, 9), TileMatch::Some);
+  EXPECT_EQ(ClassifyTile(hist, 5, 155), TileMatch::Some);
+  EXPECT_EQ(ClassifyTile(hist, -3, 200), TileMatch::All);
+}
+
+TEST_F(ZoneMapTest, MatchesPerPixelReference) {
+  std::vector<std::unique_ptr<StatefulIntegerCodec<int32_t>>> codecs;
+  codecs.push_back(std::make_unique<DeltaCodec>());
+  codecs.push_back(DeltaPlusSimdComp());
+  BitsetCodec bitset;
+  for (auto& codec : codecs)
+    for (bool histograms : {false, true}) {
+      auto grid = EncodeBlockGrid(raster.data(), kWidth, kHeight, kBlockSize,
+                                  *codec, 1, histograms);
+      ASSERT_TRUE(grid.HasSynopses());
+      for (auto text : {"ge:0", "gt:5000", "between:2100:2200", "eq:5000",
+                        "lt:1", "le:3150", "between:9:8"}) {
+        auto p = ParseValuePredicate(text);
+        uint64_t expected = 0;
+        for (int32_t v : raster) expected += p.Matches(v);
+        for (SimdLevel l : SupportedSimdLevels()) {
+          SetTransformationSimdLevel(l);
+          for (int threads : {1, 3})
+            for (bool useZoneMaps : {false, true}) {
+              EXPECT_EQ(CountMatching(grid, p, threads, useZoneMaps), expected)
+                  << codec->name() << " " << text << " " << ToString(l);
+              auto mask =
+                  PredicateMask(grid, p, bitset, threads, useZoneMaps);
+              ASSERT_TRUE(mask.HasSynopses());
+              std::vector<int32_t> tile(mask.TileLength() +
+                                        mask.MaxOverflow());
+              for (int by = 0; by < grid.blocksY; ++by)
+                for (int bx = 0; bx < grid.blocksX; ++bx) {
+                  mask.DecodeTile(bx, by, tile.data());
+                  for (int y = 0; y < kBlockSize; ++y)
+                    for (int x = 0; x < kBlockSize; ++x) {
+                      int32_t v = raster[static_cast<std::size_t>(
+                                             by * kBlockSize + y) *
+                                             kWidth +
+                                         bx * kBlockSize + x];
+                      ASSERT_EQ(tile[y * kBlockSize + x], p.Matches(v))
+                          << text << " tile " << bx << "," << by;
+                    }
+                }
+            }
+        }
+      }
+    }
+}
+
+TEST_F(ZoneMapTest, CountsSkippedAndFilledTiles) {
+  DeltaCodec delta;
+  auto grid = EncodeBlockGrid(raster.data(), kWidth, kHeight, kBlockSize,
+                              delta, 1, true);
+  const std::size_t tiles = grid.tiles.size();
+
+  // Only the sea tiles can hold 0; the rest are skipped.
+  ZoneMapStats stats;
+  CountMatching(grid, ParseValuePredicate("eq:0"), 1, true, &stats);
+  EXPECT_EQ(stats.tilesSkipped, tiles - grid.blocksY);
+  EXPECT_EQ(stats.tilesFilled, static_cast<std::size_t>(grid.blocksY));
+  EXPECT_EQ(stats.tilesDecoded, 0u);
+
+  // Terrain tiles with bx + by == 2 straddle 2150; everything else is
+  // settled by its range.
+  CountMatching(grid, ParseValuePredicate("ge:2150"), 3, true, &stats);
+  EXPECT_EQ(stats.tilesDecoded, 2u);
+  EXPECT_EQ(stats.tilesSkipped + stats.tilesFilled + stats.tilesDecoded,
+            tiles);
+
+  // Without zone maps every tile is decoded.
+  CountMatching(grid, ParseValuePredicate("eq:0"), 1, false, &stats);
+  EXPECT_EQ(stats.tilesDecoded, tiles);
+  EXPECT_EQ(stats.tilesSkipped, 0u);
+
+  // A grid without synopses falls back to decoding, except for constant
+  // tiles, which settle themselves.
+  grid.synopses.clear();
+  std::size_t constant = 0;
+  int32_t value;
+  for (int by = 0; by < grid.blocksY; ++by)
+    for (int bx = 0; bx < grid.blocksX; ++bx)
+      constant += grid.TileConstant(bx, by, value);
+  EXPECT_GE(constant, static_cast<std::size_t>(grid.blocksY));
+  EXPECT_EQ(CountMatching(grid, ParseValuePredicate("eq:0"), 1, true, &stats),
+            static_cast<uint64_t>(kBlockSize) * kHeight);
+  EXPECT_EQ(stats.tilesDecoded, tiles - constant);
+}
+
+TEST_F(ZoneMapTest, RethrowsTileFailures) {
+  DeltaCodec delta;
+  auto grid = EncodeBlockGrid(raster.data(), kWidth, kHeight, kBlockSize,
+                              delta, 1, true);
+  FailTileDecodes(grid, 4);
+  const auto p = ParseValuePredicate("ge:2150");
+  BitsetCodec bitset;
+  for (int threads : {1, 3}) {
+    EXPECT_THROW(CountMatching(grid, p, threads, false), std::runtime_error);
+    EXPECT_THROW(PredicateMask(grid, p, bitset, threads, false),
+                 std::runtime_error);
+  }
+}